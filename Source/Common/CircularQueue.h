@@ -21,6 +21,7 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 namespace Sim {
 
@@ -63,6 +64,23 @@ namespace Sim {
 				_full.notify_one ();
 			}
 
+			// copy of the queued elements, oldest first
+			void Contents (std::vector <T>& result)
+			{
+				std::unique_lock <std::mutex> loki (_mutex);
+				result.clear ();
+				for (unsigned int i = _readIndex; i != _writeIndex; i = Index (i + 1)){
+					result.push_back (_queue [i]);
+				}
+			}
+
+			void Clear ()
+			{
+				std::unique_lock <std::mutex> loki (_mutex);
+				_readIndex = _writeIndex = 0;
+				_full.notify_all ();
+			}
+
 		protected:
 			bool Full () {return (_writeIndex -_readIndex == size - 1) || (_writeIndex == _readIndex - 1);}
 			bool Empty () {return (_writeIndex == _readIndex);}
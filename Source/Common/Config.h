@@ -6,6 +6,7 @@
 #define SIM_GL_ENABLED
 /* #undef SIM_VK_ENABLED */
 /* #undef SIM_DX_ENABLED */
+/* #undef SIM_HEADLESS_ENABLED */
 
 /* #undef SIM_CL_ENABLED */
 #define SIM_CUDA_ENABLED
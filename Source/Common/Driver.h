@@ -15,4 +15,6 @@
 
 #if defined (SIM_GL_ENABLED)
 #	include "GLDriver/Driver.h"
+#elif defined (SIM_HEADLESS_ENABLED)
+#	include "HeadlessDriver/Driver.h"
 #endif
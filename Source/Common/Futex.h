@@ -0,0 +1,102 @@
+/**
+ * @file Futex.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * A counter other threads can block on until it changes. Increment ()
+ * never blocks and only enters the kernel when somebody waits; Wait ()
+ * sleeps in the kernel (a futex on Linux, a condition variable elsewhere)
+ * instead of spinning.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+
+#ifdef __linux__
+extern "C" {
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <time.h>
+#	include <unistd.h>
+}
+#else
+#	include <condition_variable>
+#	include <mutex>
+#endif
+
+namespace Sim {
+
+	class Futex {
+
+		private:
+			std::atomic <unsigned int> _value;
+			std::atomic <unsigned int> _waiters;
+#			ifndef __linux__
+			std::mutex _mutex;
+			std::condition_variable _changed;
+#			endif
+
+		public:
+			Futex (): _value (0), _waiters (0) {}
+			~Futex () {}
+
+			// forbidden copy constructor and assignment operator
+			Futex (const Futex&) = delete;
+			Futex& operator = (const Futex&) = delete;
+
+			unsigned int Load () const {return _value.load (std::memory_order_acquire);}
+
+			void Increment ()
+			{
+				_value.fetch_add (1);
+				if (_waiters.load () == 0){
+					return;
+				}
+#				ifdef __linux__
+				syscall (SYS_futex, reinterpret_cast <unsigned int*> (&_value), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#				else
+				{
+					std::lock_guard <std::mutex> lock (_mutex);
+				}
+				_changed.notify_all ();
+#				endif
+			}
+
+			/**
+			 * Blocks until the value differs from 'seen' or the timeout expires;
+			 * returns whether it changed.
+			 */
+			bool Wait (unsigned int seen, std::chrono::nanoseconds timeout)
+			{
+				if (Load () != seen){
+					return true;
+				}
+				std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now () + timeout;
+				_waiters.fetch_add (1);
+#				ifdef __linux__
+				// the kernel rechecks the value before sleeping, so a wake between the check and the call is not lost
+				while (_value.load () == seen){
+					std::chrono::nanoseconds left = deadline - std::chrono::steady_clock::now ();
+					if (left.count () <= 0){
+						break;
+					}
+					struct timespec relative;
+					relative.tv_sec = static_cast <time_t> (left.count ()/1000000000);
+					relative.tv_nsec = static_cast <long> (left.count ()%1000000000);
+					syscall (SYS_futex, reinterpret_cast <unsigned int*> (&_value), FUTEX_WAIT_PRIVATE, seen, &relative, nullptr, 0);
+				}
+#				else
+				{
+					std::unique_lock <std::mutex> lock (_mutex);
+					_changed.wait_until (lock, deadline, [this, seen] {return _value.load () != seen;});
+				}
+#				endif
+				_waiters.fetch_sub (1);
+				return Load () != seen;
+			}
+	};
+}
@@ -65,4 +65,9 @@ namespace Sim {
 		}
 		return result;
 	}
+
+	XMLElement* InputParser::FindElement (const char* name)
+	{
+		return _root->FirstChildElement (name);
+	}
 }
@@ -39,6 +39,8 @@ namespace Sim {
 			bool Initialize (const char*, const char*);
 			const char* DocName () const;
 			tinyxml2::XMLElement* GetElement (const char*);
+			// same as GetElement () for optional elements: a missing one is not an error
+			tinyxml2::XMLElement* FindElement (const char*);
 
 	};
 }
@@ -151,7 +151,7 @@ namespace Sim {
 				for (unsigned int i = 0; i < numIndices; ++i){
 					status = fscanf ( fp, "%d %d %d\n", &(inds [0]), &(inds [1]), &(inds [2]));
 #					ifndef NDEBUG
-					if (!status || inds [0] < 0 || inds [1] < 0 || inds [2] << 0 || inds [3] < 0){
+					if (!status || inds [0] < 0 || inds [1] < 0 || inds [2] < 0){
 						LOG_ERROR ("Invalid index set [" << i << "]: " << inds [0] << ", " << inds [1] << ", " << inds [2] << " in " << file);
 						fclose (fp);
 						return false;
@@ -166,7 +166,7 @@ namespace Sim {
 				for (unsigned int i = 0; i < numIndices; ++i){
 					status = fscanf ( fp, "%d %d %d %d\n", &(inds [0]), &(inds [1]), &(inds [2]), &(inds [3]));
 #					ifndef NDEBUG
-					if (!status || inds [0] < 0 || inds [1] < 0 || inds [2] << 0 || inds [3] < 0){
+					if (!status || inds [0] < 0 || inds [1] < 0 || inds [2] < 0){
 						LOG_ERROR ("Invalid index set [" << i << "]: " << inds [0] << ", " << inds [1] <<
 								", " << inds [2] << ", " << inds [3] << " in " << file);
 						fclose (fp);
@@ -0,0 +1,36 @@
+/**
+ * @file SharedCache.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See SharedCache.h
+ */
+
+#include "Preprocess.h"
+#include "SharedCache.h"
+
+namespace Sim {
+
+	SharedCache& SharedCache::Instance ()
+	{
+		static SharedCache cache;
+		return cache;
+	}
+
+	void SharedCache::Clear ()
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		_entries.clear ();
+		_hits = _misses = 0;
+		_bytes = _saved = 0;
+	}
+
+	void SharedCache::Report ()
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		LOG ("Shared cache: " << _entries.size () << " entries (" << _bytes/1048576. << " MB) loaded once, " << _hits << " hits, "
+				<< _misses << " misses, " << _saved/1048576. << " MB not loaded again");
+	}
+}
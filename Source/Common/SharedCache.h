@@ -0,0 +1,129 @@
+/**
+ * @file SharedCache.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The process-wide cache of read-only data shared by the simulation
+ * instances of a batch run (see BatchRunner.h): meshes and their rest
+ * state, precomputed matrices, textures. An entry is loaded once, by the
+ * first caller asking for its key, while later callers wait for it; all
+ * of them then share one immutable copy and keep their mutable state in
+ * copies of their own. Keys start with the type of the data (e.g.
+ * "Geometry <prefix>"), so that one key always maps to one type.
+ * The cache is disabled by default, in which case Get () just loads the
+ * data and keeps nothing.
+ */
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Sim {
+
+	class SharedCache {
+
+		protected:
+			class Entry {
+				public:
+					std::promise <std::shared_ptr <const void> > _promise;
+					std::shared_future <std::shared_ptr <const void> > _data;
+					size_t _bytes;
+
+					Entry (): _data (_promise.get_future ().share ()), _bytes (0) {}
+			};
+
+			std::mutex _mutex;
+			std::map <std::string, std::shared_ptr <Entry> > _entries;
+			std::atomic <bool> _enabled;
+			unsigned long long _hits;
+			unsigned long long _misses;
+			size_t _bytes; // held by the entries
+			size_t _saved; // not loaded again thanks to the cache
+
+		protected:
+			SharedCache (): _enabled (false), _hits (0), _misses (0), _bytes (0), _saved (0) {}
+
+		public:
+			static SharedCache& Instance ();
+			~SharedCache () {}
+
+			// forbidden copy constructor and assignment operator
+			SharedCache (const SharedCache&) = delete;
+			SharedCache& operator = (const SharedCache&) = delete;
+
+			void SetEnabled (bool flag) {_enabled.store (flag);}
+			bool Enabled () const {return _enabled.load ();}
+			// drop every entry (the data stays alive as long as somebody uses it)
+			void Clear ();
+
+			/**
+			 * The data of 'key', loaded through 'load' on a miss. The loader sets the
+			 * size of what it loaded, in bytes, for the statistics. A failed load
+			 * (null data) is not kept, so a later call tries again. If the loader
+			 * throws, the callers waiting for it get the same exception.
+			 */
+			template <class T> std::shared_ptr <const T> Get (const std::string& key, const std::function <std::shared_ptr <const T> (size_t&)>& load)
+			{
+				size_t bytes = 0;
+				if (!Enabled ()){
+					return load (bytes);
+				}
+				std::shared_ptr <Entry> entry;
+				bool loader = false;
+				{
+					std::lock_guard <std::mutex> lock (_mutex);
+					auto e = _entries.find (key);
+					if (e == _entries.end ()){
+						entry = std::make_shared <Entry> ();
+						_entries [key] = entry;
+						++_misses;
+						loader = true;
+					} else {
+						entry = e->second;
+					}
+				}
+				if (loader){
+					std::shared_ptr <const T> data;
+					try {
+						data = load (bytes);
+					} catch (...){
+						{
+							std::lock_guard <std::mutex> lock (_mutex);
+							_entries.erase (key);
+						}
+						entry->_promise.set_exception (std::current_exception ());
+						throw;
+					}
+					{
+						std::lock_guard <std::mutex> lock (_mutex);
+						if (data){
+							entry->_bytes = bytes;
+							_bytes += bytes;
+						} else {
+							_entries.erase (key);
+						}
+					}
+					entry->_promise.set_value (data);
+					return data;
+				}
+				std::shared_ptr <const void> data = entry->_data.get ();
+				if (data){
+					std::lock_guard <std::mutex> lock (_mutex);
+					++_hits;
+					_saved += entry->_bytes;
+				}
+				return std::static_pointer_cast <const T> (data);
+			}
+
+			// log the entries, hits and the memory shared
+			void Report ();
+	};
+}
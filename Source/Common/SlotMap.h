@@ -0,0 +1,131 @@
+/**
+ * @file SlotMap.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Template for a dense table of values addressed by generational handles.
+ * Insert () returns a handle (slot index and generation) that finds its
+ * value in O(1) for as long as the value is in the table, whatever is
+ * inserted or removed meanwhile; once the value is removed, the slot's
+ * generation moves on and the handle finds nothing, even after the slot
+ * is reused. The values themselves are kept contiguous (a removal moves
+ * the last value into the gap), so iterating over them is a walk over an
+ * array, in insertion order until the first removal.
+ * Not thread-safe: the owner serializes changes against lookups.
+ */
+#pragma once
+
+#include <climits>
+#include <utility>
+#include <vector>
+
+namespace Sim {
+
+	class SlotHandle {
+		public:
+			unsigned int _index;
+			unsigned int _generation; // 0: never valid
+
+			SlotHandle (): _index (UINT_MAX), _generation (0) {}
+			SlotHandle (unsigned int index, unsigned int generation): _index (index), _generation (generation) {}
+
+			bool Valid () const {return _generation != 0;}
+			bool operator == (const SlotHandle& h) const {return _index == h._index && _generation == h._generation;}
+			bool operator != (const SlotHandle& h) const {return !(*this == h);}
+	};
+
+	template <class T> class SlotMap {
+
+		protected:
+			class Slot {
+				public:
+					unsigned int _generation;
+					unsigned int _dense; // index of its value (UINT_MAX: free)
+
+					Slot (): _generation (1), _dense (UINT_MAX) {}
+			};
+
+			std::vector <Slot> _slots;
+			std::vector <unsigned int> _free; // free slots, reused last freed first
+			std::vector <T> _values;
+			std::vector <unsigned int> _owners; // slot of every value
+
+		public:
+			typedef typename std::vector <T>::iterator iterator;
+			typedef typename std::vector <T>::const_iterator const_iterator;
+
+			SlotMap () {}
+			~SlotMap () {}
+
+			SlotHandle Insert (const T& value)
+			{
+				unsigned int index;
+				if (_free.empty ()){
+					index = static_cast <unsigned int> (_slots.size ());
+					_slots.emplace_back ();
+				} else {
+					index = _free.back ();
+					_free.pop_back ();
+				}
+				_slots [index]._dense = static_cast <unsigned int> (_values.size ());
+				_values.push_back (value);
+				_owners.push_back (index);
+				return SlotHandle (index, _slots [index]._generation);
+			}
+
+			bool Remove (const SlotHandle& handle)
+			{
+				if (!Contains (handle)){
+					return false;
+				}
+				Slot& slot = _slots [handle._index];
+				unsigned int last = static_cast <unsigned int> (_values.size () - 1);
+				if (slot._dense != last){
+					_values [slot._dense] = std::move (_values [last]);
+					_owners [slot._dense] = _owners [last];
+					_slots [_owners [last]]._dense = slot._dense;
+				}
+				_values.pop_back ();
+				_owners.pop_back ();
+				slot._dense = UINT_MAX;
+				slot._generation = slot._generation == UINT_MAX ? 1 : slot._generation + 1;
+				_free.push_back (handle._index);
+				return true;
+			}
+
+			bool Contains (const SlotHandle& handle) const
+			{
+				return handle._index < _slots.size () && _slots [handle._index]._generation == handle._generation &&
+						_slots [handle._index]._dense != UINT_MAX;
+			}
+
+			// the value of a handle (null if it was removed)
+			T* Find (const SlotHandle& handle) {return Contains (handle) ? &_values [_slots [handle._index]._dense] : nullptr;}
+			const T* Find (const SlotHandle& handle) const {return Contains (handle) ? &_values [_slots [handle._index]._dense] : nullptr;}
+
+			// the handle of the value at a position of the iteration
+			SlotHandle Handle (size_t position) const
+			{
+				unsigned int index = _owners [position];
+				return SlotHandle (index, _slots [index]._generation);
+			}
+
+			// removes every value; the handles given out stay invalid
+			void Clear ()
+			{
+				while (!_values.empty ()){
+					Remove (Handle (_values.size () - 1));
+				}
+			}
+
+			size_t Size () const {return _values.size ();}
+			bool Empty () const {return _values.empty ();}
+
+			iterator begin () {return _values.begin ();}
+			iterator end () {return _values.end ();}
+			const_iterator begin () const {return _values.begin ();}
+			const_iterator end () const {return _values.end ();}
+	};
+}
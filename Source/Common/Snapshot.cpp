@@ -0,0 +1,267 @@
+/**
+ * @file Snapshot.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See Snapshot.h
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+}
+
+#include "Preprocess.h"
+#include "Vector.h"
+#include "Snapshot.h"
+
+using std::string;
+
+namespace Sim {
+
+	static const char SIM_SNAPSHOT_MAGIC [8] = {'S', 'I', 'M', 'S', 'N', 'A', 'P', '\0'};
+	static const unsigned int SIM_SNAPSHOT_VERSION = 1;
+	// alignment of the section data in the file
+	static const size_t SIM_SNAPSHOT_ALIGNMENT = 64;
+
+	class SnapshotHeader {
+		public:
+			char _magic [8];
+			unsigned int _version;
+			unsigned int _order; // byte order check
+			unsigned int _real; // sizeof (Real)
+			unsigned int _vector; // SIM_VECTOR_SIZE
+			unsigned long long _table; // offset of the section table
+			unsigned long long _size; // of the whole file
+			unsigned long long _sections;
+	};
+
+	static size_t Align (size_t offset, size_t align) {return align > 1 ? (offset + align - 1)/align*align : offset;}
+
+	bool SnapshotWriter::Begin (const string& name)
+	{
+		End ();
+		for (auto &s : _sections){
+			if (s._name == name){
+				LOG_ERROR ("Duplicate snapshot section " << name);
+				return false;
+			}
+		}
+		_data.resize (Align (_data.size (), SIM_SNAPSHOT_ALIGNMENT));
+		_sections.emplace_back (name, _data.size ());
+		_open = true;
+		return true;
+	}
+
+	void SnapshotWriter::End ()
+	{
+		if (_open){
+			_sections.back ()._size = _data.size () - _sections.back ()._offset;
+			_open = false;
+		}
+	}
+
+	// alignment is relative to the section start, which is itself aligned
+	void SnapshotWriter::Write (const void* data, size_t size, size_t align)
+	{
+		size_t offset = Align (_data.size (), align);
+		_data.resize (offset + size);
+		if (size > 0){
+			memcpy (&_data [offset], data, size);
+		}
+	}
+
+	bool SnapshotWriter::Save (const string& file) const
+	{
+		if (_open){
+			LOG_ERROR ("Snapshot section " << _sections.back ()._name << " was not ended");
+			return false;
+		}
+
+		// section table: offset, size and name of every section
+		size_t data = Align (sizeof (SnapshotHeader), SIM_SNAPSHOT_ALIGNMENT);
+		std::vector <char> table;
+		for (auto &s : _sections){
+			unsigned long long entry [3] = {data + s._offset, s._size, s._name.size ()};
+			table.insert (table.end (), reinterpret_cast <const char*> (entry), reinterpret_cast <const char*> (entry) + sizeof (entry));
+			table.insert (table.end (), s._name.begin (), s._name.end ());
+			table.resize (Align (table.size (), sizeof (unsigned long long)));
+		}
+
+		SnapshotHeader header;
+		memcpy (header._magic, SIM_SNAPSHOT_MAGIC, sizeof (header._magic));
+		header._version = SIM_SNAPSHOT_VERSION;
+		header._order = 0x01020304;
+		header._real = sizeof (Real);
+		header._vector = SIM_VECTOR_SIZE;
+		header._table = Align (data + _data.size (), sizeof (unsigned long long));
+		header._size = header._table + table.size ();
+		header._sections = _sections.size ();
+
+		string temporary (file + ".tmp");
+		{
+			std::ofstream out (temporary, std::ios::binary | std::ios::trunc);
+			if (!out.is_open ()){
+				LOG_ERROR ("Could not open " << temporary << " to write the snapshot");
+				return false;
+			}
+			std::vector <char> padding (SIM_SNAPSHOT_ALIGNMENT, 0);
+			out.write (reinterpret_cast <const char*> (&header), sizeof (header));
+			out.write (padding.data (), data - sizeof (header));
+			out.write (_data.data (), _data.size ());
+			out.write (padding.data (), header._table - data - _data.size ());
+			out.write (table.data (), table.size ());
+			if (!out.good ()){
+				LOG_ERROR ("Could not write the snapshot to " << temporary);
+				out.close ();
+				std::remove (temporary.c_str ());
+				return false;
+			}
+		}
+		if (std::rename (temporary.c_str (), file.c_str ()) != 0){
+			LOG_ERROR ("Could not move the snapshot " << temporary << " to " << file);
+			std::remove (temporary.c_str ());
+			return false;
+		}
+		return true;
+	}
+
+	bool SnapshotReader::Open (const string& file)
+	{
+		Close ();
+		int fd = open (file.c_str (), O_RDONLY);
+		if (fd < 0){
+			LOG_ERROR ("Could not open snapshot " << file);
+			return false;
+		}
+		struct stat status;
+		if (fstat (fd, &status) != 0 || static_cast <size_t> (status.st_size) < sizeof (SnapshotHeader)){
+			LOG_ERROR (file << " is not a snapshot");
+			close (fd);
+			return false;
+		}
+		_size = static_cast <size_t> (status.st_size);
+		int flags = MAP_PRIVATE;
+#		ifdef MAP_POPULATE
+		flags |= MAP_POPULATE; // the whole snapshot is read right away
+#		endif
+		void* map = mmap (nullptr, _size, PROT_READ, flags, fd, 0);
+		close (fd);
+		if (map == MAP_FAILED){
+			LOG_ERROR ("Could not map snapshot " << file);
+			_size = 0;
+			return false;
+		}
+		_map = static_cast <char*> (map);
+
+		SnapshotHeader header;
+		memcpy (&header, _map, sizeof (header));
+		if (memcmp (header._magic, SIM_SNAPSHOT_MAGIC, sizeof (header._magic)) || header._version != SIM_SNAPSHOT_VERSION){
+			LOG_ERROR (file << " is not a snapshot of this version");
+			Close ();
+			return false;
+		}
+		if (header._order != 0x01020304 || header._real != sizeof (Real) || header._vector != SIM_VECTOR_SIZE){
+			LOG_ERROR ("Snapshot " << file << " was written by a build of another byte order or precision");
+			Close ();
+			return false;
+		}
+		if (header._size != _size || header._table > _size){
+			LOG_ERROR ("Snapshot " << file << " is truncated");
+			Close ();
+			return false;
+		}
+
+		size_t offset = header._table;
+		for (unsigned long long i = 0; i < header._sections; ++i){
+			unsigned long long entry [3];
+			if (offset + sizeof (entry) > _size){
+				break;
+			}
+			memcpy (entry, _map + offset, sizeof (entry));
+			offset += sizeof (entry);
+			if (offset + entry [2] > _size || entry [0] + entry [1] > header._table){
+				break;
+			}
+			_sections [string (_map + offset, entry [2])] = std::make_pair (entry [0], entry [1]);
+			offset = Align (offset + entry [2], sizeof (unsigned long long));
+		}
+		if (_sections.size () != header._sections){
+			LOG_ERROR ("Corrupt section table in snapshot " << file);
+			Close ();
+			return false;
+		}
+		return true;
+	}
+
+	void SnapshotReader::Close ()
+	{
+		if (_map != nullptr){
+			munmap (_map, _size);
+		}
+		_map = nullptr;
+		_size = 0;
+		_sections.clear ();
+		_cursor = _end = 0;
+		_good = false;
+	}
+
+	bool SnapshotReader::Section (const string& name)
+	{
+		auto s = _sections.find (name);
+		if (s == _sections.end ()){
+			LOG_ERROR ("Snapshot has no section " << name);
+			_good = false;
+			return false;
+		}
+		_cursor = s->second.first;
+		_end = s->second.first + s->second.second;
+		_good = true;
+		return true;
+	}
+
+	bool SnapshotReader::Read (void* data, size_t size, size_t align)
+	{
+		if (!_good){
+			return false;
+		}
+		size_t offset = Align (_cursor, align);
+		if (offset + size > _end){
+			_good = false;
+			return false;
+		}
+		if (size > 0){
+			memcpy (data, _map + offset, size);
+		}
+		_cursor = offset + size;
+		return true;
+	}
+
+	bool SnapshotReader::Peek (unsigned long long& count)
+	{
+		size_t cursor = _cursor;
+		bool success = Read (count);
+		_cursor = cursor;
+		return success;
+	}
+
+	bool SnapshotReader::Read (string& value)
+	{
+		unsigned long long count = 0;
+		if (!Peek (count) || count > _end - _cursor){
+			_good = false;
+			return false;
+		}
+		value.resize (count);
+		return Read (&value [0], count);
+	}
+}
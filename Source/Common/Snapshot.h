@@ -0,0 +1,132 @@
+/**
+ * @file Snapshot.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The binary snapshot format of simulation checkpoints. A snapshot is a
+ * header, named sections of raw data and a section table at the end.
+ * Values are stored as they are laid out in memory (aligned to their
+ * type), so a snapshot is only read back by a build of the same
+ * platform and precision, which the header records.
+ * SnapshotWriter collects the sections in memory; Save () writes them to
+ * a temporary file which is then renamed, so that an interrupted write
+ * never leaves a partial snapshot behind. SnapshotReader maps the file
+ * read-only and copies values straight out of the mapping: restoring
+ * involves no parsing beyond the section table.
+ * Only plain data (no pointers, no virtual functions) may be written as
+ * raw values or arrays.
+ */
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Sim {
+
+	class SnapshotWriter {
+
+		protected:
+			class Section {
+				public:
+					std::string _name;
+					unsigned long long _offset; // in the data
+					unsigned long long _size;
+
+					Section (const std::string& name, unsigned long long offset): _name (name), _offset (offset), _size (0) {}
+			};
+
+			std::vector <char> _data;
+			std::vector <Section> _sections;
+			bool _open; // the last section is still being written
+
+		public:
+			SnapshotWriter (): _open (false) {}
+			~SnapshotWriter () {}
+
+			// forbidden copy constructor and assignment operator
+			SnapshotWriter (const SnapshotWriter&) = delete;
+			SnapshotWriter& operator = (const SnapshotWriter&) = delete;
+
+			// sections do not nest; their names must be unique
+			bool Begin (const std::string& name);
+			void End ();
+
+			void Write (const void* data, size_t size, size_t align);
+			template <class T> void Write (const T& value) {Write (&value, sizeof (T), alignof (T));}
+			template <class T> void Write (const T* values, size_t count)
+			{
+				Write (static_cast <unsigned long long> (count));
+				Write (values, count*sizeof (T), alignof (T));
+			}
+			template <class T> void Write (const std::vector <T>& values) {Write (values.data (), values.size ());}
+			void Write (const std::string& value) {Write (value.data (), value.size ());}
+
+			// bytes of section data collected so far
+			size_t Size () const {return _data.size ();}
+			bool Save (const std::string& file) const;
+	};
+
+	class SnapshotReader {
+
+		protected:
+			char* _map;
+			size_t _size;
+			std::map <std::string, std::pair <unsigned long long, unsigned long long> > _sections; // offset and size
+			size_t _cursor; // in the selected section
+			size_t _end;
+			bool _good;
+
+		public:
+			SnapshotReader (): _map (nullptr), _size (0), _cursor (0), _end (0), _good (false) {}
+			~SnapshotReader () {Close ();}
+
+			// forbidden copy constructor and assignment operator
+			SnapshotReader (const SnapshotReader&) = delete;
+			SnapshotReader& operator = (const SnapshotReader&) = delete;
+
+			bool Open (const std::string& file);
+			void Close ();
+
+			bool HasSection (const std::string& name) const {return _sections.find (name) != _sections.end ();}
+			// select the section subsequent reads come from
+			bool Section (const std::string& name);
+
+			/**
+			 * Reads fail (and return false) past the end of the selected section,
+			 * after which Good () stays false until another section is selected.
+			 */
+			bool Read (void* data, size_t size, size_t align);
+			template <class T> bool Read (T& value) {return Read (&value, sizeof (T), alignof (T));}
+			// an array of exactly 'count' values
+			template <class T> bool Read (T* values, size_t count)
+			{
+				unsigned long long stored = 0;
+				if (!Read (stored) || stored != count){
+					_good = false;
+					return false;
+				}
+				return Read (values, count*sizeof (T), alignof (T));
+			}
+			// the count of the array to be read next
+			bool Peek (unsigned long long& count);
+			// bytes left in the selected section
+			size_t Remaining () const {return _good ? _end - _cursor : 0;}
+			template <class T> bool Read (std::vector <T>& values)
+			{
+				unsigned long long count = 0;
+				if (!Peek (count) || count*sizeof (T) > _end - _cursor){
+					_good = false;
+					return false;
+				}
+				values.resize (count);
+				return Read (values.data (), values.size ());
+			}
+			bool Read (std::string& value);
+
+			bool Good () const {return _good;}
+	};
+}
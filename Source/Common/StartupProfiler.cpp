@@ -0,0 +1,285 @@
+/**
+ * @file StartupProfiler.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See StartupProfiler.h
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <sys/resource.h>
+#include <sys/stat.h>
+}
+
+#include "Preprocess.h"
+#include "StartupProfiler.h"
+
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	// phases open on the calling thread, innermost last
+	static thread_local vector <int> _openPhases;
+
+	// page faults of the calling thread (or process)
+	static void PageFaults (bool thread, long& minor, long& major)
+	{
+		struct rusage usage;
+#		ifdef RUSAGE_THREAD
+		int who = thread ? RUSAGE_THREAD : RUSAGE_SELF;
+#		else
+		int who = RUSAGE_SELF;
+#		endif
+		if (getrusage (who, &usage) != 0){
+			minor = major = 0;
+			return;
+		}
+		minor = usage.ru_minflt;
+		major = usage.ru_majflt;
+	}
+
+	static double Megabytes (unsigned long long bytes) {return bytes/(1024.*1024.);}
+
+	StartupProfiler::Phase::Phase (const string& name, int parent)
+	: _node (-1), _minorFaults (0), _majorFaults (0)
+	{
+		StartupProfiler& profiler = StartupProfiler::Instance ();
+		if (!profiler.Running ()){
+			return;
+		}
+		_node = profiler.Open (name, parent >= 0 ? parent : profiler.Current ());
+		_openPhases.push_back (_node);
+		PageFaults (true, _minorFaults, _majorFaults);
+		_start = Clock::now ();
+	}
+
+	StartupProfiler::Phase::~Phase ()
+	{
+		if (_node < 0){
+			return;
+		}
+		double seconds = duration <double> (Clock::now () - _start).count ();
+		long minor = 0, major = 0;
+		PageFaults (true, minor, major);
+		_openPhases.pop_back ();
+		StartupProfiler::Instance ().Close (_node, seconds, minor - _minorFaults, major - _majorFaults);
+	}
+
+	StartupProfiler& StartupProfiler::Instance ()
+	{
+		static StartupProfiler profiler;
+		return profiler;
+	}
+
+	void StartupProfiler::Begin ()
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		_phases.clear ();
+		_phases.emplace_back ("Startup", -1);
+		_types.clear ();
+		PageFaults (false, _minorFaults, _majorFaults);
+		_start = Clock::now ();
+		_running.store (true);
+	}
+
+	bool StartupProfiler::Initialize (XMLElement* config)
+	{
+		_budget = 0.;
+		_phaseBudgets.clear ();
+		_report.clear ();
+		if (config == nullptr){
+			return true;
+		}
+		config->QueryDoubleAttribute ("Budget", &_budget);
+		const char* report = config->Attribute ("Report");
+		if (report != nullptr){
+			_report = report;
+		}
+		for (XMLElement* p = config->FirstChildElement ("Phase"); p != nullptr; p = p->NextSiblingElement ("Phase")){
+			const char* name = p->Attribute ("Name");
+			double budget = 0.;
+			if (name == nullptr || p->QueryDoubleAttribute ("Budget", &budget) != tinyxml2::XML_SUCCESS){
+				LOG_ERROR ("Start-up phase budgets need a \'Name\' and a \'Budget\' (ms)");
+				return false;
+			}
+			_phaseBudgets [name] = budget;
+		}
+		return true;
+	}
+
+	void StartupProfiler::End ()
+	{
+		bool running = true;
+		if (!_running.compare_exchange_strong (running, false)){
+			return;
+		}
+		double seconds = duration <double> (Clock::now () - _start).count ();
+		long minor = 0, major = 0;
+		PageFaults (false, minor, major);
+
+		std::lock_guard <std::mutex> lock (_mutex);
+		_phases [0]._time = seconds;
+		_phases [0]._calls = 1;
+		_phases [0]._minorFaults = minor - _minorFaults;
+		_phases [0]._majorFaults = major - _majorFaults;
+		Report (seconds, minor - _minorFaults, major - _majorFaults);
+	}
+
+	int StartupProfiler::Current () const
+	{
+		return _openPhases.empty () ? 0 : _openPhases.back ();
+	}
+
+	void StartupProfiler::Read (const string& file, double seconds)
+	{
+		if (!Running ()){
+			return;
+		}
+		struct stat status;
+		unsigned long long bytes = stat (file.c_str (), &status) == 0 ? static_cast <unsigned long long> (status.st_size) : 0;
+		size_t dot = file.find_last_of ('.');
+		size_t slash = file.find_last_of ('/');
+		string type = dot != string::npos && (slash == string::npos || dot > slash) ? file.substr (dot) : "(none)";
+
+		std::lock_guard <std::mutex> lock (_mutex);
+		FileType& t = _types [type];
+		++t._files;
+		t._bytes += bytes;
+		t._time += seconds;
+		_phases [Current ()]._bytes += bytes;
+	}
+
+	int StartupProfiler::Open (const string& name, int parent)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		for (unsigned int i = 0; i < _phases.size (); ++i){
+			if (_phases [i]._parent == parent && _phases [i]._name == name){
+				return static_cast <int> (i);
+			}
+		}
+		_phases.emplace_back (name, parent);
+		return static_cast <int> (_phases.size () - 1);
+	}
+
+	void StartupProfiler::Close (int node, double seconds, long minorFaults, long majorFaults)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		PhaseNode& p = _phases [node];
+		p._time += seconds;
+		++p._calls;
+		p._minorFaults += minorFaults;
+		p._majorFaults += majorFaults;
+	}
+
+	unsigned long long StartupProfiler::Bytes (int node) const
+	{
+		unsigned long long bytes = _phases [node]._bytes;
+		for (unsigned int i = 1; i < _phases.size (); ++i){
+			if (_phases [i]._parent == node){
+				bytes += Bytes (static_cast <int> (i));
+			}
+		}
+		return bytes;
+	}
+
+	/**
+	 * Phases are listed depth-first in the order they were first opened. The
+	 * time of a phase includes its children, which may add up to more than it
+	 * when they ran concurrently.
+	 */
+	void StartupProfiler::Report (double seconds, long minorFaults, long majorFaults)
+	{
+		unsigned long long total = Bytes (0);
+		LOG ("Start-up took " << 1000.*seconds << " ms, read " << Megabytes (total) << " MB, " << minorFaults << " minor and "
+				<< majorFaults << " major page faults");
+
+		// depth-first order
+		vector <int> order;
+		vector <unsigned int> depth (_phases.size (), 0);
+		vector <int> stack (1, 0);
+		while (!stack.empty ()){
+			int node = stack.back ();
+			stack.pop_back ();
+			order.push_back (node);
+			for (int i = static_cast <int> (_phases.size ()) - 1; i > 0; --i){
+				if (_phases [i]._parent == node){
+					depth [i] = depth [node] + 1;
+					stack.push_back (i);
+				}
+			}
+		}
+		for (auto n : order){
+			const PhaseNode& p = _phases [n];
+			LOG (string (2*depth [n], ' ') << p._name << ": " << 1000.*p._time << " ms" << (p._calls > 1 ? " (" + std::to_string (p._calls) + " calls)" : "")
+					<< ", " << Megabytes (Bytes (n)) << " MB read, " << p._minorFaults << "/" << p._majorFaults << " page faults");
+		}
+		for (auto &t : _types){
+			LOG (t.first << " files: " << t.second._files << " read, " << Megabytes (t.second._bytes) << " MB in " << 1000.*t.second._time
+					<< " ms (" << (t.second._time > 0. ? Megabytes (t.second._bytes)/t.second._time : 0.) << " MB/s)");
+		}
+
+		// budgets
+		vector <string> over;
+		if (_budget > 0. && 1000.*seconds > _budget){
+			LOG_WARNING ("Start-up took " << 1000.*seconds << " ms, over its budget of " << _budget << " ms");
+			over.push_back ("Startup");
+		}
+		for (auto &b : _phaseBudgets){
+			double time = 0.;
+			for (auto &p : _phases){
+				time += p._name == b.first ? p._time : 0.;
+			}
+			if (1000.*time > b.second){
+				LOG_WARNING ("Start-up phase " << b.first << " took " << 1000.*time << " ms, over its budget of " << b.second << " ms");
+				over.push_back (b.first);
+			}
+		}
+
+		if (_report.empty ()){
+			return;
+		}
+		std::ofstream out (_report);
+		if (!out.is_open ()){
+			LOG_ERROR ("Could not write the start-up report to " << _report);
+			return;
+		}
+		out << "{" << std::endl;
+		out << "\t\"milliseconds\": " << 1000.*seconds << "," << std::endl;
+		out << "\t\"bytes\": " << total << "," << std::endl;
+		out << "\t\"page_faults\": {\"minor\": " << minorFaults << ", \"major\": " << majorFaults << "}," << std::endl;
+		out << "\t\"budget_ms\": " << _budget << "," << std::endl;
+		out << "\t\"over_budget\": [";
+		for (unsigned int i = 0; i < over.size (); ++i){
+			out << (i > 0 ? ", " : "") << "\"" << over [i] << "\"";
+		}
+		out << "]," << std::endl;
+		out << "\t\"phases\": [" << std::endl;
+		for (unsigned int i = 0; i < order.size (); ++i){
+			const PhaseNode& p = _phases [order [i]];
+			out << "\t\t{\"name\": \"" << p._name << "\", \"depth\": " << depth [order [i]] << ", \"ms\": " << 1000.*p._time
+					<< ", \"calls\": " << p._calls << ", \"bytes\": " << Bytes (order [i]) << ", \"minor_faults\": " << p._minorFaults
+					<< ", \"major_faults\": " << p._majorFaults << "}" << (i + 1 < order.size () ? "," : "") << std::endl;
+		}
+		out << "\t]," << std::endl;
+		out << "\t\"files\": {" << std::endl;
+		unsigned int i = 0;
+		for (auto &t : _types){
+			out << "\t\t\"" << t.first << "\": {\"files\": " << t.second._files << ", \"bytes\": " << t.second._bytes << ", \"ms\": "
+					<< 1000.*t.second._time << ", \"mb_per_s\": " << (t.second._time > 0. ? Megabytes (t.second._bytes)/t.second._time : 0.)
+					<< "}" << (++i < _types.size () ? "," : "") << std::endl;
+		}
+		out << "\t}" << std::endl;
+		out << "}" << std::endl;
+		LOG ("Start-up report written to " << _report);
+	}
+}
@@ -0,0 +1,126 @@
+/**
+ * @file StartupProfiler.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The cold-start profiler. Between Begin () (start of the driver's
+ * initialization) and End () (every asset loaded) the start-up code
+ * opens scoped phases; phases nest in the phase open on the same thread,
+ * or in an explicitly given parent for work handed to other threads
+ * (start-up steps, asset loaders). Repeated phases of the same name and
+ * parent are merged. Every phase records its wall time, calls and page
+ * faults; files read through Read () are counted by type (extension)
+ * and charged to the innermost open phase.
+ * End () logs the phase tree, the bytes read and MB/s per file type and
+ * the page faults, checks them against the budgets of the <Startup>
+ * entry of the driver configuration and optionally writes the report as
+ * JSON. 'Budget' (ms) bounds the whole start-up and <Phase Name Budget>
+ * children bound the phases of that name; an exceeded budget is logged
+ * as a warning and flagged in the report. Outside Begin ()/End ()
+ * phases cost nothing but a flag test.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+
+namespace Sim {
+
+	class StartupProfiler {
+
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+			// times the enclosing scope as a phase
+			class Phase {
+				protected:
+					int _node; // -1: not profiling
+					Clock::time_point _start;
+					long _minorFaults;
+					long _majorFaults;
+
+				public:
+					explicit Phase (const std::string& name, int parent = -1);
+					~Phase ();
+
+					// forbidden copy constructor and assignment operator
+					Phase (const Phase&) = delete;
+					Phase& operator = (const Phase&) = delete;
+			};
+
+		protected:
+			class PhaseNode {
+				public:
+					std::string _name;
+					int _parent;
+					double _time; // seconds, summed over calls
+					unsigned int _calls;
+					unsigned long long _bytes; // read within the phase itself
+					long _minorFaults;
+					long _majorFaults;
+
+					PhaseNode (const std::string& name, int parent)
+					: _name (name), _parent (parent), _time (0.), _calls (0), _bytes (0), _minorFaults (0), _majorFaults (0) {}
+			};
+
+			class FileType {
+				public:
+					unsigned int _files;
+					unsigned long long _bytes;
+					double _time; // seconds
+
+					FileType (): _files (0), _bytes (0), _time (0.) {}
+			};
+
+			std::atomic <bool> _running;
+			std::mutex _mutex;
+			std::vector <PhaseNode> _phases; // the first one is the root
+			std::map <std::string, FileType> _types;
+			Clock::time_point _start;
+			long _minorFaults;
+			long _majorFaults;
+
+			// budgets (ms, 0: none) and the report file
+			double _budget;
+			std::map <std::string, double> _phaseBudgets;
+			std::string _report;
+
+		protected:
+			StartupProfiler (): _running (false), _minorFaults (0), _majorFaults (0), _budget (0.) {}
+			~StartupProfiler () {}
+
+		public:
+			// forbidden copy constructor and assignment operator
+			StartupProfiler (const StartupProfiler&) = delete;
+			StartupProfiler& operator = (const StartupProfiler&) = delete;
+
+			static StartupProfiler& Instance ();
+
+			void Begin ();
+			// read the budgets from the <Startup> entry (may be null)
+			bool Initialize (tinyxml2::XMLElement* config);
+			// report the start-up (only the first call after Begin () does)
+			void End ();
+			bool Running () const {return _running.load (std::memory_order_relaxed);}
+
+			// the phase open on the calling thread (0: the root)
+			int Current () const;
+			// count a file read (its size) that took 'seconds'
+			void Read (const std::string& file, double seconds);
+
+		protected:
+			int Open (const std::string& name, int parent);
+			void Close (int node, double seconds, long minorFaults, long majorFaults);
+			// inclusive bytes of a phase and its descendants
+			unsigned long long Bytes (int node) const;
+			void Report (double seconds, long minorFaults, long majorFaults);
+	};
+}
@@ -0,0 +1,71 @@
+/**
+ * @file TripleBuffer.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Template for the lock-free triple buffer between one producer and one
+ * consumer thread. The producer fills its back slot and publishes it by
+ * swapping it with the middle slot; the consumer takes the middle slot in
+ * exchange for its front slot whenever a new one has been published. Both
+ * swaps are single atomic exchanges, so neither side ever waits for the
+ * other and the consumer always sees a whole, most recent state. A
+ * consumer with nothing to do may block in Wait () until the next
+ * publication.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "Futex.h"
+
+namespace Sim {
+
+	template <class T> class TripleBuffer {
+
+		private:
+			static const unsigned int FRESH = 4; // the middle slot has not been acquired yet
+
+			T _slots [3];
+			unsigned int _back; // producer side
+			std::atomic <unsigned int> _middle; // slot index | FRESH
+			unsigned int _front; // consumer side
+			Futex _sequence; // publications
+
+		public:
+			TripleBuffer (): _back (0), _middle (1), _front (2) {}
+			~TripleBuffer () {}
+
+			// forbidden copy constructor and assignment operator
+			TripleBuffer (const TripleBuffer&) = delete;
+			TripleBuffer& operator = (const TripleBuffer&) = delete;
+
+			// all slots, before either thread runs
+			T& Slot (unsigned int index) {return _slots [index];}
+
+			// producer side
+			T& Back () {return _slots [_back];}
+			void Publish ()
+			{
+				_back = _middle.exchange (_back | FRESH, std::memory_order_acq_rel) & 3;
+				_sequence.Increment ();
+			}
+
+			// consumer side: returns whether the front slot changed
+			bool Acquire ()
+			{
+				if ((_middle.load (std::memory_order_relaxed) & FRESH) == 0){
+					return false;
+				}
+				_front = _middle.exchange (_front, std::memory_order_acq_rel) & 3;
+				return true;
+			}
+			const T& Front () const {return _slots [_front];}
+
+			unsigned int Sequence () const {return _sequence.Load ();}
+			// blocks until a publication after 'seen' (a Sequence ()) or the timeout
+			bool Wait (unsigned int seen, std::chrono::nanoseconds timeout) {return _sequence.Wait (seen, timeout);}
+	};
+}
@@ -0,0 +1,131 @@
+/**
+ * @file WorkStealingDeque.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Template for the lock-free Chase-Lev work-stealing deque. The owner
+ * thread pushes and pops at the bottom end while any other thread may
+ * steal from the top end. The element type has to be trivially copyable
+ * (typically a pointer to a job). The circular array grows on demand;
+ * retired arrays are kept alive until the deque is destroyed because a
+ * concurrent thief may still be reading from them.
+ * NOTE: Based on "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Sim {
+
+	template <class T> class WorkStealingDeque {
+
+		private:
+			class CircularArray {
+				public:
+					long long _capacity;
+					long long _mask;
+					std::unique_ptr <std::atomic <T> []> _data;
+
+					explicit CircularArray (long long capacity)
+					: _capacity (capacity), _mask (capacity - 1), _data (new std::atomic <T> [capacity]) {}
+
+					T Get (long long index) const {return _data [index & _mask].load (std::memory_order_relaxed);}
+					void Put (long long index, T item) {_data [index & _mask].store (item, std::memory_order_relaxed);}
+
+					// returns a copy of the live range [top, bottom) in an array twice as big
+					CircularArray* Grow (long long bottom, long long top) const
+					{
+						CircularArray* result = new CircularArray (2*_capacity);
+						for (long long i = top; i < bottom; ++i){
+							result->Put (i, Get (i));
+						}
+						return result;
+					}
+			};
+
+			// top and bottom are kept on separate cache lines (thieves vs. owner)
+			std::atomic <long long> _top;
+			char _padding0 [64 - sizeof (std::atomic <long long>)];
+			std::atomic <long long> _bottom;
+			char _padding1 [64 - sizeof (std::atomic <long long>)];
+			std::atomic <CircularArray*> _array;
+			std::vector <std::unique_ptr <CircularArray> > _arrays; // owner-only: current and retired arrays
+
+		public:
+			// capacity has to be a power of 2
+			explicit WorkStealingDeque (long long capacity = 256)
+			: _top (0), _bottom (0)
+			{
+				_arrays.emplace_back (new CircularArray (capacity));
+				_array.store (_arrays.back ().get (), std::memory_order_relaxed);
+			}
+			~WorkStealingDeque () {}
+
+			// forbidden copy constructor and assignment operator
+			WorkStealingDeque (const WorkStealingDeque&) = delete;
+			WorkStealingDeque& operator = (const WorkStealingDeque&) = delete;
+
+			// owner only
+			void Push (T item)
+			{
+				long long b = _bottom.load (std::memory_order_relaxed);
+				long long t = _top.load (std::memory_order_acquire);
+				CircularArray* a = _array.load (std::memory_order_relaxed);
+				if (b - t > a->_capacity - 1){
+					_arrays.emplace_back (a->Grow (b, t));
+					a = _arrays.back ().get ();
+					_array.store (a, std::memory_order_release);
+				}
+				a->Put (b, item);
+				_bottom.store (b + 1, std::memory_order_release);
+			}
+
+			// owner only
+			bool Pop (T& item)
+			{
+				long long b = _bottom.load (std::memory_order_relaxed) - 1;
+				CircularArray* a = _array.load (std::memory_order_relaxed);
+				_bottom.store (b, std::memory_order_relaxed);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				long long t = _top.load (std::memory_order_relaxed);
+
+				if (t > b){ // deque was empty
+					_bottom.store (b + 1, std::memory_order_relaxed);
+					return false;
+				}
+				item = a->Get (b);
+				if (t == b){ // last item: race against thieves
+					bool won = _top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					_bottom.store (b + 1, std::memory_order_relaxed);
+					return won;
+				}
+				return true;
+			}
+
+			// any thread
+			bool Steal (T& item)
+			{
+				long long t = _top.load (std::memory_order_acquire);
+				std::atomic_thread_fence (std::memory_order_seq_cst);
+				long long b = _bottom.load (std::memory_order_acquire);
+				if (t >= b){
+					return false;
+				}
+				CircularArray* a = _array.load (std::memory_order_acquire);
+				item = a->Get (t);
+				return _top.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			}
+
+			bool Empty () const
+			{
+				long long b = _bottom.load (std::memory_order_relaxed);
+				long long t = _top.load (std::memory_order_relaxed);
+				return b <= t;
+			}
+	};
+}
@@ -8,13 +8,22 @@
  * See Asset.h
  */
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
 
 #include "InputParser.h"
+#include "StartupProfiler.h"
+#include "Snapshot.h"
 #include "Driver.h"
 #include "Plugins/Plugin.h"
 
@@ -38,6 +47,7 @@ namespace Sim {
 			LOG_ERROR ("No components specified for \'" << name << "\'");
 			return false;
 		}
+		std::vector <unsigned int> declared;
 
 		while (clist != nullptr){
 
@@ -47,15 +57,17 @@ namespace Sim {
 				return false;
 			}
 			unsigned int cid = AssetFactory::ComponentId (type);
-
-			auto t = _components.find (cid);
-			if (t != _components.end ()){
+			if (cid == UINT_MAX){
+				LOG_ERROR ("Unknown component type \'" << type << "\' specified for " << name);
+				return false;
+			}
+			if (std::find (declared.begin (), declared.end (), cid) != declared.end ()){
 				LOG_ERROR ("Duplicate component of type \'" << type << "\' specified for " << name << " (forbidden)");
 				return false;
 			}
-			shared_ptr <Component> c;
-			_components [cid] = c;
-			_components [cid]->_owner = const_cast <Asset*> (this);
+			// an empty slot until the loading plugin adds the component
+			declared.push_back (cid);
+			Reserve (cid);
 
 			clist = clist->NextSiblingElement ("Component");
 		}
@@ -67,9 +79,89 @@ namespace Sim {
 	void Asset::Cleanup ()
 	{
 		_components.clear ();
+		_elements.clear ();
+		_lazy.clear ();
+		_lazyConfig.reset ();
 	}
 
-	bool Asset::LoadComponents (XMLElement& elem)
+	bool Asset::Materialize (unsigned int id)
+	{
+		if (id >= _lazy.size () || !_lazy [id]){
+			return HasComponent (id);
+		}
+		LazyComponent& lazy = *_lazy [id];
+		for (auto d : lazy._after){
+			if (Pending (d) && !Materialize (d)){
+				LOG_ERROR ("The lazy " << lazy._type << " component of asset " << _id << " cannot load without its dependencies");
+			}
+		}
+		std::lock_guard <std::mutex> lock (lazy._mutex);
+		if (!lazy._done.load (std::memory_order_acquire)){
+			auto start = std::chrono::steady_clock::now ();
+			if (lazy._plugin->InitializeAssetComponent (lazy._type.c_str (), *lazy._spec, this)){
+				double ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+				LOG ("Lazy " << lazy._type << " component of asset " << _id << " loaded in " << ms << " ms");
+			} else {
+				LOG_ERROR ("Could not initialize lazy " << lazy._type << " component of asset " << _id);
+			}
+			lazy._done.store (true, std::memory_order_release);
+		}
+		return id < _components.size () && _components [id];
+	}
+
+	// a component to load, with the components it loads after
+	class PendingComponent {
+		public:
+			const char* _type;
+			const char* _loader; // name of the loading plugin
+			bool _main;
+			bool _lazy; // loaded on first access (see Asset.h)
+			int _priority; // of its background prefetch
+			XMLElement* _spec; // its entry in the asset's own configuration file
+			shared_ptr <Plugin> _plugin;
+			std::vector <unsigned int> _after;
+			bool _deferred; // loads after a main-thread component (so on the main thread)
+
+			PendingComponent (): _type (nullptr), _loader (nullptr), _main (false), _lazy (false), _priority (0), _spec (nullptr), _deferred (false) {}
+	};
+
+	// reads the 'After' list of a component (default: the component listed before it)
+	static bool ReadDependencies (const XMLElement& clist, unsigned int index, std::vector <PendingComponent>& components)
+	{
+		const char* after = clist.Attribute ("After");
+		if (after == nullptr){
+			if (index > 0){
+				components [index]._after.push_back (index - 1);
+			}
+			return true;
+		}
+		std::stringstream list (after);
+		string type;
+		while (std::getline (list, type, ',')){
+			type.erase (0, type.find_first_not_of (" \t"));
+			type.erase (type.find_last_not_of (" \t") + 1);
+			if (type.empty ()){
+				continue;
+			}
+			unsigned int i = 0;
+			while (i < components.size () && type != components [i]._type){
+				++i;
+			}
+			if (i == components.size () || i == index){
+				LOG_ERROR ("Component " << components [index]._type << " cannot load after \'" << type << "\'");
+				return false;
+			}
+			components [index]._after.push_back (i);
+		}
+		return true;
+	}
+
+	/**
+	 * Components load in waves: every component whose dependencies are loaded
+	 * joins the next wave. The worker components of a wave load concurrently,
+	 * its main-thread components on the calling thread.
+	 */
+	bool Asset::LoadComponents (XMLElement& elem, ComponentLoad load)
 	{
 		// get the name of the config file for the asset
 		const char* config = elem.Attribute ("Config");
@@ -78,39 +170,265 @@ namespace Sim {
 			return false;
 		}
 
-		InputParser parser;
-		if (!parser.Initialize (config, "AssetConfig")){
+		// kept by the asset while it has lazy components
+		std::unique_ptr <InputParser> parser (new InputParser ());
+		if (!parser->Initialize (config, "AssetConfig")){
 			LOG_ERROR ("Could not initialize parser for " << config);
 			return false;
 		}
 
-		XMLElement* clist = elem.FirstChildElement ("Component");
+		std::vector <PendingComponent> components;
+		for (XMLElement* clist = elem.FirstChildElement ("Component"); clist != nullptr; clist = clist->NextSiblingElement ("Component")){
+			PendingComponent c;
+			c._type = clist->Attribute ("Type");
+			c._main = clist->BoolAttribute ("MainThread");
+			c._lazy = clist->BoolAttribute ("Lazy");
+			c._priority = clist->IntAttribute ("Priority");
+			if (c._lazy && c._main){
+				LOG_ERROR (elem.Attribute ("Name") << "'s " << c._type << " cannot be both lazy and loaded on the main thread");
+				return false;
+			}
 
-		while (clist != nullptr){
-			const char* type = clist->Attribute ("Type");
 			const char* plugin = clist->Attribute ("LoadingPlugin");
 			if (plugin == nullptr){
-				LOG_ERROR ("No loading plugin specified for " << elem.Attribute ("Name") << "\'s " << type);
+				LOG_ERROR ("No loading plugin specified for " << elem.Attribute ("Name") << "\'s " << c._type);
 				return false;
 			}
 
-			XMLElement* telem = parser.GetElement (type);
-			if (telem == nullptr){
-				LOG_ERROR ("No specification for " << type << " found in " << config);
+			c._spec = parser->GetElement (c._type);
+			if (c._spec == nullptr){
+				LOG_ERROR ("No specification for " << c._type << " found in " << config);
 				return false;
 			}
 
-			shared_ptr <Plugin> p = Driver::Instance ().GetPlugin (plugin);
-			if (!p){
+			c._loader = plugin;
+			c._plugin = Driver::Instance ().GetPlugin (plugin);
+			if (!c._plugin){
 				LOG_ERROR ("Plugin " << plugin << " not found");
 				return false;
 			}
-			if (!p->InitializeAssetComponent (type, *telem, const_cast <Asset*> (this))){
-				LOG_ERROR ("Could not initialize " << type << " component from " << config);
+			components.push_back (c);
+		}
+		unsigned int index = 0;
+		for (XMLElement* clist = elem.FirstChildElement ("Component"); clist != nullptr; clist = clist->NextSiblingElement ("Component")){
+			if (!ReadDependencies (*clist, index++, components)){
+				LOG_ERROR ("Invalid component dependencies for " << elem.Attribute ("Name"));
 				return false;
 			}
+		}
+		for (auto &c : components){
+			for (auto d : c._after){
+				if (components [d]._lazy && !c._lazy){
+					LOG_ERROR (elem.Attribute ("Name") << "'s " << c._type << " cannot load after the lazy " << components [d]._type);
+					return false;
+				}
+			}
+		}
 
-			clist = clist->NextSiblingElement ("Component");
+		// order the components by their dependencies (this also finds cycles)
+		std::vector <unsigned int> order;
+		std::vector <bool> placed (components.size (), false);
+		while (order.size () < components.size ()){
+			size_t before = order.size ();
+			for (unsigned int i = 0; i < components.size (); ++i){
+				bool ready = !placed [i];
+				for (auto d : components [i]._after){
+					ready = ready && placed [d];
+				}
+				if (ready){
+					for (auto d : components [i]._after){
+						components [i]._deferred = components [i]._deferred || components [d]._main || components [d]._deferred;
+					}
+					order.push_back (i);
+				}
+			}
+			if (order.size () == before){
+				LOG_ERROR ("Cyclic component dependencies for " << elem.Attribute ("Name"));
+				return false;
+			}
+			for (size_t i = before; i < order.size (); ++i){
+				placed [order [i]] = true;
+			}
+		}
+		if (load != LOAD_MAIN_COMPONENTS){
+			_sources.clear ();
+			for (auto i : order){
+				_sources.emplace_back (components [i]._type, components [i]._loader);
+			}
+			// lazy components stay pending (their specification with them)
+			for (auto &c : components){
+				if (!c._lazy){
+					continue;
+				}
+				unsigned int id = AssetFactory::ComponentId (c._type);
+				Reserve (id);
+				_lazy [id].reset (new LazyComponent ());
+				_lazy [id]->_type = c._type;
+				_lazy [id]->_plugin = c._plugin;
+				_lazy [id]->_spec = c._spec;
+				_lazy [id]->_priority = c._priority;
+				for (auto d : c._after){
+					if (components [d]._lazy){
+						_lazy [id]->_after.push_back (AssetFactory::ComponentId (components [d]._type));
+					}
+				}
+				if (!_lazyConfig){
+					_lazyConfig = std::move (parser);
+				}
+			}
+		}
+
+		// the components of this pass; the others (and lazy ones) count as loaded
+		std::vector <bool> loaded (components.size ());
+		for (unsigned int i = 0; i < components.size (); ++i){
+			bool worker = !components [i]._main && !components [i]._deferred;
+			loaded [i] = components [i]._lazy || (load == LOAD_WORKER_COMPONENTS && !worker) || (load == LOAD_MAIN_COMPONENTS && worker);
+		}
+
+		Asset* asset = const_cast <Asset*> (this);
+		int phase = StartupProfiler::Instance ().Current ();
+		auto initialize = [asset, phase] (PendingComponent& c) {
+			StartupProfiler::Phase p (c._type, phase);
+			if (!c._plugin->InitializeAssetComponent (c._type, *c._spec, asset)){
+				LOG_ERROR ("Could not initialize " << c._type << " component of asset " << asset->Id ());
+				return false;
+			}
+			return true;
+		};
+
+		bool success = true;
+		while (success && std::find (loaded.begin (), loaded.end (), false) != loaded.end ()){
+			std::vector <unsigned int> wave;
+			for (unsigned int i = 0; i < components.size (); ++i){
+				bool ready = !loaded [i];
+				for (auto d : components [i]._after){
+					ready = ready && loaded [d];
+				}
+				if (ready){
+					wave.push_back (i);
+				}
+			}
+
+			// all worker components but the last run on their own threads
+			std::vector <std::future <bool> > running;
+			int last = -1;
+			for (auto i : wave){
+				if (!components [i]._main){
+					if (last >= 0){
+						running.push_back (std::async (std::launch::async, initialize, std::ref (components [last])));
+					}
+					last = static_cast <int> (i);
+				}
+			}
+			if (last >= 0){
+				success = initialize (components [last]) && success;
+			}
+			for (auto i : wave){
+				if (components [i]._main){
+					success = success && initialize (components [i]);
+				}
+			}
+			for (auto &r : running){
+				success = r.get () && success;
+			}
+			for (auto i : wave){
+				loaded [i] = true;
+			}
+		}
+		return success;
+	}
+
+	/**
+	 * The asset's own section lists its components with their loading plugins,
+	 * in the order they loaded, so that they are restored in that order.
+	 */
+	bool Asset::Save (SnapshotWriter& snapshot) const
+	{
+		if (!snapshot.Begin (SectionName ())){
+			return false;
+		}
+		snapshot.Write (_type);
+		snapshot.Write (static_cast <unsigned long long> (_sources.size ()));
+		for (auto &s : _sources){
+			snapshot.Write (s.first);
+			snapshot.Write (s.second);
+		}
+		// lazy components are checkpointed like the others, so they load first
+		for (auto &s : _sources){
+			unsigned int id = AssetFactory::ComponentId (s.first.c_str ());
+			if (Pending (id)){
+				const_cast <Asset*> (this)->Materialize (id);
+			}
+			if (HasElement (id)){
+				shared_ptr <Assets::ComponentSystem> system = _factory->GetSystem (id);
+				if (!snapshot.Begin (SectionName () + "/" + s.first) || !system || !system->SaveElement (Element (id), snapshot)){
+					LOG_ERROR ("The " << s.first << " element of asset " << _id << " cannot be checkpointed");
+					return false;
+				}
+				continue;
+			}
+			if (!HasComponent (id) || !snapshot.Begin (SectionName () + "/" + s.first)){
+				LOG_ERROR ("The " << s.first << " component of asset " << _id << " is not loaded");
+				return false;
+			}
+			if (!_components [id]->Save (snapshot)){
+				LOG_ERROR ("The " << s.first << " component of asset " << _id << " cannot be checkpointed");
+				return false;
+			}
+		}
+		snapshot.End ();
+		return true;
+	}
+
+	bool Asset::Restore (SnapshotReader& snapshot)
+	{
+		for (auto &s : _sources){
+			unsigned int id = AssetFactory::ComponentId (s.first.c_str ());
+			if (Pending (id)){
+				Materialize (id);
+			}
+			if (HasElement (id)){
+				shared_ptr <Assets::ComponentSystem> system = _factory->GetSystem (id);
+				if (!system || !snapshot.Section (SectionName () + "/" + s.first) || !system->RestoreElement (Element (id), snapshot)){
+					LOG_ERROR ("Could not restore the " << s.first << " element of asset " << _id);
+					return false;
+				}
+				continue;
+			}
+			if (!HasComponent (id) || !snapshot.Section (SectionName () + "/" + s.first) || !_components [id]->Restore (snapshot)){
+				LOG_ERROR ("Could not restore the " << s.first << " component of asset " << _id);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool Asset::RestoreComponents (SnapshotReader& snapshot)
+	{
+		string type;
+		unsigned long long count = 0;
+		_sources.clear ();
+		bool success = snapshot.Section (SectionName ()) && snapshot.Read (type) && snapshot.Read (count);
+		for (unsigned long long i = 0; success && i < count; ++i){
+			string component, plugin;
+			success = snapshot.Read (component) && snapshot.Read (plugin);
+			_sources.emplace_back (component, plugin);
+		}
+		if (!success){
+			LOG_ERROR ("Corrupt component list of asset " << _id << " in the snapshot");
+			return false;
+		}
+
+		for (auto &s : _sources){
+			shared_ptr <Plugin> plugin = Driver::Instance ().GetPlugin (s.second.c_str ());
+			if (!plugin){
+				LOG_ERROR ("Plugin " << s.second << " not found");
+				return false;
+			}
+			if (!snapshot.Section (SectionName () + "/" + s.first) || !plugin->RestoreAssetComponent (s.first.c_str (), snapshot, this)){
+				LOG_ERROR ("Could not restore the " << s.first << " component of asset " << _id << " through plugin " << s.second);
+				return false;
+			}
 		}
 		return true;
 	}
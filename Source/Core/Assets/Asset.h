@@ -8,13 +8,25 @@
  * The asset class for the Chimera system, representing all simulated
  * bodies/entities. Its a component based system, since different bodies
  * are compositions (mix) of distinct components, that may or may not
- * be similar across different objects.
+ * be similar across different objects. Components are kept in slots
+ * indexed by their type id (see ComponentType.h).
+ * A component marked 'Lazy="true"' in the asset configuration is not
+ * loaded with the asset: its slot stays empty (HasComponent () is false
+ * and Pending () true, so callers that must not wait can do without it)
+ * until GetComponent () or Materialize () asks for it, which loads it on
+ * the calling thread, or until the factory prefetches it in the
+ * background (see AssetFactory.h).
  */
 #pragma once
 
+#include <atomic>
+#include <climits>
 #include <map>
+#include <mutex>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
@@ -23,60 +35,181 @@
 
 namespace Sim {
 
+	class SnapshotWriter;
+	class SnapshotReader;
+	class Plugin;
+
+	// which components of an asset Asset::LoadComponents () loads
+	typedef enum {
+		LOAD_ALL_COMPONENTS,
+		LOAD_WORKER_COMPONENTS, // components that may be loaded on any thread (and do not load after main-thread ones)
+		LOAD_MAIN_COMPONENTS // components marked 'MainThread="true"' (e.g. those creating GPU resources) and those after them
+	} ComponentLoad;
+
 	class EXPORT Asset {
 
 			friend class AssetFactory;
 
 		protected:
 			unsigned int _id;
+			AssetHandle _handle; // in its factory (set by it)
 			std::string _type;
-			std::map <unsigned int, std::shared_ptr <Assets::Component> > _components;
+			AssetFactory* _factory; // the factory (simulation instance) the asset belongs to
+			/**
+			 * Components by type id (empty: not loaded). Initialize () sizes both for
+			 * the declared types, so that components loading concurrently only fill
+			 * their own slots.
+			 */
+			std::vector <std::shared_ptr <Assets::Component> > _components;
+			// components stored in their type's system (see ComponentSystem.h): element index by type id (UINT_MAX: none)
+			std::vector <unsigned int> _elements;
+			std::atomic <bool> _loaded; // set by the asset factory once every component is loaded
+			// type and loading plugin of every component, in dependency order
+			std::vector <std::pair <std::string, std::string> > _sources;
+
+			// a component loaded on first access (set up before the asset is loaded, never moved after)
+			class LazyComponent {
+				public:
+					std::string _type;
+					std::shared_ptr <Plugin> _plugin;
+					tinyxml2::XMLElement* _spec; // in _lazyConfig
+					int _priority; // of the background prefetch (0: on access only)
+					std::vector <unsigned int> _after; // lazy components it loads after (type ids)
+					std::mutex _mutex;
+					std::atomic <bool> _done; // loaded (or failed to)
+
+					LazyComponent (): _spec (nullptr), _priority (0), _done (false) {}
+			};
+			std::vector <std::unique_ptr <LazyComponent> > _lazy; // by type id (null: not lazy)
+			std::unique_ptr <InputParser> _lazyConfig; // the asset's configuration file, while lazy components are pending
 
 		private: // forbidden constructors and assignment operator
-			Asset (): _id (0) {}
-			Asset (const Asset& a): _id (a._id), _type (a._type) {}
+			Asset (): _id (0), _factory (nullptr), _loaded (false) {}
+			Asset (const Asset& a): _id (a._id), _type (a._type), _factory (a._factory), _loaded (false) {}
 			Asset& operator = (const Asset& a) {_type = a._type; return *this;}
 
 		public:
-			Asset (unsigned int id, const std::string& type): _id (id), _type (type) {}
+			Asset (unsigned int id, const std::string& type, AssetFactory* factory = nullptr): _id (id), _type (type), _factory (factory), _loaded (false) {}
 			~Asset () {Cleanup ();}
 
 			const std::string& Type () const {return _type;}
 			unsigned int Id () const {return _id;}
+			AssetHandle Handle () const {return _handle;}
+			AssetFactory* Factory () const {return _factory;}
+			// all components are loaded (assets may still be loading asynchronously, see AssetFactory)
+			bool Loaded () const {return _loaded.load (std::memory_order_acquire);}
 
 			bool Initialize (tinyxml2::XMLElement&);
 			void Cleanup ();
 
 			void AddComponent (const char* name, std::shared_ptr <Assets::Component> component)
 			{
+				unsigned int id = AssetFactory::ComponentId (name);
+				if (id == UINT_MAX){
+					return;
+				}
 				component->_owner = const_cast <Asset*> (this);
-				_components [AssetFactory::ComponentId (name)] = std::move (component);
+				Reserve (id);
+				_components [id] = std::move (component);
 			}
 
-			template <class ComponentType> std::shared_ptr <ComponentType> GetComponent (unsigned int id)
+			// an object component is loaded (a component stored in a system is an element, see below)
+			bool HasComponent (unsigned int id) const {return id < _components.size () && !Pending (id) && _components [id];}
+			// a lazy component not loaded yet
+			bool Pending (unsigned int id) const {return id < _lazy.size () && _lazy [id] && !_lazy [id]->_done.load (std::memory_order_acquire);}
+			// loads a pending lazy component now, and the lazy ones it loads after (any thread); false if it failed
+			bool Materialize (unsigned int id);
+
+			/**
+			 * A component stored in the factory's system of its type, as element
+			 * 'index' of the system (added by the loading plugin, any thread).
+			 */
+			void AddElement (const char* name, unsigned int index)
 			{
-				auto it = _components.find (id);
+				unsigned int id = AssetFactory::ComponentId (name);
+				if (id == UINT_MAX){
+					return;
+				}
+				Reserve (id);
+				_elements [id] = index;
+			}
+			bool HasElement (unsigned int id) const {return Element (id) != UINT_MAX;}
+			// index in its system of the element of a component type (UINT_MAX: none)
+			unsigned int Element (unsigned int id) const {return id < _elements.size () && !Pending (id) ? _elements [id] : UINT_MAX;}
+			// the element itself (it moves when elements are added, see ComponentArray); nullptr if there is none
+			template <class ElementType> ElementType* GetElement (unsigned int id)
+			{
+				if (Pending (id)){
+					Materialize (id);
+				}
+				unsigned int index = Element (id);
+				std::shared_ptr <Assets::ComponentSystem> system = index != UINT_MAX ? _factory->GetSystem (id) : nullptr;
+				if (!system){
+#					ifndef NDEBUG
+					LOG_ERROR ("Element of component " << id << " not found...returning null element");
+#					endif
+					return nullptr;
+				}
+				return &static_cast <Assets::ComponentArray <ElementType>&> (*system) [index];
+			}
 
-#				ifndef NDEBUG
-				if (it != _components.end ()){
-					std::shared_ptr <Assets::Component> component (it->second);
-					return std::shared_ptr <ComponentType> (std::static_pointer_cast <ComponentType> (component));
+			// e.g. GetComponent <Assets::Geometry> (SIM_COMPONENT_ID ("Geometry"))
+			template <class ComponentType> std::shared_ptr <ComponentType> GetComponent (unsigned int id)
+			{
+				if (Pending (id)){
+					Materialize (id);
+				}
+				if (id >= _components.size ()){
+#					ifndef NDEBUG
+					LOG_ERROR ("Component " << id << " not found...returning empty component");
+#					endif
+					return std::shared_ptr <ComponentType> ();
 				}
-				LOG_ERROR ("Component" << id << "not found...returning empty component");
-				return std::shared_ptr <ComponentType> ();
-#				else
-				std::shared_ptr <Assets::Component> component (it->second);
-				return std::shared_ptr <ComponentType> (std::static_pointer_cast <ComponentType> (component));
-#				endif
+				return std::static_pointer_cast <ComponentType> (_components [id]);
 			}
 
+			// by a type name read at load time (see AssetFactory::ComponentId ())
 			template <class ComponentType> std::shared_ptr <ComponentType> GetComponent (const char* name)
 			{
-				unsigned int id = AssetFactory::ComponentId (name);
-				return GetComponent <ComponentType> (id);
+				return GetComponent <ComponentType> (AssetFactory::ComponentId (name));
+			}
+
+			/**
+			 * Checkpointing (see AssetFactory::Save ()). Every component is saved in
+			 * its own section, named after the asset and the component (an element
+			 * by its system); Restore () restores the components of a loaded asset
+			 * in place.
+			 */
+			bool Save (SnapshotWriter&) const;
+			bool Restore (SnapshotReader&);
+
+			// hand an external input to every component (see Component::ApplyInput ()); false if none took it
+			bool ApplyInput (const Input& input)
+			{
+				bool applied = false;
+				for (unsigned int id = 0; id < _components.size (); ++id){
+					applied = (HasComponent (id) && _components [id]->ApplyInput (input)) || applied;
+				}
+				for (unsigned int id = 0; id < _elements.size (); ++id){
+					std::shared_ptr <Assets::ComponentSystem> system = HasElement (id) ? _factory->GetSystem (id) : nullptr;
+					applied = (system && system->ApplyInput (_elements [id], input)) || applied;
+				}
+				return applied;
 			}
 
 		protected:
-			bool LoadComponents (tinyxml2::XMLElement&);
+			bool LoadComponents (tinyxml2::XMLElement&, ComponentLoad load = LOAD_ALL_COMPONENTS);
+			// create the components from the snapshot through their loading plugins, in dependency order
+			bool RestoreComponents (SnapshotReader&);
+			std::string SectionName () const {return "Asset " + std::to_string (_id);}
+			// slots up to a type id (only types not declared to Initialize () grow them, while nothing else loads)
+			void Reserve (unsigned int id)
+			{
+				if (id >= _components.size ()){
+					_components.resize (id + 1);
+					_elements.resize (id + 1, UINT_MAX);
+					_lazy.resize (id + 1);
+				}
+			}
 	};
 }
@@ -8,19 +8,30 @@
  * See AssetFactory.h.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <map>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
 
 #include "InputParser.h"
+#include "StartupProfiler.h"
+#include "Snapshot.h"
+#include "Driver.h"
 #include "Assets/Asset.h"
 #include "Assets/AssetFactory.h"
+#include "Plugins/Plugin.h"
 
 using std::map;
+using std::string;
 using std::shared_ptr;
+using std::vector;
 using std::make_shared;
+using std::make_unique;
 using tinyxml2::XMLElement;
 using tinyxml2::XMLError;
 using tinyxml2::XML_SUCCESS;
@@ -28,17 +39,23 @@ using tinyxml2::XML_SUCCESS;
 namespace Sim {
 
 	std::map <std::string, unsigned int> AssetFactory::_componentIdMap;
+	std::mutex AssetFactory::_componentIdMutex;
+	unsigned int AssetFactory::_componentIdUsers = 0;
 
-	bool AssetFactory::Initialize (const char* configfile)
+	bool AssetFactory::Initialize (const char* configfile, bool synchronous)
 	{
-		// read configuration file
-		InputParser parser;
+		StartupProfiler::Phase phase ("AssetFactory::Initialize");
+		_startupPhase = StartupProfiler::Instance ().Current ();
+
+		// read configuration file (kept until asynchronous loads have finished)
+		_parser = make_unique <InputParser> ();
+		InputParser& parser = *_parser;
 		if (!parser.Initialize (configfile, "AssetsConfig")){
 			LOG_ERROR ("Could not initialize parser for " << configfile);
 			return false;
 		}
 
-		XMLElement* element = parser.GetElement ("ComponentMap");
+		XMLElement* element = parser.GetElement ("ComponentIdMap");
 		if (element == nullptr){
 			LOG_ERROR ("No component Id Map specified in " << configfile);
 			return false;
@@ -66,6 +83,20 @@ namespace Sim {
 			Cleanup ();
 			return false;
 		}
+
+		bool async = false;
+		unsigned int loaders = 0;
+		element->QueryBoolAttribute ("Async", &async);
+		element->QueryUnsignedAttribute ("Loaders", &loaders);
+		if (async && !synchronous){
+			if (!LoadAsync (*element, loaders)){
+				LOG_ERROR ("Could not start loading the asset components from " << configfile);
+				Cleanup ();
+				return false;
+			}
+			LOG ("AssetFactory initialized (loading " << _loads.size () << " assets asynchronously)");
+			return true;
+		}
 		if (!LoadComponents (*element)){
 			LOG_ERROR ("Failed to load all asset components from " << configfile);
 			Cleanup ();
@@ -77,23 +108,293 @@ namespace Sim {
 
 	void AssetFactory::Cleanup ()
 	{
-		_assets.clear ();
-		_componentIdMap.clear ();
+		StopPrefetch ();
+		// loaders finish the asset at hand and take no new one
+		_nextLoad.store (static_cast <unsigned int> (_loads.size ()));
+		for (auto &t : _loaders){
+			t.join ();
+		}
+		_loaders.clear ();
+		_ready.clear ();
+		_loads.clear ();
+		_pendingLoads.store (0);
+		_finishedLoads.store (0);
+		_failed = false;
+		_parser.reset ();
+
+		// plugins drop what they keep about this factory's scene
+		std::vector <string> plugins;
+		for (auto &a : _assets){
+			for (auto &s : a->_sources){
+				if (std::find (plugins.begin (), plugins.end (), s.second) == plugins.end ()){
+					plugins.push_back (s.second);
+				}
+			}
+		}
+		for (auto &p : plugins){
+			shared_ptr <Plugin> plugin = Driver::Instance ().GetPlugin (p.c_str ());
+			if (plugin){
+				plugin->ReleaseAssets (this);
+			}
+		}
+
+		_assets.Clear ();
+		_assetHandles.clear ();
+		_assetIdMap.clear ();
+		{
+			std::lock_guard <std::mutex> lock (_systemMutex);
+			_systems.clear ();
+		}
+		ReleaseComponentIdMap ();
 	}
 
 	shared_ptr <Asset> AssetFactory::GetAsset (unsigned int id)
 	{
-#		ifndef NDEBUG
-		auto f = _assets.find (id);
-		if (f != _assets.end ()){
-			return f->second;
+		auto f = _assetHandles.find (id);
+		if (f == _assetHandles.end ()){
+			LOG_ERROR ("Could not find asset with id " << id << ". Returning empty asset");
+			return shared_ptr <Asset> ();
+		}
+		return GetAsset (f->second);
+	}
+
+	AssetHandle AssetFactory::Handle (unsigned int id) const
+	{
+		auto f = _assetHandles.find (id);
+		return f != _assetHandles.end () ? f->second : AssetHandle ();
+	}
+
+	AssetHandle AssetFactory::AddAsset (const shared_ptr <Asset>& asset, const char* name)
+	{
+		auto h = _assetHandles.find (asset->Id ());
+		if (h != _assetHandles.end () && h->second.Valid ()){
+			LOG_ERROR ("Duplicate asset id " << asset->Id () << " (forbidden)");
+			return AssetHandle ();
+		}
+		if (name != nullptr){
+			auto n = _assetIdMap.find (name);
+			if (n != _assetIdMap.end () && n->second != asset->Id ()){
+				LOG_ERROR ("Duplicate asset name \'" << name << "\' (forbidden)");
+				return AssetHandle ();
+			}
+			_assetIdMap [name] = asset->Id ();
+		}
+		asset->_factory = this;
+		asset->_handle = _assets.Insert (asset);
+		_assetHandles [asset->Id ()] = asset->_handle;
+		return asset->_handle;
+	}
+
+	bool AssetFactory::RemoveAsset (AssetHandle handle)
+	{
+		shared_ptr <Asset> asset = GetAsset (handle);
+		if (!asset || Loading ()){
+			LOG_ERROR ("Only loaded assets can be removed");
+			return false;
+		}
+		// its pending lazy components are dropped (one being prefetched finishes first)
+		for (auto &l : asset->_lazy){
+			if (l){
+				std::lock_guard <std::mutex> lock (l->_mutex);
+				l->_done.store (true, std::memory_order_release);
+			}
+		}
+		// its elements leave their systems; the last element of a system takes the place of one
+		for (unsigned int id = 0; id < asset->_elements.size (); ++id){
+			shared_ptr <Assets::ComponentSystem> system = asset->_elements [id] != UINT_MAX ? GetSystem (id) : nullptr;
+			if (system){
+				Asset* moved = system->RemoveElement (asset->_elements [id]);
+				if (moved != nullptr){
+					moved->_elements [id] = asset->_elements [id];
+				}
+				asset->_elements [id] = UINT_MAX;
+			}
+		}
+		_assets.Remove (handle);
+		_assetHandles.erase (asset->Id ());
+		for (auto n = _assetIdMap.begin (); n != _assetIdMap.end (); ++n){
+			if (n->second == asset->Id ()){
+				_assetIdMap.erase (n);
+				break;
+			}
+		}
+		asset->_handle = AssetHandle ();
+		return true;
+	}
+
+	// lookup by the 'Name' given in the asset config; an unknown name returns an empty asset
+	shared_ptr <Asset> AssetFactory::GetAsset (const char* name)
+	{
+		auto f = _assetIdMap.find (name);
+		if (f == _assetIdMap.end ()){
+			shared_ptr <Asset> a;
+			return a;
+		}
+		return GetAsset (f->second);
+	}
+
+	std::shared_future <bool> AssetFactory::LoadFuture (const char* name)
+	{
+		shared_ptr <Asset> asset = GetAsset (name);
+		for (auto &l : _loads){
+			if (asset && l->_asset == asset){
+				return l->_future;
+			}
+		}
+		LOG_ERROR ("No load of asset \'" << name << "\' found");
+		return std::shared_future <bool> ();
+	}
+
+	bool AssetFactory::Then (const char* name, const Continuation& continuation)
+	{
+		shared_ptr <Asset> asset = GetAsset (name);
+		for (auto &l : _loads){
+			if (!asset || l->_asset != asset){
+				continue;
+			}
+			{
+				std::lock_guard <std::mutex> lock (_loadMutex);
+				if (!l->_done){
+					l->_continuations.push_back (continuation);
+					return true;
+				}
+			}
+			continuation (asset, l->_future.get ());
+			return true;
+		}
+		LOG_ERROR ("No load of asset \'" << name << "\' found");
+		return false;
+	}
+
+	bool AssetFactory::Poll ()
+	{
+		vector <AssetLoad*> ready;
+		{
+			std::lock_guard <std::mutex> lock (_loadMutex);
+			ready.swap (_ready);
+		}
+		for (auto l : ready){
+			StartupProfiler::Phase phase (string ("Asset ") + l->_element->Attribute ("Name") + " (main thread)", _startupPhase);
+			FinishLoad (*l, l->_success && l->_asset->LoadComponents (*l->_element, LOAD_MAIN_COMPONENTS));
+		}
+		if (!Loading () && !_loaders.empty ()){
+			for (auto &t : _loaders){
+				t.join ();
+			}
+			_loaders.clear ();
+			LOG ("All asset loads finished" << (_failed ? " (some failed)" : ""));
+		}
+		if (!Loading () && !_prefetchStarted){
+			StartPrefetch ();
+		}
+		return Loading ();
+	}
+
+	bool AssetFactory::Wait ()
+	{
+		while (Poll ()){
+			std::this_thread::sleep_for (std::chrono::milliseconds (1));
+		}
+		return !_failed;
+	}
+
+	bool AssetFactory::Save (SnapshotWriter& snapshot) const
+	{
+		if (Loading () || _assets.Empty ()){
+			LOG_ERROR ("Assets can only be checkpointed once they are all loaded");
+			return false;
+		}
+		if (!snapshot.Begin ("AssetFactory")){
+			return false;
+		}
+		snapshot.Write (static_cast <unsigned long long> (_componentIdMap.size ()));
+		for (auto &c : _componentIdMap){
+			snapshot.Write (c.first);
+			snapshot.Write (c.second);
+		}
+		snapshot.Write (static_cast <unsigned long long> (_assetIdMap.size ()));
+		for (auto &a : _assetIdMap){
+			snapshot.Write (a.first);
+			snapshot.Write (a.second);
+		}
+		for (auto &a : _assets){
+			if (!a->Loaded () || !a->Save (snapshot)){
+				LOG_ERROR ("Could not checkpoint asset " << a->Id ());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool AssetFactory::Restore (SnapshotReader& snapshot)
+	{
+		if (Loading ()){
+			LOG_ERROR ("Assets cannot be restored while they are loading");
+			return false;
 		}
-		shared_ptr <Asset> a;
-		LOG_ERROR ("Could not find asset with id " << id << ". Returning empty asset");
-		return a;
-#		else
-		return _assets [id];
-#		endif
+		map <string, unsigned int> componentIds;
+		map <string, unsigned int> assetIds;
+		unsigned long long count = 0;
+		bool success = snapshot.Section ("AssetFactory") && snapshot.Read (count);
+		for (unsigned long long i = 0; success && i < count; ++i){
+			string name;
+			unsigned int id = 0;
+			success = snapshot.Read (name) && snapshot.Read (id);
+			componentIds [name] = id;
+		}
+		success = success && snapshot.Read (count);
+		for (unsigned long long i = 0; success && i < count; ++i){
+			string name;
+			unsigned int id = 0;
+			success = snapshot.Read (name) && snapshot.Read (id);
+			assetIds [name] = id;
+		}
+		if (!success){
+			LOG_ERROR ("Corrupt asset registry in the snapshot");
+			return false;
+		}
+
+		// a scenario reset
+		if (!_assets.Empty ()){
+			if (assetIds != _assetIdMap || componentIds != _componentIdMap){
+				LOG_ERROR ("The snapshot holds other assets than the loaded ones");
+				return false;
+			}
+			for (auto &a : _assets){
+				if (!a->Restore (snapshot)){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		StartupProfiler::Phase phase ("AssetFactory::Restore");
+		if (!UseComponentIdMap (componentIds)){
+			return false;
+		}
+		_assetIdMap = assetIds;
+		for (auto &a : _assetIdMap){
+			string type;
+			if (!snapshot.Section ("Asset " + std::to_string (a.second)) || !snapshot.Read (type)){
+				LOG_ERROR ("Asset " << a.first << " not found in the snapshot");
+				Cleanup ();
+				return false;
+			}
+			shared_ptr <Asset> asset = make_shared <Asset> (a.second, type, this);
+			AddAsset (asset);
+			_loads.push_back (make_unique <AssetLoad> ());
+			_loads.back ()->_asset = asset;
+			_pendingLoads.fetch_add (1);
+			StartupProfiler::Phase p (string ("Asset ") + a.first);
+			success = asset->RestoreComponents (snapshot);
+			FinishLoad (*_loads.back (), success);
+			if (!success){
+				Cleanup ();
+				return false;
+			}
+		}
+		LOG ("AssetFactory restored " << _assets.Size () << " assets");
+		return true;
 	}
 
 	bool AssetFactory::InitializeComponentIdMap (XMLElement& elem)
@@ -105,6 +406,7 @@ namespace Sim {
 		}
 
 		XMLError error = XML_SUCCESS;
+		map <string, unsigned int> ids;
 		while (clist != nullptr){
 			const char* name = clist->Attribute ("Name");
 			if (name == nullptr){
@@ -116,12 +418,42 @@ namespace Sim {
 				LOG_ERROR ("No key value associated with Map element" << name);
 				return false;
 			}
-			_componentIdMap [name] = key;
+			ids [name] = key;
 			clist = clist->NextSiblingElement ("Map");
 		}
+		return UseComponentIdMap (ids);
+	}
+
+	// the map is only written while no other factory uses it, so lookups need no lock
+	bool AssetFactory::UseComponentIdMap (const map <string, unsigned int>& ids)
+	{
+		std::lock_guard <std::mutex> lock (_componentIdMutex);
+		unsigned int others = _componentIdUsers - (_usesComponentIds ? 1 : 0);
+		if (others == 0){
+			_componentIdMap = ids;
+		} else if (ids != _componentIdMap){
+			LOG_ERROR ("The component Id Map differs from the one the other asset factories use");
+			return false;
+		}
+		if (!_usesComponentIds){
+			_usesComponentIds = true;
+			++_componentIdUsers;
+		}
 		return true;
 	}
 
+	void AssetFactory::ReleaseComponentIdMap ()
+	{
+		std::lock_guard <std::mutex> lock (_componentIdMutex);
+		if (!_usesComponentIds){
+			return;
+		}
+		_usesComponentIds = false;
+		if (--_componentIdUsers == 0){
+			_componentIdMap.clear ();
+		}
+	}
+
 	bool AssetFactory::InitializeAssetMap (XMLElement& elem)
 	{
 		const XMLElement* alist = elem.FirstChildElement ("Asset");
@@ -145,15 +477,15 @@ namespace Sim {
 				LOG_ERROR ("Error reading ID for asset \'" << name << "\'");
 				return false;
 			}
-			auto f = _assets.find (id);
-			if (f != _assets.end ()){
+			auto f = _assetHandles.find (id);
+			if (f != _assetHandles.end ()){
 				LOG_ERROR ("Duplicate asset id " << id << "found in config file (forbidden)");
 				return false;
 			}
 
-			// add dummy asset ptr to map (this results in near-contiguous map)
-			shared_ptr <Asset> p;
-			_assets [id] = p;
+			// the asset gets its handle once it is created
+			_assetHandles [id] = AssetHandle ();
+			_assetIdMap [name] = id;
 
 			alist = alist->NextSiblingElement ("Asset");
 		}
@@ -176,9 +508,10 @@ namespace Sim {
 			}
 
 			unsigned int id = alist->UnsignedAttribute ("ID");
-			_assets [id] = make_shared <Asset> (id, assettype);
+			shared_ptr <Asset> asset = make_shared <Asset> (id, assettype, this);
+			AddAsset (asset);
 
-			_assets [id]->Initialize (*alist);
+			asset->Initialize (*alist);
 
 			alist = alist->NextSiblingElement ("Asset");
 		}
@@ -191,9 +524,16 @@ namespace Sim {
 
 		while (alist != nullptr){
 
-			auto a = _assets.find (alist->UnsignedAttribute ("ID"));
-			if (!a->second->LoadComponents (*alist)){
-				LOG_ERROR ("Could not load components for asset " << a->second->Id ());
+			shared_ptr <Asset> asset = GetAsset (alist->UnsignedAttribute ("ID"));
+			_loads.push_back (make_unique <AssetLoad> ());
+			AssetLoad& load = *_loads.back ();
+			load._asset = asset;
+			load._element = alist;
+			_pendingLoads.fetch_add (1);
+			StartupProfiler::Phase phase (string ("Asset ") + alist->Attribute ("Name"));
+			bool success = asset->LoadComponents (*alist);
+			FinishLoad (load, success);
+			if (!success){
 				return false;
 			}
 
@@ -202,4 +542,105 @@ namespace Sim {
 		return true;
 	}
 
+	bool AssetFactory::LoadAsync (XMLElement& elem, unsigned int loaders)
+	{
+		for (XMLElement* alist = elem.FirstChildElement ("Asset"); alist != nullptr; alist = alist->NextSiblingElement ("Asset")){
+			_loads.push_back (make_unique <AssetLoad> ());
+			_loads.back ()->_asset = GetAsset (alist->UnsignedAttribute ("ID"));
+			_loads.back ()->_element = alist;
+		}
+		_pendingLoads.store (static_cast <unsigned int> (_loads.size ()));
+
+		if (loaders == 0){
+			loaders = std::thread::hardware_concurrency ();
+		}
+		loaders = std::max (1u, std::min (loaders, static_cast <unsigned int> (_loads.size ())));
+		_nextLoad.store (0);
+		for (unsigned int i = 0; i < loaders; ++i){
+			_loaders.emplace_back ([this] {LoaderLoop ();});
+		}
+		return true;
+	}
+
+	// every loader takes the next asset and loads the components that need not run on the main thread
+	void AssetFactory::LoaderLoop ()
+	{
+		for (unsigned int i = _nextLoad.fetch_add (1); i < _loads.size (); i = _nextLoad.fetch_add (1)){
+			AssetLoad& load = *_loads [i];
+			{
+				StartupProfiler::Phase phase (string ("Asset ") + load._element->Attribute ("Name"), _startupPhase);
+				load._success = load._asset->LoadComponents (*load._element, LOAD_WORKER_COMPONENTS);
+			}
+			std::lock_guard <std::mutex> lock (_loadMutex);
+			_ready.push_back (&load);
+		}
+	}
+
+	void AssetFactory::FinishLoad (AssetLoad& load, bool success)
+	{
+		if (success){
+			load._asset->_loaded.store (true, std::memory_order_release);
+		} else {
+			LOG_ERROR ("Could not load components for asset " << load._asset->Id ());
+			_failed = true;
+		}
+
+		vector <Continuation> continuations;
+		{
+			std::lock_guard <std::mutex> lock (_loadMutex);
+			load._done = true;
+			continuations.swap (load._continuations);
+		}
+		load._promise.set_value (success);
+		for (auto &c : continuations){
+			c (load._asset, success);
+		}
+		_finishedLoads.fetch_add (1);
+		_pendingLoads.fetch_sub (1);
+	}
+
+	void AssetFactory::StartPrefetch ()
+	{
+		typedef std::pair <shared_ptr <Asset>, unsigned int> LazyEntry;
+		vector <LazyEntry> lazy;
+		for (auto &a : _assets){
+			for (unsigned int id = 0; id < a->_lazy.size (); ++id){
+				if (a->_lazy [id] && a->_lazy [id]->_priority > 0 && a->Pending (id)){
+					lazy.emplace_back (a, id);
+				}
+			}
+		}
+		_prefetchStarted = true;
+		if (lazy.empty ()){
+			return;
+		}
+		std::stable_sort (lazy.begin (), lazy.end (), [] (const LazyEntry& a, const LazyEntry& b) {
+			return a.first->_lazy [a.second]->_priority > b.first->_lazy [b.second]->_priority;
+		});
+		_stopPrefetch.store (false);
+		_prefetcher = std::thread ([this, lazy] {
+			auto start = std::chrono::steady_clock::now ();
+			unsigned int count = 0;
+			for (auto &l : lazy){
+				if (_stopPrefetch.load ()){
+					break;
+				}
+				if (l.first->Pending (l.second)){
+					l.first->Materialize (l.second);
+					++count;
+				}
+			}
+			double ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+			LOG ("Prefetched " << count << " lazy components in " << ms << " ms");
+		});
+	}
+
+	void AssetFactory::StopPrefetch ()
+	{
+		_stopPrefetch.store (true);
+		if (_prefetcher.joinable ()){
+			_prefetcher.join ();
+		}
+		_prefetchStarted = false;
+	}
 }
@@ -5,59 +5,235 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * The factory class for assets in the Chimera framework.
+ * The factory class for assets in the Chimera framework. It creates the
+ * assets of a configuration file, loads their components (in the
+ * background if asked to) and checkpoints them to snapshots.
  */
 #pragma once
 
+#include <atomic>
 #include <climits>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
 #include <string>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
+#include "InputParser.h"
+#include "SlotMap.h"
+#include "Assets/ComponentSystem.h"
+#include "Assets/ComponentType.h"
 
 namespace Sim {
 
 	class Asset;
 
+	typedef SlotHandle AssetHandle;
+	class SnapshotWriter;
+	class SnapshotReader;
+
 	class AssetFactory {
 
+		public:
+			// called with the asset and whether all of its components could be loaded
+			typedef std::function <void (std::shared_ptr <Asset>, bool)> Continuation;
+
 		protected:
+			// the loading of one asset
+			class AssetLoad {
+				public:
+					std::shared_ptr <Asset> _asset;
+					tinyxml2::XMLElement* _element;
+					std::promise <bool> _promise;
+					std::shared_future <bool> _future;
+					std::vector <Continuation> _continuations;
+					bool _success; // of the worker part
+					bool _done;
+
+					AssetLoad (): _element (nullptr), _future (_promise.get_future ().share ()), _success (false), _done (false) {}
+			};
+
+			/**
+			 * The component Id map is shared by every factory of the process (one per
+			 * simulation instance in a batch run); they must agree on it. It is set by
+			 * the first factory and cleared when the last one cleans up.
+			 */
 			static std::map <std::string, unsigned int> _componentIdMap;
-			std::map <unsigned int, std::shared_ptr <Asset> > _assets;
+			static std::mutex _componentIdMutex;
+			static unsigned int _componentIdUsers;
+			bool _usesComponentIds;
+			std::map <std::string, unsigned int> _assetIdMap;
+			/**
+			 * Assets are kept in a dense table and addressed by their handle, a lookup
+			 * by index that stays valid until the asset is removed, whatever else is
+			 * added or removed meanwhile (e.g. assets spawned by cutting). The ids of
+			 * the configuration file (see MapId.xml) are a side index to the handles,
+			 * for loading, snapshots and external inputs.
+			 */
+			SlotMap <std::shared_ptr <Asset> > _assets;
+			std::map <unsigned int, AssetHandle> _assetHandles; // by the id of the configuration file (invalid until created)
+			std::mutex _systemMutex;
+			std::map <unsigned int, std::shared_ptr <Assets::ComponentSystem> > _systems; // by component id
+
+			// asynchronous loading
+			std::unique_ptr <InputParser> _parser; // keeps the asset elements alive while loading
+			std::vector <std::unique_ptr <AssetLoad> > _loads;
+			std::vector <std::thread> _loaders;
+			std::atomic <unsigned int> _nextLoad;
+			std::atomic <unsigned int> _pendingLoads;
+			std::atomic <unsigned int> _finishedLoads;
+			std::mutex _loadMutex; // guards the ready queue and the continuations
+			std::vector <AssetLoad*> _ready; // worker part done, main-thread part pending
+			bool _failed;
+			int _startupPhase; // parent of the asset loads in the start-up profile
+
+			// background prefetch of lazy components
+			std::thread _prefetcher;
+			std::atomic <bool> _stopPrefetch;
+			bool _prefetchStarted;
 
 		private: // forbidden copy constructor and assignment operator
 			AssetFactory (const AssetFactory& a) {}
 			AssetFactory& operator = (const AssetFactory& a) {return *this;}
 
 		public:
-			AssetFactory () {LOG ("Asset factory constructed");}
-			~AssetFactory () {LOG ("Asset factory destroyed");}
+			AssetFactory (): _usesComponentIds (false), _nextLoad (0), _pendingLoads (0), _finishedLoads (0), _failed (false), _startupPhase (-1),
+					_stopPrefetch (false), _prefetchStarted (false) {LOG ("Asset factory constructed");}
+			~AssetFactory () {Cleanup (); LOG ("Asset factory destroyed");}
 
-			bool Initialize (const char* config);
+			/**
+			 * With 'Async="true"' on the <Assets> entry, returns as soon as the assets
+			 * are created, and their components are loaded in the background: one
+			 * task per asset on 'Loaders' threads (0: one per hardware thread), so
+			 * loading plugins must be safe to call concurrently for different assets.
+			 * Components marked 'MainThread="true"' (typically those creating GPU
+			 * resources) are then loaded by the thread calling Poll (). Without
+			 * 'Async', or with synchronous set, every asset is loaded on the calling
+			 * thread before it returns.
+			 */
+			bool Initialize (const char* config, bool synchronous = false);
 			void Cleanup ();
 
 			std::shared_ptr <Asset> GetAsset (unsigned int id);
+			std::shared_ptr <Asset> GetAsset (const char* name);
+			// O(1); empty once the asset is removed
+			std::shared_ptr <Asset> GetAsset (AssetHandle handle) const
+			{
+				const std::shared_ptr <Asset>* asset = _assets.Find (handle);
+				return asset != nullptr ? *asset : std::shared_ptr <Asset> ();
+			}
+			// the handle of an id of the configuration file (invalid if there is no such asset)
+			AssetHandle Handle (unsigned int id) const;
+
+			/**
+			 * Assets added or removed while the simulation runs (between frames, on
+			 * the main thread, with every asset loaded). AddAsset () registers the
+			 * asset's id (and name) too; it fails if either is taken. The tasks
+			 * running the components of a removed asset must be rebuilt (see
+			 * TaskManager::ReloadGraph ()).
+			 */
+			AssetHandle AddAsset (const std::shared_ptr <Asset>& asset, const char* name = nullptr);
+			bool RemoveAsset (AssetHandle handle);
+			// every asset, contiguous
+			const SlotMap <std::shared_ptr <Asset> >& AllAssets () const {return _assets;}
+
+			/**
+			 * Loading plugins may store the components of a type by value in one
+			 * contiguous array per factory, its system (see ComponentSystem.h),
+			 * rather than as one object per asset. This is the system of a component
+			 * type (created on first use, by any loading thread).
+			 */
+			template <class SystemType> SystemType& System (const char* type)
+			{
+				std::lock_guard <std::mutex> lock (_systemMutex);
+				std::shared_ptr <Assets::ComponentSystem>& system = _systems [ComponentId (type)];
+				if (!system){
+					system = std::make_shared <SystemType> (type);
+				}
+				return static_cast <SystemType&> (*system);
+			}
+			// the system of a component type (empty if no asset stores that type in one)
+			std::shared_ptr <Assets::ComponentSystem> GetSystem (unsigned int id)
+			{
+				std::lock_guard <std::mutex> lock (_systemMutex);
+				auto s = _systems.find (id);
+				return s != _systems.end () ? s->second : std::shared_ptr <Assets::ComponentSystem> ();
+			}
+
+			// future of an asset's load, ready (true on success) once all its components are loaded (invalid for unknown assets)
+			std::shared_future <bool> LoadFuture (const char* name);
+			// run continuation from Poll () once the asset is loaded (right away if it already is)
+			bool Then (const char* name, const Continuation& continuation);
+			/**
+			 * Load pending main-thread components and run the continuations of the
+			 * assets that finished loading. Returns true while loads are pending.
+			 */
+			bool Poll ();
+			// poll until every asset is loaded; false if any failed
+			bool Wait ();
+			bool Loading () const {return _pendingLoads.load () > 0;}
+			// number of asset loads that have finished (successfully or not)
+			unsigned int FinishedLoads () const {return _finishedLoads.load ();}
+
+			/**
+			 * Checkpointing (between frames, with every asset loaded): Save () writes
+			 * the asset registry and the state of every component. In place of
+			 * Initialize (), Restore () creates the assets and restores their
+			 * components through their loading plugins, without reading any
+			 * configuration or mesh file; into a factory holding the same assets (a
+			 * scenario reset) it restores the components in place.
+			 */
+			bool Save (SnapshotWriter&) const;
+			bool Restore (SnapshotReader&);
 
+			/**
+			 * The id (slot, see ComponentType.h) of a component type named in a
+			 * configuration file or snapshot; UINT_MAX if the component Id map does
+			 * not name it. For loading only: code that knows the type at compile
+			 * time uses SIM_COMPONENT_ID () instead.
+			 */
 			static unsigned int ComponentId (const char* name)
 			{
-#				ifndef NDEBUG
-				auto it = _componentIdMap.find (name);
-				if (it == _componentIdMap.end ()){
+				if (_componentIdMap.find (name) == _componentIdMap.end ()){
 					LOG_ERROR ("No ID could be found for " << name);
 					return UINT_MAX;
 				}
-				return it->second;
-#				else
-				return _componentIdMap [name];
-#				endif
+				return Assets::ComponentTypes::Slot (name);
 			}
 
 		private:
 			bool InitializeComponentIdMap (tinyxml2::XMLElement&);
+			bool UseComponentIdMap (const std::map <std::string, unsigned int>&);
+			void ReleaseComponentIdMap ();
 			bool InitializeAssetMap (tinyxml2::XMLElement&);
 			bool InitializeAssets (tinyxml2::XMLElement&);
+			/**
+			 * Within an asset, a component loads after the components named in its
+			 * 'After' attribute (e.g. After="Geometry,Render"), or after the one
+			 * listed before it when it has none. Components whose dependencies are
+			 * loaded load concurrently, so plugins must be safe to call for
+			 * independent components of one asset. A worker component that depends
+			 * on a main-thread one loads on the main thread after it.
+			 */
 			bool LoadComponents (tinyxml2::XMLElement&);
+			bool LoadAsync (tinyxml2::XMLElement&, unsigned int loaders);
+			void LoaderLoop ();
+			void FinishLoad (AssetLoad&, bool success);
+			/**
+			 * Components marked 'Lazy="true"' are left out of the load and loaded on
+			 * first access (see Asset.h); those with a 'Priority' above 0 are also
+			 * prefetched by a background thread once every asset is loaded (from
+			 * Poll ()), highest priority first. Only components that nothing else
+			 * loads after, and that no plugin reaches through other assets while the
+			 * simulation runs, should be lazy. Cleanup () and RemoveAsset () stop the
+			 * prefetch of what they drop.
+			 */
+			void StartPrefetch ();
+			void StopPrefetch ();
 	};
 }
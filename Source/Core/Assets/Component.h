@@ -14,11 +14,16 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "tinyxml2.h"
 
 namespace Sim {
 
 	class Asset;
+	class Input;
+	class QualityKnob;
+	class SnapshotWriter;
+	class SnapshotReader;
 
 	namespace Assets {
 
@@ -36,10 +41,49 @@ namespace Sim {
 				virtual ~Component () {_owner = nullptr;}
 
 				virtual const std::string Name () const = 0;
+				Asset* Owner () const {return _owner;}
 
 				virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) = 0;
 				virtual void Update () = 0;
 				virtual void Cleanup () = 0;
+
+				/**
+				 * Components whose work can be split over the spatial subsets of their
+				 * asset's geometry return the number of subsets (0: cannot be split).
+				 * A split task calls UpdateSubset () for every subset concurrently and
+				 * then MergeSubsets () once, which reconciles the data shared across
+				 * subset boundaries, in place of Update (). Per-subset results (e.g.
+				 * contacts) are merged in subset order, so that they do not depend on
+				 * the order in which the subsets ran.
+				 */
+				virtual unsigned int SubsetCount () const {return 0;}
+				virtual void UpdateSubset (unsigned int subset) {}
+				virtual void MergeSubsets () {}
+
+				/**
+				 * Checkpointing (see AssetFactory::Save ()). Save () writes the complete
+				 * state of the component to the section selected for it; Restore () reads
+				 * it back into a component of the same shape, in place of loading it from
+				 * its configuration. Both are called between frames, with no task of the
+				 * component running. Components that cannot be checkpointed (e.g. those
+				 * owning GPU resources) return false.
+				 */
+				virtual bool Save (SnapshotWriter& snapshot) const {return false;}
+				virtual bool Restore (SnapshotReader& snapshot) {return false;}
+
+				/**
+				 * External input aimed at the asset (e.g. the pose of a tool, see
+				 * InputLog.h), applied between two ticks of the slowest rate. Returns
+				 * whether the component took it.
+				 */
+				virtual bool ApplyInput (const Input& input) {return false;}
+
+				/**
+				 * Components that can trade quality for time (e.g. fewer solver
+				 * iterations) append the knobs they read to 'knobs'; the knobs stay
+				 * owned by the component (see QualityGovernor.h).
+				 */
+				virtual void QualityKnobs (std::vector <QualityKnob*>& knobs) {}
 		};
 	}
 }
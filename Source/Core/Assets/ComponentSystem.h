@@ -0,0 +1,152 @@
+/**
+ * @file ComponentSystem.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Data-oriented storage of a component type. Rather than every asset
+ * owning its component as a separate heap object behind a virtual
+ * Update (), a loading plugin may put the components of one type of all
+ * assets of a factory by value into one contiguous array, owned by the
+ * type's system (see AssetFactory::System ()); an asset then only holds
+ * the index of its element (see Asset::AddElement ()). The system is
+ * itself a component that the task graph runs once per frame for the
+ * whole array (a <System Component="..."/> entry of a task, see
+ * TaskGraph.h): one pass over consecutive elements, with their update
+ * inlined, split into blocks of SIM_SYSTEM_BLOCK elements that idle
+ * workers steal. Systems have no owner, so they do not publish the
+ * geometry of the assets their elements belong to (see RateScheduler.h).
+ * Elements are stored and checkpointed as raw bytes, so they must not
+ * hold pointers into the process.
+ */
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Snapshot.h"
+#include "Assets/Component.h"
+
+namespace Sim {
+
+	class Asset;
+	class Input;
+
+	namespace Assets {
+
+		// elements per block of a system's split update
+		const static unsigned int SIM_SYSTEM_BLOCK = 512;
+
+		class ComponentSystem : public Component {
+
+			protected:
+				std::string _type;
+				mutable std::mutex _mutex; // guards adding elements (assets load concurrently)
+				std::vector <Asset*> _owners; // per element
+
+			public:
+				explicit ComponentSystem (const std::string& type): _type (type) {}
+				virtual ~ComponentSystem () {}
+
+				// forbidden copy constructor and assignment operator
+				ComponentSystem (const ComponentSystem&) = delete;
+				ComponentSystem& operator = (const ComponentSystem&) = delete;
+
+				virtual const std::string Name () const override {return _type;}
+				virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) override {return true;}
+				virtual void Cleanup () override {}
+
+				unsigned int Count () const {return static_cast <unsigned int> (_owners.size ());}
+				Asset* ElementOwner (unsigned int index) const {return _owners [index];}
+
+				// the elements [begin, end) in order
+				virtual void UpdateRange (unsigned int begin, unsigned int end) = 0;
+				virtual void Update () override {UpdateRange (0, Count ());}
+
+				// blocks of the array (0: a single block, not worth splitting)
+				virtual unsigned int SubsetCount () const override
+				{
+					return Count () > SIM_SYSTEM_BLOCK ? (Count () + SIM_SYSTEM_BLOCK - 1)/SIM_SYSTEM_BLOCK : 0;
+				}
+				virtual void UpdateSubset (unsigned int block) override
+				{
+					UpdateRange (block*SIM_SYSTEM_BLOCK, std::min ((block + 1)*SIM_SYSTEM_BLOCK, Count ()));
+				}
+
+				// removes an element by moving the last one into its place; returns the asset of the moved one (null: none moved)
+				virtual Asset* RemoveElement (unsigned int index) = 0;
+
+				// the state of one element, in the section of its asset's component (see Asset::Save ())
+				virtual bool SaveElement (unsigned int index, SnapshotWriter& snapshot) const = 0;
+				virtual bool RestoreElement (unsigned int index, SnapshotReader& snapshot) = 0;
+				// an external input aimed at the element's asset (see Component::ApplyInput ())
+				virtual bool ApplyInput (unsigned int index, const Input& input) {return false;}
+		};
+
+		/**
+		 * The elements are updated through their non-virtual Update (). Adding
+		 * and removing may move them, so references to elements are only good
+		 * until the next element is added or removed; they are added while the
+		 * assets load and removed with their assets (see AssetFactory::RemoveAsset ()).
+		 */
+		template <class ElementType> class ComponentArray : public ComponentSystem {
+
+			protected:
+				std::vector <ElementType> _elements;
+
+			public:
+				explicit ComponentArray (const std::string& type): ComponentSystem (type) {}
+				virtual ~ComponentArray () {}
+
+				// returns the index of the new element (any thread)
+				unsigned int Add (Asset* owner, const ElementType& element)
+				{
+					std::lock_guard <std::mutex> lock (_mutex);
+					_elements.push_back (element);
+					_owners.push_back (owner);
+					return static_cast <unsigned int> (_elements.size () - 1);
+				}
+
+				virtual Asset* RemoveElement (unsigned int index) override
+				{
+					std::lock_guard <std::mutex> lock (_mutex);
+					Asset* moved = nullptr;
+					if (index + 1 < _elements.size ()){
+						_elements [index] = _elements.back ();
+						_owners [index] = _owners.back ();
+						moved = _owners [index];
+					}
+					_elements.pop_back ();
+					_owners.pop_back ();
+					return moved;
+				}
+
+				ElementType& operator [] (unsigned int index) {return _elements [index];}
+				const ElementType& operator [] (unsigned int index) const {return _elements [index];}
+				ElementType* Data () {return _elements.data ();}
+
+				virtual void UpdateRange (unsigned int begin, unsigned int end) override
+				{
+					ElementType* e = _elements.data ();
+					for (unsigned int i = begin; i < end; ++i){
+						e [i].Update ();
+					}
+				}
+
+				virtual bool SaveElement (unsigned int index, SnapshotWriter& snapshot) const override
+				{
+					snapshot.Write (&_elements [index], 1);
+					return true;
+				}
+
+				virtual bool RestoreElement (unsigned int index, SnapshotReader& snapshot) override
+				{
+					return snapshot.Read (&_elements [index], 1);
+				}
+		};
+	}
+}
@@ -0,0 +1,68 @@
+/**
+ * @file ComponentType.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See ComponentType.h.
+ */
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Preprocess.h"
+
+#include "Assets/ComponentType.h"
+
+using std::string;
+
+namespace Sim {
+
+	namespace Assets {
+
+		std::mutex ComponentTypes::_mutex;
+		std::vector <unsigned int> ComponentTypes::_keys;
+		std::vector <string> ComponentTypes::_names;
+
+		// there are few types, and slots are only looked up on first use
+		unsigned int ComponentTypes::Slot (unsigned int key)
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			for (unsigned int i = 0; i < _keys.size (); ++i){
+				if (_keys [i] == key){
+					return i;
+				}
+			}
+			_keys.push_back (key);
+			_names.push_back (string ());
+			return static_cast <unsigned int> (_keys.size () - 1);
+		}
+
+		unsigned int ComponentTypes::Slot (const char* name)
+		{
+			unsigned int slot = Slot (ComponentKey (name));
+			std::lock_guard <std::mutex> lock (_mutex);
+			if (_names [slot].empty ()){
+				_names [slot] = name;
+			} else if (_names [slot] != name){
+				LOG_ERROR ("Component types " << _names [slot] << " and " << name << " have the same key");
+				return UINT_MAX;
+			}
+			return slot;
+		}
+
+		unsigned int ComponentTypes::Count ()
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			return static_cast <unsigned int> (_keys.size ());
+		}
+
+		string ComponentTypes::Name (unsigned int slot)
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			return slot < _names.size () ? _names [slot] : string ();
+		}
+	}
+}
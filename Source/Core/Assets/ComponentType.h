@@ -0,0 +1,66 @@
+/**
+ * @file ComponentType.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Component type ids. Every component type name gets a small dense id
+ * (its slot), so that an asset keeps its components in a vector indexed
+ * by it (see Asset.h). The slot is registered by the 32 bit FNV-1a key of
+ * the name, which ComponentKey () computes at compile time for literals:
+ * code reaching a component of a known type uses
+ *   SIM_COMPONENT_ID ("Geometry")
+ * which resolves the slot once per call site and is a static load from
+ * then on, without strings or map lookups. Names read from configuration
+ * files and snapshots are resolved at load time through
+ * AssetFactory::ComponentId (), which checks them against the component
+ * Id Map first. Slots are never released, so the ids hold for the whole
+ * process, across asset factories.
+ */
+#pragma once
+
+#include <climits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Sim {
+
+	namespace Assets {
+
+		// key of a component type name (evaluated by the compiler for literals)
+		constexpr unsigned int ComponentKey (const char* name, unsigned int hash = 2166136261u)
+		{
+			return *name == '\0' ? hash : ComponentKey (name + 1, (hash ^ static_cast <unsigned char> (*name))*16777619u);
+		}
+
+		class ComponentTypes {
+
+			protected:
+				static std::mutex _mutex;
+				static std::vector <unsigned int> _keys; // by slot
+				static std::vector <std::string> _names; // by slot (empty until registered by name)
+
+			public:
+				// the slot of a key, registered on first use (any thread)
+				static unsigned int Slot (unsigned int key);
+				// the slot of a name (UINT_MAX if another name has the same key)
+				static unsigned int Slot (const char* name);
+				static unsigned int Count ();
+				static std::string Name (unsigned int slot);
+		};
+
+		// the slot of the type whose key is 'Key', resolved on first use
+		template <unsigned int Key> class ComponentType {
+			public:
+				static unsigned int Id ()
+				{
+					static const unsigned int id = ComponentTypes::Slot (Key);
+					return id;
+				}
+		};
+	}
+}
+
+#define SIM_COMPONENT_ID(name) (Sim::Assets::ComponentType <Sim::Assets::ComponentKey (name)>::Id ())
@@ -9,13 +9,20 @@
  */
 
 #include <cstdio>
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
 
 #include "InputParser.h"
+#include "StartupProfiler.h"
+#include "Snapshot.h"
+#include "SharedCache.h"
 #include "MeshLoader.h"
 #include "Vector.h"
 #include "Assets/Geometry.h"
@@ -32,10 +39,26 @@ using Sim::Vector;
 namespace Sim {
 	namespace Assets {
 
+		// number of buffers in the vertex ring
+		const static unsigned int SIM_GEOMETRY_BUFFER_COUNT = 3;
+
+		std::mutex Geometry::_instanceMutex;
+		std::condition_variable Geometry::_instanceLoaded;
+		std::map <string, std::weak_ptr <const Geometry::MeshData> > Geometry::_instances;
+		std::set <string> Geometry::_instanceLoads;
+		std::atomic <unsigned int> Geometry::_instanceCount (0);
+		std::atomic <unsigned long long> Geometry::_instanceBytes (0);
+
 		Geometry::Geometry ()
-		: _offsetIndex (1), _offsetSize (0), _numVertices (0),
-			_numSurfaceVertices (0), _numFaces (0), _numSubsets (1)
-		{}
+		: _offsetIndex (1), _publishedIndex (0), _retiredIndex (2), _pipelined (false), _latch (0), _publications (0),
+			_interpolated (false), _laterCount (0), _offsetSize (0), _numVertices (0), _numSurfaceVertices (0), _vertexData (nullptr),
+			_shared (false), _numFaces (0), _numSubsets (1), _normalQuality ("Normals", 0, 3), _splitUpdates (0)
+		{
+			for (unsigned int i = 0; i < SIM_GEOMETRY_BUFFER_COUNT; ++i){
+				_publishCount [i].store (0);
+				_publishTime [i].store (0);
+			}
+		}
 
 		bool Geometry::Initialize (XMLElement& config, Asset* asset)
 		{
@@ -72,51 +95,459 @@ namespace Sim {
 			prefix += "/";
 			prefix += name;
 
+			_source = prefix;
+
+			shared_ptr <const MeshData> mesh = Instance (prefix);
+			if (!mesh){
+				return false;
+			}
+			Instantiate (mesh);
+			return true;
+		}
+
+		/**
+		 * Concurrent loads of one prefix wait for the first. A mesh is forgotten
+		 * once its last instance is gone; in a batch run the SharedCache keeps it
+		 * for the other simulation instances.
+		 */
+		shared_ptr <const Geometry::MeshData> Geometry::Instance (const string& prefix)
+		{
+			shared_ptr <const MeshData> mesh;
+			{
+				std::unique_lock <std::mutex> lock (_instanceMutex);
+				_instanceLoaded.wait (lock, [&prefix] {return _instanceLoads.count (prefix) == 0;});
+				auto i = _instances.find (prefix);
+				if (i != _instances.end ()){
+					mesh = i->second.lock ();
+					if (mesh){
+						LOG ("Geometry " << prefix << " instanced (" << mesh->_bytes << " bytes shared)");
+						_instanceCount.fetch_add (1);
+						_instanceBytes.fetch_add (mesh->_bytes);
+						return mesh;
+					}
+					_instances.erase (i);
+				}
+				_instanceLoads.insert (prefix);
+			}
+			bool loaded = false;
+			try {
+				mesh = SharedCache::Instance ().Get <MeshData> ("Geometry " + prefix, [this, &prefix, &loaded] (size_t& bytes) {
+					loaded = true;
+					return Load (prefix) ? Share (bytes) : shared_ptr <const MeshData> ();
+				});
+			} catch (...){
+				// the geometries waiting for this load try it themselves
+				{
+					std::lock_guard <std::mutex> lock (_instanceMutex);
+					_instanceLoads.erase (prefix);
+				}
+				_instanceLoaded.notify_all ();
+				throw;
+			}
+			// a hit in the batch cache is an instance of the mesh another simulation loaded
+			if (mesh && !loaded){
+				_instanceCount.fetch_add (1);
+				_instanceBytes.fetch_add (mesh->_bytes);
+			}
+			{
+				std::lock_guard <std::mutex> lock (_instanceMutex);
+				if (mesh){
+					_instances [prefix] = mesh;
+				}
+				_instanceLoads.erase (prefix);
+			}
+			_instanceLoaded.notify_all ();
+			return mesh;
+		}
+
+		void Geometry::ReportInstances ()
+		{
+			LOG ("Geometry instances: " << _instanceCount.load () << ", sharing " << _instanceBytes.load () << " bytes of mesh data");
+		}
+
+		bool Geometry::Load (const string& prefix)
+		{
 			string file (prefix);
 			file += ".node";
 
 			if (!ReadVertexFile (file.c_str ())){
-				LOG_ERROR ("Failed to read vertex file for Geometry component of " << name);
+				LOG_ERROR ("Failed to read vertex file for Geometry component " << prefix);
 				Cleanup ();
 				return false;
 			}
 
 			if (!ReadIndexFiles (prefix.c_str ())){
-				LOG_ERROR ("Failed to read index files for Geometry component of " << name);
+				LOG_ERROR ("Failed to read index files for Geometry component " << prefix);
 				Cleanup ();
 				return false;
 			}
 			UpdateSurfaceVertexCount ();
+			InitializeSubsets ();
 			_offsetSize = SIM_VECTOR_SIZE * sizeof (Vector) * _numVertices;
 
 			return true;
 		}
 
+		// the loaded ring (still the rest state in every buffer), normals and faces are handed over as they are
+		shared_ptr <const Geometry::MeshData> Geometry::Share (size_t& bytes) const
+		{
+			shared_ptr <MeshData> mesh = make_shared <MeshData> ();
+			mesh->_rest = _vertices;
+			mesh->_normals = _normals;
+			mesh->_faces = _faces;
+			mesh->_subsets.assign (_subsets.get (), _subsets.get () + _numSubsets);
+			mesh->_numVertices = _numVertices;
+			mesh->_numSurfaceVertices = _numSurfaceVertices;
+			mesh->_numFaces = _numFaces;
+			mesh->_bounds = _bounds;
+
+			bytes = (SIM_GEOMETRY_BUFFER_COUNT*_numVertices + _numSurfaceVertices)*sizeof (Vector) + 3*_numFaces*sizeof (unsigned int);
+			for (auto &s : mesh->_subsets){
+				bytes += sizeof (SpatialSubset) + (s._owned.size () + s._halo.size ())*sizeof (unsigned int);
+			}
+			mesh->_bytes = bytes;
+			return mesh;
+		}
+
+		/**
+		 * The faces stay shared (nothing writes them; Relocate () and Restore ()
+		 * make a copy of their own first), and so do the ring and the normals
+		 * until the first write (see Detach ()). The subsets, whose bounds and
+		 * halo normals change every frame, belong to this geometry.
+		 */
+		void Geometry::Instantiate (const shared_ptr <const MeshData>& mesh)
+		{
+			_mesh = mesh;
+			_numVertices = mesh->_numVertices;
+			_numSurfaceVertices = mesh->_numSurfaceVertices;
+			_numFaces = mesh->_numFaces;
+			_numSubsets = static_cast <unsigned int> (mesh->_subsets.size ());
+			_bounds = mesh->_bounds;
+
+			_vertices = mesh->_rest;
+			_normals = mesh->_normals;
+			_faces = mesh->_faces;
+			_subsets = shared_ptr <SpatialSubset> (new SpatialSubset [_numSubsets], DeleteArray <SpatialSubset> ());
+			std::copy (mesh->_subsets.begin (), mesh->_subsets.end (), _subsets.get ());
+			_offsetSize = SIM_VECTOR_SIZE * sizeof (Vector) * _numVertices;
+			_vertexData.store (_vertices.get (), std::memory_order_release);
+			_shared.store (true, std::memory_order_release);
+		}
+
+		/**
+		 * Only writers detach, and a writer never writes the buffers readers have
+		 * latched, so a reader still holding a pointer into the shared ring reads
+		 * the same values the copy holds. The shared arrays stay alive with the
+		 * mesh.
+		 */
+		void Geometry::Detach ()
+		{
+			std::lock_guard <std::mutex> lock (_detachMutex);
+			if (!_shared.load (std::memory_order_acquire)){
+				return;
+			}
+			unsigned int count = SIM_GEOMETRY_BUFFER_COUNT*_numVertices;
+			shared_ptr <Vector> vertices (new Vector [count], DeleteArray <Vector> ());
+			std::copy (_vertices.get (), _vertices.get () + count, vertices.get ());
+			shared_ptr <Vector> normals (new Vector [_numSurfaceVertices], DeleteArray <Vector> ());
+			std::copy (_normals.get (), _normals.get () + _numSurfaceVertices, normals.get ());
+			_vertices = vertices;
+			_normals = normals;
+			_vertexData.store (_vertices.get (), std::memory_order_release);
+			_shared.store (false, std::memory_order_release);
+		}
+
+		// publish the buffer just written and move the writer to a buffer nobody reads
 		void Geometry::Update ()
 		{
-			++_offsetIndex;
+			unsigned int written = _offsetIndex.load ();
+			_publishCount [written].store (++_publications);
+			_publishTime [written].store (std::chrono::steady_clock::now ().time_since_epoch ().count ());
+			_retiredIndex.store (_publishedIndex.load ());
+			_publishedIndex.store (written);
+
+			unsigned int latch = _latch.load ();
+			unsigned int pinned = latch >= SIM_GEOMETRY_LATCH_READER ? (latch & 3) : SIM_GEOMETRY_BUFFER_COUNT;
+			for (unsigned int i = 1; i < SIM_GEOMETRY_BUFFER_COUNT; ++i){
+				unsigned int next = (written + i) % SIM_GEOMETRY_BUFFER_COUNT;
+				if (next != pinned){
+					_offsetIndex.store (next);
+					break;
+				}
+			}
+			_published.Increment ();
+		}
+
+		/**
+		 * Must be called before any other thread holds a pointer into the buffers.
+		 * Every page of the new arrays is first written by the calling thread, so
+		 * the OS places them on that thread's NUMA node.
+		 */
+		void Geometry::Relocate ()
+		{
+			if (_vertices){
+				unsigned int count = SIM_GEOMETRY_BUFFER_COUNT*_numVertices;
+				std::shared_ptr <Vector> vertices (new Vector [count], DeleteArray <Vector> ());
+				Vector* src = _vertices.get ();
+				Vector* dst = vertices.get ();
+				for (unsigned int i = 0; i < count; ++i){
+					dst [i] = src [i];
+				}
+				_vertices = vertices;
+				_vertexData.store (_vertices.get (), std::memory_order_release);
+			}
+			if (_faces){
+				unsigned int count = 3*_numFaces;
+				std::shared_ptr <unsigned int> faces (new unsigned int [count], DeleteArray <unsigned int> ());
+				unsigned int* src = _faces.get ();
+				unsigned int* dst = faces.get ();
+				for (unsigned int i = 0; i < count; ++i){
+					dst [i] = src [i];
+				}
+				_faces = faces;
+			}
+			if (_normals){
+				std::shared_ptr <Vector> normals (new Vector [_numSurfaceVertices], DeleteArray <Vector> ());
+				for (unsigned int i = 0; i < _numSurfaceVertices; ++i){
+					normals.get () [i] = _normals.get () [i];
+				}
+				_normals = normals;
+			}
+			_shared.store (false, std::memory_order_release);
+		}
+
+		/**
+		 * The first reader pins the published buffer; later readers join that latch.
+		 * A pin is safe once the writer is bound to see it before choosing its next
+		 * target, which holds whenever the pinned buffer is still the published one
+		 * after pinning (the writer publishes before it reads the latch). A reader
+		 * that finds its unconfirmed pin stale drops it and tries again; readers
+		 * joining a confirmed pin are done at once. No reader waits for the writer.
+		 */
+		void Geometry::LatchVertexBuffer ()
+		{
+			while (true){
+				unsigned int latch = _latch.load ();
+				unsigned int pinned = latch >= SIM_GEOMETRY_LATCH_READER ? latch + SIM_GEOMETRY_LATCH_READER :
+						(SIM_GEOMETRY_LATCH_READER | _publishedIndex.load ());
+				if (!_latch.compare_exchange_weak (latch, pinned)){
+					continue;
+				}
+				if (pinned & SIM_GEOMETRY_LATCH_SAFE){
+					return;
+				}
+				if (_publishedIndex.load () == (pinned & 3)){
+					_latch.fetch_or (SIM_GEOMETRY_LATCH_SAFE);
+					return;
+				}
+				ReleaseVertexBuffer ();
+			}
+		}
+
+		// the last reader clears the latch for a fresh pin
+		void Geometry::ReleaseVertexBuffer ()
+		{
+			unsigned int latch = _latch.load ();
+			while (latch >= SIM_GEOMETRY_LATCH_READER){
+				unsigned int released = latch >= 2*SIM_GEOMETRY_LATCH_READER ? latch - SIM_GEOMETRY_LATCH_READER : 0;
+				if (_latch.compare_exchange_weak (latch, released)){
+					return;
+				}
+			}
+		}
+
+		void Geometry::SetInterpolated (bool flag)
+		{
+			_interpolated = flag;
+			_laterCount = 0;
+			if (!flag){
+				_earlier.reset ();
+				_later.reset ();
+				_display.reset ();
+				return;
+			}
+			_earlier = std::shared_ptr <Vector> (new Vector [_numVertices], DeleteArray <Vector> ());
+			_later = std::shared_ptr <Vector> (new Vector [_numVertices], DeleteArray <Vector> ());
+			_display = std::shared_ptr <Vector> (new Vector [_numVertices], DeleteArray <Vector> ());
+			const Vector* published = LatchedVertexBuffer ();
+			for (unsigned int i = 0; i < _numVertices; ++i){
+				_display.get () [i] = published [i];
+			}
+		}
+
+		/**
+		 * A new state is copied in once, when the reader first sees it. If the
+		 * reader runs slower than the writer it misses states and the blend
+		 * saturates at the latest one.
+		 */
+		void Geometry::Interpolate (double period)
+		{
+			unsigned int latch = _latch.load ();
+			if (!_interpolated || latch < SIM_GEOMETRY_LATCH_READER){
+				return;
+			}
+			unsigned int index = latch & 3;
+			const Vector* latched = Buffer (index);
+
+			unsigned long long count = _publishCount [index].load ();
+			if (count != _laterCount){
+				std::swap (_earlier, _later);
+				for (unsigned int i = 0; i < _numVertices; ++i){
+					_later.get () [i] = latched [i];
+				}
+				if (_laterCount == 0){
+					for (unsigned int i = 0; i < _numVertices; ++i){
+						_earlier.get () [i] = latched [i];
+					}
+				}
+				_laterCount = count;
+			}
+
+			std::chrono::steady_clock::duration age = std::chrono::steady_clock::now ().time_since_epoch () -
+					std::chrono::steady_clock::duration (_publishTime [index].load ());
+			double alpha = period > 0. ? std::chrono::duration <double> (age).count ()/period : 1.;
+			Real a = static_cast <Real> (alpha < 0. ? 0. : alpha > 1. ? 1. : alpha);
+
+			const Vector* earlier = _earlier.get ();
+			const Vector* later = _later.get ();
+			Vector* display = _display.get ();
+			for (unsigned int i = 0; i < _numVertices; ++i){
+				display [i] = later [i];
+				display [i] -= earlier [i];
+				display [i] *= a;
+				display [i] += earlier [i];
+			}
 		}
 
 		void Geometry::Cleanup ()
 		{
+			_vertexData.store (nullptr);
+			_shared.store (false);
+			_mesh.reset ();
 			_vertices.reset ();
 			_faces.reset ();
 			_subsets.reset ();
+			_normals.reset ();
+			_earlier.reset ();
+			_later.reset ();
+			_display.reset ();
+		}
+
+		bool Geometry::Save (SnapshotWriter& snapshot) const
+		{
+			unsigned int counts [4] = {_numVertices, _numSurfaceVertices, _numFaces, _numSubsets};
+			unsigned int ring [3] = {_offsetIndex.load (), _publishedIndex.load (), _retiredIndex.load ()};
+			unsigned long long published [SIM_GEOMETRY_BUFFER_COUNT];
+			for (unsigned int i = 0; i < SIM_GEOMETRY_BUFFER_COUNT; ++i){
+				published [i] = _publishCount [i].load ();
+			}
+			snapshot.Write (counts, 4);
+			snapshot.Write (ring, 3);
+			snapshot.Write (published, SIM_GEOMETRY_BUFFER_COUNT);
+			snapshot.Write (_publications);
+			snapshot.Write (_bounds);
+			snapshot.Write (Buffer (0), SIM_GEOMETRY_BUFFER_COUNT*_numVertices);
+			snapshot.Write (_faces.get (), 3*_numFaces);
+			snapshot.Write (_normals.get (), _numSurfaceVertices);
+			for (unsigned int i = 0; i < _numSubsets; ++i){
+				const SpatialSubset& s = _subsets.get () [i];
+				unsigned int offsets [3] = {s._voffset, s._ioffset, s._isize};
+				snapshot.Write (offsets, 3);
+				snapshot.Write (s._bound);
+				snapshot.Write (s._owned);
+				snapshot.Write (s._halo);
+				snapshot.Write (s._haloNormals);
+			}
+			return true;
+		}
+
+		bool Geometry::Restore (SnapshotReader& snapshot)
+		{
+			unsigned int counts [4];
+			if (!snapshot.Read (counts, 4)){
+				LOG_ERROR ("No geometry state found in the snapshot");
+				return false;
+			}
+			bool reuse = _vertexData.load () != nullptr && counts [0] == _numVertices && counts [1] == _numSurfaceVertices && counts [2] == _numFaces && counts [3] == _numSubsets;
+			if (!reuse){
+				Cleanup ();
+				_numVertices = counts [0];
+				_numSurfaceVertices = counts [1];
+				_numFaces = counts [2];
+				_numSubsets = counts [3];
+				_vertices = shared_ptr <Vector> (new Vector [SIM_GEOMETRY_BUFFER_COUNT*_numVertices], DeleteArray <Vector> ());
+				_faces = shared_ptr <unsigned int> (new unsigned int [3*_numFaces], DeleteArray <unsigned int> ());
+				_normals = shared_ptr <Vector> (new Vector [_numSurfaceVertices], DeleteArray <Vector> ());
+				_subsets = shared_ptr <SpatialSubset> (new SpatialSubset [_numSubsets], DeleteArray <SpatialSubset> ());
+				_vertexData.store (_vertices.get (), std::memory_order_release);
+			} else {
+				// buffers shared with other instances (see Instantiate ())
+				if (Shared ()){
+					Detach ();
+				}
+				if (_faces.use_count () > 1){
+					_faces = shared_ptr <unsigned int> (new unsigned int [3*_numFaces], DeleteArray <unsigned int> ());
+				}
+			}
+
+			unsigned int ring [3];
+			unsigned long long published [SIM_GEOMETRY_BUFFER_COUNT];
+			bool success = snapshot.Read (ring, 3) && snapshot.Read (published, SIM_GEOMETRY_BUFFER_COUNT) && snapshot.Read (_publications) &&
+					snapshot.Read (_bounds) && snapshot.Read (Buffer (0), SIM_GEOMETRY_BUFFER_COUNT*_numVertices) &&
+					snapshot.Read (_faces.get (), 3*_numFaces) && snapshot.Read (_normals.get (), _numSurfaceVertices);
+			for (unsigned int i = 0; success && i < _numSubsets; ++i){
+				SpatialSubset& s = _subsets.get () [i];
+				unsigned int offsets [3];
+				success = snapshot.Read (offsets, 3) && snapshot.Read (s._bound) && snapshot.Read (s._owned) &&
+						snapshot.Read (s._halo) && snapshot.Read (s._haloNormals);
+				s._voffset = offsets [0];
+				s._ioffset = offsets [1];
+				s._isize = offsets [2];
+			}
+			for (unsigned int i = 0; i < 3; ++i){
+				success = success && ring [i] < SIM_GEOMETRY_BUFFER_COUNT;
+			}
+			if (!success){
+				LOG_ERROR ("Corrupt geometry state in the snapshot");
+				return false;
+			}
+
+			long long now = std::chrono::steady_clock::now ().time_since_epoch ().count ();
+			for (unsigned int i = 0; i < SIM_GEOMETRY_BUFFER_COUNT; ++i){
+				_publishCount [i].store (published [i]);
+				_publishTime [i].store (now);
+			}
+			_offsetIndex.store (ring [0]);
+			_publishedIndex.store (ring [1]);
+			_retiredIndex.store (ring [2]);
+			_latch.store (0);
+			_offsetSize = SIM_VECTOR_SIZE * sizeof (Vector) * _numVertices;
+			if (reuse && _interpolated){
+				_laterCount = 0;
+				std::copy (PreviousVertexBuffer (), PreviousVertexBuffer () + _numVertices, _display.get ());
+			} else {
+				SetInterpolated (_interpolated);
+			}
+			return true;
 		}
 
 		bool Geometry::ReadVertexFile (const char* file)
 		{
+			StartupProfiler::Phase phase ("Geometry::ReadVertexFile");
+			StartupProfiler::Clock::time_point start = StartupProfiler::Clock::now ();
 			_numVertices = MeshLoader::GetElementCount (file);
 			_vertices = std::shared_ptr <Vector> (new Vector [3*_numVertices], DeleteArray <Vector> ());
 			if (!_vertices){
 				LOG_ERROR ("Could not allocate 1st vertex array of size " << _numVertices << " from " << file);
 				return false;
 			}
+			_vertexData.store (_vertices.get ());
 
 			if (!MeshLoader::LoadVertices <SIM_VECTOR_SIZE> (file, _vertices.get ())){
 				LOG_ERROR ("Could not read vertex file " << file);
 				return false;
 			}
+			StartupProfiler::Instance ().Read (file, std::chrono::duration <double> (StartupProfiler::Clock::now () - start).count ());
 			// populate 2nd buffer
 			unsigned int offset = _numVertices;
 			Vector* vptr = _vertices.get ();
@@ -150,6 +581,7 @@ namespace Sim {
 
 		bool Geometry::ReadIndexFiles (const char* prefix)
 		{
+			StartupProfiler::Phase phase ("Geometry::ReadIndexFiles");
 			_subsets = shared_ptr <SpatialSubset> (new SpatialSubset [_numSubsets], DeleteArray <SpatialSubset> ());
 
 			// get total number of faces
@@ -176,10 +608,16 @@ namespace Sim {
 
 				SpatialSubset* s = &(_subsets.get () [i]);
 				unsigned int* f = &(_faces.get () [s->_ioffset]);
+				StartupProfiler::Clock::time_point start = StartupProfiler::Clock::now ();
 				if (!MeshLoader::LoadIndices <3> (file.c_str (), f)){
 					LOG_ERROR ("Could not load index file " <<  file);
 					return false;
 				}
+				StartupProfiler::Instance ().Read (file, std::chrono::duration <double> (StartupProfiler::Clock::now () - start).count ());
+
+				if (s->_isize == 0){
+					continue;
+				}
 
 				// calculate the offset of vertex
 				unsigned int min = f [0];
@@ -190,7 +628,7 @@ namespace Sim {
 				}
 				s->_voffset = min;
 
-				s->UpdateBound (CurrentVertexBuffer (), f);
+				s->UpdateBound (CurrentVertexBuffer () + s->_voffset, f);
 			}
 			return true;
 		}
@@ -207,5 +645,136 @@ namespace Sim {
 			// has the index of the last surface vertex
 			++_numSurfaceVertices;
 		}
+	
+		/**
+		 * A vertex is owned by the subset whose faces reference it most often
+		 * (the lowest such subset on ties), so that ownership partitions the
+		 * referenced surface vertices whatever their numbering.
+		 */
+		void Geometry::InitializeSubsets ()
+		{
+			const unsigned int none = _numSubsets;
+			std::vector <unsigned int> owner (_numSurfaceVertices, none);
+			std::vector <unsigned int> references (_numSurfaceVertices, 0);
+			std::vector <std::vector <unsigned int> > referenced (_numSubsets);
+
+			for (unsigned int i = 0; i < _numSubsets; ++i){
+				SpatialSubset& s = _subsets.get () [i];
+				const unsigned int* f = &(_faces.get () [s._ioffset]);
+				std::vector <unsigned int> indices (f, f + 3*s._isize);
+				std::sort (indices.begin (), indices.end ());
+				for (unsigned int j = 0; j < indices.size (); ){
+					unsigned int k = j;
+					while (k < indices.size () && indices [k] == indices [j]){
+						++k;
+					}
+					unsigned int v = indices [j];
+					if (owner [v] == none || k - j > references [v]){
+						owner [v] = i;
+						references [v] = k - j;
+					}
+					referenced [i].push_back (v);
+					j = k;
+				}
+			}
+			for (unsigned int v = 0; v < _numSurfaceVertices; ++v){
+				if (owner [v] != none){
+					_subsets.get () [owner [v]]._owned.push_back (v);
+				}
+			}
+			for (unsigned int i = 0; i < _numSubsets; ++i){
+				SpatialSubset& s = _subsets.get () [i];
+				for (auto v : referenced [i]){
+					if (owner [v] != i){
+						s._halo.push_back (v);
+					}
+				}
+				s._haloNormals.assign (s._halo.size (), Vector::ZERO);
+			}
+
+			_normals = std::shared_ptr <Vector> (new Vector [_numSurfaceVertices], DeleteArray <Vector> ());
+			for (unsigned int v = 0; v < _numSurfaceVertices; ++v){
+				_normals.get () [v] = Vector::ZERO;
+			}
+		}
+
+		// bound and normals of one subset, from the current buffer
+		void Geometry::UpdateSubset (unsigned int subset)
+		{
+			SpatialSubset& s = _subsets.get () [subset];
+			if (s._isize == 0){
+				return;
+			}
+			Vector* vertices = CurrentVertexBuffer ();
+			Vector* normals = CurrentNormalBuffer ();
+			const unsigned int* f = &(_faces.get () [s._ioffset]);
+
+			s.UpdateBound (vertices + s._voffset, f);
+			if (!NormalsDue ()){
+				return;
+			}
+
+			for (auto v : s._owned){
+				normals [v] = Vector::ZERO;
+			}
+			for (auto &n : s._haloNormals){
+				n = Vector::ZERO;
+			}
+			for (unsigned int i = 0; i < s._isize; ++i, f += 3){
+				Vector e1 (vertices [f [1]]);
+				e1 -= vertices [f [0]];
+				Vector e2 (vertices [f [2]]);
+				e2 -= vertices [f [0]];
+				Vector n;
+				e1.Cross (e2, n);
+				for (unsigned int j = 0; j < 3; ++j){
+					auto h = std::lower_bound (s._halo.begin (), s._halo.end (), f [j]);
+					if (h != s._halo.end () && *h == f [j]){
+						s._haloNormals [h - s._halo.begin ()] += n;
+					} else {
+						normals [f [j]] += n;
+					}
+				}
+			}
+		}
+
+		// add the halo contributions to their owners and rebuild the asset bound
+		void Geometry::MergeSubsets ()
+		{
+			Vector* normals = CurrentNormalBuffer ();
+			bool due = NormalsDue ();
+			++_splitUpdates;
+			Vector min, max;
+			bool first = true;
+			for (unsigned int i = 0; i < _numSubsets; ++i){
+				SpatialSubset& s = _subsets.get () [i];
+				if (s._isize == 0){
+					continue;
+				}
+				for (unsigned int h = 0; h < s._halo.size () && due; ++h){
+					normals [s._halo [h]] += s._haloNormals [h];
+				}
+
+				Vector smin (s._bound [0]);
+				Vector smax (s._bound [7]);
+				if (first){
+					min = smin;
+					max = smax;
+					first = false;
+					continue;
+				}
+				for (unsigned int j = 0; j < 3; ++j){
+					if (min [j] > smin [j]){
+						min [j] = smin [j];
+					}
+					if (max [j] < smax [j]){
+						max [j] = smax [j];
+					}
+				}
+			}
+			if (!first){
+				_bounds.Update (min, max);
+			}
+		}
 	}
 }
@@ -8,20 +8,40 @@
  * The geometry component interface for the Asset class in the Chimera
  * class. It is derived from the generic Component interface. Geometry
  * loads all the vertices and face-indices for any asset.
+ * Geometries loading the same mesh prefix are instances of one mesh: the
+ * first one reads the files, the others wait for it and share its rest
+ * state, faces and subset layout for as long as any of them is alive.
+ * An instance reads the shared rest state until it first deforms (its
+ * first CurrentVertexBuffer () or CurrentNormalBuffer ()), when it copies
+ * the mutable per-frame buffers (the vertex ring and the normals) into
+ * arrays of its own; the reader accessors hand out const data only.
  */
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "Preprocess.h"
 #include "Vector.h"
+#include "Futex.h"
 #include "AxisAlignedBox.h"
 #include "Assets/Component.h"
+#include "Tasks/QualityGovernor.h"
 
 namespace Sim {
 	namespace Assets {
 
+		// the latch of the vertex ring: pinned buffer (low 2 bits), whether the pin is known safe and the reader count above
+		const static unsigned int SIM_GEOMETRY_LATCH_SAFE = 4;
+		const static unsigned int SIM_GEOMETRY_LATCH_READER = 8;
+
 		class Geometry : public Component {
 
 			private:
@@ -32,11 +52,18 @@ namespace Sim {
 					unsigned int _isize;
 					AxisAlignedBox _bound;
 
+					// surface vertices owned by the subset (sorted)
+					std::vector <unsigned int> _owned;
+					// vertices referenced by the subset's faces but owned by another subset (sorted)
+					std::vector <unsigned int> _halo;
+					// normal contributions of the subset's faces to its halo vertices
+					std::vector <Vector> _haloNormals;
+
 					SpatialSubset (): _voffset (0), _ioffset (0), _isize (0) {}
 					~SpatialSubset () {}
 
 					// udpate the axis-aligned bounding box for subset
-					void UpdateBound (Vector* vertices, unsigned int* faces)
+					void UpdateBound (const Vector* vertices, const unsigned int* faces)
 					{
 						Vector min (vertices [faces [0] - _voffset]);
 						Vector max (min);
@@ -56,14 +83,79 @@ namespace Sim {
 					}
 				};
 
+				/**
+				 * The read-only part of a loaded mesh, shared by its instances (and
+				 * through the SharedCache by the simulation instances of a batch run).
+				 */
+				class MeshData {
+				public:
+					std::shared_ptr <Vector> _rest; // the rest state in every buffer of the ring
+					std::shared_ptr <Vector> _normals; // zero
+					std::shared_ptr <unsigned int> _faces;
+					std::vector <SpatialSubset> _subsets;
+					unsigned int _numVertices;
+					unsigned int _numSurfaceVertices;
+					unsigned int _numFaces;
+					AxisAlignedBox _bounds;
+					size_t _bytes;
+
+					MeshData (): _numVertices (0), _numSurfaceVertices (0), _numFaces (0), _bytes (0) {}
+				};
+
+				// meshes with live instances, by prefix, and the prefixes being loaded
+				static std::mutex _instanceMutex;
+				static std::condition_variable _instanceLoaded;
+				static std::map <std::string, std::weak_ptr <const MeshData> > _instances;
+				static std::set <std::string> _instanceLoads;
+				// geometries that shared a mesh loaded by another, and the bytes they did not load again
+				static std::atomic <unsigned int> _instanceCount;
+				static std::atomic <unsigned long long> _instanceBytes;
+
 			protected:
+				std::string _source; // prefix of the mesh files
 				AxisAlignedBox _bounds;
 
-				unsigned int _offsetIndex;
+				/**
+				 * The three vertex buffers form a ring shared between the physics rate
+				 * (writer) and slower rates such as collision and render (readers). The
+				 * writer fills the current buffer from the previous (published) one and
+				 * publishes it in Update (). Readers latch the published buffer for the
+				 * duration of their tick; all readers share one latch so that the writer always has a free buffer
+				 * and never blocks. Latching is lock-free as well (see
+				 * LatchVertexBuffer ()); a reader that only wants new states may sleep
+				 * in WaitForPublication () instead of polling.
+				 * In pipelined mode the ring rotates once per frame at the scheduler's
+				 * hand-off fence: physics writes frame k+1 (current), collision reads
+				 * frame k (previous) and render reads frame k-1 (retired).
+				 * Every publication stamps its buffer with a sequence number and the
+				 * time it was published, which lets the display interpolate between
+				 * the last two states it has seen (see Interpolate ()).
+				 */
+				std::atomic <unsigned int> _offsetIndex;
+				std::atomic <unsigned int> _publishedIndex;
+				std::atomic <unsigned int> _retiredIndex;
+				bool _pipelined;
+				std::atomic <unsigned int> _latch;
+				Futex _published; // publications, for readers to block on
+				std::atomic <unsigned long long> _publishCount [3]; // per buffer of the ring
+				std::atomic <long long> _publishTime [3]; // steady clock ticks
+				unsigned long long _publications; // writer side
+
+				// display interpolation (reader side): the last two states seen and their blend
+				bool _interpolated;
+				unsigned long long _laterCount;
+				std::shared_ptr <Vector> _earlier;
+				std::shared_ptr <Vector> _later;
+				std::shared_ptr <Vector> _display;
 				unsigned int _offsetSize;
 	      unsigned int _numVertices;
 	      unsigned int _numSurfaceVertices;
 	      std::shared_ptr <Vector> _vertices;
+				// the ring the accessors read: the one above, or the mesh's rest state until the first write
+				std::atomic <Vector*> _vertexData;
+				std::shared_ptr <const MeshData> _mesh; // the mesh this is an instance of
+				std::atomic <bool> _shared; // the ring and the normals are still the mesh's
+				std::mutex _detachMutex;
 
 				unsigned int _numFaces;
 				std::shared_ptr <unsigned int> _faces;
@@ -71,6 +163,12 @@ namespace Sim {
 	      unsigned int _numSubsets;
 	      std::shared_ptr <SpatialSubset> _subsets;
 
+				// area-weighted (unnormalized) surface vertex normals of the current buffer
+				std::shared_ptr <Vector> _normals;
+				// split updates recompute the normals every 2^(3 - level) updates (see QualityGovernor.h)
+				QualityKnob _normalQuality;
+				unsigned long long _splitUpdates;
+
 			public:
 				Geometry ();
 				virtual ~Geometry () {Cleanup ();}
@@ -81,14 +179,107 @@ namespace Sim {
 				virtual void Update () override;
 				virtual void Cleanup () override;
 
+				/**
+				 * The snapshot holds the buffer ring with its publication counts, the
+				 * faces, normals and the spatial subsets with their ownership and halos,
+				 * so that a restored geometry needs neither its mesh files nor the subset
+				 * precomputation. A geometry of the same shape is restored without any
+				 * allocation. Publication times restart at the time of the restore.
+				 */
+				virtual bool Save (SnapshotWriter& snapshot) const override;
+				virtual bool Restore (SnapshotReader& snapshot) override;
+
+				const std::string& Source () const {return _source;}
 				unsigned int VertexCount () const {return _numVertices;}
 				unsigned int SurfaceVertexCount () const {return _numSurfaceVertices;}
-				Vector* PreviousVertexBuffer () {return &(_vertices.get () [(_offsetIndex - 1)*_numVertices]);}
-				Vector* CurrentVertexBuffer () {return &(_vertices.get () [_offsetIndex*_numVertices]);}
+				const Vector* PreviousVertexBuffer () const {return Buffer (_publishedIndex.load ());}
+				// the buffer the writer fills (a shared instance copies the ring first)
+				Vector* CurrentVertexBuffer ()
+				{
+					if (_shared.load (std::memory_order_acquire)){
+						Detach ();
+					}
+					return Buffer (_offsetIndex.load ());
+				}
+				// whether the buffers are still shared with the other instances of the mesh
+				bool Shared () const {return _shared.load (std::memory_order_acquire);}
+				// log how many geometries of the process were instances and the memory they shared
+				static void ReportInstances ();
+
+				// reader side of the buffer ring (see above)
+				void LatchVertexBuffer ();
+				void ReleaseVertexBuffer ();
+				unsigned int Publications () const {return _published.Load ();}
+				// blocks until a publication after 'seen' (a Publications ()) or the timeout
+				bool WaitForPublication (unsigned int seen, std::chrono::nanoseconds timeout) {return _published.Wait (seen, timeout);}
+				const Vector* LatchedVertexBuffer () const
+				{
+					unsigned int latch = _latch.load ();
+					unsigned int index = latch >= SIM_GEOMETRY_LATCH_READER ? (latch & 3) : _publishedIndex.load ();
+					return Buffer (index);
+				}
+
+				// reallocate the buffers from the calling thread (first-touch NUMA placement)
+				void Relocate ();
+
+				// pipelined mode (set by the scheduler before any frame runs)
+				void SetPipelined (bool flag) {_pipelined = flag;}
+				bool Pipelined () const {return _pipelined;}
+				const Vector* RetiredVertexBuffer () const {return Buffer (_retiredIndex.load ());}
+				/**
+				 * Display interpolation, for a reader running at its own rate. Called with
+				 * the buffer latched, Interpolate () keeps the last two published states
+				 * the reader has seen and blends them by the time elapsed since the later
+				 * one was published, over the writer's 'period' (seconds). The display
+				 * thus trails physics by one period but moves smoothly whatever the
+				 * phase of the two rates.
+				 */
+				void SetInterpolated (bool flag);
+				bool Interpolated () const {return _interpolated;}
+				void Interpolate (double period);
+				const Vector* InterpolatedVertexBuffer () const {return _display.get ();}
+
+				// the buffer render should draw from in the current scheduling mode
+				const Vector* RenderVertexBuffer () const
+				{
+					return _pipelined ? RetiredVertexBuffer () : _interpolated ? InterpolatedVertexBuffer () : LatchedVertexBuffer ();
+				}
+
+				/**
+				 * Intra-asset parallelism. Every surface vertex is owned by exactly one
+				 * spatial subset (the one whose faces reference it most); the faces of a
+				 * subset may also reference vertices owned by its neighbours (its halo). A split physics update writes only
+				 * the owned vertices of the current buffer and reads the halo from the
+				 * previous one, so subsets never race. The geometry's own split update
+				 * recomputes the subset bounds and the vertex normals of the current
+				 * buffer; halo normal contributions are kept per subset and added to
+				 * their owners in MergeSubsets ().
+				 */
+				virtual unsigned int SubsetCount () const override {return _numSubsets > 1 ? _numSubsets : 0;}
+				virtual void UpdateSubset (unsigned int subset) override;
+				virtual void MergeSubsets () override;
+				virtual void QualityKnobs (std::vector <QualityKnob*>& knobs) override {knobs.push_back (&_normalQuality);}
+
+				unsigned int SubsetFaceCount (unsigned int index) const {return _subsets.get () [index]._isize;}
+				const std::vector <unsigned int>& SubsetVertices (unsigned int index) const {return _subsets.get () [index]._owned;}
+				const std::vector <unsigned int>& SubsetHalo (unsigned int index) const {return _subsets.get () [index]._halo;}
+				const AxisAlignedBox& SubsetBound (unsigned int index) const {return _subsets.get () [index]._bound;}
+				const AxisAlignedBox& Bound () const {return _bounds;}
+				// the normals of the current buffer
+				const Vector* NormalBuffer () const {return _normals.get ();}
+				// the same for the writer (a shared instance copies them first)
+				Vector* CurrentNormalBuffer ()
+				{
+					if (_shared.load (std::memory_order_acquire)){
+						Detach ();
+					}
+					return _normals.get ();
+				}
 
 				unsigned int FaceIndexCount () const {return _numFaces;}
-				unsigned int* FaceIndexBuffer () {return _faces.get ();}
-				unsigned int* FaceIndexBuffer (unsigned int index)
+				// the faces stay shared between the instances of a mesh: nothing writes them
+				const unsigned int* FaceIndexBuffer () const {return _faces.get ();}
+				const unsigned int* FaceIndexBuffer (unsigned int index) const
 				{
 #					ifndef NDEBUG
 					if (index >= _numSubsets){
@@ -103,9 +294,21 @@ namespace Sim {
 				}
 
 			protected:
+				Vector* Buffer (unsigned int index) const {return _vertexData.load (std::memory_order_acquire) + index*_numVertices;}
+				// copy the shared ring and normals into arrays of this instance (any writer thread, once)
+				void Detach ();
+				// whether the running split update recomputes the normals
+				bool NormalsDue () const {return _splitUpdates % (1ull << (_normalQuality.Max () - _normalQuality.Level ())) == 0;}
+				bool Load (const std::string& prefix);
+				// the mesh of a prefix: the one of its live instances, or loaded by this geometry
+				std::shared_ptr <const MeshData> Instance (const std::string& prefix);
+				std::shared_ptr <const MeshData> Share (size_t& bytes) const;
+				void Instantiate (const std::shared_ptr <const MeshData>& mesh);
 				bool ReadVertexFile (const char* file);
 				bool ReadIndexFiles (const char* file);
 				void UpdateSurfaceVertexCount ();
+				// assign vertex ownership and halos to the subsets
+				void InitializeSubsets ();
 		};
 	}
 }
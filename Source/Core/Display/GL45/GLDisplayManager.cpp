@@ -15,6 +15,7 @@
 
 #include "InputParser.h"
 #include "Driver.h"
+#include "Events/InputLog.h"
 #include "Display/GL45/GLRenderer.h"
 #include "Display/GL45/GLDisplayManager.h"
 
@@ -74,6 +75,36 @@ namespace Sim {
 			return false;
 		}
 		glFinish ();
+
+		// mouse input reaches the renderer at frame boundaries, so that it can be recorded and replayed
+		InputLog& inputs = Driver::Instance ().GetInputLog ();
+		inputs.SetHandler (INPUT_MOUSE_BUTTON, [this] (const Input& input) {
+			if (input._values.size () < 2){
+				return false;
+			}
+			_renderer->Mouse (input._target, static_cast <int> (input._values [0]), static_cast <int> (input._values [1]));
+			return true;
+		});
+		inputs.SetHandler (INPUT_MOUSE_MOTION, [this] (const Input& input) {
+			if (input._values.size () < 2){
+				return false;
+			}
+			int x = static_cast <int> (input._values [0]), y = static_cast <int> (input._values [1]);
+			switch (input._target){
+				case Button1Mask:
+					_renderer->LeftMouseMotion (x, y);
+					break;
+				case Button2Mask:
+					_renderer->RightMouseMotion (x, y);
+					break;
+				case Button3Mask:
+					_renderer->MiddleMouseMotion (x, y);
+					break;
+				default:
+					return false;
+			}
+			return true;
+		});
 		LOG ("OpenGL 4.5 display manager initialized");
 		return true;
 	}
@@ -155,22 +186,14 @@ namespace Sim {
 	 	}
 	 	case ButtonPress:
 	 	{
-	 		_renderer->Mouse (_event.xbutton.button, _event.xbutton.x, _event.xbutton.y);
+	 		Driver::Instance ().GetInputLog ().Submit (Input (INPUT_MOUSE_BUTTON, _event.xbutton.button,
+	 				{static_cast <double> (_event.xbutton.x), static_cast <double> (_event.xbutton.y)}));
 	 		break;
 	 	}
 	 	case MotionNotify:
 	 	{
-	 		switch (_event.xmotion.state){
-	 			case Button1Mask:
-	 				_renderer->LeftMouseMotion (_event.xmotion.x, _event.xmotion.y);
-	 				break;
-	 			case Button2Mask:
-	 				_renderer->RightMouseMotion (_event.xmotion.x, _event.xmotion.y);
-	 				break;
-	 			case Button3Mask:
-	 				_renderer->MiddleMouseMotion (_event.xmotion.x, _event.xmotion.y);
-	 				break;
-	 		}
+	 		Driver::Instance ().GetInputLog ().Submit (Input (INPUT_MOUSE_MOTION, _event.xmotion.state,
+	 				{static_cast <double> (_event.xmotion.x), static_cast <double> (_event.xmotion.y)}));
 	 		break;
 	 	}
 	 	case KeyPress :
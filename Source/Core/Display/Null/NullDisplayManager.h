@@ -0,0 +1,36 @@
+/**
+ * @file NullDisplayManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The display manager of headless runs: there is no window, context or
+ * display connection, and render components have nothing to draw to.
+ */
+#pragma once
+
+#include "Preprocess.h"
+
+#include "Display/DisplayManager.h"
+
+namespace Sim {
+
+	class NullDisplayManager : public DisplayManager {
+
+		private: // forbidden copy constructor and assignment operator
+			NullDisplayManager (const NullDisplayManager&);
+			NullDisplayManager& operator = (const NullDisplayManager&);
+
+		public:
+			NullDisplayManager () {}
+			~NullDisplayManager () {}
+
+			virtual bool Initialize (const char* config) override
+			{
+				LOG ("Null display manager initialized (no display)");
+				return true;
+			}
+			virtual void Cleanup () override {}
+	};
+}
@@ -8,17 +8,24 @@
  * See BaseDriver.h
  */
 
+#include <chrono>
+#include <fstream>
 #include <memory>
+#include <string>
 
 #include "Config.h"
 #include "Preprocess.h"
+#include "Snapshot.h"
+#include "StartupProfiler.h"
 
 #include "Display/DisplayManager.h"
 #include "HPC/HPCManager.h"
 #include "Tasks/TaskManager.h"
 #include "Plugins/PluginManager.h"
+#include "Assets/Asset.h"
 #include "Assets/AssetFactory.h"
 #include "Events/EventManager.h"
+#include "Events/InputLog.h"
 #include "Driver/BaseDriver.h"
 
 using std::make_unique;
@@ -26,21 +33,81 @@ using tinyxml2::XMLElement;
 
 namespace Sim {
 
+	// the input log exists from the start, so that subsystems may set their handlers while they initialize
+	BaseDriver::BaseDriver (): _inputLog (make_unique <InputLog> ()) {}
+
+	BaseDriver::~BaseDriver () = default;
+
 	// prepare for quitting
 	void BaseDriver::Quit () {_runFlag = false;}
 
 	bool BaseDriver::InitializePluginManager (const char* config)
 	{
-		_pluginManager = make_unique <PluginManager> ();
-		if (!_pluginManager->Initialize (config)){
+		_pluginFactory = make_unique <PluginFactory> ();
+		if (!_pluginFactory->Initialize (config)){
 			LOG_ERROR ("All plugin libraries specified in " << config << " could not be initialized");
 			return false;
 		}
 		return true;
 	}
 
-	bool BaseDriver::InitializeAssetFactory (const char* config)
+	bool BaseDriver::Checkpoint (const char* file)
+	{
+		if (!CheckpointWritten ()){
+			LOG_WARNING ("The previous checkpoint could not be written");
+		}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+		std::shared_ptr <SnapshotWriter> snapshot = std::make_shared <SnapshotWriter> ();
+		if (!_eventManager->Save (*snapshot) || !_assetFactory->Save (*snapshot)){
+			LOG_ERROR ("Could not checkpoint the simulation");
+			return false;
+		}
+		LOG ("Checkpoint of " << snapshot->Size ()/(1024.*1024.) << " MB taken in "
+				<< 1000.*std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count () << " ms, writing it to " << file);
+
+		std::string name (file);
+		_checkpoint = std::async (std::launch::async, [snapshot, name] {
+			if (!snapshot->Save (name)){
+				LOG_ERROR ("Could not write the checkpoint to " << name);
+				return false;
+			}
+			return true;
+		});
+		return true;
+	}
+
+	bool BaseDriver::CheckpointWritten ()
+	{
+		return !_checkpoint.valid () || _checkpoint.get ();
+	}
+
+	bool BaseDriver::Restore (const char* file)
+	{
+		if (!CheckpointWritten ()){
+			LOG_WARNING ("The last checkpoint could not be written");
+		}
+		SnapshotReader snapshot;
+		if (!snapshot.Open (file) || !_assetFactory->Restore (snapshot) || !_eventManager->Restore (snapshot)){
+			LOG_ERROR ("Could not restore the simulation from " << file);
+			return false;
+		}
+		return true;
+	}
+
+	bool BaseDriver::InitializeAssetFactory (const char* config, const char* snapshot)
 	{
+		if (snapshot != nullptr && std::ifstream (snapshot).good ()){
+			StartupProfiler::Clock::time_point start = StartupProfiler::Clock::now ();
+			_assetFactory = make_unique <AssetFactory> ();
+			SnapshotReader reader;
+			if (reader.Open (snapshot) && _assetFactory->Restore (reader) && _eventManager->Restore (reader)){
+				StartupProfiler::Instance ().Read (snapshot, std::chrono::duration <double> (StartupProfiler::Clock::now () - start).count ());
+				LOG ("Assets restored from " << snapshot);
+				return true;
+			}
+			LOG_WARNING ("Could not restore the assets from " << snapshot << ". Loading them from " << config);
+		}
+
 		_assetFactory = make_unique <AssetFactory> ();
 		if (!_assetFactory->Initialize (config)){
 			LOG_ERROR ("All assets specified in " << config << " could not be initialized");
@@ -49,6 +116,26 @@ namespace Sim {
 		return true;
 	}
 
+	bool BaseDriver::InitializeInputLog (XMLElement* config, const char* assets)
+	{
+		const char* record = config != nullptr ? config->Attribute ("Record") : nullptr;
+		const char* replay = config != nullptr ? config->Attribute ("Replay") : nullptr;
+		if (record != nullptr && replay != nullptr){
+			LOG_ERROR ("Inputs can not be recorded and replayed at the same time");
+			return false;
+		}
+		InputMode mode = record != nullptr ? INPUT_RECORD : (replay != nullptr ? INPUT_REPLAY : INPUT_LIVE);
+		if (!_inputLog->Initialize (mode, record != nullptr ? record : (replay != nullptr ? replay : ""), assets != nullptr ? assets : "")){
+			LOG_ERROR ("Input log could not be initialized");
+			return false;
+		}
+		_inputLog->SetHandler (INPUT_TOOL_POSE, [this] (const Input& input) {
+			std::shared_ptr <Asset> asset = _assetFactory ? _assetFactory->GetAsset (input._target) : std::shared_ptr <Asset> ();
+			return asset && asset->ApplyInput (input);
+		});
+		return true;
+	}
+
 	bool BaseDriver::InitializeEventManager (const char* config)
 	{
 		_eventManager = make_unique <EventManager> ();
@@ -19,14 +19,20 @@
  */
 #pragma once
 
+#include <future>
 #include <memory>
 
+namespace tinyxml2 {
+	class XMLElement;
+}
+
 namespace Sim {
 
 	class PluginFactory;
 	class AssetFactory;
 	class DisplayManager;
 	class EventManager;
+	class InputLog;
 	class HPCManager;
 	class TaskManager;
 
@@ -70,10 +76,17 @@ namespace Sim {
 			 * similar thing.
 			 */
 			std::unique_ptr <TaskManager> _taskManager;
+			/**
+			 * The external inputs (tool poses, mouse, configuration changes), applied
+			 * at frame boundaries and recorded or replayed (see InputLog.h).
+			 */
+			std::unique_ptr <InputLog> _inputLog;
+			// the snapshot being written by the last checkpoint
+			std::future <bool> _checkpoint;
 
 		protected:
-			BaseDriver () = default;
-			virtual ~BaseDriver () = default;
+			BaseDriver ();
+			virtual ~BaseDriver ();
 
 			// forbidden copy ctor. and assignment operator
 			BaseDriver (const BaseDriver&) = delete;
@@ -85,9 +98,34 @@ namespace Sim {
 			virtual void Cleanup () = 0;
 			virtual void Quit ();
 
+			/**
+			 * Checkpoint/restore of the complete simulation state (the queued events
+			 * and every asset, see AssetFactory), between frames with no task running.
+			 * Checkpoint () copies the state right away and writes the snapshot file
+			 * in the background. Restore () resets the running simulation to a
+			 * snapshot in place.
+			 */
+			bool Checkpoint (const char* file);
+			// wait for the last checkpoint to be written (false if it failed)
+			bool CheckpointWritten ();
+			bool Restore (const char* file);
+
+			InputLog& GetInputLog () const {return *_inputLog;}
+
 		protected:
 			virtual bool InitializePluginManager (const char* config);
-			virtual bool InitializeAssetFactory (const char* config);
+			/**
+			 * With a snapshot file that exists, the assets are restored from it rather
+			 * than loaded from the configuration (which they still are if the restore
+			 * fails, e.g. for components that cannot be checkpointed).
+			 */
+			virtual bool InitializeAssetFactory (const char* config, const char* snapshot = nullptr);
 			virtual bool InitializeEventManager (const char* config);
+			/**
+			 * The <Input Record Replay> entry (may be null): the inputs are recorded
+			 * to the 'Record' file or replayed from the 'Replay' one, on the scenario
+			 * loaded from 'assets'. Tool poses go to the components of their asset.
+			 */
+			virtual bool InitializeInputLog (tinyxml2::XMLElement* config, const char* assets);
 	};
 }
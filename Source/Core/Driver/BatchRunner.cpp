@@ -0,0 +1,225 @@
+/**
+ * @file BatchRunner.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See BatchRunner.h
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "Assets/AssetFactory.h"
+#include "Driver/BatchRunner.h"
+#include "Tasks/Affinity.h"
+#include "Tasks/RateScheduler.h"
+#include "Tasks/SerialTaskManager.h"
+
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	// the p-th percentile of some samples (sorted in place)
+	static double Percentile (vector <double>& samples, double p)
+	{
+		if (samples.empty ()){
+			return 0.;
+		}
+		std::sort (samples.begin (), samples.end ());
+		return samples [std::min (samples.size () - 1, static_cast <size_t> (p/100.*samples.size ()))];
+	}
+
+	static double Mean (const vector <double>& samples)
+	{
+		double sum = 0.;
+		for (auto s : samples){
+			sum += s;
+		}
+		return samples.empty () ? 0. : sum/samples.size ();
+	}
+
+	bool BatchRunner::Initialize (XMLElement& config, const string& taskConfig, const string& taskRoot)
+	{
+		_taskConfig = taskConfig;
+		_taskRoot = taskRoot;
+		config.QueryUnsignedAttribute ("Threads", &_threads);
+		config.QueryUnsignedAttribute ("Frames", &_frames);
+		config.QueryBoolAttribute ("Pinned", &_pinned);
+		const char* statistics = config.Attribute ("Statistics");
+		_statistics = statistics != nullptr ? statistics : "";
+		if (_frames == 0){
+			LOG_ERROR ("A batch run needs a number of \'Frames\' per instance");
+			return false;
+		}
+
+		for (XMLElement* s = config.FirstChildElement ("Scenario"); s != nullptr; s = s->NextSiblingElement ("Scenario")){
+			const char* assets = s->Attribute ("Config");
+			unsigned int count = 1;
+			s->QueryUnsignedAttribute ("Count", &count);
+			if (assets == nullptr){
+				LOG_ERROR ("Batch scenario has no assets \'Config\'");
+				return false;
+			}
+			for (unsigned int i = 0; i < count; ++i){
+				_instances.push_back (Instance (static_cast <unsigned int> (_scenarios.size ())));
+			}
+			_scenarios.push_back (Scenario (assets, count));
+		}
+		if (_instances.empty ()){
+			LOG_ERROR ("A batch run needs at least one scenario instance");
+			return false;
+		}
+
+		if (_threads == 0){
+			_threads = std::max (std::thread::hardware_concurrency (), 1u);
+		}
+		_threads = std::min (_threads, static_cast <unsigned int> (_instances.size ()));
+		LOG ("Batch of " << _instances.size () << " instances of " << _scenarios.size () << " scenarios on " << _threads << " threads, "
+				<< _frames << " frames each");
+		return true;
+	}
+
+	// the threads take the next instance until there are none left
+	bool BatchRunner::Run ()
+	{
+		vector <unsigned int> cpus;
+		if (_pinned){
+			Affinity affinity;
+			if (affinity.Initialize ()){
+				cpus = affinity.AllCpus ();
+			}
+		}
+
+		std::atomic <unsigned int> next (0);
+		auto work = [this, &next, &cpus] (unsigned int index){
+			if (!cpus.empty () && !Affinity::SetThreadAffinity (vector <unsigned int> (1, cpus [index % cpus.size ()]))){
+				LOG_WARNING ("Could not pin batch thread " << index);
+			}
+			for (unsigned int i = next++; i < _instances.size (); i = next++){
+				RunInstance (_instances [i]);
+			}
+		};
+
+		Clock::time_point start = Clock::now ();
+		vector <std::thread> threads;
+		for (unsigned int t = 1; t < _threads; ++t){
+			threads.emplace_back (work, t);
+		}
+		work (0);
+		for (auto &t : threads){
+			t.join ();
+		}
+		_seconds = duration <double> (Clock::now () - start).count ();
+
+		bool success = true;
+		for (auto &i : _instances){
+			success = success && i._success;
+		}
+		return success;
+	}
+
+	/**
+	 * The instance's assets, task graph and scheduler live on this thread's
+	 * stack, and are torn down in reverse order once its frames have run.
+	 */
+	void BatchRunner::RunInstance (Instance& instance) const
+	{
+		const Scenario& scenario = _scenarios [instance._scenario];
+		Clock::time_point start = Clock::now ();
+
+		// the instances already load side by side; loader threads of their own would oversubscribe
+		AssetFactory assets;
+		if (!assets.Initialize (scenario._config.c_str (), true) || !assets.Wait ()){
+			LOG_ERROR ("Could not load the assets of a batch instance from " << scenario._config);
+			return;
+		}
+		SerialTaskManager tasks (_taskRoot);
+		tasks.SetAssetFactory (&assets);
+		if (!tasks.Initialize (_taskConfig.c_str ())){
+			LOG_ERROR ("Could not build the task graph of a batch instance from " << _taskConfig);
+			return;
+		}
+		RateScheduler scheduler (tasks);
+		if (!scheduler.Initialize ()){
+			LOG_ERROR ("Could not initialize the multi-rate scheduler of a batch instance");
+			return;
+		}
+		Clock::time_point loaded = Clock::now ();
+
+		for (unsigned int f = 0; f < _frames; ++f){
+			scheduler.Advance ();
+		}
+		instance._load = duration <double> (loaded - start).count ();
+		instance._run = duration <double> (Clock::now () - loaded).count ();
+		instance._success = true;
+	}
+
+	void BatchRunner::Report () const
+	{
+		unsigned int succeeded = 0;
+		for (auto &i : _instances){
+			succeeded += i._success ? 1 : 0;
+		}
+		double perHour = _seconds > 0. ? 3600.*succeeded/_seconds : 0.;
+		LOG ("Batch ran " << succeeded << " of " << _instances.size () << " instances in " << _seconds << " s on " << _threads
+				<< " threads: " << perHour << " simulations per hour");
+
+		std::ofstream out;
+		if (!_statistics.empty ()){
+			out.open (_statistics);
+			if (!out.is_open ()){
+				LOG_ERROR ("Could not write the batch statistics to " << _statistics);
+			}
+		}
+		if (out.is_open ()){
+			out << "{" << std::endl;
+			out << "\t\"instances\": " << _instances.size () << "," << std::endl;
+			out << "\t\"succeeded\": " << succeeded << "," << std::endl;
+			out << "\t\"threads\": " << _threads << "," << std::endl;
+			out << "\t\"frames\": " << _frames << "," << std::endl;
+			out << "\t\"seconds\": " << _seconds << "," << std::endl;
+			out << "\t\"simulations_per_hour\": " << perHour << "," << std::endl;
+			out << "\t\"scenarios\": [" << std::endl;
+		}
+
+		for (unsigned int s = 0; s < _scenarios.size (); ++s){
+			vector <double> loads, runs;
+			for (auto &i : _instances){
+				if (i._scenario == s && i._success){
+					loads.push_back (i._load);
+					runs.push_back (i._run);
+				}
+			}
+			double loadMean = Mean (loads), runMean = Mean (runs);
+			double loadP99 = Percentile (loads, 99.), runP99 = Percentile (runs, 99.);
+			LOG ("  " << _scenarios [s]._config << ": " << runs.size () << " of " << _scenarios [s]._count << " instances, load mean "
+					<< 1000.*loadMean << " ms (p99 " << 1000.*loadP99 << " ms), run mean " << 1000.*runMean << " ms (p99 " << 1000.*runP99
+					<< " ms, " << (runMean > 0. ? _frames/runMean : 0.) << " frames/s per instance)");
+			if (out.is_open ()){
+				out << "\t\t{\"config\": \"" << _scenarios [s]._config << "\", \"instances\": " << _scenarios [s]._count << ", \"succeeded\": "
+						<< runs.size () << ", \"load_ms\": {\"mean\": " << 1000.*loadMean << ", \"p99\": " << 1000.*loadP99
+						<< "}, \"run_ms\": {\"mean\": " << 1000.*runMean << ", \"p99\": " << 1000.*runP99 << "}}"
+						<< (s + 1 < _scenarios.size () ? "," : "") << std::endl;
+			}
+		}
+
+		if (out.is_open ()){
+			out << "\t]" << std::endl;
+			out << "}" << std::endl;
+			LOG ("Batch statistics written to " << _statistics);
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/**
+ * @file BatchRunner.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Runs many headless simulation instances concurrently in one process,
+ * as set by the <Batch> entry of the driver configuration:
+ *   <Batch Threads="0" Frames="600" Pinned="true" Statistics="batch.json">
+ *     <Scenario Config="Assets/Config/AssetsConfig.xml" Count="32"/>
+ *   </Batch>
+ * Every instance has its own asset factory (loaded from the scenario's
+ * assets configuration), task manager and rate scheduler, so that all
+ * mutable state stays with the instance; plugins are shared and keep
+ * their per-scene state per asset factory (see Plugin::ReleaseAssets ()).
+ * Read-only data (e.g. the meshes of the Geometry components) is loaded
+ * once for the whole batch through the shared cache (see SharedCache.h).
+ * 'Threads' threads (0: one per hardware thread, optionally pinned to a
+ * core each) take the instances one after the other and run each of them
+ * to completion on a serial task manager (see SerialTaskManager.h): an
+ * instance keeps to one core, and the batch scales with the number of
+ * instances rather than with the parallelism of a single frame. A run is
+ * 'Frames' unpaced ticks of the slowest rate (see RateScheduler::Advance ()).
+ * The report gives the simulations per hour of the batch and the load and
+ * run times of the instances.
+ */
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+
+namespace Sim {
+
+	class BatchRunner {
+
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+		protected:
+			class Scenario {
+				public:
+					std::string _config; // assets configuration
+					unsigned int _count;
+
+					Scenario (const std::string& config, unsigned int count): _config (config), _count (count) {}
+			};
+
+			class Instance {
+				public:
+					unsigned int _scenario;
+					bool _success;
+					double _load; // seconds
+					double _run; // seconds
+
+					explicit Instance (unsigned int scenario): _scenario (scenario), _success (false), _load (0.), _run (0.) {}
+			};
+
+			std::vector <Scenario> _scenarios;
+			std::vector <Instance> _instances;
+			// scheduler configuration (file and root element) the task graphs are read from
+			std::string _taskConfig;
+			std::string _taskRoot;
+			unsigned int _threads;
+			unsigned int _frames;
+			bool _pinned;
+			std::string _statistics;
+			double _seconds; // wall time of the batch
+
+		public:
+			BatchRunner (): _threads (0), _frames (0), _pinned (false), _seconds (0.) {}
+			~BatchRunner () {}
+
+			// forbidden copy constructor and assignment operator
+			BatchRunner (const BatchRunner&) = delete;
+			BatchRunner& operator = (const BatchRunner&) = delete;
+
+			// the <Batch> entry and the scheduler configuration of the driver's task manager
+			bool Initialize (tinyxml2::XMLElement& config, const std::string& taskConfig, const std::string& taskRoot);
+			void Cleanup () {_scenarios.clear (); _instances.clear ();}
+
+			// run every instance; false if any of them failed
+			bool Run ();
+			// log the throughput and per-scenario times and write them to the statistics file
+			void Report () const;
+
+			unsigned int InstanceCount () const {return static_cast <unsigned int> (_instances.size ());}
+
+		protected:
+			void RunInstance (Instance& instance) const;
+	};
+}
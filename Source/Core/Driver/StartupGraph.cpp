@@ -0,0 +1,144 @@
+/**
+ * @file StartupGraph.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See StartupGraph.h
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Preprocess.h"
+#include "StartupProfiler.h"
+
+#include "Driver/StartupGraph.h"
+
+using std::string;
+using std::vector;
+
+namespace Sim {
+
+	bool StartupGraph::Add (const char* name, const Step& step, const vector <string>& after, bool main)
+	{
+		StartupStep s (name, step, main);
+		for (auto &a : after){
+			unsigned int i = 0;
+			while (i < _steps.size () && _steps [i]._name != a){
+				++i;
+			}
+			if (i == _steps.size ()){
+				LOG_ERROR ("Start-up step " << name << " depends on unknown step " << a);
+				return false;
+			}
+			s._after.push_back (i);
+		}
+		_steps.push_back (s);
+		return true;
+	}
+
+	bool StartupGraph::Run ()
+	{
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start = Clock::now ();
+		vector <std::thread> workers;
+		int phase = StartupProfiler::Instance ().Current (); // steps are phases of the caller's phase
+
+		std::unique_lock <std::mutex> lock (_mutex);
+		while (true){
+			// start every worker step that is ready
+			for (int i = NextReady (false); i >= 0; i = NextReady (false)){
+				_steps [i]._state = StartupStep::STEP_RUNNING;
+				workers.emplace_back ([this, i, phase] {
+					bool success = false;
+					{
+						StartupProfiler::Phase p (_steps [i]._name, phase);
+						success = _steps [i]._step ();
+					}
+					Finish (i, success);
+				});
+			}
+
+			int main = NextReady (true);
+			if (main >= 0){
+				_steps [main]._state = StartupStep::STEP_RUNNING;
+				lock.unlock ();
+				bool success = false;
+				{
+					StartupProfiler::Phase p (_steps [main]._name, phase);
+					success = _steps [main]._step ();
+				}
+				Finish (main, success);
+				lock.lock ();
+				continue;
+			}
+
+			bool running = false;
+			for (auto &s : _steps){
+				running = running || s._state == StartupStep::STEP_RUNNING;
+			}
+			if (!running){
+				break;
+			}
+			_changed.wait (lock);
+		}
+		lock.unlock ();
+		for (auto &w : workers){
+			w.join ();
+		}
+
+		bool success = true;
+		for (auto &s : _steps){
+			if (s._state != StartupStep::STEP_DONE){
+				LOG_ERROR ("Start-up step " << s._name << (s._state == StartupStep::STEP_FAILED ? " failed" : " was skipped"));
+				success = false;
+			}
+		}
+		LOG ("Start-up " << (success ? "finished" : "failed") << " in "
+				<< 1000.*std::chrono::duration <double> (Clock::now () - start).count () << " ms");
+		return success;
+	}
+
+	// a step never runs once a step it depends on has failed
+	int StartupGraph::NextReady (bool main) const
+	{
+		for (unsigned int i = 0; i < _steps.size (); ++i){
+			const StartupStep& s = _steps [i];
+			if (s._state != StartupStep::STEP_WAITING || s._main != main || Blocked (s)){
+				continue;
+			}
+			bool ready = true;
+			for (auto a : s._after){
+				ready = ready && _steps [a]._state == StartupStep::STEP_DONE;
+			}
+			if (ready){
+				return static_cast <int> (i);
+			}
+		}
+		return -1;
+	}
+
+	// true if the step depends (directly or not) on a failed one
+	bool StartupGraph::Blocked (const StartupStep& step) const
+	{
+		for (auto a : step._after){
+			if (_steps [a]._state == StartupStep::STEP_FAILED || Blocked (_steps [a])){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void StartupGraph::Finish (unsigned int index, bool success)
+	{
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			_steps [index]._state = success ? StartupStep::STEP_DONE : StartupStep::STEP_FAILED;
+		}
+		_changed.notify_all ();
+	}
+}
@@ -0,0 +1,75 @@
+/**
+ * @file StartupGraph.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The dependency graph of the driver's start-up. Every step brings up
+ * one subsystem (display, HPC, plugins, assets...) and names the steps
+ * it needs; steps whose dependencies are up run concurrently. Steps
+ * marked main-thread (e.g. those creating a GPU context, which is bound
+ * to the thread that made it current) run on the thread calling Run (),
+ * the others on threads of their own. A failed step fails the start-up:
+ * the steps depending on it are skipped and Run () returns false once
+ * the running ones have finished.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Sim {
+
+	class StartupGraph {
+
+		public:
+			typedef std::function <bool ()> Step;
+
+		protected:
+			class StartupStep {
+				public:
+					std::string _name;
+					Step _step;
+					std::vector <unsigned int> _after;
+					bool _main;
+
+					typedef enum {
+						STEP_WAITING,
+						STEP_RUNNING,
+						STEP_DONE,
+						STEP_FAILED
+					} State;
+					State _state;
+
+					StartupStep (const std::string& name, const Step& step, bool main)
+					: _name (name), _step (step), _main (main), _state (STEP_WAITING) {}
+			};
+
+			std::vector <StartupStep> _steps;
+			std::mutex _mutex;
+			std::condition_variable _changed;
+
+		public:
+			StartupGraph () {}
+			~StartupGraph () {}
+
+			// forbidden copy constructor and assignment operator
+			StartupGraph (const StartupGraph&) = delete;
+			StartupGraph& operator = (const StartupGraph&) = delete;
+
+			// add a step running after the (already added) steps named in 'after'
+			bool Add (const char* name, const Step& step, const std::vector <std::string>& after, bool main = false);
+			// run every step; false if any failed
+			bool Run ();
+
+		protected:
+			// index of a waiting step whose dependencies are done (-1 if none)
+			int NextReady (bool main) const;
+			bool Blocked (const StartupStep& step) const;
+			void Finish (unsigned int index, bool success);
+	};
+}
@@ -8,7 +8,10 @@
  * See EventManager.h.
  */
 
+#include <vector>
+
 #include "Preprocess.h"
+#include "Snapshot.h"
 #include "Events/EventManager.h"
 
 namespace Sim {
@@ -53,6 +56,32 @@ namespace Sim {
 		return true;
 	}
 
+	bool EventManager::Save (SnapshotWriter& snapshot)
+	{
+		std::vector <Event> events;
+		_queue.Contents (events);
+		if (!snapshot.Begin ("Events")){
+			return false;
+		}
+		snapshot.Write (events);
+		snapshot.End ();
+		return true;
+	}
+
+	bool EventManager::Restore (SnapshotReader& snapshot)
+	{
+		std::vector <Event> events;
+		if (!snapshot.Section ("Events") || !snapshot.Read (events)){
+			LOG_ERROR ("No event queue found in the snapshot");
+			return false;
+		}
+		_queue.Clear ();
+		for (auto &e : events){
+			_queue.Push (e);
+		}
+		return true;
+	}
+
 	bool EventManager::Initialize (const char* config)
 	{
 		return true;
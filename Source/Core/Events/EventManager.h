@@ -18,6 +18,10 @@
 #include "Events/Event.h"
 
 namespace Sim {
+
+	class SnapshotWriter;
+	class SnapshotReader;
+
 	typedef util::Callback <void (unsigned int)> EventListener;
 
 	class EventManager {
@@ -40,6 +44,10 @@ namespace Sim {
 
 			bool QueueEvent (Event&);
 
+			// checkpointing of the queued events (listeners are registered by code and not saved)
+			bool Save (SnapshotWriter&);
+			bool Restore (SnapshotReader&);
+
 			bool Initialize (const char* config);
 			void Cleanup ();
 	};
@@ -0,0 +1,210 @@
+/**
+ * @file InputLog.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See InputLog.h.
+ */
+
+#include <string>
+#include <vector>
+
+#include "Preprocess.h"
+#include "Snapshot.h"
+#include "Events/InputLog.h"
+
+using std::string;
+using std::vector;
+
+namespace Sim {
+
+	static const char* const SIM_INPUT_TYPES [] = {"tool pose", "mouse button", "mouse motion", "configuration"};
+
+	InputLog::InputLog ()
+	: _mode (INPUT_LIVE), _next (0), _frame (0), _frames (0), _time (0.), _applied (0), _dropped (0)
+	{}
+
+	bool InputLog::Initialize (InputMode mode, const string& file, const string& scenario)
+	{
+		_mode = mode;
+		_file = file;
+		_scenario = scenario;
+		if (_mode == INPUT_LIVE){
+			return true;
+		}
+		if (_file.empty ()){
+			LOG_ERROR ("No file to record the inputs to or replay them from");
+			return false;
+		}
+		if (_mode == INPUT_RECORD){
+			LOG ("Recording the inputs to " << _file);
+			return true;
+		}
+		if (!Load ()){
+			return false;
+		}
+		if (_scenario != scenario){
+			LOG_WARNING ("The inputs of " << _file << " were recorded on " << _scenario << ", not on " << scenario);
+		}
+		LOG ("Replaying " << _log.size () << " inputs over " << _frames << " frames from " << _file);
+		return true;
+	}
+
+	bool InputLog::Cleanup ()
+	{
+		bool saved = true;
+		if (_mode == INPUT_RECORD){
+			saved = Save ();
+		}
+		std::lock_guard <std::mutex> lock (_mutex);
+		_pending.clear ();
+		_log.clear ();
+		_next = 0;
+		_mode = INPUT_LIVE;
+		for (auto &h : _handlers){
+			h = Handler ();
+		}
+		_settings.clear ();
+		return saved;
+	}
+
+	void InputLog::Submit (const Input& input)
+	{
+		if (_mode == INPUT_REPLAY){
+			return;
+		}
+		std::lock_guard <std::mutex> lock (_mutex);
+		_pending.push_back (input);
+	}
+
+	void InputLog::Tick (double period)
+	{
+		++_frame;
+		_time += period;
+		if (_mode == INPUT_RECORD){
+			_frames = _frame;
+		}
+		Apply ();
+	}
+
+	void InputLog::Rewind ()
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		_frame = 0;
+		_time = 0.;
+		_next = 0;
+		_applied = _dropped = 0;
+		if (_mode == INPUT_RECORD){
+			_log.clear ();
+			_frames = 0;
+		}
+	}
+
+	void InputLog::Report () const
+	{
+		LOG ("Inputs: " << _applied << " applied, " << _dropped << " without a handler, by frame " << _frame << " (" << _time << " s)");
+	}
+
+	// the inputs due at the current frame, in the order they were submitted (or recorded)
+	void InputLog::Apply ()
+	{
+		if (_mode == INPUT_REPLAY){
+			while (_next < _log.size () && _log [_next]._frame <= _frame){
+				Dispatch (_log [_next++]);
+			}
+			return;
+		}
+		vector <Input> due;
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			due.swap (_pending);
+		}
+		for (auto &i : due){
+			i._frame = _frame;
+			i._time = _time;
+			Dispatch (i);
+			if (_mode == INPUT_RECORD){
+				_log.push_back (i);
+			}
+		}
+	}
+
+	bool InputLog::Dispatch (const Input& input)
+	{
+		Handler* handler = nullptr;
+		if (input._type == INPUT_CONFIG){
+			auto s = _settings.find (input._name);
+			handler = s != _settings.end () ? &s->second : nullptr;
+		} else if (input._type < INPUT_TYPE_COUNT){
+			handler = &_handlers [input._type];
+		}
+		if (handler == nullptr || !*handler || !(*handler) (input)){
+			if (_dropped++ == 0){
+				LOG_WARNING ("Dropping " << (input._type < INPUT_TYPE_COUNT ? SIM_INPUT_TYPES [input._type] : "invalid")
+						<< " input" << (input._name.empty () ? "" : " " + input._name) << " without a handler (further ones are only counted)");
+			}
+			return false;
+		}
+		++_applied;
+		return true;
+	}
+
+	bool InputLog::Save () const
+	{
+		SnapshotWriter snapshot;
+		if (!snapshot.Begin ("Inputs")){
+			return false;
+		}
+		snapshot.Write (_scenario);
+		snapshot.Write (_frames);
+		snapshot.Write (static_cast <unsigned long long> (_log.size ()));
+		for (auto &i : _log){
+			snapshot.Write (i._frame);
+			snapshot.Write (i._time);
+			snapshot.Write (static_cast <unsigned int> (i._type));
+			snapshot.Write (i._target);
+			snapshot.Write (i._values);
+			snapshot.Write (i._name);
+			snapshot.Write (i._text);
+		}
+		snapshot.End ();
+		if (!snapshot.Save (_file)){
+			LOG_ERROR ("Could not write the recorded inputs to " << _file);
+			return false;
+		}
+		LOG ("Recorded " << _log.size () << " inputs over " << _frames << " frames to " << _file);
+		return true;
+	}
+
+	bool InputLog::Load ()
+	{
+		SnapshotReader snapshot;
+		unsigned long long count = 0;
+		if (!snapshot.Open (_file) || !snapshot.Section ("Inputs") || !snapshot.Read (_scenario) || !snapshot.Read (_frames) ||
+				!snapshot.Read (count)){
+			LOG_ERROR ("Could not read recorded inputs from " << _file);
+			return false;
+		}
+		// every input holds at least its fixed fields and the counts of its values, name and text
+		const size_t minimum = sizeof (Input::_frame) + sizeof (Input::_time) + sizeof (unsigned int) + sizeof (Input::_target) +
+				3*sizeof (unsigned long long);
+		if (count > snapshot.Remaining ()/minimum){
+			LOG_ERROR ("The recorded inputs of " << _file << " are truncated");
+			return false;
+		}
+		_log.assign (count, Input ());
+		for (auto &i : _log){
+			unsigned int type = 0;
+			if (!snapshot.Read (i._frame) || !snapshot.Read (i._time) || !snapshot.Read (type) || !snapshot.Read (i._target) ||
+					!snapshot.Read (i._values) || !snapshot.Read (i._name) || !snapshot.Read (i._text)){
+				LOG_ERROR ("The recorded inputs of " << _file << " are truncated");
+				return false;
+			}
+			i._type = type < INPUT_TYPE_COUNT ? static_cast <InputType> (type) : INPUT_TYPE_COUNT;
+		}
+		_next = 0;
+		return true;
+	}
+}
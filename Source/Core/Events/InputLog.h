@@ -0,0 +1,137 @@
+/**
+ * @file InputLog.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Recording and replay of the external inputs of a simulation: tool
+ * poses from the devices, mouse input of the display and configuration
+ * changes. Inputs are submitted from any thread and applied by their
+ * handlers on the driver's thread at the next frame boundary (a tick of
+ * the slowest rate), so that they are stamped with the simulation time
+ * they take effect at rather than the wall-clock time they arrived at.
+ * While recording, every applied input is logged with its frame; the
+ * log is saved in the snapshot format (see Snapshot.h) together with the
+ * scenario it was recorded on and the number of frames run. A replay
+ * ignores live inputs and applies the logged ones at their frames, so
+ * that with deterministic scheduling (see TaskManager.h) a captured
+ * session runs bit-identically, as fast as the driver goes, e.g. as a
+ * benchmark workload of the headless driver.
+ * The drivers set the handlers: tool poses go to the components of the
+ * target asset (see Component::ApplyInput ()), mouse input to the
+ * renderer where there is one. Inputs without a handler are counted and
+ * dropped. Outside of deterministic mode faster rates keep running on
+ * their own threads while the handlers run.
+ */
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Sim {
+
+	typedef enum {
+		INPUT_TOOL_POSE, // target: asset id; values: position (3) and orientation quaternion (4)
+		INPUT_MOUSE_BUTTON, // target: button; values: x, y
+		INPUT_MOUSE_MOTION, // target: button mask; values: x, y
+		INPUT_CONFIG, // name: setting; text: its new value
+		INPUT_TYPE_COUNT
+	} InputType;
+
+	typedef enum {
+		INPUT_LIVE, // inputs are applied as they come and not kept
+		INPUT_RECORD,
+		INPUT_REPLAY
+	} InputMode;
+
+	class Input {
+		public:
+			unsigned long long _frame; // ticks of the slowest rate run before it took effect
+			double _time; // simulation time (seconds) it took effect at
+			InputType _type;
+			unsigned int _target;
+			std::vector <double> _values;
+			std::string _name;
+			std::string _text;
+
+			Input (): _frame (0), _time (0.), _type (INPUT_TYPE_COUNT), _target (0) {}
+			Input (InputType type, unsigned int target, const std::vector <double>& values)
+			: _frame (0), _time (0.), _type (type), _target (target), _values (values) {}
+			Input (const std::string& name, const std::string& text)
+			: _frame (0), _time (0.), _type (INPUT_CONFIG), _target (0), _name (name), _text (text) {}
+	};
+
+	class InputLog {
+
+		public:
+			// applies an input; returns false if nothing took it
+			typedef std::function <bool (const Input&)> Handler;
+
+		protected:
+			InputMode _mode;
+			std::string _file; // recorded to or replayed from
+			std::string _scenario; // assets configuration of the recording
+			std::mutex _mutex;
+			std::vector <Input> _pending; // submitted, not yet applied
+			std::vector <Input> _log; // recorded, or being replayed
+			size_t _next; // next input of the replay
+			unsigned long long _frame;
+			unsigned long long _frames; // run by the recording
+			double _time; // seconds
+			Handler _handlers [INPUT_TYPE_COUNT];
+			std::map <std::string, Handler> _settings; // configuration change handlers, by setting
+
+			// statistics
+			unsigned long long _applied;
+			unsigned long long _dropped; // without a handler
+
+		public:
+			InputLog ();
+			~InputLog () {}
+
+			// forbidden copy constructor and assignment operator
+			InputLog (const InputLog&) = delete;
+			InputLog& operator = (const InputLog&) = delete;
+
+			// record to or replay from 'file' (mode INPUT_LIVE: neither) on the given scenario
+			bool Initialize (InputMode mode, const std::string& file, const std::string& scenario);
+			// save the recording (if any) and drop the handlers
+			bool Cleanup ();
+
+			InputMode Mode () const {return _mode;}
+			void SetHandler (InputType type, const Handler& handler) {_handlers [type] = handler;}
+			void SetSettingHandler (const std::string& setting, const Handler& handler) {_settings [setting] = handler;}
+
+			// queue an input for the next frame boundary (any thread; ignored during a replay)
+			void Submit (const Input& input);
+
+			/**
+			 * Frame boundaries, on the thread running the slowest rate: Begin () before
+			 * its first tick, Tick () after every tick (with the period that passed in
+			 * simulation time). Both apply the inputs due by then.
+			 */
+			void Begin () {Apply ();}
+			void Tick (double period);
+			// back to frame 0 (e.g. for a scenario reset): a replay starts over, a recording drops what it has
+			void Rewind ();
+
+			unsigned long long Frame () const {return _frame;}
+			double Time () const {return _time;}
+			// frames run by the recording being replayed
+			unsigned long long RecordedFrames () const {return _frames;}
+			// every input of the replay has been applied
+			bool Finished () const {return _mode != INPUT_REPLAY || _next >= _log.size ();}
+
+			void Report () const;
+
+		protected:
+			void Apply ();
+			bool Dispatch (const Input& input);
+			bool Save () const;
+			bool Load ();
+	};
+}
@@ -0,0 +1,39 @@
+/**
+ * @file CpuHPCManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The High Performance Computing module manager of CPU-only runs. There
+ * is no device context to create: numerical plugins run on the threads
+ * of the task manager.
+ */
+#pragma once
+
+#include <thread>
+
+#include "Preprocess.h"
+
+#include "HPC/HPCManager.h"
+
+namespace Sim {
+
+	class CpuHPCManager : public HPCManager {
+
+		private: // forbidden copy constructor and assignment operator
+			CpuHPCManager (const CpuHPCManager&);
+			CpuHPCManager& operator = (const CpuHPCManager&);
+
+		public:
+			CpuHPCManager () {}
+			~CpuHPCManager () {}
+
+			virtual bool Initialize (const char* config) override
+			{
+				LOG ("CPU HPC manager initialized (" << std::thread::hardware_concurrency () << " hardware threads)");
+				return true;
+			}
+			virtual void Cleanup () override {}
+	};
+}
@@ -8,12 +8,14 @@
  * See LibManager.h
  */
 
+#include <chrono>
 #include <cstring>
 #include <map>
 #include <string>
 #include <memory>
 
 #include "Preprocess.h"
+#include "StartupProfiler.h"
 
 #include "Plugins/SharedLib.h"
 #include "Plugins/LibManager.h"
@@ -157,12 +159,15 @@ namespace Sim {
 	bool LibManager::LoadAllLibraries ()
 	{
 		for (auto &l : _libs) {
+			StartupProfiler::Phase phase ("Load " + l.first);
+			auto begin = std::chrono::steady_clock::now ();
 			l.second = make_unique <SharedLib> ();
 			if (!l.second->Load (l.first)){
 				LOG_ERROR ("Could not load " << l.first);
 				_libs.erase (l.first);
 				return false;
 			}
+			StartupProfiler::Instance ().Read (l.first, std::chrono::duration <double> (std::chrono::steady_clock::now () - begin).count ());
 #			ifdef __GNUC__
 			__extension__
 #			endif
@@ -173,7 +178,7 @@ namespace Sim {
 			}
 			string name;
 			GetRawLibName (l.first, name);
-			start (PluginManager::PluginId (name.c_str ())); // this function adds the corresponding plugins to PluginManager
+			start (PluginFactory::PluginId (name.c_str ())); // this function adds the corresponding plugins to PluginFactory
 		}
 		return true;
 	}
@@ -18,6 +18,8 @@
 namespace Sim {
 
 	class Asset;
+	class AssetFactory;
+	class SnapshotReader;
 
 	class Plugin {
 
@@ -32,6 +34,19 @@ namespace Sim {
 			virtual const char* Name () const = 0;
 
 			virtual bool InitializeAssetComponent (const char* componentName, tinyxml2::XMLElement& config, Asset* asset) = 0;
+			/**
+			 * Create a component from its checkpointed state (see Component::Restore ())
+			 * instead of its configuration. Plugins whose components cannot be
+			 * checkpointed keep this default.
+			 */
+			virtual bool RestoreAssetComponent (const char* componentName, SnapshotReader& snapshot, Asset* asset) {return false;}
+			/**
+			 * Several simulation instances may run in one process (see BatchRunner.h),
+			 * each with its own asset factory. Plugins keeping state across the assets
+			 * of a scene (e.g. the colliders) keep it per factory (Asset::Factory ())
+			 * and drop it here, when the factory cleans up.
+			 */
+			virtual void ReleaseAssets (const AssetFactory* factory) {}
 			virtual void Cleanup () = 0;
 	};
 
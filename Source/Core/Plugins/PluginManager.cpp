@@ -14,6 +14,7 @@
 
 #include "Preprocess.h"
 #include "InputParser.h"
+#include "StartupProfiler.h"
 
 #include "Plugins/LibManager.h"
 #include "Plugins/PluginManager.h"
@@ -30,12 +31,12 @@ namespace Sim {
 
 	std::map <std::string, unsigned int> PluginFactory::_nameMap;
 
-	PluginFactory::PluginManager ()
+	PluginFactory::PluginFactory ()
 	{
 		LOG ("Plugin manager constructed");
 	}
 
-	PluginFactory::~PluginManager ()
+	PluginFactory::~PluginFactory ()
 	{
 		Cleanup ();
 		LOG ("Plugin manager destroyed");
@@ -43,6 +44,7 @@ namespace Sim {
 
 	bool PluginFactory::Initialize (const char* configfile)
 	{
+		StartupProfiler::Phase phase ("PluginFactory::Initialize");
 		InputParser parser;
 		if (!parser.Initialize (configfile, "PluginsConfig")){
 			LOG_ERROR ("Could not initialize parser for " << configfile);
@@ -131,7 +133,7 @@ namespace Sim {
 #		endif
 	}
 
-	bool PluginManager::InitializeIdMap (XMLElement& elem)
+	bool PluginFactory::InitializeIdMap (XMLElement& elem)
 	{
 		XMLElement* mlist = elem.FirstChildElement ("Map");
 		if (mlist == nullptr){
@@ -32,8 +32,8 @@ namespace Sim {
 			std::map <unsigned int, std::shared_ptr <Plugin> > _plugins;
 
 			// forbidden copy constructor and assignment operator
-			PluginFactory (const PluginManager&) = delete;
-			PluginFactory& operator = (const PluginManager&) = delete;
+			PluginFactory (const PluginFactory&) = delete;
+			PluginFactory& operator = (const PluginFactory&) = delete;
 
 		public:
 			PluginFactory ();
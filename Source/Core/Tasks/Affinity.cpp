@@ -0,0 +1,170 @@
+/**
+ * @file Affinity.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See Affinity.h.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined (__linux__)
+#	include <pthread.h>
+#	include <sched.h>
+#endif
+
+#include "Preprocess.h"
+#include "Tasks/Affinity.h"
+
+using std::string;
+using std::vector;
+
+namespace Sim {
+
+	static const char* SIM_NUMA_SYSFS_PATH = "/sys/devices/system/node/";
+
+	// read the first line of a (sysfs) file
+	static bool ReadLine (const string& file, string& line)
+	{
+		std::ifstream input (file.c_str ());
+		if (!input.is_open ()){
+			return false;
+		}
+		std::getline (input, line);
+		return !line.empty ();
+	}
+
+	bool Affinity::Initialize ()
+	{
+		_nodes.clear ();
+
+		string line;
+		vector <unsigned int> ids;
+		if (ReadLine (string (SIM_NUMA_SYSFS_PATH) + "online", line) && ParseCpuList (line.c_str (), ids)){
+			for (auto id : ids){
+				NumaNode node;
+				node._id = id;
+				string file = string (SIM_NUMA_SYSFS_PATH) + "node" + std::to_string (id) + "/cpulist";
+				if (ReadLine (file, line) && ParseCpuList (line.c_str (), node._cpus) && !node._cpus.empty ()){
+					_nodes.push_back (node);
+				}
+			}
+		}
+
+		// no NUMA information: every processor we may run on forms one node
+		if (_nodes.empty ()){
+			NumaNode node;
+			if (!GetThreadAffinity (node._cpus) || node._cpus.empty ()){
+				unsigned int count = std::thread::hardware_concurrency ();
+				for (unsigned int i = 0; i < (count > 0 ? count : 1); ++i){
+					node._cpus.push_back (i);
+				}
+			}
+			_nodes.push_back (node);
+		}
+
+		for (auto &n : _nodes){
+			LOG ("NUMA node " << n._id << ": " << n._cpus.size () << " processor(s)");
+		}
+		return true;
+	}
+
+	vector <unsigned int> Affinity::AllCpus () const
+	{
+		vector <unsigned int> cpus;
+		for (auto &n : _nodes){
+			cpus.insert (cpus.end (), n._cpus.begin (), n._cpus.end ());
+		}
+		return cpus;
+	}
+
+	bool Affinity::ParseCpuList (const char* list, vector <unsigned int>& cpus)
+	{
+		if (list == nullptr){
+			return false;
+		}
+		cpus.clear ();
+		const char* p = list;
+		while (*p != '\0' && *p != '\n'){
+			char* end = nullptr;
+			unsigned long first = strtoul (p, &end, 10);
+			if (end == p){
+				LOG_ERROR ("Invalid cpu list \'" << list << "\'");
+				return false;
+			}
+			unsigned long last = first;
+			p = end;
+			if (*p == '-'){
+				++p;
+				last = strtoul (p, &end, 10);
+				if (end == p || last < first){
+					LOG_ERROR ("Invalid cpu range in \'" << list << "\'");
+					return false;
+				}
+				p = end;
+			}
+			for (unsigned long c = first; c <= last; ++c){
+				cpus.push_back (static_cast <unsigned int> (c));
+			}
+			if (*p == ','){
+				++p;
+			}
+		}
+		return true;
+	}
+
+	bool Affinity::GetThreadAffinity (vector <unsigned int>& cpus)
+	{
+#		if defined (__linux__)
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		if (pthread_getaffinity_np (pthread_self (), sizeof (set), &set) != 0){
+			return false;
+		}
+		cpus.clear ();
+		for (unsigned int i = 0; i < CPU_SETSIZE; ++i){
+			if (CPU_ISSET (i, &set)){
+				cpus.push_back (i);
+			}
+		}
+		return true;
+#		else
+		return false;
+#		endif
+	}
+
+	bool Affinity::SetThreadAffinity (const vector <unsigned int>& cpus)
+	{
+		if (cpus.empty ()){
+			return false;
+		}
+#		if defined (__linux__)
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		for (auto c : cpus){
+			if (c < CPU_SETSIZE){
+				CPU_SET (c, &set);
+			}
+		}
+		return pthread_setaffinity_np (pthread_self (), sizeof (set), &set) == 0;
+#		else
+		return false;
+#		endif
+	}
+
+	void Affinity::RunOn (const vector <unsigned int>& cpus, const std::function <void ()>& function)
+	{
+		std::thread thread ([&cpus, &function] {
+			if (!SetThreadAffinity (cpus)){
+				LOG_WARNING ("Could not pin thread to " << cpus.size () << " processor(s)");
+			}
+			function ();
+		});
+		thread.join ();
+	}
+}
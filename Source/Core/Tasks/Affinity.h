@@ -0,0 +1,61 @@
+/**
+ * @file Affinity.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * CPU affinity and NUMA topology helpers used by the task managers to
+ * pin worker threads to core sets and to keep asset memory on the node
+ * that runs the asset's tasks. The topology is read from sysfs; on
+ * machines (or platforms) without NUMA information all processors form
+ * a single node. Memory placement relies on the first-touch policy of
+ * the OS: RunOn () executes a function on a thread pinned to a core set
+ * so that pages allocated and written there land on that node.
+ */
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace Sim {
+
+	class NumaNode {
+		public:
+			unsigned int _id;
+			std::vector <unsigned int> _cpus;
+
+			NumaNode (): _id (0) {}
+	};
+
+	class Affinity {
+
+		protected:
+			std::vector <NumaNode> _nodes;
+
+		public:
+			Affinity () {}
+			~Affinity () {}
+
+			// read the NUMA topology of the machine
+			bool Initialize ();
+			void Cleanup () {_nodes.clear ();}
+
+			unsigned int NodeCount () const {return static_cast <unsigned int> (_nodes.size ());}
+			const NumaNode& Node (unsigned int index) const {return _nodes [index];}
+			const std::vector <NumaNode>& Nodes () const {return _nodes;}
+
+			// all processors of the machine, node by node
+			std::vector <unsigned int> AllCpus () const;
+
+			// parse a Linux-style cpu list ("0-3,8,10-11")
+			static bool ParseCpuList (const char* list, std::vector <unsigned int>& cpus);
+
+			// affinity mask of the calling thread
+			static bool GetThreadAffinity (std::vector <unsigned int>& cpus);
+			static bool SetThreadAffinity (const std::vector <unsigned int>& cpus);
+
+			// run a function on a temporary thread pinned to the given processors
+			static void RunOn (const std::vector <unsigned int>& cpus, const std::function <void ()>& function);
+	};
+}
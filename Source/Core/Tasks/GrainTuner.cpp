@@ -0,0 +1,154 @@
+/**
+ * @file GrainTuner.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See GrainTuner.h.
+ */
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Tasks/GrainTuner.h"
+
+using std::string;
+using tinyxml2::XMLDocument;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	// weight of the newest call in a site's average cost
+	const static double SIM_GRAIN_SMOOTHING = 0.25;
+
+	bool GrainTuner::Initialize (InputParser& parser)
+	{
+		XMLElement* element = parser.FindElement ("Grain");
+		if (element == nullptr){
+			return true;
+		}
+		element->QueryBoolAttribute ("Adaptive", &_enabled);
+		if (!_enabled){
+			return true;
+		}
+		double target = 50.;
+		element->QueryDoubleAttribute ("Target", &target);
+		if (target <= 0.){
+			LOG_ERROR ("Invalid target chunk cost for the grain tuner");
+			return false;
+		}
+		_target = 1000.*target;
+
+		const char* file = element->Attribute ("File");
+		if (file != nullptr && _file.empty ()){
+			_file = file;
+			Load (file);
+		}
+		LOG ("Adaptive grain enabled (target chunk " << target << " us, " << _sites.size () << " known site(s))");
+		return true;
+	}
+
+	void GrainTuner::Cleanup ()
+	{
+		if (_enabled && !_file.empty ()){
+			Save (_file.c_str ());
+		}
+		_enabled = false;
+		_file.clear ();
+		std::lock_guard <std::mutex> lock (_mutex);
+		_sites.clear ();
+	}
+
+	GrainSite& GrainTuner::Site (const char* name)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		std::unique_ptr <GrainSite>& site = _sites [name];
+		if (!site){
+			site.reset (new GrainSite);
+		}
+		return *site;
+	}
+
+	unsigned int GrainTuner::Grain (GrainSite& site, unsigned int count)
+	{
+		double cost = 0.;
+		{
+			std::lock_guard <std::mutex> lock (site._mutex);
+			cost = site._cost;
+		}
+		if (cost <= 0.){
+			return 0;
+		}
+		double grain = _target / cost;
+		if (grain >= count){
+			return count;
+		}
+		return grain < 1. ? 1 : static_cast <unsigned int> (grain);
+	}
+
+	void GrainTuner::Update (GrainSite& site)
+	{
+		unsigned long long elements = site._elements.exchange (0, std::memory_order_relaxed);
+		unsigned long long nanoseconds = site._nanoseconds.exchange (0, std::memory_order_relaxed);
+		if (elements == 0){
+			return;
+		}
+		double cost = static_cast <double> (nanoseconds) / elements;
+
+		std::lock_guard <std::mutex> lock (site._mutex);
+		site._cost = site._cost > 0. ? (1. - SIM_GRAIN_SMOOTHING)*site._cost + SIM_GRAIN_SMOOTHING*cost : cost;
+		++site._calls;
+	}
+
+	// a missing file is not an error: the first run starts without costs
+	bool GrainTuner::Load (const char* file)
+	{
+		if (!std::ifstream (file).good ()){
+			return false;
+		}
+		XMLDocument doc;
+		if (doc.LoadFile (file) != XML_SUCCESS || doc.FirstChildElement ("Grains") == nullptr){
+			LOG_WARNING ("Could not read grain costs from " << file);
+			return false;
+		}
+		for (XMLElement* s = doc.FirstChildElement ("Grains")->FirstChildElement ("Site"); s != nullptr;
+				s = s->NextSiblingElement ("Site")){
+			const char* name = s->Attribute ("Name");
+			double cost = 0.;
+			if (name == nullptr || s->QueryDoubleAttribute ("Cost", &cost) != XML_SUCCESS || cost <= 0.){
+				continue;
+			}
+			Site (name)._cost = cost;
+		}
+		return true;
+	}
+
+	bool GrainTuner::Save (const char* file)
+	{
+		std::ofstream out (file);
+		if (!out.is_open ()){
+			LOG_ERROR ("Could not open " << file << " to save grain costs");
+			return false;
+		}
+		std::lock_guard <std::mutex> lock (_mutex);
+		out << "<Grains>" << std::endl;
+		for (auto &s : _sites){
+			if (s.second->_cost > 0.){
+				double grain = _target / s.second->_cost;
+				out << "\t<Site Name=\"" << s.first << "\" Cost=\"" << s.second->_cost << "\" Grain=\""
+						<< (grain < 1. ? 1 : static_cast <unsigned int> (grain)) << "\"/>" << std::endl;
+			}
+		}
+		out << "</Grains>" << std::endl;
+		LOG ("Grain costs of " << _sites.size () << " site(s) written to " << file);
+		return true;
+	}
+}
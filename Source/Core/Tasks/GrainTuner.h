@@ -0,0 +1,90 @@
+/**
+ * @file GrainTuner.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Online grain-size tuning for the parallel loops of the task manager,
+ * configured by the <Grain> entry of the scheduler configuration file.
+ * Every call site of TaskManager::AdaptiveParallelFor () is identified
+ * by a name (e.g. "Liver.Physics"). The chunks a site runs are timed and
+ * their cost per element is tracked as a moving average, so the grain
+ * follows the work as meshes change (e.g. with cutting): it is the
+ * number of elements that cost about 'Target' microseconds, enough to
+ * hide the scheduling overhead while leaving chunks for idle workers to
+ * steal. Loops cheaper than one target chunk run serially. The costs
+ * are read from and written back to the file 'File' so that a new run
+ * starts from the grains of the last one.
+ */
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "InputParser.h"
+
+namespace Sim {
+
+	class GrainSite {
+		public:
+			// chunks of the running calls (written by the workers)
+			std::atomic <unsigned long long> _elements;
+			std::atomic <unsigned long long> _nanoseconds;
+
+			// moving average of the cost of one element (ns, 0: not measured yet)
+			std::mutex _mutex;
+			double _cost;
+			unsigned long long _calls;
+
+			GrainSite (): _elements (0), _nanoseconds (0), _cost (0.), _calls (0) {}
+
+			// forbidden copy constructor and assignment operator
+			GrainSite (const GrainSite&) = delete;
+			GrainSite& operator = (const GrainSite&) = delete;
+	};
+
+	class GrainTuner {
+
+		protected:
+			bool _enabled;
+			double _target; // chunk cost aimed at (ns)
+			std::string _file; // persisted costs (empty: not persisted)
+			std::mutex _mutex;
+			std::map <std::string, std::unique_ptr <GrainSite> > _sites;
+
+		private: // forbidden copy constructor and assignment operator
+			GrainTuner (const GrainTuner&);
+			GrainTuner& operator = (const GrainTuner&);
+
+		public:
+			GrainTuner (): _enabled (false), _target (50000.) {}
+			~GrainTuner () {}
+
+			// reads the settings; the persisted costs are read once and kept over graph reloads
+			bool Initialize (InputParser& parser);
+			// writes the costs back and forgets them
+			void Cleanup ();
+
+			bool Enabled () const {return _enabled;}
+
+			// the site of a name (created on first use; the reference stays valid until Cleanup ())
+			GrainSite& Site (const char* name);
+			// grain for a loop of 'count' elements at the site (0: no measurement yet)
+			unsigned int Grain (GrainSite& site, unsigned int count);
+			// a chunk of the running call has finished
+			void Record (GrainSite& site, unsigned int elements, unsigned long long nanoseconds)
+			{
+				site._elements.fetch_add (elements, std::memory_order_relaxed);
+				site._nanoseconds.fetch_add (nanoseconds, std::memory_order_relaxed);
+			}
+			// the call has finished: fold its chunks into the site's average
+			void Update (GrainSite& site);
+
+			bool Load (const char* file);
+			bool Save (const char* file);
+	};
+}
@@ -0,0 +1,236 @@
+/**
+ * @file QualityGovernor.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See QualityGovernor.h.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Tasks/QualityGovernor.h"
+
+using std::string;
+using std::chrono::duration;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	// most windows a rate waits in a row before it raises a knob, in multiples of the configured calm windows
+	const static unsigned int SIM_QUALITY_MAX_BACKOFF = 64;
+
+	bool QualityGovernor::Initialize (InputParser& parser, bool deterministic)
+	{
+		_enabled = false;
+		XMLElement* element = parser.FindElement ("Quality");
+		if (element == nullptr){
+			return true;
+		}
+		element->QueryBoolAttribute ("Enabled", &_enabled);
+		if (!_enabled){
+			return true;
+		}
+		if (deterministic){
+			LOG_WARNING ("Adaptive quality is off in deterministic mode");
+			_enabled = false;
+			return true;
+		}
+		element->QueryDoubleAttribute ("Budget", &_budget);
+		element->QueryDoubleAttribute ("High", &_high);
+		element->QueryDoubleAttribute ("Low", &_low);
+		element->QueryUnsignedAttribute ("Window", &_window);
+		element->QueryUnsignedAttribute ("Calm", &_calmWindows);
+		if (_budget <= 0. || _low <= 0. || _high < _low || _window == 0){
+			LOG_ERROR ("Invalid budget, thresholds or window for adaptive quality");
+			_enabled = false;
+			return false;
+		}
+
+		const char* file = element->Attribute ("Log");
+		if (file != nullptr){
+			_file = file;
+			_log.open (_file);
+			if (!_log.is_open ()){
+				LOG_WARNING ("Could not open " << _file << " to log the quality adjustments");
+			} else {
+				_log << "seconds,rate,tick,load,knob,from,to" << std::endl;
+			}
+		}
+		_start = Clock::now ();
+		LOG ("Adaptive quality enabled (budget " << 100.*_budget << "% of the period, lowered above " << 100.*_high << "%, raised below "
+				<< 100.*_low << "% of it, " << _window << " tick windows)");
+		return true;
+	}
+
+	void QualityGovernor::Cleanup ()
+	{
+		Detach ();
+		std::lock_guard <std::mutex> lock (_logMutex);
+		if (_log.is_open ()){
+			_log.close ();
+		}
+		_file.clear ();
+		_enabled = false;
+	}
+
+	unsigned int QualityGovernor::AddRate (double rate)
+	{
+		_rates.emplace_back (new GovernedRate (rate, _budget/rate));
+		return static_cast <unsigned int> (_rates.size () - 1);
+	}
+
+	void QualityGovernor::AddKnob (unsigned int rate, unsigned int stage, const string& label, QualityKnob& knob)
+	{
+		if (knob.Max () <= knob.Min ()){
+			return; // nothing to give
+		}
+		for (auto &r : _rates){
+			for (auto &k : r->_knobs){
+				if (k._knob == &knob){
+					return;
+				}
+			}
+		}
+		knob.Reset ();
+		_rates [rate]->_knobs.emplace_back (&knob, label, stage);
+		LOG ("Quality knob " << label << " (" << knob.Min () << " to " << knob.Max () << ") at rate " << _rates [rate]->_rate << " Hz");
+	}
+
+	void QualityGovernor::Detach ()
+	{
+		for (auto &r : _rates){
+			for (auto &k : r->_knobs){
+				k._knob->Reset ();
+			}
+		}
+		_rates.clear ();
+	}
+
+	void QualityGovernor::Tick (unsigned int index, double seconds)
+	{
+		GovernedRate& rate = *_rates [index];
+		++rate._ticks;
+		rate._windowTime += seconds;
+		if (++rate._windowTicks < _window){
+			return;
+		}
+
+		double load = rate._windowTime/rate._windowTicks/rate._budget;
+		if (load > _high){
+			rate._calm = 0;
+			if (rate._probation > 0){
+				rate._probation = 0;
+				rate._backoff = std::min (2*rate._backoff, SIM_QUALITY_MAX_BACKOFF);
+			}
+			Lower (rate, load);
+		} else {
+			if (rate._probation > 0 && --rate._probation == 0){
+				rate._backoff = std::max (rate._backoff/2, 1u);
+			}
+			if (load >= _low){
+				rate._calm = 0;
+			} else if (++rate._calm >= _calmWindows*rate._backoff && Raise (rate, load)){
+				rate._calm = 0;
+				rate._probation = _calmWindows*rate._backoff;
+			}
+		}
+
+		rate._windowTicks = 0;
+		rate._windowTime = 0.;
+		for (auto &s : rate._stageTimes){
+			s.second = 0.;
+		}
+	}
+
+	// a knob of the costliest stage that can still give a step: lowest priority, then least reduced
+	bool QualityGovernor::Lower (GovernedRate& rate, double load)
+	{
+		const GovernedKnob* best = nullptr;
+		double bestTime = 0.;
+		for (auto &k : rate._knobs){
+			if (k._knob->Level () <= k._knob->Min ()){
+				continue;
+			}
+			auto s = rate._stageTimes.find (k._stage);
+			double time = s != rate._stageTimes.end () ? s->second : 0.;
+			if (best == nullptr || time > bestTime || (time == bestTime && (k._knob->Priority () < best->_knob->Priority () ||
+					(k._knob->Priority () == best->_knob->Priority () && k._knob->Reduction () < best->_knob->Reduction ())))){
+				best = &k;
+				bestTime = time;
+			}
+		}
+		if (best == nullptr){
+			return false;
+		}
+		int from = best->_knob->Level ();
+		best->_knob->Set (from - 1);
+		++rate._lowered;
+		Adjusted (rate, *best, from, load);
+		return true;
+	}
+
+	// highest priority first, then the most reduced
+	bool QualityGovernor::Raise (GovernedRate& rate, double load)
+	{
+		const GovernedKnob* best = nullptr;
+		for (auto &k : rate._knobs){
+			if (k._knob->Level () >= k._knob->Max ()){
+				continue;
+			}
+			if (best == nullptr || k._knob->Priority () > best->_knob->Priority () ||
+					(k._knob->Priority () == best->_knob->Priority () && k._knob->Reduction () > best->_knob->Reduction ())){
+				best = &k;
+			}
+		}
+		if (best == nullptr){
+			return false;
+		}
+		int from = best->_knob->Level ();
+		best->_knob->Set (from + 1);
+		++rate._raised;
+		Adjusted (rate, *best, from, load);
+		return true;
+	}
+
+	void QualityGovernor::Adjusted (GovernedRate& rate, const GovernedKnob& knob, int from, double load)
+	{
+		int to = knob._knob->Level ();
+		LOG ("Quality: rate " << rate._rate << " Hz at " << 100.*load << "% of its budget, " << knob._label << " " << from << " -> " << to);
+		std::lock_guard <std::mutex> lock (_logMutex);
+		if (_log.is_open ()){
+			_log << duration <double> (Clock::now () - _start).count () << "," << rate._rate << "," << rate._ticks << "," << load << ","
+					<< knob._label << "," << from << "," << to << std::endl;
+		}
+	}
+
+	void QualityGovernor::Report () const
+	{
+		if (!_enabled){
+			return;
+		}
+		for (auto &r : _rates){
+			LOG ("Quality at rate " << r->_rate << " Hz: " << r->_knobs.size () << " knob(s), lowered " << r->_lowered << " times, raised "
+					<< r->_raised << " times");
+			for (auto &k : r->_knobs){
+				if (k._knob->Level () < k._knob->Max ()){
+					LOG ("  " << k._label << " at " << k._knob->Level () << " of " << k._knob->Max ());
+				}
+			}
+		}
+		if (!_file.empty ()){
+			LOG ("Quality adjustments written to " << _file);
+		}
+	}
+}
@@ -0,0 +1,168 @@
+/**
+ * @file QualityGovernor.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Adaptive quality that holds the frame budget of every rate, configured
+ * by the <Quality> entry of the scheduler configuration file:
+ *   <Quality Enabled="true" Budget="0.9" High="1" Low="0.75" Window="30" Calm="3" Log="Quality.csv"/>
+ * Components trade quality for time through knobs they declare (see
+ * Component::QualityKnobs ()), e.g. solver iterations, collision level of
+ * detail, how often normals are recomputed or which subsets are drawn; the
+ * rate scheduler adds the sub-steps of sub-stepped stages. A knob is an
+ * integer level between its minimum and maximum (full quality, which it
+ * starts at) that its owner reads whenever it runs.
+ * The governor watches the tick times of every rate (and the share of its
+ * stages) over windows of 'Window' ticks. The budget of a rate is 'Budget'
+ * times its period. A window whose mean tick is above 'High' times the
+ * budget lowers one knob of the rate by a step: one of the costliest stage
+ * that still has a step to give, lowest priority first. Only after 'Calm'
+ * windows in a row below 'Low' times the budget is one knob raised again,
+ * highest priority first, so that quality does not flap around the budget.
+ * A raise is on probation for as many windows as it took to earn it: an
+ * overload in that time doubles the calm windows the rate needs before it
+ * raises a knob again, a raise that holds halves them back.
+ * Every adjustment is logged, and written to the CSV file 'Log' if set.
+ * Wall-clock driven adjustments would break determinism, so the governor
+ * stays off in deterministic mode (see TaskManager.h).
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "InputParser.h"
+
+namespace Sim {
+
+	class QualityKnob {
+
+		protected:
+			std::string _name;
+			int _min;
+			int _max;
+			int _priority; // lower: given up first and restored last
+			std::atomic <int> _level;
+
+		public:
+			QualityKnob (const std::string& name, int min, int max, int priority = 0)
+			: _name (name), _min (min), _max (max > min ? max : min), _priority (priority), _level (_max) {}
+			~QualityKnob () {}
+
+			// forbidden copy constructor and assignment operator
+			QualityKnob (const QualityKnob&) = delete;
+			QualityKnob& operator = (const QualityKnob&) = delete;
+
+			const std::string& Name () const {return _name;}
+			int Min () const {return _min;}
+			int Max () const {return _max;}
+			int Priority () const {return _priority;}
+			// read by the owner whenever it runs (any thread)
+			int Level () const {return _level.load (std::memory_order_relaxed);}
+			// how far below full quality (0: full, 1: lowest)
+			double Reduction () const {return _max > _min ? static_cast <double> (_max - Level ())/(_max - _min) : 0.;}
+
+			// change the maximum (e.g. when the configuration of the owner changes), back at full quality
+			void SetMax (int max) {_max = max > _min ? max : _min; Reset ();}
+			void Set (int level) {_level.store (level < _min ? _min : level > _max ? _max : level, std::memory_order_relaxed);}
+			void Reset () {Set (_max);}
+	};
+
+	class QualityGovernor {
+
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+		protected:
+			class GovernedKnob {
+				public:
+					QualityKnob* _knob;
+					std::string _label; // e.g. "Liver.Collision.LOD"
+					unsigned int _stage;
+
+					GovernedKnob (QualityKnob* knob, const std::string& label, unsigned int stage)
+					: _knob (knob), _label (label), _stage (stage) {}
+			};
+
+			// only the thread ticking the rate touches it
+			class GovernedRate {
+				public:
+					double _rate; // Hz
+					double _budget; // seconds
+					std::vector <GovernedKnob> _knobs;
+					std::map <unsigned int, double> _stageTimes; // seconds of the window, per stage
+					unsigned long long _ticks;
+					unsigned int _windowTicks;
+					double _windowTime; // seconds
+					unsigned int _calm; // windows in a row below the low threshold
+					unsigned int _backoff; // calm windows needed, in multiples of the configured ones
+					unsigned int _probation; // windows left before the last raise holds
+
+					// statistics
+					unsigned long long _lowered;
+					unsigned long long _raised;
+
+					GovernedRate (double rate, double budget)
+					: _rate (rate), _budget (budget), _ticks (0), _windowTicks (0), _windowTime (0.), _calm (0), _backoff (1), _probation (0),
+						_lowered (0), _raised (0) {}
+			};
+
+			bool _enabled;
+			double _budget; // fraction of the period
+			double _high; // fractions of the budget
+			double _low;
+			unsigned int _window; // ticks
+			unsigned int _calmWindows;
+			std::string _file;
+			std::mutex _logMutex;
+			std::ofstream _log;
+			Clock::time_point _start;
+			std::vector <std::unique_ptr <GovernedRate> > _rates;
+
+		public:
+			QualityGovernor ()
+			: _enabled (false), _budget (0.9), _high (1.), _low (0.75), _window (30), _calmWindows (3) {}
+			~QualityGovernor () {}
+
+			// forbidden copy constructor and assignment operator
+			QualityGovernor (const QualityGovernor&) = delete;
+			QualityGovernor& operator = (const QualityGovernor&) = delete;
+
+			// reads the settings; stays off in deterministic mode
+			bool Initialize (InputParser& parser, bool deterministic);
+			void Cleanup ();
+
+			bool Enabled () const {return _enabled;}
+
+			/**
+			 * Set up by the rate scheduler, before its rates start: AddRate () for
+			 * every rate (in the order of the indices Tick () gets), AddKnob () for
+			 * every knob of a component (or stage) the rate runs. Knobs are taken by
+			 * one rate only. Detach () puts them back to full quality and forgets them.
+			 */
+			unsigned int AddRate (double rate);
+			void AddKnob (unsigned int rate, unsigned int stage, const std::string& label, QualityKnob& knob);
+			void Detach ();
+
+			// a stage of a rate ran for 'seconds' (within the tick being measured)
+			void StageTime (unsigned int rate, unsigned int stage, double seconds) {_rates [rate]->_stageTimes [stage] += seconds;}
+			// a tick of a rate took 'seconds': adjusts its knobs at the end of every window
+			void Tick (unsigned int rate, double seconds);
+
+			// log the adjustments made and the knobs left below full quality
+			void Report () const;
+
+		protected:
+			bool Lower (GovernedRate& rate, double load);
+			bool Raise (GovernedRate& rate, double load);
+			void Adjusted (GovernedRate& rate, const GovernedKnob& knob, int from, double load);
+	};
+}
@@ -0,0 +1,496 @@
+/**
+ * @file RateScheduler.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See RateScheduler.h.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "Preprocess.h"
+
+#include "Assets/Asset.h"
+#include "Assets/AssetFactory.h"
+#include "Assets/Component.h"
+#include "Assets/Geometry.h"
+#include "Tasks/QualityGovernor.h"
+#include "Tasks/TaskManager.h"
+#include "Tasks/RateScheduler.h"
+
+using std::shared_ptr;
+using std::unique_ptr;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using Sim::Assets::Component;
+using Sim::Assets::Geometry;
+
+namespace Sim {
+
+	// returns the geometry of the asset owning a component (empty if it has none)
+	static shared_ptr <Geometry> OwnerGeometry (const Component& c)
+	{
+		Asset* owner = c.Owner ();
+		unsigned int id = SIM_COMPONENT_ID ("Geometry");
+		if (owner == nullptr || !owner->HasComponent (id)){
+			return shared_ptr <Geometry> ();
+		}
+		return owner->GetComponent <Geometry> (id);
+	}
+
+	// number of tick times kept per rate for the percentiles
+	const static unsigned int SIM_RATE_SAMPLES = 4096;
+
+	// pipeline phases, in frame order
+	enum {SIM_PIPELINE_PHYSICS = 0, SIM_PIPELINE_COLLISION, SIM_PIPELINE_RENDER};
+
+	// a stage belongs to the earliest phase of any of its components
+	static unsigned int StagePhase (const TaskStage& stage)
+	{
+		unsigned int phase = SIM_PIPELINE_RENDER;
+		for (auto &node : stage._nodes){
+			for (auto &c : node._components){
+				const std::string name = c->Name ();
+				unsigned int p = name == "Render" ? SIM_PIPELINE_RENDER :
+						name == "Collision" ? SIM_PIPELINE_COLLISION : SIM_PIPELINE_PHYSICS;
+				phase = std::min (phase, p);
+			}
+		}
+		return phase;
+	}
+
+	// returns true if the geometry was added
+	static bool AddUnique (std::vector <shared_ptr <Geometry> >& list, const shared_ptr <Geometry>& g)
+	{
+		if (g && std::find (list.begin (), list.end (), g) == list.end ()){
+			list.push_back (g);
+			return true;
+		}
+		return false;
+	}
+
+	// the given percentile (0-100) of a set of samples
+	static double Percentile (std::vector <double> samples, double percentile)
+	{
+		if (samples.empty ()){
+			return 0.;
+		}
+		size_t n = std::min (samples.size () - 1, static_cast <size_t> (percentile*samples.size ()/100.));
+		std::nth_element (samples.begin (), samples.begin () + n, samples.end ());
+		return samples [n];
+	}
+
+	RateScheduler::RateScheduler (TaskManager& manager)
+	: _taskManager (manager), _running (false)
+	{}
+
+	RateScheduler::~RateScheduler ()
+	{
+		Cleanup ();
+	}
+
+	bool RateScheduler::Initialize ()
+	{
+		const TaskGraph& graph = _taskManager.Graph ();
+		if (graph.StageCount () == 0){
+			LOG_ERROR ("No task stages to schedule");
+			return false;
+		}
+
+		// group stages by rate
+		for (unsigned int i = 0; i < graph.StageCount (); ++i){
+			const TaskStage& stage = graph.Stage (i);
+			double rate = stage._rate > 0. ? stage._rate : graph.DefaultRate ();
+
+			auto it = std::find_if (_groups.begin (), _groups.end (),
+					[rate] (const unique_ptr <RateGroup>& g) {return g->_rate == rate;});
+			if (it == _groups.end ()){
+				_groups.emplace_back (new RateGroup (rate));
+				it = _groups.end () - 1;
+			}
+			(*it)->_stages.emplace_back (i, stage._subSteps, StagePhase (stage));
+		}
+		std::sort (_groups.begin (), _groups.end (),
+				[] (const unique_ptr <RateGroup>& a, const unique_ptr <RateGroup>& b) {return a->_rate > b->_rate;});
+		for (unsigned int i = 0; i < _groups.size (); ++i){
+			_groups [i]->_index = i;
+		}
+
+		// the rate running an asset's physics owns (publishes) its geometry
+		std::map <Geometry*, RateGroup*> writers;
+		for (auto &g : _groups){
+			for (auto &s : g->_stages){
+				for (auto &node : graph.Stage (s._index)._nodes){
+					for (auto &c : node._components){
+						if (c->Name () != "Physics"){
+							continue;
+						}
+						shared_ptr <Geometry> geometry = OwnerGeometry (*c);
+						if (!geometry){
+							continue;
+						}
+						auto w = writers.find (geometry.get ());
+						if (w != writers.end () && w->second != g.get ()){
+							LOG_ERROR ("Physics of one asset is scheduled at two rates (" << w->second->_rate << " Hz and " << g->_rate << " Hz)");
+							Cleanup ();
+							return false;
+						}
+						writers [geometry.get ()] = g.get ();
+						AddUnique (s._published, geometry);
+					}
+				}
+			}
+		}
+
+		// every other rate touching that asset reads a latched buffer
+		for (auto &g : _groups){
+			for (auto &s : g->_stages){
+				for (auto &node : graph.Stage (s._index)._nodes){
+					for (auto &c : node._components){
+						shared_ptr <Geometry> geometry = OwnerGeometry (*c);
+						if (!geometry){
+							continue;
+						}
+						auto w = writers.find (geometry.get ());
+						if (w != writers.end () && w->second != g.get () && AddUnique (g->_latched, geometry)){
+							g->_latchedPeriods.push_back (1./w->second->_rate);
+						}
+					}
+				}
+			}
+		}
+
+		/**
+		 * Pipelining rotates the ring exactly once per tick, so it needs single-step
+		 * stages and geometries that no other rate latches (a latch could make the
+		 * writer skip the buffer render is about to read).
+		 */
+		if (graph.Pipelined ()){
+			for (auto &g : _groups){
+				bool eligible = true;
+				for (auto &s : g->_stages){
+					if (s._subSteps > 1){
+						LOG_WARNING ("Rate " << g->_rate << " Hz has sub-stepped task " << graph.Stage (s._index)._index << ". Not pipelined");
+						eligible = false;
+					}
+					for (auto &p : s._published){
+						for (auto &other : _groups){
+							if (std::find (other->_latched.begin (), other->_latched.end (), p) != other->_latched.end ()){
+								LOG_WARNING ("Rate " << g->_rate << " Hz shares geometry with rate " << other->_rate << " Hz. Not pipelined");
+								eligible = false;
+							}
+						}
+					}
+				}
+				g->_pipelined = eligible;
+				for (auto &s : g->_stages){
+					for (auto &p : s._published){
+						p->SetPipelined (eligible);
+					}
+				}
+			}
+		}
+
+		// rates that render draw the geometry of other rates interpolated between their steps
+		for (auto &g : _groups){
+			if (!graph.Interpolate () || g->_pipelined || g->_latched.empty ()){
+				continue;
+			}
+			for (auto &s : g->_stages){
+				g->_interpolated = g->_interpolated || s._phase == SIM_PIPELINE_RENDER;
+			}
+			for (auto &l : g->_latched){
+				l->SetInterpolated (g->_interpolated);
+			}
+		}
+
+		TaskProfiler& profiler = _taskManager.Profiler ();
+		for (unsigned int i = 0; i < _groups.size () && profiler.Enabled (); ++i){
+			profiler.NameFrame (i, std::to_string (_groups [i]->_rate) + " Hz");
+		}
+
+		if (_taskManager.Quality ().Enabled ()){
+			GovernQuality ();
+		}
+
+		for (auto &g : _groups){
+			LOG ("Rate " << g->_rate << " Hz: " << g->_stages.size () << " stage(s), " << g->_latched.size ()
+					<< " latched geometries" << (g->_pipelined ? ", pipelined" : "") << (g->_interpolated ? ", interpolated" : ""));
+		}
+		return true;
+	}
+
+	void RateScheduler::Cleanup ()
+	{
+		_running.store (false);
+		for (auto &g : _groups){
+			if (g->_thread.joinable ()){
+				g->_thread.join ();
+			}
+			for (auto &l : g->_latched){
+				if (g->_interpolated){
+					l->SetInterpolated (false);
+				}
+			}
+		}
+		_taskManager.Quality ().Detach ();
+		_groups.clear ();
+	}
+
+	// sub-steps are given up after every component knob (priority 3)
+	void RateScheduler::GovernQuality ()
+	{
+		QualityGovernor& quality = _taskManager.Quality ();
+		const TaskGraph& graph = _taskManager.Graph ();
+		std::vector <QualityKnob*> knobs;
+		for (auto &g : _groups){
+			unsigned int rate = quality.AddRate (g->_rate);
+			for (auto &s : g->_stages){
+				const TaskStage& stage = graph.Stage (s._index);
+				if (s._subSteps > 1){
+					s._steps = std::make_shared <QualityKnob> ("SubSteps", 1, s._subSteps, 3);
+					quality.AddKnob (rate, s._index, "Task " + std::to_string (stage._index) + ".SubSteps", *s._steps);
+				}
+				for (auto &node : stage._nodes){
+					for (unsigned int i = 0; i < node._components.size (); ++i){
+						knobs.clear ();
+						node._components [i]->QualityKnobs (knobs);
+						for (auto k : knobs){
+							quality.AddKnob (rate, s._index, node._sites [i] + "." + k->Name (), *k);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void RateScheduler::Run (const std::function <bool ()>& proceed)
+	{
+		if (_groups.empty ()){
+			return;
+		}
+		_running.store (true);
+		if (_taskManager.Deterministic ()){
+			Lockstep (proceed);
+			_running.store (false);
+			return;
+		}
+		for (unsigned int i = 0; i + 1 < _groups.size (); ++i){
+			RateGroup& group = *_groups [i];
+			group._thread = std::thread ([this, &group] {Tick (group, std::function <bool ()> ());});
+		}
+
+		// the slowest rate (display) stays on the calling thread
+		Tick (*_groups.back (), proceed);
+
+		_running.store (false);
+		for (auto &g : _groups){
+			if (g->_thread.joinable ()){
+				g->_thread.join ();
+			}
+		}
+	}
+
+	void RateScheduler::Report () const
+	{
+		_taskManager.Quality ().Report ();
+		for (auto &g : _groups){
+			double mean = g->_ticks > 0 ? g->_totalTime / g->_ticks : 0.;
+			double jitter = g->_intervals > 0 ? std::sqrt (g->_jitter2/g->_intervals) : 0.;
+			LOG ("Rate " << g->_rate << " Hz: " << g->_ticks << " ticks, mean " << mean*1000. << " ms, 99th percentile "
+					<< Percentile (g->_samples, 99.)*1000. << " ms, max " << g->_maxTime*1000. << " ms, period " << 1000./g->_rate
+					<< " ms, jitter " << jitter*1000. << " ms rms (max " << g->_maxJitter*1000. << " ms), " << g->_overruns
+					<< " overruns, " << g->_dropped << " dropped ticks");
+		}
+	}
+
+	void RateScheduler::Tick (RateGroup& group, const std::function <bool ()>& proceed)
+	{
+		const Clock::duration period = duration_cast <Clock::duration> (duration <double> (1./group._rate));
+		const unsigned int maxCatchUp = _taskManager.Graph ().MaxCatchUp ();
+		Clock::duration accumulator = period; // the first tick runs right away
+		Clock::time_point previous = Clock::now ();
+
+		while (_running.load ()){
+			Clock::time_point now = Clock::now ();
+			accumulator += now - previous;
+			previous = now;
+
+			// one tick per period owed; late ones run back to back, but never more than 'maxCatchUp' of them
+			for (unsigned int steps = 0; accumulator >= period && steps <= maxCatchUp && _running.load (); ++steps){
+				Clock::time_point start = Clock::now ();
+				Pace (group, start);
+				Step (group);
+				if (proceed && !proceed ()){
+					_running.store (false);
+				}
+				Clock::time_point end = Clock::now ();
+
+				Record (group, start, end);
+				if (end - start > period){
+					++group._overruns;
+				}
+				accumulator -= period;
+			}
+			if (accumulator >= period){
+				group._dropped += accumulator / period;
+				accumulator %= period;
+			}
+
+			// sleep through the rest of the period
+			if (_running.load ()){
+				std::this_thread::sleep_for (period - accumulator);
+			}
+		}
+	}
+
+	// the faster rates catch up with the next tick of the slowest one, fastest first
+	void RateScheduler::Advance ()
+	{
+		if (_groups.empty ()){
+			return;
+		}
+		RateGroup& slowest = *_groups.back ();
+		unsigned long long tick = slowest._ticks + 1;
+		for (auto &g : _groups){
+			unsigned long long due = g.get () == &slowest ? tick :
+					static_cast <unsigned long long> (tick*g->_rate/slowest._rate);
+			while (g->_ticks < due){
+				Clock::time_point start = Clock::now ();
+				Step (*g);
+				Record (*g, start, Clock::now ());
+			}
+		}
+	}
+
+	void RateScheduler::Lockstep (const std::function <bool ()>& proceed)
+	{
+		RateGroup& slowest = *_groups.back ();
+		const Clock::duration period = duration_cast <Clock::duration> (duration <double> (1./slowest._rate));
+		Clock::time_point next = Clock::now ();
+
+		while (_running.load ()){
+			std::this_thread::sleep_until (next);
+
+			Pace (slowest, Clock::now ());
+			Advance ();
+			if (proceed && !proceed ()){
+				_running.store (false);
+			}
+
+			// paced by the slowest rate; a late tick delays the next one instead of being dropped
+			Clock::time_point end = Clock::now ();
+			next += period;
+			if (end > next){
+				++slowest._overruns;
+				next = end;
+			}
+		}
+	}
+
+	void RateScheduler::Step (RateGroup& group)
+	{
+		TaskProfiler& profiler = _taskManager.Profiler ();
+		if (profiler.Enabled ()){
+			profiler.BeginFrame ();
+		}
+		for (auto &g : group._latched){
+			g->LatchVertexBuffer ();
+		}
+		for (unsigned int i = 0; i < group._latched.size () && group._interpolated; ++i){
+			group._latched [i]->Interpolate (group._latchedPeriods [i]);
+		}
+		if (group._pipelined){
+			PipelinedStep (group);
+		} else {
+			QualityGovernor& quality = _taskManager.Quality ();
+			for (auto &s : group._stages){
+				Clock::time_point start = quality.Enabled () ? Clock::now () : Clock::time_point ();
+				unsigned int steps = s._steps ? static_cast <unsigned int> (s._steps->Level ()) : s._subSteps;
+				for (unsigned int i = 0; i < steps; ++i){
+					_taskManager.UpdateStage (s._index);
+					for (auto &g : s._published){
+						g->Update ();
+					}
+				}
+				if (quality.Enabled ()){
+					quality.StageTime (group._index, s._index, duration <double> (Clock::now () - start).count ());
+				}
+			}
+		}
+		for (auto &g : group._latched){
+			g->ReleaseVertexBuffer ();
+		}
+		if (profiler.Enabled ()){
+			profiler.EndFrame (group._index);
+		}
+	}
+
+	void RateScheduler::Record (RateGroup& group, Clock::time_point start, Clock::time_point end)
+	{
+		double elapsed = duration <double> (end - start).count ();
+		++group._ticks;
+		group._totalTime += elapsed;
+		group._maxTime = std::max (group._maxTime, elapsed);
+		if (group._samples.size () < SIM_RATE_SAMPLES){
+			group._samples.push_back (elapsed);
+		} else {
+			group._samples [group._nextSample] = elapsed;
+			group._nextSample = (group._nextSample + 1) % SIM_RATE_SAMPLES;
+		}
+		QualityGovernor& quality = _taskManager.Quality ();
+		if (quality.Enabled ()){
+			quality.Tick (group._index, elapsed);
+		}
+	}
+
+	void RateScheduler::Pace (RateGroup& group, Clock::time_point start)
+	{
+		if (group._lastStart != Clock::time_point ()){
+			double deviation = std::fabs (duration <double> (start - group._lastStart).count () - 1./group._rate);
+			++group._intervals;
+			group._jitter2 += deviation*deviation;
+			group._maxJitter = std::max (group._maxJitter, deviation);
+		}
+		group._lastStart = start;
+	}
+
+	void RateScheduler::PipelinedStep (RateGroup& group)
+	{
+		TaskGroup phases;
+		_taskManager.Run (phases, [this, &group] {RunPhase (group, SIM_PIPELINE_PHYSICS);});
+		_taskManager.Run (phases, [this, &group] {RunPhase (group, SIM_PIPELINE_COLLISION);});
+		// render stays on the calling thread since it holds the display context
+		RunPhase (group, SIM_PIPELINE_RENDER);
+		_taskManager.Wait (phases);
+
+		/**
+		 * Hand-off fence: all phases of this tick have finished (Wait () acquires the
+		 * physics writes), so the ring rotates. Frame k+1 becomes the collision input
+		 * and frame k the render input, while physics moves on to the buffer render
+		 * just released.
+		 */
+		for (auto &s : group._stages){
+			for (auto &g : s._published){
+				g->Update ();
+			}
+		}
+	}
+
+	void RateScheduler::RunPhase (RateGroup& group, unsigned int phase)
+	{
+		for (auto &s : group._stages){
+			if (s._phase == phase){
+				_taskManager.UpdateStage (s._index);
+			}
+		}
+	}
+}
@@ -0,0 +1,154 @@
+/**
+ * @file RateScheduler.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The multi-rate scheduler. Stages of the task graph are grouped by
+ * their rate (e.g. 1 kHz haptics, a few hundred Hz deformation, 60 Hz
+ * display) and every group is ticked on a fixed period by its own
+ * thread; each tick runs the group's stages for their fixed number of
+ * sub-steps through the task manager. The slowest group runs on the
+ * thread calling Run () since it holds the display context.
+ * With adaptive quality (see QualityGovernor.h) the tick and stage times
+ * of every rate feed the governor, and a sub-stepped stage runs as many
+ * sub-steps as its "SubSteps" knob allows.
+ * Every group keeps a fixed-timestep accumulator: the wall-clock time
+ * that has passed is added to it and one tick runs per period it holds.
+ * A group that falls behind runs at most 'MaxCatchUp' late ticks back
+ * to back and drops the rest (counted as dropped ticks); a tick longer
+ * than the period counts as an overrun. In between the thread sleeps
+ * for what is left of the period rather than spin.
+ * Rates exchange vertex state through the Geometry buffer ring: a group
+ * that runs an asset's Physics publishes its Geometry after every step,
+ * any other group touching that asset latches the published buffer for
+ * the duration of its tick. With 'Interpolate' set, a group running
+ * render stages draws such geometry blended between the last two
+ * physics states it has seen (see Geometry::Interpolate ()), one
+ * physics period behind.
+ * With 'Pipelined' set, a rate runs its physics, collision and render
+ * stages of one tick concurrently on consecutive frames of the ring
+ * (physics writes k+1, collision reads k, render reads k-1) and rotates
+ * the ring at a hand-off fence once all three have finished, so a tick
+ * costs as much as its slowest phase instead of the sum of all phases.
+ * In deterministic mode (see TaskManager.h) the rates do not run on
+ * their own clocks: every tick of the slowest rate runs, on the calling
+ * thread, the ticks the faster rates owe by then, so the interleaving of
+ * the rates is the same in every run. Late ticks are never dropped.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Sim {
+
+	class TaskManager;
+	class QualityKnob;
+
+	namespace Assets {
+		class Geometry;
+	}
+
+	class RateScheduler {
+
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+		protected:
+			class RateStage {
+				public:
+					unsigned int _index;
+					unsigned int _subSteps;
+					unsigned int _phase; // pipeline phase
+					std::vector <std::shared_ptr <Assets::Geometry> > _published; // written by the stage
+					std::shared_ptr <QualityKnob> _steps; // sub-steps run under adaptive quality (sub-stepped stages only)
+
+					RateStage (unsigned int index, unsigned int steps, unsigned int phase)
+					: _index (index), _subSteps (steps), _phase (phase) {}
+			};
+
+			class RateGroup {
+				public:
+					double _rate;
+					unsigned int _index; // in the scheduler's (decreasing) order of rates
+					bool _pipelined;
+					std::vector <RateStage> _stages;
+					bool _interpolated;
+					std::vector <std::shared_ptr <Assets::Geometry> > _latched; // written by other rates
+					std::vector <double> _latchedPeriods; // period (seconds) of the rate writing each latched geometry
+					std::thread _thread;
+
+					// statistics
+					unsigned long long _ticks;
+					unsigned long long _overruns; // ticks that took longer than the period
+					unsigned long long _dropped; // ticks skipped after exceeding the catch-up limit
+					double _totalTime; // seconds
+					double _maxTime; // seconds
+					std::vector <double> _samples; // the latest tick times (seconds), for percentiles
+					unsigned int _nextSample;
+					Clock::time_point _lastStart; // of the previous paced tick
+					unsigned long long _intervals; // paced intervals measured for the jitter
+					double _jitter2; // sum of the squared deviations of tick intervals from the period
+					double _maxJitter; // seconds
+
+					explicit RateGroup (double rate)
+					: _rate (rate), _index (0), _pipelined (false), _interpolated (false), _ticks (0), _overruns (0), _dropped (0), _totalTime (0.),
+						_maxTime (0.), _nextSample (0), _intervals (0), _jitter2 (0.), _maxJitter (0.) {}
+			};
+
+			TaskManager& _taskManager;
+			std::vector <std::unique_ptr <RateGroup> > _groups; // sorted by decreasing rate
+			std::atomic <bool> _running;
+
+		private: // forbidden copy constructor and assignment operator
+			RateScheduler (const RateScheduler&) = delete;
+			RateScheduler& operator = (const RateScheduler&) = delete;
+
+		public:
+			explicit RateScheduler (TaskManager& manager);
+			~RateScheduler ();
+
+			bool Initialize ();
+			void Cleanup ();
+
+			unsigned int RateCount () const {return static_cast <unsigned int> (_groups.size ());}
+			// the rate (Hz) whose ticks are the frames (0: no rates)
+			double SlowestRate () const {return _groups.empty () ? 0. : _groups.back ()->_rate;}
+
+			/**
+			 * Start the faster rates on their own threads and tick the slowest rate on
+			 * the calling thread until 'proceed' returns false (it is called once per
+			 * tick of the slowest rate) or Stop () is called.
+			 */
+			void Run (const std::function <bool ()>& proceed);
+			void Stop () {_running.store (false);}
+			/**
+			 * Run the next tick of the slowest rate, and the ticks the faster rates owe
+			 * by then, on the calling thread and without pacing, as deterministic mode
+			 * does (e.g. for batch runs as fast as possible).
+			 */
+			void Advance ();
+
+			// log the per-rate tick time (mean, 99th percentile, max), jitter and overrun statistics
+			void Report () const;
+
+		protected:
+			void Tick (RateGroup& group, const std::function <bool ()>& proceed);
+			void Lockstep (const std::function <bool ()>& proceed);
+			void Step (RateGroup& group);
+			// account a tick that ran from 'start' to 'end'
+			void Record (RateGroup& group, Clock::time_point start, Clock::time_point end);
+			// account the interval between paced ticks against the period
+			void Pace (RateGroup& group, Clock::time_point start);
+			// the knobs of the components (and sub-stepped stages) of every rate, for the governor
+			void GovernQuality ();
+			void PipelinedStep (RateGroup& group);
+			void RunPhase (RateGroup& group, unsigned int phase);
+	};
+}
@@ -0,0 +1,61 @@
+/**
+ * @file SerialTaskManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Task manager that runs the task graph on the calling thread only, with
+ * the default (serial) primitives of the base class. A batch run gives
+ * one to each of its simulation instances so that an instance keeps to
+ * the core it was scheduled on and the instances, rather than the tasks
+ * of one frame, are spread over the cores (see BatchRunner.h). It reads
+ * the task graph from the scheduler configuration of the driver's task
+ * manager and ignores the worker, profiler and grain settings in there.
+ */
+#pragma once
+
+#include <string>
+
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Tasks/TaskManager.h"
+
+namespace Sim {
+
+	class SerialTaskManager : public TaskManager {
+
+		public:
+			// 'root': the root element of the scheduler configuration (e.g. "ThreadsConfig")
+			explicit SerialTaskManager (const std::string& root) {_configRoot = root;}
+			virtual ~SerialTaskManager () {Cleanup ();}
+
+			// forbidden copy constructor and assignment operator
+			SerialTaskManager (const SerialTaskManager&) = delete;
+			SerialTaskManager& operator = (const SerialTaskManager&) = delete;
+
+			virtual bool Initialize (const char* configfile) override
+			{
+				InputParser parser;
+				if (!parser.Initialize (configfile, _configRoot.c_str ())){
+					LOG_ERROR ("Could not initialize parser for " << configfile);
+					return false;
+				}
+				_configFile = configfile;
+				if (!InitializeGraph (parser)){
+					LOG_ERROR ("Could not initialize task graph from " << configfile);
+					Cleanup ();
+					return false;
+				}
+				return true;
+			}
+
+		protected:
+			// no profiling and no grain tuning: nothing runs in parallel, and the profiler files are the driver's
+			virtual bool InitializeGraph (InputParser& parser) override
+			{
+				return _graph.Initialize (parser) && ReadDeterminism (parser);
+			}
+	};
+}
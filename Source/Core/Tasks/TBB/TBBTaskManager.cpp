@@ -8,11 +8,110 @@
  * See TBBTaskManager.h.
  */
 
-#include "Preprocess.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "Tasks/TBB/TBBTaskManager.h"
 
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task.h"
+#include "tbb/task_group.h"
+#include "tbb/task_scheduler_init.h"
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Driver.h"
+#include "Assets/Asset.h"
+#include "Assets/Component.h"
+#include "Assets/Geometry.h"
+
+using std::make_unique;
+using std::shared_ptr;
+using std::vector;
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+using Sim::Assets::Geometry;
+
 namespace Sim {
 
+	/**
+	 * Arenas the calling thread has entered, innermost last, together with the
+	 * affinity mask to restore when it leaves them.
+	 */
+	class ArenaEntry {
+		public:
+			tbb::task_arena* _arena;
+			bool _pinned;
+			vector <unsigned int> _cpus;
+
+			ArenaEntry (): _arena (nullptr), _pinned (false) {}
+	};
+	static thread_local vector <ArenaEntry> t_arenas;
+
+	static inline tbb::priority_t TbbPriority (TaskPriority priority)
+	{
+		return priority == PRIORITY_HIGH ? tbb::priority_high : (priority == PRIORITY_LOW ? tbb::priority_low : tbb::priority_normal);
+	}
+
+	/**
+	 * A task of a TaskGroup. Both the worker that dequeues it and the waiting
+	 * thread may try to run it; whoever claims it first does.
+	 */
+	class GroupJob {
+		public:
+			TaskManager::Task _task;
+			TaskPriority _priority;
+			std::atomic <bool> _claimed;
+
+			GroupJob (const TaskManager::Task& task, TaskPriority priority): _task (task), _priority (priority), _claimed (false) {}
+	};
+
+	// jobs of a group not yet handed to its waiter
+	class GroupJobs {
+		public:
+			std::mutex _mutex;
+			vector <shared_ptr <GroupJob>> _jobs;
+	};
+
+	static void RunJob (TaskGroup& group, GroupJob& job)
+	{
+		if (job._claimed.exchange (true, std::memory_order_acq_rel)){
+			return;
+		}
+		{
+			PriorityScope scope (job._priority);
+			job._task ();
+		}
+		group._pending.fetch_sub (1, std::memory_order_release);
+	}
+
+	void TBBTaskManager::ArenaObserver::on_scheduler_entry (bool worker)
+	{
+		ArenaEntry entry;
+		entry._arena = &_arena;
+		if (!_cpus.empty () && Affinity::GetThreadAffinity (entry._cpus)){
+			entry._pinned = Affinity::SetThreadAffinity (_cpus);
+		}
+		t_arenas.push_back (std::move (entry));
+	}
+
+	void TBBTaskManager::ArenaObserver::on_scheduler_exit (bool worker)
+	{
+		if (t_arenas.empty ()){
+			return;
+		}
+		if (t_arenas.back ()._pinned){
+			Affinity::SetThreadAffinity (t_arenas.back ()._cpus);
+		}
+		t_arenas.pop_back ();
+	}
+
 	TBBTaskManager::TBBTaskManager ()
 	{
 		LOG ("TBB task manager constructed");
@@ -24,17 +123,341 @@ namespace Sim {
 		LOG ("TBB task manager destroyed");
 	}
 
-	TBBTaskManager::TBBTaskManager (const TBBTaskManager& tm) {}
-
-	TBBTaskManager& TBBTaskManager::operator = (const TBBTaskManager& tm) {return *this;}
-
 	bool TBBTaskManager::Initialize (const char* configfile)
 	{
+		InputParser parser;
+		if (!parser.Initialize (configfile, "TBBConfig")){
+			LOG_ERROR ("Could not initialize parser for " << configfile);
+			return false;
+		}
+		_configFile = configfile;
+		_configRoot = "TBBConfig";
+
+		// a worker count of 0 lets TBB use every hardware thread
+		unsigned int count = 0;
+		XMLElement* element = parser.GetElement ("Workers");
+		if (element != nullptr){
+			element->QueryUnsignedAttribute ("Count", &count);
+		}
+		if (count == 0){
+			count = static_cast <unsigned int> (tbb::task_scheduler_init::default_num_threads ());
+		}
+
+		// reserved workers come out of the default arena, which keeps at least one thread
+		vector <unsigned int> reserved;
+		if (!ReadReservedWorkers (parser, reserved)){
+			LOG_ERROR ("Could not read priority classes");
+			return false;
+		}
+		for (unsigned int p = 0; p < PRIORITY_COUNT; ++p){
+			if (reserved [p] == 0){
+				continue;
+			}
+			if (reserved [p] > count - 1){
+				LOG_WARNING ("Only " << count - 1 << " of " << reserved [p] << " worker(s) could be reserved for "
+						<< (p == PRIORITY_HIGH ? "high" : "normal") << " priority tasks");
+				reserved [p] = count - 1;
+				if (reserved [p] == 0){
+					continue;
+				}
+			}
+			count -= reserved [p];
+			// one more slot for the thread that runs the stage
+			_classArenas [p] = MakeArena (static_cast <int> (reserved [p]) + 1, vector <unsigned int> (), 1);
+		}
+
+		_arena = make_unique <tbb::task_arena> (static_cast <int> (count));
+		_arena->initialize ();
+		_observer = make_unique <ArenaObserver> (*_arena, vector <unsigned int> ());
+
+		if (!InitializeGraph (parser)){
+			LOG_ERROR ("Could not initialize task graph from " << configfile);
+			Cleanup ();
+			return false;
+		}
+		LOG ("TBB task manager initialized with " << ThreadCount () << " threads");
 		return true;
 	}
 
+	void TBBTaskManager::Update ()
+	{
+		_arena->execute ([this] {TaskManager::Update ();});
+	}
+
 	void TBBTaskManager::Cleanup ()
 	{
+		_placedAssets.clear ();
+		_assetNodes.clear ();
+		_nodeArenas.clear ();
+		_stageArenas.clear ();
+		_arenas.clear ();
+		_affinity.Cleanup ();
+		for (unsigned int p = 0; p < PRIORITY_COUNT; ++p){
+			_classArenas [p].reset ();
+		}
+		_observer.reset ();
+		_arena.reset ();
+		TaskManager::Cleanup ();
+	}
 
+	unsigned int TBBTaskManager::ThreadCount () const
+	{
+		return _arena ? static_cast <unsigned int> (_arena->max_concurrency ()) : 1;
+	}
+
+	void TBBTaskManager::Run (TaskGroup& group, const Task& task)
+	{
+		if (!group._native){
+			group._native = std::make_shared <GroupJobs> ();
+		}
+		GroupJobs& jobs = *std::static_pointer_cast <GroupJobs> (group._native);
+		TaskPriority priority = CurrentPriority ();
+		shared_ptr <GroupJob> job = std::make_shared <GroupJob> (task, priority);
+		{
+			std::lock_guard <std::mutex> lock (jobs._mutex);
+			jobs._jobs.push_back (job);
+		}
+		group._pending.fetch_add (1, std::memory_order_relaxed);
+		CurrentArena ().enqueue ([&group, job] {RunJob (group, *job);}, TbbPriority (priority));
+	}
+
+	/**
+	 * The caller runs what the arena workers have not picked up yet through a
+	 * task group of its own, then waits for those already running elsewhere.
+	 * Spawning and waiting within a single execute () keeps the caller's task
+	 * pool empty whenever it leaves the arena.
+	 */
+	void TBBTaskManager::Wait (TaskGroup& group)
+	{
+		if (group._native){
+			GroupJobs& jobs = *std::static_pointer_cast <GroupJobs> (group._native);
+			vector <shared_ptr <GroupJob>> open;
+			{
+				std::lock_guard <std::mutex> lock (jobs._mutex);
+				open.swap (jobs._jobs);
+			}
+			CurrentArena ().execute ([&group, &open] {
+				tbb::task_group helpers;
+				for (auto &j : open){
+					GroupJob* job = j.get ();
+					helpers.run ([&group, job] {RunJob (group, *job);});
+				}
+				helpers.wait ();
+			});
+		}
+		while (!group.Done ()){
+			std::this_thread::yield ();
+		}
+	}
+
+	void TBBTaskManager::ParallelFor (unsigned int begin, unsigned int end, unsigned int grain, const RangeTask& task)
+	{
+		if (begin >= end){
+			return;
+		}
+		if (grain == 0){
+			grain = DefaultGrain (end - begin);
+		}
+		TaskPriority priority = CurrentPriority ();
+		CurrentArena ().execute ([&] {
+			tbb::task_group_context context;
+			context.set_priority (TbbPriority (priority));
+			auto body = [&task, priority] (const tbb::blocked_range <unsigned int>& r) {
+				PriorityScope scope (priority);
+				task (r.begin (), r.end ());
+			};
+			// the simple partitioner splits down to the grain whatever the thread count
+			if (_deterministic){
+				tbb::parallel_for (tbb::blocked_range <unsigned int> (begin, end, grain), body, tbb::simple_partitioner (), context);
+			} else {
+				tbb::parallel_for (tbb::blocked_range <unsigned int> (begin, end, grain), body, context);
+			}
+		});
+	}
+
+	void TBBTaskManager::DispatchStage (const TaskStage& stage)
+	{
+		// stage pinned to a core set
+		unsigned int index = StagePosition (stage);
+		if (index < _stageArenas.size () && _stageArenas [index] >= 0){
+			_arenas [_stageArenas [index]]->_arena->execute ([this, &stage] {TaskManager::DispatchStage (stage);});
+			return;
+		}
+		// stage of a class with reserved workers
+		Arena* reserved = _classArenas [stage._priority].get ();
+		if (reserved != nullptr){
+			if (&CurrentArena () != reserved->_arena.get ()){
+				reserved->_arena->execute ([this, &stage] {TaskManager::DispatchStage (stage);});
+			} else {
+				TaskManager::DispatchStage (stage);
+			}
+			return;
+		}
+		if (_nodeArenas.empty () || !stage._parallel){
+			TaskManager::DispatchStage (stage);
+			return;
+		}
+
+		// every node runs in the arena of the NUMA node its asset is bound to
+		std::map <int, vector <unsigned int>> placed;
+		for (unsigned int i = 0; i < stage._nodes.size (); ++i){
+			placed [NodeArena (stage._nodes [i])].push_back (i);
+		}
+		CurrentArena ().execute ([this, &stage, &placed] {
+			tbb::task_group arenas;
+			for (auto &p : placed){
+				tbb::task_arena* arena = _arenas [p.first]->_arena.get ();
+				const vector <unsigned int>* nodes = &p.second;
+				arenas.run ([this, &stage, arena, nodes] {
+					arena->execute ([this, &stage, nodes] {
+						tbb::task_group group;
+						for (unsigned int i : *nodes){
+							group.run ([this, &stage, i] {
+								PriorityScope scope (stage._priority);
+								RunNode (stage, i);
+							});
+						}
+						group.wait ();
+					});
+				});
+			}
+			arenas.wait ();
+		});
+	}
+
+	// the pinned and NUMA arenas follow the stages and assets of the graph
+	bool TBBTaskManager::InitializeGraph (InputParser& parser)
+	{
+		_assetNodes.clear ();
+		_nodeArenas.clear ();
+		_stageArenas.clear ();
+		_arenas.clear ();
+		if (!TaskManager::InitializeGraph (parser)){
+			return false;
+		}
+		if (!InitializeAffinity (parser)){
+			LOG_ERROR ("Could not initialize affinity settings");
+			return false;
+		}
+		return true;
+	}
+
+	bool TBBTaskManager::InitializeAffinity (InputParser& parser)
+	{
+		_stageArenas.assign (_graph.StageCount (), -1);
+
+		bool enabled = false;
+		bool numa = false;
+		XMLElement* element = parser.FindElement ("Affinity");
+		if (element != nullptr){
+			element->QueryBoolAttribute ("Enabled", &enabled);
+			element->QueryBoolAttribute ("NumaArenas", &numa);
+		}
+		if (!enabled){
+			return true;
+		}
+		if (!_affinity.Initialize ()){
+			LOG_ERROR ("Could not read processor topology");
+			return false;
+		}
+
+		// stages pinned to the same core set share an arena (the caller joins it)
+		std::map <vector <unsigned int>, int> coreArenas;
+		for (unsigned int i = 0; i < _graph.StageCount (); ++i){
+			const vector <unsigned int>& cores = _graph.Stage (i)._cores;
+			if (cores.empty ()){
+				continue;
+			}
+			auto it = coreArenas.find (cores);
+			if (it == coreArenas.end ()){
+				it = coreArenas.insert (std::make_pair (cores, AddArena (cores, 1))).first;
+			}
+			_stageArenas [i] = it->second;
+		}
+		if (!numa){
+			LOG ("Affinity enabled with " << _arenas.size () << " pinned stage arena(s)");
+			return true;
+		}
+
+		// one arena per NUMA node, fed by enqueued tasks only
+		for (auto &node : _affinity.Nodes ()){
+			_nodeArenas.push_back (AddArena (node._cpus, 0));
+		}
+
+		// explicit asset bindings
+		for (XMLElement* a = element->FirstChildElement ("Asset"); a != nullptr; a = a->NextSiblingElement ("Asset")){
+			const char* name = a->Attribute ("Name");
+			unsigned int node = 0;
+			if (name == nullptr || a->QueryUnsignedAttribute ("Node", &node) != XML_SUCCESS || node >= _affinity.NodeCount ()){
+				LOG_ERROR ("Invalid asset binding in affinity settings");
+				return false;
+			}
+			shared_ptr <Asset> asset = _graph.Assets () != nullptr ? _graph.Assets ()->GetAsset (name) : Driver::Instance ().GetAsset (name);
+			if (!asset){
+				LOG_WARNING ("Asset \'" << name << "\' is not loaded. Skipping its NUMA binding");
+				continue;
+			}
+			_assetNodes [asset.get ()] = node;
+		}
+
+		// all other assets of the task graph are spread round-robin over the nodes
+		unsigned int next = 0;
+		for (auto &stage : _graph.Stages ()){
+			for (auto &node : stage._nodes){
+				for (auto &c : node._components){
+					Asset* owner = c->Owner ();
+					if (owner != nullptr && _assetNodes.find (owner) == _assetNodes.end ()){
+						_assetNodes [owner] = next++ % _affinity.NodeCount ();
+					}
+				}
+			}
+		}
+
+		// move every asset's geometry to the memory of its node
+		unsigned int gid = SIM_COMPONENT_ID ("Geometry");
+		for (auto &an : _assetNodes){
+			auto placed = _placedAssets.find (an.first);
+			if (!an.first->HasComponent (gid) || (placed != _placedAssets.end () && placed->second == an.second)){
+				continue;
+			}
+			_placedAssets [an.first] = an.second;
+			shared_ptr <Geometry> geometry = an.first->GetComponent <Geometry> (gid);
+			Affinity::RunOn (_affinity.Node (an.second)._cpus, [&geometry] {geometry->Relocate ();});
+		}
+
+		LOG ("Affinity enabled with " << _nodeArenas.size () << " NUMA arena(s) for " << _assetNodes.size () << " asset(s)");
+		return true;
+	}
+
+	int TBBTaskManager::AddArena (const vector <unsigned int>& cpus, unsigned int reserved)
+	{
+		_arenas.push_back (MakeArena (static_cast <int> (cpus.size ()), cpus, reserved));
+		return static_cast <int> (_arenas.size ()) - 1;
+	}
+
+	std::unique_ptr <TBBTaskManager::Arena> TBBTaskManager::MakeArena (int concurrency, const vector <unsigned int>& cpus,
+			unsigned int reserved)
+	{
+		std::unique_ptr <Arena> arena (new Arena);
+		arena->_arena = make_unique <tbb::task_arena> (concurrency, reserved);
+		arena->_arena->initialize ();
+		arena->_observer = make_unique <ArenaObserver> (*arena->_arena, cpus);
+		return arena;
+	}
+
+	int TBBTaskManager::NodeArena (const TaskNode& node) const
+	{
+		if (!node._components.empty ()){
+			auto it = _assetNodes.find (node._components.front ()->Owner ());
+			if (it != _assetNodes.end ()){
+				return _nodeArenas [it->second];
+			}
+		}
+		return _nodeArenas.front ();
+	}
+
+	tbb::task_arena& TBBTaskManager::CurrentArena () const
+	{
+		return t_arenas.empty () ? *_arena : *t_arenas.back ()._arena;
 	}
 }
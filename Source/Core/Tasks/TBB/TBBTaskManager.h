@@ -5,25 +5,104 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * The Intel TBB based task manager.
+ * The Intel TBB based task manager. All work runs inside one task arena
+ * sized by the <Workers> entry of the configuration file, so the frame
+ * graph can be compared against the other backends at equal thread
+ * counts.
+ * The <Affinity> entry adds pinned arenas: a stage with a 'Cores' set
+ * runs in an arena whose threads are pinned to those processors and,
+ * with 'NumaArenas' set, every NUMA node gets an arena pinned to its
+ * processors. Each asset is then bound to one node (explicitly through
+ * <Asset Name Node> or round-robin), its tasks of parallel stages run
+ * in that node's arena and its geometry is re-allocated on that node.
+ * Tasks are enqueued with the TBB priority of their class, so workers
+ * move to the most urgent work at task boundaries. A class given
+ * reserved workers by <Priorities> gets an arena of its own (the default
+ * arena shrinks by as many threads) in which its stages run, out of
+ * reach of the background work queued in the other arenas.
  */
 #pragma once
 
+#include <map>
+#include <memory>
+#include <vector>
+
+#ifndef TBB_PREVIEW_LOCAL_OBSERVER
+#	define TBB_PREVIEW_LOCAL_OBSERVER 1
+#endif
+#include "tbb/task_arena.h"
+#include "tbb/task_scheduler_observer.h"
+
+#include "Tasks/Affinity.h"
 #include "Tasks/TaskManager.h"
 
 namespace Sim {
 
+	class Asset;
+
 	class TBBTaskManager : public TaskManager {
 
-		private: // forbidden copy constructor and assignment operator
-			TBBTaskManager (const TBBTaskManager&);
-			TBBTaskManager& operator = (const TBBTaskManager&);
+		protected:
+			// pins threads entering an arena (and tracks the arena each thread is in)
+			class ArenaObserver : public tbb::task_scheduler_observer {
+				protected:
+					tbb::task_arena& _arena;
+					std::vector <unsigned int> _cpus; // empty: not pinned
+
+				public:
+					ArenaObserver (tbb::task_arena& arena, const std::vector <unsigned int>& cpus)
+					: tbb::task_scheduler_observer (arena), _arena (arena), _cpus (cpus) {observe (true);}
+					virtual ~ArenaObserver () {observe (false);}
+
+					virtual void on_scheduler_entry (bool worker) override;
+					virtual void on_scheduler_exit (bool worker) override;
+			};
+
+			class Arena {
+				public:
+					std::unique_ptr <tbb::task_arena> _arena;
+					std::unique_ptr <ArenaObserver> _observer; // destroyed before the arena
+			};
+
+			std::unique_ptr <tbb::task_arena> _arena;
+			std::unique_ptr <ArenaObserver> _observer;
+			std::unique_ptr <Arena> _classArenas [PRIORITY_COUNT]; // reserved per priority class (null: shared)
+
+			Affinity _affinity;
+			std::vector <std::unique_ptr <Arena> > _arenas;
+			std::vector <int> _stageArenas; // per graph stage (-1: default arena)
+			std::vector <int> _nodeArenas; // per NUMA node
+			std::map <Asset*, unsigned int> _assetNodes;
+			std::map <Asset*, unsigned int> _placedAssets; // NUMA node each geometry was moved to
 
 		public:
 			TBBTaskManager ();
 			~TBBTaskManager ();
 
+			// forbidden copy constructor and assignment operator
+			TBBTaskManager (const TBBTaskManager&) = delete;
+			TBBTaskManager& operator = (const TBBTaskManager&) = delete;
+
 			virtual bool Initialize (const char* config) override;
+			virtual void Update () override;
 			virtual void Cleanup () override;
+
+			virtual unsigned int ThreadCount () const override;
+
+			virtual void Run (TaskGroup& group, const Task& task) override;
+			virtual void Wait (TaskGroup& group) override;
+			virtual void ParallelFor (unsigned int begin, unsigned int end, unsigned int grain, const RangeTask& task) override;
+
+		protected:
+			virtual void DispatchStage (const TaskStage& stage) override;
+			virtual bool InitializeGraph (InputParser& parser) override;
+
+			bool InitializeAffinity (InputParser& parser);
+			int AddArena (const std::vector <unsigned int>& cpus, unsigned int reserved);
+			std::unique_ptr <Arena> MakeArena (int concurrency, const std::vector <unsigned int>& cpus, unsigned int reserved);
+			int NodeArena (const TaskNode& node) const;
+
+			// the arena the calling thread is in (the default arena outside all of them)
+			tbb::task_arena& CurrentArena () const;
 	};
 }
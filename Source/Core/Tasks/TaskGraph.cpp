@@ -0,0 +1,257 @@
+/**
+ * @file TaskGraph.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskGraph.h.
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Driver.h"
+#include "Assets/Asset.h"
+#include "Assets/Component.h"
+#include "Assets/ComponentSystem.h"
+#include "Tasks/Affinity.h"
+#include "Tasks/TaskGraph.h"
+
+using std::shared_ptr;
+using std::string;
+using tinyxml2::XMLElement;
+using tinyxml2::XMLError;
+using tinyxml2::XML_SUCCESS;
+using Sim::Assets::Component;
+using Sim::Assets::ComponentSystem;
+
+namespace Sim {
+
+	bool TaskGraph::Initialize (InputParser& parser)
+	{
+		XMLElement* rates = parser.FindElement ("Rates");
+		if (rates != nullptr){
+			rates->QueryDoubleAttribute ("Default", &_defaultRate);
+			rates->QueryUnsignedAttribute ("MaxCatchUp", &_maxCatchUp);
+			rates->QueryBoolAttribute ("Pipelined", &_pipelined);
+			rates->QueryBoolAttribute ("Interpolate", &_interpolate);
+		}
+		if (_defaultRate <= 0.){
+			LOG_ERROR ("Invalid default task rate " << _defaultRate << " in " << parser.DocName ());
+			return false;
+		}
+
+		XMLElement* tlist = parser.GetElement ("Task");
+		if (tlist == nullptr){
+			LOG_ERROR ("No tasks specified in " << parser.DocName ());
+			return false;
+		}
+
+		while (tlist != nullptr){
+			TaskStage stage;
+			if (!InitializeStage (*tlist, stage)){
+				LOG_ERROR ("Could not initialize task no. " << _stages.size () << " in " << parser.DocName ());
+				Cleanup ();
+				return false;
+			}
+			// a stage none of whose assets exist in the scene is dropped
+			if (!stage._nodes.empty ()){
+				_stages.push_back (std::move (stage));
+			}
+			tlist = tlist->NextSiblingElement ("Task");
+		}
+
+		std::stable_sort (_stages.begin (), _stages.end (),
+				[] (const TaskStage& a, const TaskStage& b) {return a._index < b._index;});
+
+		LOG ("Task graph initialized with " << _stages.size () << " stages");
+		return true;
+	}
+
+	bool TaskGraph::ParsePriority (const char* name, TaskPriority& priority)
+	{
+		if (!strcmp (name, "High")){
+			priority = PRIORITY_HIGH;
+		}
+		else if (!strcmp (name, "Normal")){
+			priority = PRIORITY_NORMAL;
+		}
+		else if (!strcmp (name, "Low")){
+			priority = PRIORITY_LOW;
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	bool TaskGraph::InitializeStage (XMLElement& elem, TaskStage& stage)
+	{
+		XMLError error = XML_SUCCESS;
+		if ((error = elem.QueryUnsignedAttribute ("Index", &stage._index)) != XML_SUCCESS){
+			LOG_ERROR ("No \'Index\' specified for task");
+			return false;
+		}
+		const char* type = elem.Attribute ("Type");
+		if (type == nullptr){
+			LOG_ERROR ("No \'Type\' specified for task " << stage._index);
+			return false;
+		}
+		stage._parallel = !strcmp (type, "Parallel");
+
+		// optional: stages without a rate run at the default rate
+		elem.QueryDoubleAttribute ("Rate", &stage._rate);
+		elem.QueryUnsignedAttribute ("SubSteps", &stage._subSteps);
+		if (stage._rate < 0. || stage._subSteps == 0){
+			LOG_ERROR ("Invalid rate or sub-step count for task " << stage._index);
+			return false;
+		}
+		const char* cores = elem.Attribute ("Cores");
+		if (cores != nullptr && !Affinity::ParseCpuList (cores, stage._cores)){
+			LOG_ERROR ("Invalid core set for task " << stage._index);
+			return false;
+		}
+		const char* priority = elem.Attribute ("Priority");
+		if (priority != nullptr && !ParsePriority (priority, stage._priority)){
+			LOG_ERROR ("Invalid priority '" << priority << "' for task " << stage._index);
+			return false;
+		}
+
+		// serial stage: all assets (and systems) share the stage's component and form one chain
+		if (!stage._parallel){
+			const char* component = elem.Attribute ("Component");
+			TaskNode node;
+			for (XMLElement* a = elem.FirstChildElement (); a != nullptr; a = a->NextSiblingElement ()){
+				const char* c = a->Attribute ("Component");
+				if (!strcmp (a->Value (), "Asset")){
+					if (!AddComponent (a->Attribute ("Name"), c != nullptr ? c : component, a->BoolAttribute ("Split"), node)){
+						return false;
+					}
+				}
+				else if (!strcmp (a->Value (), "System") && !AddSystem (c != nullptr ? c : component, node)){
+					return false;
+				}
+			}
+			if (!node._components.empty ()){
+				stage._nodes.push_back (std::move (node));
+			}
+			return true;
+		}
+
+		// parallel stage: every asset is a node and every sub-task is a serial chain
+		for (XMLElement* a = elem.FirstChildElement (); a != nullptr; a = a->NextSiblingElement ()){
+			TaskNode node;
+			if (!strcmp (a->Value (), "Asset")){
+				if (!AddComponent (a->Attribute ("Name"), a->Attribute ("Component"), a->BoolAttribute ("Split"), node)){
+					return false;
+				}
+			}
+			else if (!strcmp (a->Value (), "System")){
+				if (!AddSystem (a->Attribute ("Component"), node)){
+					return false;
+				}
+			}
+			else if (!strcmp (a->Value (), "SubTask")){
+				const char* component = a->Attribute ("Component");
+				for (XMLElement* s = a->FirstChildElement ("Asset"); s != nullptr; s = s->NextSiblingElement ("Asset")){
+					if (!AddComponent (s->Attribute ("Name"), component, s->BoolAttribute ("Split"), node)){
+						return false;
+					}
+				}
+			}
+			if (!node._components.empty ()){
+				stage._nodes.push_back (std::move (node));
+			}
+		}
+		return true;
+	}
+
+	// the 'Plugin' attribute is informative only: components are already bound to their plugin
+	bool TaskGraph::AddComponent (const char* asset, const char* component, bool split, TaskNode& node)
+	{
+		if (asset == nullptr || component == nullptr){
+			LOG_ERROR ("Task entry without asset name or component type");
+			return false;
+		}
+		shared_ptr <Asset> a = _assets != nullptr ? _assets->GetAsset (asset) : Driver::Instance ().GetAsset (asset);
+		if (!a){
+			LOG_WARNING ("Asset \'" << asset << "\' is not loaded. Skipping its " << component << " task");
+			return true;
+		}
+		if (!a->Loaded ()){
+			LOG ("Asset \'" << asset << "\' is still loading. Its " << component << " task joins once it is loaded");
+			return true;
+		}
+		// a lazy component that a task runs loads now
+		unsigned int cid = AssetFactory::ComponentId (component);
+		shared_ptr <Component> c = a->GetComponent <Component> (cid);
+		if (!c){
+			LOG_WARNING ("Asset \'" << asset << "\' has no " << component << " component. Skipping task");
+			return true;
+		}
+		unsigned int subsets = 0;
+		if (split){
+			subsets = c->SubsetCount ();
+			if (subsets == 0){
+				LOG_WARNING ("The " << component << " component of '" << asset << "' cannot be split. Running it whole");
+			}
+		}
+		node._components.push_back (c);
+		node._subsets.push_back (subsets);
+		node._sites.push_back (string (asset) + "." + component);
+		if (!node._label.empty ()){
+			node._label += ">";
+		}
+		node._label += string (asset) + "." + component;
+		if (subsets > 0){
+			node._label += "/" + std::to_string (subsets);
+		}
+
+		// the geometry of a split physics update refreshes its bounds and normals the same way
+		unsigned int gid = SIM_COMPONENT_ID ("Geometry");
+		if (subsets > 0 && !strcmp (component, "Physics") && a->HasComponent (gid)){
+			shared_ptr <Component> g = a->GetComponent <Component> (gid);
+			if (g->SubsetCount () > 0){
+				node._components.push_back (g);
+				node._subsets.push_back (g->SubsetCount ());
+				node._sites.push_back (string (asset) + ".Geometry");
+				node._label += ">" + string (asset) + ".Geometry/" + std::to_string (g->SubsetCount ());
+			}
+		}
+		return true;
+	}
+
+	bool TaskGraph::AddSystem (const char* component, TaskNode& node)
+	{
+		if (component == nullptr){
+			LOG_ERROR ("System task entry without component type");
+			return false;
+		}
+		AssetFactory& assets = _assets != nullptr ? *_assets : Driver::Instance ().GetAssetFactory ();
+		if (assets.Loading ()){
+			LOG ("Assets are still loading. The " << component << " system joins once they are loaded");
+			return true;
+		}
+		shared_ptr <ComponentSystem> system = assets.GetSystem (AssetFactory::ComponentId (component));
+		if (!system || system->Count () == 0){
+			LOG_WARNING ("No asset stores its " << component << " component in a system. Skipping task");
+			return true;
+		}
+		unsigned int blocks = system->SubsetCount ();
+		node._components.push_back (system);
+		node._subsets.push_back (blocks);
+		node._sites.push_back (string ("System.") + component);
+		if (!node._label.empty ()){
+			node._label += ">";
+		}
+		node._label += string ("System.") + component + "/" + std::to_string (system->Count ());
+		return true;
+	}
+}
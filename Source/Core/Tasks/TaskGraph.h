@@ -0,0 +1,121 @@
+/**
+ * @file TaskGraph.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The per-frame task graph run by the task managers. The graph is read
+ * from the <Task> entries of the scheduler configuration file (see
+ * TBBConfig.xml) and is identical for every scheduler backend. A frame
+ * is a sequence of stages ordered by their 'Index'. A 'Parallel' stage
+ * runs its nodes concurrently, a 'Serial' stage runs them one after the
+ * other. Each node is a chain of asset components that are updated in
+ * order (a <SubTask> inside a parallel stage becomes one such chain).
+ * An <Asset> entry with 'Split="true"' runs its component split over the
+ * spatial subsets of the asset's geometry (see Component::SubsetCount);
+ * a split physics update is followed by the geometry's split update of
+ * its bounds and normals. A <System Component="..."/> entry runs the
+ * system of a component type, i.e. that component of every asset storing
+ * it in one array (see ComponentSystem.h), as a single node split into
+ * blocks; systems join the graph once every asset is loaded.
+ * Assets that are still loading (see AssetFactory) are left out; the
+ * graph is rebuilt through TaskManager::ReloadGraph () once they are in.
+ * A stage may carry a 'Rate' (Hz) and a number of 'SubSteps' per tick
+ * for the multi-rate scheduler (see RateScheduler.h); stages without a
+ * rate run at the default rate given by the <Rates> entry, which also
+ * switches on pipelined frame execution ('Pipelined') and the display's
+ * interpolation of faster rates' geometry ('Interpolate'). 'Cores' pins a
+ * stage to a set of processors (e.g. "0-3,8") where the task manager
+ * supports it. 'Priority' ("High", "Normal" or "Low") puts the stage's
+ * tasks in a priority class: the task managers run more urgent work
+ * first at every task boundary and may reserve workers for a class (see
+ * the <Priorities> entry of the configuration files).
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "InputParser.h"
+
+namespace Sim {
+
+	class AssetFactory;
+
+	namespace Assets {
+		class Component;
+	}
+
+	// priority classes of tasks, most urgent first
+	typedef enum {
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_COUNT
+	} TaskPriority;
+
+	class TaskNode {
+		public:
+			std::vector <std::shared_ptr <Assets::Component> > _components;
+			std::vector <unsigned int> _subsets; // per component: subsets it is split over (0: not split)
+			std::vector <std::string> _sites; // per component: "Asset.Component", its grain site
+			std::string _label; // "Asset.Component" entries of the chain, for reports
+	};
+
+	class TaskStage {
+		public:
+			unsigned int _index;
+			bool _parallel;
+			double _rate;
+			unsigned int _subSteps;
+			TaskPriority _priority;
+			std::vector <unsigned int> _cores; // empty: not pinned
+			std::vector <TaskNode> _nodes;
+
+			TaskStage (): _index (0), _parallel (false), _rate (0.), _subSteps (1), _priority (PRIORITY_NORMAL) {}
+	};
+
+	class TaskGraph {
+
+		protected:
+			std::vector <TaskStage> _stages;
+			double _defaultRate;
+			unsigned int _maxCatchUp;
+			bool _pipelined;
+			bool _interpolate;
+			AssetFactory* _assets; // the assets the tasks run on (null: the driver's)
+
+		public:
+			TaskGraph (): _defaultRate (60.), _maxCatchUp (4), _pipelined (false), _interpolate (false), _assets (nullptr) {}
+			~TaskGraph () {}
+
+			// the assets of a simulation instance other than the driver's (before Initialize ())
+			void SetAssets (AssetFactory* assets) {_assets = assets;}
+			AssetFactory* Assets () const {return _assets;}
+			bool Initialize (InputParser& parser);
+			void Cleanup () {_stages.clear ();}
+
+			unsigned int StageCount () const {return static_cast <unsigned int> (_stages.size ());}
+			const TaskStage& Stage (unsigned int index) const {return _stages [index];}
+			const std::vector <TaskStage>& Stages () const {return _stages;}
+
+			// rate of stages that do not specify one
+			double DefaultRate () const {return _defaultRate;}
+			// maximum number of late ticks a rate may run back to back to catch up
+			unsigned int MaxCatchUp () const {return _maxCatchUp;}
+			// overlap physics, collision and render of consecutive frames
+			bool Pipelined () const {return _pipelined;}
+			// let rates that render draw geometry interpolated between physics steps
+			bool Interpolate () const {return _interpolate;}
+
+			// priority class from its name ("High", "Normal" or "Low")
+			static bool ParsePriority (const char* name, TaskPriority& priority);
+
+		protected:
+			bool InitializeStage (tinyxml2::XMLElement&, TaskStage&);
+			bool AddComponent (const char* asset, const char* component, bool split, TaskNode&);
+			bool AddSystem (const char* component, TaskNode&);
+	};
+}
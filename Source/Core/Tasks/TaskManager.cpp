@@ -0,0 +1,217 @@
+/**
+ * @file TaskManager.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskManager.h.
+ */
+
+#include <chrono>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Assets/Component.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/TaskManager.h"
+
+using tinyxml2::XMLElement;
+using tinyxml2::XML_SUCCESS;
+
+namespace Sim {
+
+	static thread_local TaskPriority t_priority = PRIORITY_NORMAL;
+	static thread_local TaskManager* t_manager = nullptr;
+
+	PriorityScope::PriorityScope (TaskPriority priority): _previous (t_priority)
+	{
+		t_priority = priority;
+	}
+
+	PriorityScope::~PriorityScope ()
+	{
+		t_priority = _previous;
+	}
+
+	TaskPriority TaskManager::CurrentPriority ()
+	{
+		return t_priority;
+	}
+
+	TaskManager* TaskManager::Current ()
+	{
+		return t_manager;
+	}
+
+	bool TaskManager::ReloadGraph ()
+	{
+		InputParser parser;
+		if (!parser.Initialize (_configFile.c_str (), _configRoot.c_str ())){
+			LOG_ERROR ("Could not initialize parser for " << _configFile);
+			return false;
+		}
+		_quality.Cleanup ();
+		_profiler.Cleanup ();
+		_graph.Cleanup ();
+		if (!InitializeGraph (parser)){
+			LOG_ERROR ("Could not rebuild task graph from " << _configFile);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Every <Priority Class Workers> entry reserves workers for a class; they
+	 * never pick up less urgent work. Low priority work runs on the shared
+	 * workers only.
+	 */
+	bool TaskManager::ReadReservedWorkers (InputParser& parser, std::vector <unsigned int>& reserved)
+	{
+		reserved.assign (PRIORITY_COUNT, 0);
+		XMLElement* element = parser.FindElement ("Priorities");
+		if (element == nullptr){
+			return true;
+		}
+		for (XMLElement* p = element->FirstChildElement ("Priority"); p != nullptr; p = p->NextSiblingElement ("Priority")){
+			const char* name = p->Attribute ("Class");
+			TaskPriority priority = PRIORITY_NORMAL;
+			unsigned int workers = 0;
+			if (name == nullptr || !TaskGraph::ParsePriority (name, priority) ||
+					p->QueryUnsignedAttribute ("Workers", &workers) != XML_SUCCESS){
+				LOG_ERROR ("Invalid priority class settings");
+				return false;
+			}
+			if (priority == PRIORITY_LOW){
+				LOG_WARNING ("Workers can not be reserved for low priority tasks. Ignoring");
+				continue;
+			}
+			reserved [priority] = workers;
+		}
+		return true;
+	}
+
+	/**
+	 * <Deterministic Enabled Chunks>: with 'Enabled' set every loop without an
+	 * explicit grain is cut into 'Chunks' chunks whatever the thread count.
+	 */
+	bool TaskManager::ReadDeterminism (InputParser& parser)
+	{
+		_deterministic = false;
+		XMLElement* element = parser.FindElement ("Deterministic");
+		if (element == nullptr){
+			return true;
+		}
+		element->QueryBoolAttribute ("Enabled", &_deterministic);
+		element->QueryUnsignedAttribute ("Chunks", &_chunks);
+		if (_chunks == 0){
+			LOG_ERROR ("Invalid chunk count for deterministic execution");
+			return false;
+		}
+		if (_deterministic){
+			LOG ("Deterministic execution enabled (" << _chunks << " chunks per loop)");
+		}
+		return true;
+	}
+
+	// run one frame of the task graph
+	void TaskManager::Update ()
+	{
+		if (_profiler.Enabled ()){
+			_profiler.BeginFrame ();
+		}
+		for (auto &stage : _graph.Stages ()){
+			RunStage (stage);
+		}
+		if (_profiler.Enabled ()){
+			_profiler.EndFrame (0);
+		}
+	}
+
+	void TaskManager::RunStage (const TaskStage& stage)
+	{
+		PriorityScope scope (stage._priority);
+		if (!_profiler.Enabled ()){
+			DispatchStage (stage);
+			return;
+		}
+		TaskProfiler::Clock::time_point start = TaskProfiler::Clock::now ();
+		DispatchStage (stage);
+		_profiler.StageDone (StagePosition (stage), start, TaskProfiler::Clock::now (), ThreadCount ());
+	}
+
+	void TaskManager::DispatchStage (const TaskStage& stage)
+	{
+		if (!stage._parallel || stage._nodes.size () == 1){
+			for (unsigned int i = 0; i < stage._nodes.size (); ++i){
+				RunNode (stage, i);
+			}
+			return;
+		}
+		ParallelFor (0, static_cast <unsigned int> (stage._nodes.size ()), 1,
+				[this, &stage] (unsigned int begin, unsigned int end){
+			for (unsigned int i = begin; i < end; ++i){
+				RunNode (stage, i);
+			}
+		});
+	}
+
+	void TaskManager::RunNode (const TaskStage& stage, unsigned int node)
+	{
+		TaskManager* previous = t_manager;
+		t_manager = this;
+		if (!_profiler.Enabled ()){
+			RunChain (stage._nodes [node]);
+		} else {
+			TaskProfiler::Clock::time_point start = TaskProfiler::Clock::now ();
+			RunChain (stage._nodes [node]);
+			_profiler.TaskDone (StagePosition (stage), node, start, TaskProfiler::Clock::now ());
+		}
+		t_manager = previous;
+	}
+
+	void TaskManager::AdaptiveParallelFor (const char* name, unsigned int begin, unsigned int end, const RangeTask& task)
+	{
+		if (!_grains.Enabled () || _deterministic){
+			ParallelFor (begin, end, 0, task);
+			return;
+		}
+		if (begin >= end){
+			return;
+		}
+		GrainSite& site = _grains.Site (name);
+		unsigned int grain = _grains.Grain (site, end - begin);
+		ParallelFor (begin, end, grain, [this, &site, &task] (unsigned int b, unsigned int e){
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+			task (b, e);
+			_grains.Record (site, e - b, std::chrono::duration_cast <std::chrono::nanoseconds> (
+					std::chrono::steady_clock::now () - start).count ());
+		});
+		_grains.Update (site);
+	}
+
+	/**
+	 * The subsets of a split component run as a nested parallel loop whose
+	 * grain is tuned per component (see GrainTuner.h), so that idle workers
+	 * steal them, and are merged by the calling task once they have all
+	 * finished.
+	 */
+	void TaskManager::RunChain (const TaskNode& node)
+	{
+		for (unsigned int i = 0; i < node._components.size (); ++i){
+			Assets::Component* c = node._components [i].get ();
+			if (node._subsets [i] == 0){
+				c->Update ();
+				continue;
+			}
+			AdaptiveParallelFor (node._sites [i].c_str (), 0, node._subsets [i], [c] (unsigned int begin, unsigned int end){
+				for (unsigned int s = begin; s < end; ++s){
+					c->UpdateSubset (s);
+				}
+			});
+			c->MergeSubsets ();
+		}
+	}
+}
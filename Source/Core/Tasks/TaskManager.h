@@ -11,20 +11,254 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "InputParser.h"
+#include "Tasks/GrainTuner.h"
+#include "Tasks/QualityGovernor.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/TaskProfiler.h"
+
 namespace Sim {
 
+	/**
+	 * A set of tasks spawned through TaskManager::Run () and waited upon
+	 * together through TaskManager::Wait (). Groups may be nested and may
+	 * be waited upon from within a running task.
+	 */
+	class TaskGroup {
+		public:
+			std::atomic <unsigned int> _pending;
+			std::shared_ptr <void> _native; // task manager's own bookkeeping, set by its first Run ()
+
+			TaskGroup (): _pending (0) {}
+			~TaskGroup () {}
+
+			// forbidden copy constructor and assignment operator
+			TaskGroup (const TaskGroup&) = delete;
+			TaskGroup& operator = (const TaskGroup&) = delete;
+
+			bool Done () const {return _pending.load (std::memory_order_acquire) == 0;}
+	};
+
+	/**
+	 * Sets the priority class of the calling thread for the lifetime of the
+	 * scope (see TaskManager::CurrentPriority).
+	 */
+	class PriorityScope {
+		protected:
+			TaskPriority _previous;
+
+		public:
+			explicit PriorityScope (TaskPriority priority);
+			~PriorityScope ();
+
+			// forbidden copy constructor and assignment operator
+			PriorityScope (const PriorityScope&) = delete;
+			PriorityScope& operator = (const PriorityScope&) = delete;
+	};
+
 	class TaskManager {
 
+		public:
+			typedef std::function <void ()> Task;
+			typedef std::function <void (unsigned int, unsigned int)> RangeTask;
+
+		protected:
+			TaskGraph _graph;
+			TaskProfiler _profiler;
+			GrainTuner _grains;
+			QualityGovernor _quality;
+			std::string _configFile; // scheduler configuration and its root element, for ReloadGraph ()
+			std::string _configRoot;
+			/**
+			 * In deterministic mode (the <Deterministic> entry) a run is bit-identical
+			 * whatever the thread count: loops are cut into a fixed number of chunks
+			 * instead of a number following the threads (and the grain is not tuned
+			 * online), reductions combine their chunks in a fixed tree and the
+			 * multi-rate scheduler runs the rates in lockstep. It costs the grain
+			 * tuning and the balance of chunks sized to the thread count, which
+			 * benchFrame (ToolBox/FrameBench) measures at every thread count.
+			 */
+			bool _deterministic;
+			unsigned int _chunks; // chunks per loop in deterministic mode
+
 		protected: // forbidden copy constructor and assignment operator
 			TaskManager (const TaskManager& t) {}
 			TaskManager& operator = (const TaskManager& t) {return *this;}
 
 		public:
-			TaskManager () {}
+			TaskManager (): _deterministic (false), _chunks (64) {}
 			virtual ~TaskManager () {}
 
 			virtual bool Initialize (const char* config) {return true;}
-			virtual void Update () {}
-			virtual void Cleanup () {}
+			// run the task graph for a frame, with the parallel primitives below (serial in this base class)
+			virtual void Update ();
+			virtual void Cleanup () {_quality.Cleanup (); _grains.Cleanup (); _profiler.Cleanup (); _graph.Cleanup ();}
+
+			// the assets of a simulation instance other than the driver's (before Initialize ())
+			void SetAssetFactory (AssetFactory* assets) {_graph.SetAssets (assets);}
+			const std::string& ConfigFile () const {return _configFile;}
+			const std::string& ConfigRoot () const {return _configRoot;}
+
+			const TaskGraph& Graph () const {return _graph;}
+			TaskProfiler& Profiler () {return _profiler;}
+			GrainTuner& Grains () {return _grains;}
+			QualityGovernor& Quality () {return _quality;}
+			bool Deterministic () const {return _deterministic;}
+			// run a single stage of the task graph (used by the multi-rate scheduler)
+			void UpdateStage (unsigned int index) {RunStage (_graph.Stage (index));}
+			// rebuild the task graph from the configuration file (no stage may be running)
+			bool ReloadGraph ();
+
+			// priority class of the work the calling thread is running (the stage's, see
+			// TaskStage::_priority); the tasks it spawns inherit it
+			static TaskPriority CurrentPriority ();
+			/**
+			 * The manager running the task graph node the calling thread is in (null
+			 * outside of one). Components use it for their parallel loops, so that
+			 * each simulation instance of a batch run keeps to its own manager.
+			 */
+			static TaskManager* Current ();
+
+			// number of threads (including the calling one) that execute tasks
+			virtual unsigned int ThreadCount () const {return 1;}
+
+			// spawn a task as part of a group
+			virtual void Run (TaskGroup& group, const Task& task) {task ();}
+			// block until every task of the group has finished (the caller helps run tasks)
+			virtual void Wait (TaskGroup& group) {}
+			/**
+			 * Run task over the range [begin, end) split into sub-ranges of at least
+			 * 'grain' elements. A grain of 0 lets the manager pick one.
+			 */
+			virtual void ParallelFor (unsigned int begin, unsigned int end, unsigned int grain, const RangeTask& task)
+			{
+				if (begin < end){
+					task (begin, end);
+				}
+			}
+
+			/**
+			 * Parallel loop whose grain is tuned online for the named call site (see
+			 * GrainTuner.h). Without adaptive grains, or in deterministic mode, it runs
+			 * with the default grain.
+			 */
+			void AdaptiveParallelFor (const char* site, unsigned int begin, unsigned int end, const RangeTask& task);
+
+			/**
+			 * Reduction over [begin, end). 'reduce (b, e, identity)' folds a sub-range
+			 * into a partial value and 'combine (x, y)' merges two partial values. The
+			 * range is cut into fixed chunks of 'grain' elements and the partial values
+			 * are combined pairwise in a tree over the chunks, left before right, whose
+			 * shape only depends on the number of chunks. With a grain of 0 that number
+			 * follows the thread count, except in deterministic mode.
+			 */
+			template <typename T, typename Reduce, typename Combine>
+			T ParallelReduce (unsigned int begin, unsigned int end, unsigned int grain,
+					const T& identity, const Reduce& reduce, const Combine& combine)
+			{
+				if (begin >= end){
+					return identity;
+				}
+				if (grain == 0){
+					grain = DefaultGrain (end - begin);
+				}
+				unsigned int numChunks = (end - begin - 1) / grain + 1;
+				// an array rather than a vector, whose bool specialization packs chunks into shared words
+				std::unique_ptr <T []> partial (new T [numChunks]);
+				std::fill (partial.get (), partial.get () + numChunks, identity);
+
+				ParallelFor (0, numChunks, 1, [&] (unsigned int b, unsigned int e){
+					for (unsigned int c = b; c < e; ++c){
+						unsigned int first = begin + c*grain;
+						unsigned int last = end - first > grain ? first + grain : end;
+						partial [c] = reduce (first, last, identity);
+					}
+				});
+
+				for (unsigned int stride = 1; stride < numChunks; stride *= 2){
+					for (unsigned int c = 0; c + stride < numChunks; c += 2*stride){
+						partial [c] = combine (partial [c], partial [c + stride]);
+					}
+				}
+				return partial [0];
+			}
+
+			/**
+			 * Gather in 'result' the items 'produce (b, e, items)' appends for the
+			 * sub-ranges of [begin, end). The items of every chunk are kept apart and
+			 * concatenated in chunk order, so they come out in the order of the range
+			 * whichever thread ran which chunk, in deterministic mode or not.
+			 */
+			template <typename T, typename Produce>
+			void ParallelCollect (unsigned int begin, unsigned int end, unsigned int grain,
+					const Produce& produce, std::vector <T>& result)
+			{
+				result.clear ();
+				if (begin >= end){
+					return;
+				}
+				if (grain == 0){
+					grain = DefaultGrain (end - begin);
+				}
+				unsigned int numChunks = (end - begin - 1) / grain + 1;
+				std::vector <std::vector <T> > items (numChunks);
+
+				ParallelFor (0, numChunks, 1, [&] (unsigned int b, unsigned int e){
+					for (unsigned int c = b; c < e; ++c){
+						unsigned int first = begin + c*grain;
+						produce (first, end - first > grain ? first + grain : end, items [c]);
+					}
+				});
+
+				size_t size = 0;
+				for (auto &i : items){
+					size += i.size ();
+				}
+				result.reserve (size);
+				for (auto &i : items){
+					result.insert (result.end (), i.begin (), i.end ());
+				}
+			}
+
+		protected:
+			// reads the task graph and the profiler settings (and whatever depends on the graph)
+			virtual bool InitializeGraph (InputParser& parser)
+			{
+				return _graph.Initialize (parser) && _profiler.Initialize (parser, _graph) && _grains.Initialize (parser) &&
+						ReadDeterminism (parser) && _quality.Initialize (parser, _deterministic);
+			}
+
+			// the <Deterministic> entry
+			bool ReadDeterminism (InputParser& parser);
+
+			// workers reserved per priority class by the <Priorities> entry
+			static bool ReadReservedWorkers (InputParser& parser, std::vector <unsigned int>& reserved);
+
+			// run a stage (timed when profiling) through DispatchStage ()
+			void RunStage (const TaskStage& stage);
+			// spread the nodes of a stage over the threads; every node runs through RunNode ()
+			virtual void DispatchStage (const TaskStage& stage);
+			void RunNode (const TaskStage& stage, unsigned int node);
+			// update the components of a node in order, split ones over their subsets
+			void RunChain (const TaskNode& node);
+
+			unsigned int StagePosition (const TaskStage& stage) const
+			{
+				return static_cast <unsigned int> (&stage - &_graph.Stage (0));
+			}
+
+			// roughly 8 chunks per thread, or a fixed number of chunks in deterministic mode
+			unsigned int DefaultGrain (unsigned int count) const
+			{
+				unsigned int grain = count / (_deterministic ? _chunks : 8*ThreadCount ());
+				return grain > 0 ? grain : 1;
+			}
 	};
 }
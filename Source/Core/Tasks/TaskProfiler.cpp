@@ -0,0 +1,337 @@
+/**
+ * @file TaskProfiler.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See TaskProfiler.h.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Tasks/TaskGraph.h"
+#include "Tasks/TaskProfiler.h"
+
+using std::string;
+using std::vector;
+using std::chrono::duration;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	// workers beyond this count share the last slot
+	const static unsigned int SIM_PROFILER_MAX_WORKERS = 256;
+
+	// the frame being run by the calling thread
+	class FrameRun {
+		public:
+			bool _active;
+			TaskProfiler::Clock::time_point _start;
+			double _critical;
+			double _idle;
+			double _maxCritical;
+			int _driving;
+
+			FrameRun (): _active (false), _critical (0.), _idle (0.), _maxCritical (0.), _driving (-1) {}
+	};
+	static thread_local FrameRun t_frame;
+	static thread_local int t_worker = -1;
+
+	static inline double Seconds (TaskProfiler::Clock::duration d)
+	{
+		return duration <double> (d).count ();
+	}
+
+	TaskProfiler::TaskProfiler ()
+	: _graph (nullptr), _enabled (false), _interval (600), _topTasks (5), _windowFrames (0), _workerCount (0)
+	{}
+
+	bool TaskProfiler::Initialize (InputParser& parser, const TaskGraph& graph)
+	{
+		_graph = &graph;
+		XMLElement* element = parser.FindElement ("Profiler");
+		if (element == nullptr){
+			return true;
+		}
+		element->QueryBoolAttribute ("Enabled", &_enabled);
+		if (!_enabled){
+			return true;
+		}
+		element->QueryUnsignedAttribute ("Interval", &_interval);
+		element->QueryUnsignedAttribute ("TopTasks", &_topTasks);
+		const char* dot = element->Attribute ("Dot");
+		if (dot != nullptr){
+			_dotFile = dot;
+		}
+
+		_stages.assign (graph.StageCount (), StageStats ());
+		for (unsigned int i = 0; i < graph.StageCount (); ++i){
+			_stages [i]._tasks.assign (graph.Stage (i)._nodes.size (), TaskStats ());
+		}
+		_busy.reset (new std::atomic <long long> [SIM_PROFILER_MAX_WORKERS]);
+		ResetWindow ();
+
+		LOG ("Task profiler enabled (report every " << _interval << " frames)");
+		return true;
+	}
+
+	void TaskProfiler::Cleanup ()
+	{
+		if (_enabled && !_dotFile.empty ()){
+			ExportDot (_dotFile.c_str ());
+		}
+		_enabled = false;
+		_stages.clear ();
+		_frames.clear ();
+		_busy.reset ();
+		_graph = nullptr;
+	}
+
+	void TaskProfiler::TaskDone (unsigned int stage, unsigned int node, Clock::time_point start, Clock::time_point end)
+	{
+		TaskStats& t = _stages [stage]._tasks [node];
+		t._start = start;
+		t._end = end;
+		t._worker = WorkerIndex ();
+		_busy [t._worker].fetch_add (std::chrono::duration_cast <std::chrono::nanoseconds> (end - start).count (),
+				std::memory_order_relaxed);
+	}
+
+	// the tasks of the stage have all finished: reduce their last run
+	void TaskProfiler::StageDone (unsigned int stage, Clock::time_point start, Clock::time_point end, unsigned int threads)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		StageStats& s = _stages [stage];
+
+		double wall = Seconds (end - start);
+		double critical = 0.;
+		double busy = 0.;
+		for (auto &t : s._tasks){
+			double d = Seconds (t._end - t._start);
+			critical = std::max (critical, d);
+			busy += d;
+			++t._windowCount;
+			t._windowTotal += d;
+			t._windowMax = std::max (t._windowMax, d);
+			++t._count;
+			t._total += d;
+		}
+		double idle = std::max (0., threads*wall - busy);
+		double mean = s._tasks.empty () ? 0. : busy / s._tasks.size ();
+
+		++s._runs;
+		s._wall += wall;
+		s._critical += critical;
+		s._idle += idle;
+		s._imbalance += mean > 0. ? critical / mean : 1.;
+		++s._totalRuns;
+		s._totalCritical += critical;
+
+		if (t_frame._active){
+			t_frame._critical += critical;
+			t_frame._idle += idle;
+			if (critical > t_frame._maxCritical){
+				t_frame._maxCritical = critical;
+				t_frame._driving = static_cast <int> (stage);
+			}
+		}
+	}
+
+	void TaskProfiler::BeginFrame ()
+	{
+		t_frame = FrameRun ();
+		t_frame._active = true;
+		t_frame._start = Clock::now ();
+	}
+
+	void TaskProfiler::EndFrame (unsigned int key)
+	{
+		if (!t_frame._active){
+			return;
+		}
+		t_frame._active = false;
+		double wall = Seconds (Clock::now () - t_frame._start);
+
+		bool report = false;
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			FrameStats& f = _frames [key];
+			++f._frames;
+			f._wall += wall;
+			f._maxWall = std::max (f._maxWall, wall);
+			f._critical += t_frame._critical;
+			f._idle += t_frame._idle;
+			if (t_frame._driving >= 0){
+				++_stages [t_frame._driving]._driving;
+			}
+			++_windowFrames;
+			report = _interval > 0 && f._frames >= _interval;
+		}
+		if (report){
+			Report ();
+		}
+	}
+
+	void TaskProfiler::NameFrame (unsigned int key, const string& name)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		_frames [key]._name = name;
+	}
+
+	void TaskProfiler::Report ()
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		if (!_enabled){
+			return;
+		}
+		double window = Seconds (Clock::now () - _windowStart);
+		LOG ("Task profile of the last " << window << " s");
+
+		// frame costs
+		for (auto &fs : _frames){
+			const FrameStats& f = fs.second;
+			if (f._frames == 0){
+				continue;
+			}
+			LOG ("  " << (f._name.empty () ? string ("Frame ") + std::to_string (fs.first) : f._name) << ": " << f._frames
+					<< " frames, mean " << 1000.*f._wall/f._frames << " ms (max " << 1000.*f._maxWall << " ms), critical path "
+					<< 1000.*f._critical/f._frames << " ms, idle " << 1000.*f._idle/f._frames << " ms");
+		}
+
+		// stages, and which of them drive the critical path
+		for (unsigned int i = 0; i < _stages.size (); ++i){
+			const StageStats& s = _stages [i];
+			if (s._runs == 0){
+				continue;
+			}
+			LOG ("  Stage " << _graph->Stage (i)._index << ": critical " << 1000.*s._critical/s._runs << " ms, idle "
+					<< 1000.*s._idle/s._runs << " ms, imbalance " << s._imbalance/s._runs << ", drove the critical path in "
+					<< s._driving << " frame(s)");
+		}
+
+		// top-N tasks by mean cost
+		vector <std::pair <double, std::pair <unsigned int, unsigned int> > > tasks;
+		for (unsigned int i = 0; i < _stages.size (); ++i){
+			for (unsigned int j = 0; j < _stages [i]._tasks.size (); ++j){
+				const TaskStats& t = _stages [i]._tasks [j];
+				if (t._windowCount > 0){
+					tasks.push_back (std::make_pair (t._windowTotal/t._windowCount, std::make_pair (i, j)));
+				}
+			}
+		}
+		std::sort (tasks.begin (), tasks.end (),
+				[] (const std::pair <double, std::pair <unsigned int, unsigned int> >& a,
+					const std::pair <double, std::pair <unsigned int, unsigned int> >& b) {return a.first > b.first;});
+		for (unsigned int k = 0; k < tasks.size () && k < _topTasks; ++k){
+			unsigned int i = tasks [k].second.first;
+			unsigned int j = tasks [k].second.second;
+			LOG ("  #" << k + 1 << " " << _graph->Stage (i)._nodes [j]._label << " (stage " << _graph->Stage (i)._index
+					<< "): mean " << 1000.*tasks [k].first << " ms, max " << 1000.*_stages [i]._tasks [j]._windowMax << " ms");
+		}
+
+		// worker utilisation
+		unsigned int workers = std::min (_workerCount.load (), SIM_PROFILER_MAX_WORKERS);
+		for (unsigned int w = 0; w < workers; ++w){
+			double busy = 1e-9*_busy [w].load (std::memory_order_relaxed);
+			LOG ("  Worker " << w << ": " << (window > 0. ? 100.*busy/window : 0.) << "% busy");
+		}
+
+		ResetWindow ();
+	}
+
+	/**
+	 * Every task is a node labelled with its cumulative mean cost; the tasks of
+	 * consecutive stages are joined through a barrier node carrying the stage's
+	 * mean critical path. The longest task of each stage is highlighted.
+	 */
+	bool TaskProfiler::ExportDot (const char* file)
+	{
+		std::lock_guard <std::mutex> lock (_mutex);
+		if (_graph == nullptr){
+			return false;
+		}
+		std::ofstream out (file);
+		if (!out.is_open ()){
+			LOG_ERROR ("Could not open " << file << " for the task graph export");
+			return false;
+		}
+
+		out << "digraph TaskGraph {" << std::endl;
+		out << "\trankdir=TB;" << std::endl;
+		out << "\tnode [shape=box, fontname=\"Helvetica\"];" << std::endl;
+		for (unsigned int i = 0; i < _stages.size (); ++i){
+			const TaskStage& stage = _graph->Stage (i);
+			const StageStats& s = _stages [i];
+
+			unsigned int critical = 0;
+			for (unsigned int j = 1; j < s._tasks.size (); ++j){
+				if (s._tasks [j]._total/std::max (s._tasks [j]._count, 1ULL) >
+						s._tasks [critical]._total/std::max (s._tasks [critical]._count, 1ULL)){
+					critical = j;
+				}
+			}
+
+			out << "\tsubgraph cluster_" << i << " {" << std::endl;
+			out << "\t\tlabel=\"Stage " << stage._index << " (" << (stage._parallel ? "Parallel" : "Serial") << ")\";" << std::endl;
+			for (unsigned int j = 0; j < s._tasks.size (); ++j){
+				const TaskStats& t = s._tasks [j];
+				double mean = t._count > 0 ? t._total/t._count : 0.;
+				out << "\t\ts" << i << "t" << j << " [label=\"" << stage._nodes [j]._label << "\\n" << 1000.*mean << " ms\""
+						<< (j == critical ? ", color=red" : "") << "];" << std::endl;
+			}
+			out << "\t}" << std::endl;
+
+			double mean = s._totalRuns > 0 ? s._totalCritical/s._totalRuns : 0.;
+			out << "\tb" << i << " [shape=circle, label=\"" << 1000.*mean << " ms\"];" << std::endl;
+			for (unsigned int j = 0; j < s._tasks.size (); ++j){
+				if (i > 0){
+					out << "\tb" << i - 1 << " -> s" << i << "t" << j << ";" << std::endl;
+				}
+				out << "\ts" << i << "t" << j << " -> b" << i << (j == critical ? " [color=red]" : "") << ";" << std::endl;
+			}
+		}
+		out << "}" << std::endl;
+		LOG ("Task graph with measured costs written to " << file);
+		return true;
+	}
+
+	unsigned int TaskProfiler::WorkerIndex ()
+	{
+		if (t_worker < 0){
+			t_worker = static_cast <int> (_workerCount.fetch_add (1));
+		}
+		return std::min (static_cast <unsigned int> (t_worker), SIM_PROFILER_MAX_WORKERS - 1);
+	}
+
+	void TaskProfiler::ResetWindow ()
+	{
+		for (auto &s : _stages){
+			s._runs = 0;
+			s._wall = s._critical = s._idle = s._imbalance = 0.;
+			s._driving = 0;
+			for (auto &t : s._tasks){
+				t._windowCount = 0;
+				t._windowTotal = t._windowMax = 0.;
+			}
+		}
+		for (auto &f : _frames){
+			string name = f.second._name;
+			f.second = FrameStats ();
+			f.second._name = name;
+		}
+		for (unsigned int w = 0; w < SIM_PROFILER_MAX_WORKERS; ++w){
+			_busy [w].store (0, std::memory_order_relaxed);
+		}
+		_windowFrames = 0;
+		_windowStart = Clock::now ();
+	}
+}
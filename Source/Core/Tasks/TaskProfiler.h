@@ -0,0 +1,139 @@
+/**
+ * @file TaskProfiler.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Per-task profiler of the task manager, configured by the <Profiler>
+ * entry of the scheduler configuration file. Every task (node of the
+ * task graph) records its start and end time and the worker that ran
+ * it. When a stage completes, its run is reduced to the stage critical
+ * path (longest task, since the tasks of a stage are independent), the
+ * idle time of the workers during the stage and its load imbalance
+ * (longest over mean task). A frame is the sequence of stages run by
+ * one thread between BeginFrame () and EndFrame (): its critical path
+ * is the sum of its stages' and the stage contributing most drives it.
+ * Every 'Interval' frames a report of the window is logged: frame
+ * costs, top-N tasks, per-worker utilisation and the stages driving
+ * the critical path. The task graph with the measured (cumulative mean)
+ * costs can be exported in DOT format, at cleanup to the 'Dot' file.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "InputParser.h"
+
+namespace Sim {
+
+	class TaskGraph;
+
+	class TaskProfiler {
+
+		public:
+			typedef std::chrono::steady_clock Clock;
+
+		protected:
+			class TaskStats {
+				public:
+					// last run (written by the worker, read once the stage is over)
+					Clock::time_point _start;
+					Clock::time_point _end;
+					unsigned int _worker;
+
+					// report window and cumulative costs (seconds)
+					unsigned long long _windowCount;
+					double _windowTotal;
+					double _windowMax;
+					unsigned long long _count;
+					double _total;
+
+					TaskStats ()
+					: _worker (0), _windowCount (0), _windowTotal (0.), _windowMax (0.), _count (0), _total (0.) {}
+			};
+
+			class StageStats {
+				public:
+					std::vector <TaskStats> _tasks;
+
+					// report window (seconds)
+					unsigned long long _runs;
+					double _wall;
+					double _critical;
+					double _idle;
+					double _imbalance;
+					unsigned long long _driving; // frames whose critical path this stage dominated
+
+					// cumulative
+					unsigned long long _totalRuns;
+					double _totalCritical;
+
+					StageStats ()
+					: _runs (0), _wall (0.), _critical (0.), _idle (0.), _imbalance (0.), _driving (0),
+						_totalRuns (0), _totalCritical (0.) {}
+			};
+
+			class FrameStats {
+				public:
+					std::string _name;
+					unsigned long long _frames;
+					double _wall;
+					double _critical;
+					double _idle;
+					double _maxWall;
+
+					FrameStats (): _frames (0), _wall (0.), _critical (0.), _idle (0.), _maxWall (0.) {}
+			};
+
+			const TaskGraph* _graph;
+			bool _enabled;
+			unsigned int _interval;
+			unsigned int _topTasks;
+			std::string _dotFile;
+
+			std::mutex _mutex; // guards the stage and frame statistics
+			std::vector <StageStats> _stages;
+			std::map <unsigned int, FrameStats> _frames;
+			unsigned long long _windowFrames;
+
+			// busy time per worker (nanoseconds) in the report window
+			std::unique_ptr <std::atomic <long long> []> _busy;
+			std::atomic <unsigned int> _workerCount;
+			Clock::time_point _windowStart;
+
+		private: // forbidden copy constructor and assignment operator
+			TaskProfiler (const TaskProfiler&) = delete;
+			TaskProfiler& operator = (const TaskProfiler&) = delete;
+
+		public:
+			TaskProfiler ();
+			~TaskProfiler () {}
+
+			bool Initialize (InputParser& parser, const TaskGraph& graph);
+			void Cleanup ();
+
+			bool Enabled () const {return _enabled;}
+
+			// instrumentation
+			void TaskDone (unsigned int stage, unsigned int node, Clock::time_point start, Clock::time_point end);
+			void StageDone (unsigned int stage, Clock::time_point start, Clock::time_point end, unsigned int threads);
+			void BeginFrame ();
+			void EndFrame (unsigned int key);
+			void NameFrame (unsigned int key, const std::string& name);
+
+			// log the statistics of the current window and start a new one
+			void Report ();
+			bool ExportDot (const char* file);
+
+		protected:
+			unsigned int WorkerIndex ();
+			void ResetWindow ();
+	};
+}
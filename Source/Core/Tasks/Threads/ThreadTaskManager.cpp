@@ -0,0 +1,369 @@
+/**
+ * @file ThreadTaskManager.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See ThreadTaskManager.h.
+ */
+
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "InputParser.h"
+#include "Tasks/Affinity.h"
+#include "Tasks/Threads/ThreadTaskManager.h"
+
+using std::unique_ptr;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	// identity of the calling thread within a pool (owner is null outside any pool)
+	static thread_local ThreadTaskManager* t_owner = nullptr;
+	static thread_local unsigned int t_index = 0;
+	static thread_local unsigned int t_seed = 0x9e3779b9;
+
+	// longest a waiting thread sleeps before it looks for work again (ms)
+	const static unsigned int SIM_THREAD_WAIT_TIMEOUT = 10;
+
+	// xorshift generator used to pick steal victims
+	static inline unsigned int NextRandom (unsigned int& seed)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
+	}
+
+	ThreadTaskManager::ThreadTaskManager ()
+	: _spinCount (64), _running (false), _epoch (0)
+	{
+		for (unsigned int p = 0; p < PRIORITY_COUNT; ++p){
+			_injected [p].store (0);
+			_sleepers [p].store (0);
+		}
+		LOG ("Thread task manager constructed");
+	}
+
+	ThreadTaskManager::~ThreadTaskManager ()
+	{
+		Cleanup ();
+		LOG ("Thread task manager destroyed");
+	}
+
+	bool ThreadTaskManager::Initialize (const char* configfile)
+	{
+		InputParser parser;
+		if (!parser.Initialize (configfile, "ThreadsConfig")){
+			LOG_ERROR ("Could not initialize parser for " << configfile);
+			return false;
+		}
+		_configFile = configfile;
+		_configRoot = "ThreadsConfig";
+
+		// a worker count of 0 uses every hardware thread
+		unsigned int count = 0;
+		XMLElement* element = parser.GetElement ("Workers");
+		if (element != nullptr){
+			element->QueryUnsignedAttribute ("Count", &count);
+			element->QueryUnsignedAttribute ("SpinCount", &_spinCount);
+		}
+		bool pinned = false;
+		element = parser.FindElement ("Affinity");
+		if (element != nullptr){
+			element->QueryBoolAttribute ("Enabled", &pinned);
+		}
+		if (pinned){
+			Affinity affinity;
+			if (affinity.Initialize ()){
+				_cpus = affinity.AllCpus ();
+			}
+		}
+		if (!ReadReservedWorkers (parser, _reserved)){
+			LOG_ERROR ("Could not read priority classes");
+			return false;
+		}
+
+		if (!StartWorkers (count)){
+			LOG_ERROR ("Could not start worker threads");
+			Cleanup ();
+			return false;
+		}
+
+		if (!InitializeGraph (parser)){
+			LOG_ERROR ("Could not initialize task graph from " << configfile);
+			Cleanup ();
+			return false;
+		}
+		LOG ("Thread task manager initialized with " << _workers.size () << " threads");
+		return true;
+	}
+
+	void ThreadTaskManager::Cleanup ()
+	{
+		if (!_workers.empty ()){
+			{
+				std::lock_guard <std::mutex> lock (_sleepMutex);
+				_running.store (false);
+			}
+			for (unsigned int p = 0; p < PRIORITY_COUNT; ++p){
+				_wake [p].notify_all ();
+			}
+			for (unsigned int i = 1; i < _workers.size (); ++i){
+				if (_workers [i]->_thread.joinable ()){
+					_workers [i]->_thread.join ();
+				}
+			}
+
+			// discard jobs nobody ran
+			Job* job = nullptr;
+			for (unsigned int p = 0; p < PRIORITY_COUNT; ++p){
+				for (auto &w : _workers){
+					while (w->_deques [p].Pop (job)){
+						delete job;
+					}
+				}
+				for (auto j : _injection [p]){
+					delete j;
+				}
+				_injection [p].clear ();
+				_injected [p].store (0);
+			}
+
+			if (t_owner == this){
+				t_owner = nullptr;
+			}
+			_workers.clear ();
+		}
+		_cpus.clear ();
+		_reserved.clear ();
+		TaskManager::Cleanup ();
+	}
+
+	void ThreadTaskManager::Run (TaskGroup& group, const Task& task)
+	{
+		group._pending.fetch_add (1, std::memory_order_relaxed);
+		TaskPriority priority = CurrentPriority ();
+		Job* job = new Job (task, &group, priority);
+
+		if (t_owner == this){
+			_workers [t_index]->_deques [priority].Push (job);
+		} else {
+			std::lock_guard <std::mutex> lock (_injectionMutex);
+			_injection [priority].push_back (job);
+			_injected [priority].fetch_add (1);
+		}
+		Notify (priority);
+	}
+
+	/**
+	 * Helping with less urgent work would delay the waiting task behind it.
+	 * Without work to help with, the caller spins for a while and then sleeps
+	 * until a group finishes or a job is pushed. The progress count is read
+	 * before the last check, so neither can slip in unnoticed.
+	 */
+	void ThreadTaskManager::Wait (TaskGroup& group)
+	{
+		TaskPriority lowest = CurrentPriority ();
+		unsigned int spins = 0;
+		while (!group.Done ()){
+			unsigned int seen = _progress.Load ();
+			Job* job = FindJob (lowest);
+			if (job != nullptr){
+				Execute (job);
+				spins = 0;
+			} else if (spins < _spinCount){
+				std::this_thread::yield ();
+				++spins;
+			} else if (!group.Done ()){
+				_progress.Wait (seen, std::chrono::milliseconds (SIM_THREAD_WAIT_TIMEOUT));
+			}
+		}
+	}
+
+	/**
+	 * Recursive binary splitting: the right halves are left for thieves. The
+	 * sub-ranges only depend on the grain, except that a single thread runs
+	 * the whole range at once unless in deterministic mode.
+	 */
+	void ThreadTaskManager::ParallelFor (unsigned int begin, unsigned int end, unsigned int grain, const RangeTask& task)
+	{
+		if (begin >= end){
+			return;
+		}
+		if (grain == 0){
+			grain = DefaultGrain (end - begin);
+		}
+		if (end - begin <= grain || (_workers.size () < 2 && !_deterministic)){
+			task (begin, end);
+			return;
+		}
+
+		TaskGroup group;
+		std::function <void (unsigned int, unsigned int)> split;
+		split = [&] (unsigned int b, unsigned int e){
+			while (e - b > grain){
+				unsigned int m = b + (e - b)/2;
+				Run (group, [&split, m, e] {split (m, e);});
+				e = m;
+			}
+			task (b, e);
+		};
+		split (begin, end);
+		Wait (group);
+	}
+
+	bool ThreadTaskManager::StartWorkers (unsigned int count)
+	{
+		if (count == 0){
+			count = std::thread::hardware_concurrency ();
+		}
+		if (count == 0){
+			count = 1;
+		}
+
+		_running.store (true);
+		for (unsigned int i = 0; i < count; ++i){
+			_workers.emplace_back (new Worker);
+			_workers.back ()->_seed = 2654435761u * (i + 1);
+		}
+
+		// reserved workers are taken from the end; worker 0 is always shared
+		unsigned int last = count;
+		for (unsigned int p = 0; p < _reserved.size (); ++p){
+			unsigned int n = _reserved [p];
+			if (n > last - 1){
+				LOG_WARNING ("Only " << last - 1 << " of " << n << " worker(s) could be reserved for "
+						<< (p == PRIORITY_HIGH ? "high" : "normal") << " priority tasks");
+				n = last - 1;
+			}
+			for (unsigned int i = last - n; i < last; ++i){
+				_workers [i]->_lowest = static_cast <TaskPriority> (p);
+			}
+			last -= n;
+		}
+
+		// the initializing thread is worker 0
+		t_owner = this;
+		t_index = 0;
+		t_seed = _workers [0]->_seed;
+
+		for (unsigned int i = 1; i < count; ++i){
+			_workers [i]->_thread = std::thread (&ThreadTaskManager::WorkerLoop, this, i);
+		}
+		return true;
+	}
+
+	void ThreadTaskManager::WorkerLoop (unsigned int index)
+	{
+		t_owner = this;
+		t_index = index;
+		t_seed = _workers [index]->_seed;
+		if (!_cpus.empty () && !Affinity::SetThreadAffinity (std::vector <unsigned int> (1, _cpus [index % _cpus.size ()]))){
+			LOG_WARNING ("Could not pin worker " << index);
+		}
+		TaskPriority lowest = _workers [index]->_lowest;
+
+		while (_running.load (std::memory_order_relaxed)){
+
+			Job* job = FindJob (lowest);
+			for (unsigned int i = 0; job == nullptr && i < _spinCount; ++i){
+				std::this_thread::yield ();
+				job = FindJob (lowest);
+			}
+			if (job != nullptr){
+				Execute (job);
+				continue;
+			}
+
+			/**
+			 * Going to sleep. The epoch is read before the final check for work so that
+			 * a job pushed between that check and the wait changes the epoch and keeps
+			 * this worker awake.
+			 */
+			unsigned int epoch = _epoch.load ();
+			job = FindJob (lowest);
+			if (job != nullptr){
+				Execute (job);
+				continue;
+			}
+			std::unique_lock <std::mutex> lock (_sleepMutex);
+			_sleepers [lowest].fetch_add (1);
+			_wake [lowest].wait (lock, [this, epoch] {return _epoch.load () != epoch || !_running.load ();});
+			_sleepers [lowest].fetch_sub (1);
+		}
+	}
+
+	/**
+	 * Classes are searched most urgent first; within a class the own deque
+	 * comes first, then the injection queue, then a random victim's deque.
+	 */
+	ThreadTaskManager::Job* ThreadTaskManager::FindJob (TaskPriority lowest)
+	{
+		Job* job = nullptr;
+		bool member = t_owner == this;
+		unsigned int count = static_cast <unsigned int> (_workers.size ());
+
+		for (unsigned int p = 0; p <= static_cast <unsigned int> (lowest); ++p){
+			if (member && _workers [t_index]->_deques [p].Pop (job)){
+				return job;
+			}
+
+			if (_injected [p].load (std::memory_order_relaxed) > 0){
+				std::lock_guard <std::mutex> lock (_injectionMutex);
+				if (!_injection [p].empty ()){
+					job = _injection [p].front ();
+					_injection [p].pop_front ();
+					_injected [p].fetch_sub (1);
+					return job;
+				}
+			}
+
+			unsigned int start = NextRandom (t_seed) % count;
+			for (unsigned int i = 0; i < count; ++i){
+				unsigned int victim = (start + i) % count;
+				if (member && victim == t_index){
+					continue;
+				}
+				if (_workers [victim]->_deques [p].Steal (job)){
+					return job;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	void ThreadTaskManager::Execute (Job* job)
+	{
+		{
+			PriorityScope scope (job->_priority);
+			job->_task ();
+		}
+		TaskGroup* group = job->_group;
+		delete job;
+		// the group may be gone as soon as its last job is counted off
+		if (group->_pending.fetch_sub (1, std::memory_order_release) == 1){
+			_progress.Increment ();
+		}
+	}
+
+	// wake a sleeper able to run the class, preferring those reserved for it
+	void ThreadTaskManager::Notify (TaskPriority priority)
+	{
+		_progress.Increment ();
+		_epoch.fetch_add (1);
+		for (unsigned int p = priority; p < PRIORITY_COUNT; ++p){
+			if (_sleepers [p].load () > 0){
+				std::lock_guard <std::mutex> lock (_sleepMutex);
+				_wake [p].notify_one ();
+				return;
+			}
+		}
+	}
+}
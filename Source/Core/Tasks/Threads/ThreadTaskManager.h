@@ -0,0 +1,112 @@
+/**
+ * @file ThreadTaskManager.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The dependency-free std::thread based task manager. It is a work-
+ * stealing pool: every worker owns a Chase-Lev deque that it pushes
+ * to and pops from, and idle workers steal from the other deques.
+ * Tasks spawned by threads outside the pool go through a shared
+ * injection queue. Workers spin for a bounded number of rounds when
+ * they run out of work and then sleep until new work is pushed. The
+ * thread that initializes the manager is worker 0 and participates in
+ * every Wait (); any thread waiting on a group spins the same way and
+ * then sleeps until a group finishes or new work is pushed. With <Affinity Enabled> set, the other workers are
+ * pinned one per processor, filling NUMA nodes one after the other.
+ * Deques and injection queues are kept per priority class and a worker
+ * always looks for the most urgent job first, so high priority tasks
+ * overtake queued work at the next task boundary. A thread waiting on a
+ * group only helps with work at least as urgent as its own. Workers
+ * reserved for a class by <Priorities> (taken from the end of the pool)
+ * never run less urgent work, so a long collision task can not hold up
+ * a haptic-rate stage.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Futex.h"
+#include "WorkStealingDeque.h"
+#include "Tasks/TaskManager.h"
+
+namespace Sim {
+
+	class ThreadTaskManager : public TaskManager {
+
+		protected:
+			class Job {
+				public:
+					Task _task;
+					TaskGroup* _group;
+					TaskPriority _priority;
+
+					Job (const Task& t, TaskGroup* g, TaskPriority p): _task (t), _group (g), _priority (p) {}
+			};
+
+			class Worker {
+				public:
+					WorkStealingDeque <Job*> _deques [PRIORITY_COUNT];
+					std::thread _thread;
+					unsigned int _seed;
+					TaskPriority _lowest; // least urgent class it runs
+
+					Worker (): _seed (0), _lowest (PRIORITY_LOW) {}
+			};
+
+			std::vector <std::unique_ptr <Worker> > _workers;
+
+			// jobs spawned by threads outside the pool
+			std::mutex _injectionMutex;
+			std::deque <Job*> _injection [PRIORITY_COUNT];
+			std::atomic <unsigned int> _injected [PRIORITY_COUNT];
+
+			// workers reserved per priority class
+			std::vector <unsigned int> _reserved;
+
+			// processors the workers are pinned to (empty: not pinned)
+			std::vector <unsigned int> _cpus;
+
+			// sleep/wake policy
+			unsigned int _spinCount;
+			std::atomic <bool> _running;
+			std::atomic <unsigned int> _epoch;
+			std::mutex _sleepMutex;
+			std::atomic <unsigned int> _sleepers [PRIORITY_COUNT]; // by the least urgent class the sleeper runs
+			std::condition_variable _wake [PRIORITY_COUNT];
+			Futex _progress; // finished groups and pushed jobs, for the threads in Wait ()
+
+		public:
+			ThreadTaskManager ();
+			~ThreadTaskManager ();
+
+			// forbidden copy constructor and assignment operator
+			ThreadTaskManager (const ThreadTaskManager&) = delete;
+			ThreadTaskManager& operator = (const ThreadTaskManager&) = delete;
+
+			virtual bool Initialize (const char* config) override;
+			virtual void Cleanup () override;
+
+			virtual unsigned int ThreadCount () const override {return static_cast <unsigned int> (_workers.size ());}
+
+			virtual void Run (TaskGroup& group, const Task& task) override;
+			virtual void Wait (TaskGroup& group) override;
+			virtual void ParallelFor (unsigned int begin, unsigned int end, unsigned int grain, const RangeTask& task) override;
+
+		protected:
+			bool StartWorkers (unsigned int count);
+			void WorkerLoop (unsigned int index);
+
+			// most urgent job of a class down to 'lowest'
+			Job* FindJob (TaskPriority lowest);
+			void Execute (Job* job);
+			void Notify (TaskPriority priority);
+	};
+}
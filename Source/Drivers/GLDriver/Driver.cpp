@@ -7,15 +7,25 @@
  * @section DESCRIPTION
  * See Driver.h.
  */
+#include <chrono>
 #include <cstring>
 #include <memory>
+#include <thread>
 
 #include "tinyxml2.h"
 #include "Preprocess.h"
 #include "InputParser.h"
+#include "StartupProfiler.h"
 #include "GLDriver/Driver.h"
+#include "Driver/StartupGraph.h"
+#include "Events/InputLog.h"
 #include "HPC/CUDA/CudaHPCManager.h"
-#include "Tasks/TBB/TBBTaskManager.h"
+#include "Tasks/RateScheduler.h"
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+#	include "Tasks/Threads/ThreadTaskManager.h"
+#else
+#	include "Tasks/TBB/TBBTaskManager.h"
+#endif
 
 using std::unique_ptr;
 using std::make_unique;
@@ -32,109 +42,124 @@ namespace Sim {
 			return false;
 		}
 
+		// the cold start is profiled until every asset is loaded (see Run ())
+		StartupProfiler& profiler = StartupProfiler::Instance ();
+		profiler.Begin ();
+		StartupProfiler::Phase phase ("Driver::Initialize");
+
 		// read configuration file
 		InputParser parser;
 		if (!parser.Initialize (configfile, "ChimeraConfig")){
 			LOG_ERROR ("Could not initialize parser for " << configfile);
 			return false;
 		}
+		if (!profiler.Initialize (parser.FindElement ("Startup"))){
+			LOG_ERROR ("Invalid start-up budgets in " << configfile);
+			return false;
+		}
 
 		// Initialize the event manager (always the first module to be initialized)
-		XMLElement* element = parser.GetElement ("EventManager");
-		if (element == nullptr){
+		XMLElement* events = parser.GetElement ("EventManager");
+		if (events == nullptr){
 			LOG_ERROR ("Event manager profile not found in " << configfile);
 			return false;
 		}
-		if (!InitializeEventManager (element->Attribute ("Config"))){
+		if (!InitializeEventManager (events->Attribute ("Config"))){
 			Cleanup ();
 			return false;
 		}
-		element = nullptr;
 
 		/**
-		 * Initialize renderer and display window. The input configuration may contain
-		 * multiple renderer profiles. We pick the one with "OpenGL" type.
+		 * The input configuration may contain multiple renderer profiles. We pick
+		 * the one with "OpenGL" type.
 		 */
-		element = parser.GetElement ("DisplayManager");
-		while (element != nullptr && strcmp (element->Attribute ("Type"), "OpenGL")){
-			element = element->NextSiblingElement ("DisplayManager");
+		XMLElement* display = parser.GetElement ("DisplayManager");
+		while (display != nullptr && strcmp (display->Attribute ("Type"), "OpenGL")){
+			display = display->NextSiblingElement ("DisplayManager");
 		}
-		if (element == nullptr){
+		if (display == nullptr){
 			LOG_ERROR ("OpenGL display manager profile not found in " << configfile);
 			Cleanup ();
 			return false;
 		}
-		if (!InitializeGLDisplay (element->Attribute ("Config"))){
-			Cleanup ();
-			return false;
-		}
-		element = nullptr;
 
 		/**
-		 * Initialize HPC computing manager. The input configuration may contain
-		 * multiple HPC profiles. We pick the one with "CUDA" type.
+		 * The input configuration may contain multiple HPC profiles. We pick the
+		 * one with "CUDA" type.
 		 */
-		element = parser.GetElement ("HPCManager");
-		while (element != nullptr && strcmp (element->Attribute ("Type"), "CUDA")){
-			element = element->NextSiblingElement ("HPCManager");
+		XMLElement* hpc = parser.GetElement ("HPCManager");
+		while (hpc != nullptr && strcmp (hpc->Attribute ("Type"), "CUDA")){
+			hpc = hpc->NextSiblingElement ("HPCManager");
 		}
-		if (element == nullptr){
+		if (hpc == nullptr){
 			LOG_ERROR ("CUDA HPC manager profile not found in " << configfile);
 			Cleanup ();
 			return false;
 		}
-		if (!InitializeCUDAManager (element->Attribute ("Config"))){
-			Cleanup ();
-			return false;
-		}
-		element = nullptr;
 
-		// Initialize plugin manager (loads all dynamic plugin libraries)
-		element = parser.GetElement ("PluginManager");
-		if (element == nullptr){
+		XMLElement* plugins = parser.GetElement ("PluginManager");
+		if (plugins == nullptr){
 			LOG_ERROR ("Plugin loader profile not found in " << configfile);
 			Cleanup ();
 			return false;
 		}
-		if (!InitializePluginManager (element->Attribute ("Config"))){
+
+		XMLElement* assets = parser.GetElement ("AssetFactory");
+		if (assets == nullptr){
+			LOG_ERROR ("Asset loader profile not found in " << configfile);
 			Cleanup ();
 			return false;
 		}
-		element = nullptr;
-
-		exit (0);
 
-		// Intialize asset factory and load all assets
-		element = parser.GetElement ("AssetFactory");
-		if (element == nullptr){
-			LOG_ERROR ("Asset loader profile not found in " << configfile);
+		/**
+		 * The input configuration may contain multiple task manager profiles. We
+		 * pick the one matching the scheduler package the framework was built with
+		 * ("Threads" or "IntelTBB").
+		 */
+#		ifdef SIM_THREAD_SCHEDULER_ENABLED
+		const char* scheduler = "Threads";
+#		else
+		const char* scheduler = "IntelTBB";
+#		endif
+		XMLElement* tasks = parser.GetElement ("TaskManager");
+		while (tasks != nullptr && strcmp (tasks->Attribute ("Type"), scheduler)){
+			tasks = tasks->NextSiblingElement ("TaskManager");
+		}
+		if (tasks == nullptr){
+			LOG_ERROR (scheduler << " task manager profile not found in " << configfile);
 			Cleanup ();
 			return false;
 		}
-		if (!InitializeAssetFactory (element->Attribute ("Config"))){
+
+		// inputs are recorded or replayed as set by the <Input> entry (none: live)
+		if (!InitializeInputLog (parser.FindElement ("Input"), assets->Attribute ("Config"))){
 			Cleanup ();
 			return false;
 		}
-		element = nullptr;
 
 		/**
-		 * Initialize Intel TBB task manager. The input configuration may contain
-		 * multiple task manager profiles. We pick the one with "IntelTBB" type.
+		 * Bring up the other subsystems through the start-up graph. The display
+		 * and the CUDA manager (whose context shares the display's) make their GL
+		 * contexts current on this thread; the plugin libraries load meanwhile.
+		 * Assets need the plugins and may create GPU resources on this thread; the
+		 * task graph is built over the assets, also on this thread, which runs the
+		 * frames and so must be the task manager's own (worker 0 of the pool).
 		 */
-		element = parser.GetElement ("TaskManager");
-		while (element != nullptr && strcmp (element->Attribute ("Type"), "IntelTBB")){
-			element = element->NextSiblingElement ("TaskManager");
-		}
-		if (element == nullptr){
-			LOG_ERROR ("Intel TBB task manager profile not found in " << configfile);
-			Cleanup ();
-			return false;
-		}
-		if (!InitializeTBBManager (element->Attribute ("Config"))){
+		StartupGraph startup;
+		startup.Add ("Display", [this, display] {return InitializeGLDisplay (display->Attribute ("Config"));}, {}, true);
+		startup.Add ("HPC", [this, hpc] {return InitializeCUDAManager (hpc->Attribute ("Config"));}, {"Display"}, true);
+		startup.Add ("Plugins", [this, plugins] {return InitializePluginManager (plugins->Attribute ("Config"));}, {});
+		startup.Add ("Assets", [this, assets] {return InitializeAssetFactory (assets->Attribute ("Config"), assets->Attribute ("Snapshot"));},
+				{"Display", "HPC", "Plugins"}, true);
+#		ifdef SIM_THREAD_SCHEDULER_ENABLED
+		startup.Add ("Tasks", [this, tasks] {return InitializeThreadManager (tasks->Attribute ("Config"));}, {"Assets"}, true);
+#		else
+		startup.Add ("Tasks", [this, tasks] {return InitializeTBBManager (tasks->Attribute ("Config"));}, {"Assets"}, true);
+#		endif
+		if (!startup.Run ()){
 			Cleanup ();
 			return false;
 		}
-		element = nullptr;
 
 		// Driver is now set to run
 		_runFlag = true;
@@ -142,16 +167,68 @@ namespace Sim {
 		return true;
 	}
 
+	/**
+	 * Every rate of the task graph is ticked at its own frequency until the driver
+	 * quits. While assets are still loading, the display thread finishes their
+	 * main-thread components; each time an asset is done the scheduler stops, the
+	 * task graph is rebuilt with it and the scheduler restarts.
+	 */
 	void Driver::Run ()
 	{
+		while (_runFlag){
+			bool loading = _assetFactory->Poll ();
+			unsigned int finished = _assetFactory->FinishedLoads ();
+			if (!loading){
+				StartupProfiler::Instance ().End ();
+			}
+			auto waiting = [this, loading, finished] {
+				if (!loading){
+					return _runFlag;
+				}
+				_assetFactory->Poll ();
+				return _runFlag && _assetFactory->FinishedLoads () == finished;
+			};
+
+			RateScheduler scheduler (*_taskManager);
+			if (!scheduler.Initialize ()){
+				LOG_ERROR ("Could not initialize the multi-rate scheduler");
+				return;
+			}
+			if (_taskManager->Graph ().StageCount () > 0){
+				// the inputs are applied between ticks of the slowest rate
+				double period = 1./scheduler.SlowestRate ();
+				_inputLog->Begin ();
+				scheduler.Run ([this, &waiting, period] {
+					_inputLog->Tick (period);
+					return waiting ();
+				});
+				scheduler.Report ();
+			} else {
+				while (waiting ()){
+					std::this_thread::sleep_for (std::chrono::milliseconds (1));
+				}
+			}
 
+			if (!loading || !_runFlag){
+				return;
+			}
+			if (!_taskManager->ReloadGraph ()){
+				LOG_ERROR ("Could not add the newly loaded assets to the task graph");
+				return;
+			}
+		}
 	}
 
 	void Driver::Cleanup ()
 	{
+		CheckpointWritten ();
+		if (_inputLog->Mode () != INPUT_LIVE){
+			_inputLog->Report ();
+		}
+		_inputLog->Cleanup ();
 		_taskManager.reset ();
 		_assetFactory.reset ();
-		_pluginManager.reset ();
+		_pluginFactory.reset ();
 		_hpcManager.reset ();
 		_displayManager.reset ();
 		_eventManager.reset ();
@@ -179,7 +256,19 @@ namespace Sim {
 		return true;
 	}
 
-	// initialization method for CUDA HPC manager
+#	ifdef SIM_THREAD_SCHEDULER_ENABLED
+	// initialization method for std::thread based task manager
+	bool Driver::InitializeThreadManager (const char* config)
+	{
+		_taskManager = make_unique <ThreadTaskManager> ();
+		if (!_taskManager->Initialize (config)){
+			LOG_ERROR ("Thread task manager could not be initialized from " << config);
+			return false;
+		}
+		return true;
+	}
+#	else
+	// initialization method for Intel TBB task manager
 	bool Driver::InitializeTBBManager (const char* config)
 	{
 		_taskManager = make_unique <TBBTaskManager> ();
@@ -189,4 +278,5 @@ namespace Sim {
 		}
 		return true;
 	}
+#	endif
 }
@@ -76,13 +76,25 @@ namespace Sim {
 			}
 
 			// numerical plugin-related methods
-			void AddPlugin (unsigned int id, std::shared_ptr <Plugin> p) {_pluginManager->AddPlugin (id, p);}
-			std::shared_ptr <Plugin> GetPlugin (unsigned int id) const {return _pluginManager->GetPlugin (id);}
-			std::shared_ptr <Plugin> GetPlugin (const char* name) const {return _pluginManager->GetPlugin (name);}
+			void AddPlugin (unsigned int id, std::shared_ptr <Plugin> p) {_pluginFactory->AddPlugin (id, p);}
+			std::shared_ptr <Plugin> GetPlugin (unsigned int id) const {return _pluginFactory->GetPlugin (id);}
+			std::shared_ptr <Plugin> GetPlugin (const char* name) const {return _pluginFactory->GetPlugin (name);}
+
+			// asset-related methods
+			std::shared_ptr <Asset> GetAsset (unsigned int id) const {return _assetFactory->GetAsset (id);}
+			std::shared_ptr <Asset> GetAsset (const char* name) const {return _assetFactory->GetAsset (name);}
+			AssetFactory& GetAssetFactory () const {return *_assetFactory;}
+
+			// task-related methods (e.g. AdaptiveParallelFor for plugin loops)
+			TaskManager& GetTaskManager () const {return *_taskManager;}
 
 		protected:
 			bool InitializeGLDisplay (const char* config);
 			bool InitializeCUDAManager (const char* config);
+#			ifdef SIM_THREAD_SCHEDULER_ENABLED
+			bool InitializeThreadManager (const char* config);
+#			else
 			bool InitializeTBBManager (const char* config);
+#			endif
 	};
 }
@@ -0,0 +1,380 @@
+/**
+ * @file Driver.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * See Driver.h.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+#include "InputParser.h"
+#include "StartupProfiler.h"
+#include "SharedCache.h"
+#include "HeadlessDriver/Driver.h"
+#include "Assets/Geometry.h"
+#include "Driver/BatchRunner.h"
+#include "Driver/StartupGraph.h"
+#include "Display/Null/NullDisplayManager.h"
+#include "Events/InputLog.h"
+#include "HPC/CPU/CpuHPCManager.h"
+#include "Tasks/RateScheduler.h"
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+#	include "Tasks/Threads/ThreadTaskManager.h"
+#else
+#	include "Tasks/TBB/TBBTaskManager.h"
+#endif
+
+using std::make_unique;
+using std::chrono::duration;
+using tinyxml2::XMLElement;
+
+namespace Sim {
+
+	Driver* Driver::_instance = new Driver ();
+
+	bool Driver::Initialize (const char* configfile)
+	{
+		if (configfile == nullptr){
+			LOG_ERROR ("No input configuration file specified");
+			return false;
+		}
+
+		// the cold start is profiled until every asset is loaded (see Run ())
+		StartupProfiler& profiler = StartupProfiler::Instance ();
+		profiler.Begin ();
+		StartupProfiler::Phase phase ("Driver::Initialize");
+
+		// read configuration file
+		InputParser parser;
+		if (!parser.Initialize (configfile, "ChimeraConfig")){
+			LOG_ERROR ("Could not initialize parser for " << configfile);
+			return false;
+		}
+		if (!profiler.Initialize (parser.FindElement ("Startup"))){
+			LOG_ERROR ("Invalid start-up budgets in " << configfile);
+			return false;
+		}
+
+		// Initialize the event manager (always the first module to be initialized)
+		XMLElement* element = parser.GetElement ("EventManager");
+		if (element == nullptr){
+			LOG_ERROR ("Event manager profile not found in " << configfile);
+			return false;
+		}
+		if (!InitializeEventManager (element->Attribute ("Config"))){
+			Cleanup ();
+			return false;
+		}
+		element = nullptr;
+
+		XMLElement* plugins = parser.GetElement ("PluginManager");
+		if (plugins == nullptr){
+			LOG_ERROR ("Plugin loader profile not found in " << configfile);
+			Cleanup ();
+			return false;
+		}
+
+		XMLElement* assets = parser.GetElement ("AssetFactory");
+		if (assets == nullptr){
+			LOG_ERROR ("Asset loader profile not found in " << configfile);
+			Cleanup ();
+			return false;
+		}
+
+		/**
+		 * The input configuration may contain multiple task manager profiles. We
+		 * pick the one matching the scheduler package the framework was built with
+		 * ("Threads" or "IntelTBB").
+		 */
+#		ifdef SIM_THREAD_SCHEDULER_ENABLED
+		const char* scheduler = "Threads";
+#		else
+		const char* scheduler = "IntelTBB";
+#		endif
+		XMLElement* tasks = parser.GetElement ("TaskManager");
+		while (tasks != nullptr && strcmp (tasks->Attribute ("Type"), scheduler)){
+			tasks = tasks->NextSiblingElement ("TaskManager");
+		}
+		if (tasks == nullptr){
+			LOG_ERROR (scheduler << " task manager profile not found in " << configfile);
+			Cleanup ();
+			return false;
+		}
+
+		// inputs are recorded or replayed as set by the <Input> entry (none: live)
+		if (!InitializeInputLog (parser.FindElement ("Input"), assets->Attribute ("Config"))){
+			Cleanup ();
+			return false;
+		}
+
+		// a batch run shares read-only data between its instances, starting with the driver's own assets
+		XMLElement* batch = parser.FindElement ("Batch");
+		SharedCache::Instance ().SetEnabled (batch != nullptr);
+
+		/**
+		 * Bring up the other subsystems through the start-up graph (see the GL
+		 * driver). No display and no GPU: the null display and CPU HPC managers
+		 * need no profile and come up while the plugin libraries load. The task
+		 * manager starts on this thread, which runs the frames.
+		 */
+		StartupGraph startup;
+		startup.Add ("Display", [this] {return InitializeNullDisplay (nullptr);}, {}, true);
+		startup.Add ("HPC", [this] {return InitializeCPUManager (nullptr);}, {"Display"}, true);
+		startup.Add ("Plugins", [this, plugins] {return InitializePluginManager (plugins->Attribute ("Config"));}, {});
+		startup.Add ("Assets", [this, assets] {return InitializeAssetFactory (assets->Attribute ("Config"), assets->Attribute ("Snapshot"));},
+				{"Display", "HPC", "Plugins"}, true);
+#		ifdef SIM_THREAD_SCHEDULER_ENABLED
+		startup.Add ("Tasks", [this, tasks] {return InitializeThreadManager (tasks->Attribute ("Config"));}, {"Assets"}, true);
+#		else
+		startup.Add ("Tasks", [this, tasks] {return InitializeTBBManager (tasks->Attribute ("Config"));}, {"Assets"}, true);
+#		endif
+		if (!startup.Run ()){
+			Cleanup ();
+			return false;
+		}
+
+		// run limits and statistics
+		element = parser.GetElement ("Headless");
+		if (element != nullptr){
+			element->QueryUnsignedAttribute ("Frames", &_frames);
+			element->QueryDoubleAttribute ("Seconds", &_seconds);
+			element->QueryBoolAttribute ("Paced", &_paced);
+			const char* statistics = element->Attribute ("Statistics");
+			_statistics = statistics != nullptr ? statistics : "";
+			const char* checkpoint = element->Attribute ("Checkpoint");
+			_checkpointFile = checkpoint != nullptr ? checkpoint : "";
+			element->QueryUnsignedAttribute ("Resets", &_resets);
+		}
+		element = nullptr;
+		if (_resets > 0 && _checkpointFile.empty ()){
+			LOG_ERROR ("Scenario resets need a \'Checkpoint\' file in " << configfile);
+			Cleanup ();
+			return false;
+		}
+		if (batch != nullptr){
+			_batch = make_unique <BatchRunner> ();
+			if (!_batch->Initialize (*batch, _taskManager->ConfigFile (), _taskManager->ConfigRoot ())){
+				LOG_ERROR ("Invalid batch settings in " << configfile);
+				Cleanup ();
+				return false;
+			}
+		}
+
+		// Driver is now set to run
+		_runFlag = true;
+
+		return true;
+	}
+
+	/**
+	 * A batch run starts once every asset is loaded, with the complete task graph.
+	 * Unpaced, the ticks of the rates run back to back on this thread (see
+	 * RateScheduler::Advance ()); paced, the rate scheduler runs as in the GL
+	 * driver. A frame is a tick of the slowest rate. Every reset restores the
+	 * checkpoint taken before the first frame and runs the frames again.
+	 * A batch run instead runs its instances (see BatchRunner.h); the driver's
+	 * own assets are only loaded, which fills the shared cache for them.
+	 */
+	void Driver::Run ()
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		if (!_assetFactory->Wait ()){
+			LOG_ERROR ("Some assets failed to load. Aborting the run");
+			return;
+		}
+		StartupProfiler::Instance ().End ();
+		if (!_taskManager->ReloadGraph ()){
+			LOG_ERROR ("Could not build the task graph of the loaded assets");
+			return;
+		}
+		if (_batch){
+			if (!_batch->Run ()){
+				LOG_ERROR ("Some batch instances failed");
+			}
+			_batch->Report ();
+			SharedCache::Instance ().Report ();
+			Assets::Geometry::ReportInstances ();
+			_runFlag = false;
+			return;
+		}
+		Assets::Geometry::ReportInstances ();
+		if (!_checkpointFile.empty () && !Checkpoint (_checkpointFile.c_str ())){
+			return;
+		}
+		// a replay without run limits runs as many frames as were recorded
+		if (_inputLog->Mode () == INPUT_REPLAY){
+			if (_frames == 0 && _seconds <= 0.){
+				_frames = static_cast <unsigned int> (_inputLog->RecordedFrames ());
+			}
+			if (!_taskManager->Deterministic ()){
+				LOG_WARNING ("Replaying inputs without deterministic scheduling: runs may differ");
+			}
+		}
+
+		for (unsigned int run = 0; run <= _resets && _runFlag; ++run){
+			if (run > 0){
+				Clock::time_point begin = Clock::now ();
+				if (!Restore (_checkpointFile.c_str ())){
+					LOG_ERROR ("Could not reset the scenario");
+					return;
+				}
+				LOG ("Scenario reset " << run << " of " << _resets << " took " << 1000.*duration <double> (Clock::now () - begin).count () << " ms");
+			}
+			RateScheduler scheduler (*_taskManager);
+			if (!scheduler.Initialize ()){
+				LOG_ERROR ("Could not initialize the multi-rate scheduler");
+				return;
+			}
+			// the inputs are applied between frames
+			double period = scheduler.SlowestRate () > 0. ? 1./scheduler.SlowestRate () : 0.;
+			_inputLog->Rewind ();
+			_inputLog->Begin ();
+
+			std::vector <double> frames;
+			frames.reserve (_frames);
+			Clock::time_point start = Clock::now ();
+			Clock::time_point last = start;
+			auto proceed = [this, &frames, &start, &last, period] {
+				_inputLog->Tick (period);
+				Clock::time_point now = Clock::now ();
+				frames.push_back (duration <double> (now - last).count ());
+				last = now;
+				return _runFlag && (_frames == 0 || frames.size () < _frames) &&
+						(_seconds <= 0. || duration <double> (now - start).count () < _seconds);
+			};
+
+			LOG ("Running " << (_paced ? "paced" : "unpaced") << " for " << (_frames > 0 ? std::to_string (_frames) : "any number of")
+					<< " frames" << (_seconds > 0. ? " or " + std::to_string (_seconds) + " s" : ""));
+			if (_paced){
+				scheduler.Run (proceed);
+			} else {
+				do {
+					scheduler.Advance ();
+				} while (proceed ());
+			}
+			double seconds = duration <double> (Clock::now () - start).count ();
+
+			scheduler.Report ();
+			ReportStatistics (frames, seconds);
+			if (_inputLog->Mode () != INPUT_LIVE){
+				_inputLog->Report ();
+			}
+		}
+		_runFlag = false;
+	}
+
+	void Driver::Cleanup ()
+	{
+		CheckpointWritten ();
+		_inputLog->Cleanup ();
+		_batch.reset ();
+		_taskManager.reset ();
+		_assetFactory.reset ();
+		_pluginFactory.reset ();
+		_hpcManager.reset ();
+		_displayManager.reset ();
+		_eventManager.reset ();
+		SharedCache::Instance ().Clear ();
+	}
+
+	void Driver::ReportStatistics (const std::vector <double>& frames, double seconds) const
+	{
+		if (frames.empty ()){
+			LOG_WARNING ("No frames were run");
+			return;
+		}
+		std::vector <double> sorted (frames);
+		std::sort (sorted.begin (), sorted.end ());
+		double mean = 0.;
+		for (auto f : sorted){
+			mean += f;
+		}
+		mean /= sorted.size ();
+		double jitter = 0.; // deviation of the frame times from their mean
+		for (auto f : sorted){
+			jitter += (f - mean)*(f - mean);
+		}
+		jitter = std::sqrt (jitter/sorted.size ());
+		double median = sorted [sorted.size ()/2];
+		double p99 = sorted [std::min (sorted.size () - 1, sorted.size ()*99/100)];
+		double max = sorted.back ();
+
+		LOG ("Ran " << frames.size () << " frames in " << seconds << " s (" << frames.size ()/seconds << " frames/s). Frame time: mean "
+				<< 1000.*mean << " ms, median " << 1000.*median << " ms, 99th percentile " << 1000.*p99 << " ms, max " << 1000.*max << " ms, jitter " << 1000.*jitter << " ms rms");
+		if (_statistics.empty ()){
+			return;
+		}
+		std::ofstream out (_statistics);
+		if (!out.is_open ()){
+			LOG_ERROR ("Could not write the run statistics to " << _statistics);
+			return;
+		}
+		out << "{" << std::endl;
+		out << "\t\"frames\": " << frames.size () << "," << std::endl;
+		out << "\t\"seconds\": " << seconds << "," << std::endl;
+		out << "\t\"fps\": " << frames.size ()/seconds << "," << std::endl;
+		out << "\t\"paced\": " << (_paced ? "true" : "false") << "," << std::endl;
+		out << "\t\"threads\": " << _taskManager->ThreadCount () << "," << std::endl;
+		out << "\t\"frame_ms\": {\"mean\": " << 1000.*mean << ", \"median\": " << 1000.*median << ", \"p99\": " << 1000.*p99
+				<< ", \"max\": " << 1000.*max << ", \"jitter\": " << 1000.*jitter << "}" << std::endl;
+		out << "}" << std::endl;
+		LOG ("Run statistics written to " << _statistics);
+	}
+
+	// initialization method for the null display manager
+	bool Driver::InitializeNullDisplay (const char* config)
+	{
+		_displayManager = make_unique <NullDisplayManager> ();
+		if (!_displayManager->Initialize (config)){
+			LOG_ERROR ("Null display manager could not be initialized");
+			return false;
+		}
+		return true;
+	}
+
+	// initialization method for CPU HPC manager
+	bool Driver::InitializeCPUManager (const char* config)
+	{
+		_hpcManager = make_unique <CpuHPCManager> ();
+		if (!_hpcManager->Initialize (config)){
+			LOG_ERROR ("CPU HPC manager could not be initialized");
+			return false;
+		}
+		return true;
+	}
+
+#	ifdef SIM_THREAD_SCHEDULER_ENABLED
+	// initialization method for std::thread based task manager
+	bool Driver::InitializeThreadManager (const char* config)
+	{
+		_taskManager = make_unique <ThreadTaskManager> ();
+		if (!_taskManager->Initialize (config)){
+			LOG_ERROR ("Thread task manager could not be initialized from " << config);
+			return false;
+		}
+		return true;
+	}
+#	else
+	// initialization method for Intel TBB task manager
+	bool Driver::InitializeTBBManager (const char* config)
+	{
+		_taskManager = make_unique <TBBTaskManager> ();
+		if (!_taskManager->Initialize (config)){
+			LOG_ERROR ("Intel TBB task manager could not be initialized from " << config);
+			return false;
+		}
+		return true;
+	}
+#	endif
+}
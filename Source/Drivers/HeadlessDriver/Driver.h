@@ -0,0 +1,103 @@
+/**
+ * @file Driver.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The headless CPU-only driver derived from the BaseDriver class, for
+ * batch simulations and performance tests on servers without a display
+ * or GPU: it uses the null display and CPU HPC managers. Plugins and
+ * assets are loaded as by the GL driver; Run () then waits for every
+ * asset and runs the task graph for a number of frames (ticks of the
+ * slowest rate) or until a time limit, as set by the <Headless> entry of
+ * the configuration file, and reports the frame statistics. With a
+ * 'Checkpoint' file the loaded scenario is checkpointed before the first
+ * frame, and 'Resets' reruns it that many times, each time restored from
+ * the checkpoint. With an <Input Replay> entry the inputs of a recorded
+ * session (see InputLog.h) are replayed on every run, for as many frames
+ * as were recorded unless limited otherwise. With a <Batch> entry Run ()
+ * runs many instances of some scenarios concurrently instead (see
+ * BatchRunner.h).
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Preprocess.h"
+
+#include "Assets/AssetFactory.h"
+#include "Display/DisplayManager.h"
+#include "Events/EventManager.h"
+#include "HPC/HPCManager.h"
+#include "Plugins/PluginManager.h"
+#include "Plugins/Plugin.h"
+#include "Tasks/TaskManager.h"
+#include "Driver/BaseDriver.h"
+#include "Driver/BatchRunner.h"
+
+namespace Sim {
+
+	class Driver : public BaseDriver {
+
+		protected:
+			static Driver* _instance;
+
+			// run limits (0: none; with neither set the run lasts until Quit ())
+			unsigned int _frames;
+			double _seconds;
+			// ticks paced at their rates (false: frames run back to back)
+			bool _paced;
+			// file the statistics are written to (empty: only logged)
+			std::string _statistics;
+			// snapshot of the loaded scenario (empty: none) and the runs restored from it
+			std::string _checkpointFile;
+			unsigned int _resets;
+			// instances run instead of the driver's scene (null: none)
+			std::unique_ptr <BatchRunner> _batch;
+
+		protected:
+			Driver (): _frames (0), _seconds (0.), _paced (false), _resets (0) {LOG ("Headless Driver constructed");}
+
+			// forbidden copy constructor and assignment operator
+			Driver (const Driver&) = delete;
+			Driver& operator = (const Driver&) = delete;
+
+		public:
+			static Driver& Instance () {return *_instance;}
+			~Driver () {LOG ("Headless Driver destroyed");}
+
+			virtual bool Initialize (const char* config);
+			virtual void Run ();
+			virtual void Cleanup ();
+
+			// override the run limits of the configuration file
+			void SetLimits (unsigned int frames, double seconds) {_frames = frames; _seconds = seconds;}
+
+			// numerical plugin-related methods
+			void AddPlugin (unsigned int id, std::shared_ptr <Plugin> p) {_pluginFactory->AddPlugin (id, p);}
+			std::shared_ptr <Plugin> GetPlugin (unsigned int id) const {return _pluginFactory->GetPlugin (id);}
+			std::shared_ptr <Plugin> GetPlugin (const char* name) const {return _pluginFactory->GetPlugin (name);}
+
+			// asset-related methods
+			std::shared_ptr <Asset> GetAsset (unsigned int id) const {return _assetFactory->GetAsset (id);}
+			std::shared_ptr <Asset> GetAsset (const char* name) const {return _assetFactory->GetAsset (name);}
+			AssetFactory& GetAssetFactory () const {return *_assetFactory;}
+
+			// task-related methods (e.g. AdaptiveParallelFor for plugin loops)
+			TaskManager& GetTaskManager () const {return *_taskManager;}
+
+		protected:
+			bool InitializeNullDisplay (const char* config);
+			bool InitializeCPUManager (const char* config);
+#			ifdef SIM_THREAD_SCHEDULER_ENABLED
+			bool InitializeThreadManager (const char* config);
+#			else
+			bool InitializeTBBManager (const char* config);
+#			endif
+			// log the frame times (seconds) of a run and write them to the statistics file
+			void ReportStatistics (const std::vector <double>& frames, double seconds) const;
+	};
+}
@@ -0,0 +1,58 @@
+/**
+ * @file main.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The entry point of headless runs of the Chimera simulation framework.
+ * The driver loads the configuration, runs the simulation for the given
+ * number of frames or time limit (overriding those of the configuration
+ * file), reports the run statistics and exits cleanly.
+ */
+#include <cstdlib>
+#include <cstring>
+
+#include "Preprocess.h"
+#include "HeadlessDriver/Driver.h"
+
+using Sim::Driver;
+
+int main (int argc, const char** argv)
+{
+	// sanity check
+		if (argc == 2) {
+			if (!strcmp (argv [1], "-h") || !strcmp (argv [1], "--help")){
+				LOG ("Usage: ./Bin/simulateHeadless <config file> (default: Assets/Config/HeadlessConfig.xml) [frames] [seconds]");
+				exit (EXIT_SUCCESS);
+			}
+		}
+
+		// READ INPUT FILE AND INITIALIZE
+		{
+			const char* input = nullptr;
+			if (argc < 2){
+				input = "Assets/Config/HeadlessConfig.xml";
+			} else {
+				input = argv [1];
+			}
+			LOG ("Reading " << input << "...");
+			if (!Driver::Instance ().Initialize (input)){
+				LOG_ERROR ("Fatal error: Application failed to start. Aborting..");
+
+				Driver::Instance() .Quit ();
+				exit (EXIT_FAILURE);
+			}
+			if (argc > 2){
+				Driver::Instance ().SetLimits (static_cast <unsigned int> (atoi (argv [2])), argc > 3 ? atof (argv [3]) : 0.);
+			}
+		}
+
+		// THE MAIN LOOP
+		Driver::Instance ().Run ();
+
+		// PREPARE FOR EXITING: CLEAN ALL APP RESOURCES
+		Driver::Instance ().Cleanup ();
+
+	exit (EXIT_SUCCESS);
+}
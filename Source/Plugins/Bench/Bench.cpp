@@ -0,0 +1,31 @@
+/**
+ * @file Bench.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Entry point of the CPU stand-in plugin (see BenchPlugin.h) built as a
+ * library, so that the headless driver runs a scene without GPU or vendor
+ * plugins.
+ */
+
+#include <memory>
+
+#include "Preprocess.h"
+#include "Driver.h"
+
+#include "BenchPlugin.h"
+
+using std::shared_ptr;
+using std::make_shared;
+
+namespace Sim {
+
+	extern "C" EXPORT void
+	StartPlugin (unsigned int id)
+	{
+		shared_ptr <BenchPlugin> plugin = make_shared <BenchPlugin> ();
+		Driver::Instance().AddPlugin (id, shared_ptr <Plugin> (plugin));
+	}
+}
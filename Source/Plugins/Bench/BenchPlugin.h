@@ -0,0 +1,634 @@
+/**
+ * @file BenchPlugin.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * CPU stand-in loading plugin ("Bench"), so that a scene runs without GPU
+ * or vendor plugins. The benchmarks build it in; the headless driver loads
+ * it as a library (see Bench.cpp). It loads:
+ *   Geometry:     the Geometry component; with 'Tessellation' set and no
+ *                 mesh at 'Location', a torus of that tessellation is
+ *                 written there first (see BenchMesh.h);
+ *   Physics:      a smoothing step over the geometry, splittable over its
+ *                 spatial subsets (see BenchPhysics), repeated for up to
+ *                 'Iterations' passes as a solver would iterate; a tool
+ *                 pose aimed at the asset moves its rest shape to the pose
+ *                 position;
+ *   Collision,
+ *   Intersection: finds the vertices of the asset inside the subset
+ *                 bounds of every other asset and their penetration
+ *                 energy (see BenchCollision);
+ *   Render:       copies the buffer render would draw into a staging
+ *                 array, as an upload would;
+ *   Motion:       a damped spring pulling the asset's position towards
+ *                 a target (the position of the last tool pose aimed at
+ *                 it), without geometry. With Storage="System" it is an
+ *                 element of the factory's Motion system (see
+ *                 ComponentSystem.h) rather than an object of its own.
+ * Under adaptive quality (see QualityGovernor.h) physics gives up passes
+ * ("Iterations"), collision tests every 2nd or 4th vertex ("LOD") and
+ * render refreshes a rotating half or quarter of the subsets per update
+ * ("Culling").
+ * All of them can be checkpointed and restored (see AssetFactory).
+ * The plugin is shared by every simulation instance of a batch run; the
+ * geometries colliders look at are kept per asset factory (scene).
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "Vector.h"
+#include "Snapshot.h"
+#include "Driver.h"
+#include "Events/InputLog.h"
+#include "Plugins/Plugin.h"
+#include "Assets/Asset.h"
+#include "Assets/AssetFactory.h"
+#include "Assets/Component.h"
+#include "Assets/Geometry.h"
+#include "Tasks/QualityGovernor.h"
+#include "Tasks/TaskManager.h"
+#include "BenchMesh.h"
+
+namespace Sim {
+
+	// folds the bytes of a value into a running FNV-1a digest
+	inline void Digest (unsigned long long& digest, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast <const unsigned char*> (data);
+		for (size_t i = 0; i < size; ++i){
+			digest = (digest ^ bytes [i])*1099511628211ull;
+		}
+	}
+
+	// physics that advances its phase every step
+	class FramePhysics : public BenchPhysics {
+		protected:
+			Vector _position; // of the tool pose applied last
+			QualityKnob _iterations; // passes per step
+
+		public:
+			explicit FramePhysics (Assets::Geometry& geometry, bool precompute = true)
+			: BenchPhysics (geometry, precompute), _position (Vector::ZERO), _iterations ("Iterations", 1, 1, 2) {}
+
+			virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) override
+			{
+				unsigned int iterations = 1;
+				config.QueryUnsignedAttribute ("Iterations", &iterations);
+				_iterations.SetMax (static_cast <int> (std::max (iterations, 1u)));
+				return true;
+			}
+
+			virtual void Update () override
+			{
+				unsigned int count = _geometry.SubsetCount () > 0 ? _geometry.SubsetCount () : 1;
+				for (unsigned int i = 0; i < count; ++i){
+					UpdateSubset (i);
+				}
+				MergeSubsets ();
+			}
+
+			// the passes all read the previous buffer: they cost what iterations would, for the same result
+			virtual void UpdateSubset (unsigned int subset) override
+			{
+				for (int i = _iterations.Level (); i > 0; --i){
+					BenchPhysics::UpdateSubset (subset);
+				}
+			}
+
+			virtual void MergeSubsets () override {_phase += 0.05;}
+
+			virtual void QualityKnobs (std::vector <QualityKnob*>& knobs) override {knobs.push_back (&_iterations);}
+
+			virtual bool Save (SnapshotWriter& snapshot) const override
+			{
+				BenchPhysics::Save (snapshot);
+				snapshot.Write (static_cast <unsigned int> (_iterations.Max ()));
+				return true;
+			}
+
+			virtual bool Restore (SnapshotReader& snapshot) override
+			{
+				unsigned int iterations = 1;
+				if (!BenchPhysics::Restore (snapshot) || !snapshot.Read (iterations)){
+					return false;
+				}
+				_iterations.SetMax (static_cast <int> (iterations));
+				return true;
+			}
+
+			// the rest shape follows the position of the tool (it is saved with the rest shape)
+			virtual bool ApplyInput (const Input& input) override
+			{
+				if (input._type != INPUT_TOOL_POSE || input._values.size () < 3){
+					return false;
+				}
+				Vector delta (Vector::ZERO);
+				for (unsigned int j = 0; j < 3; ++j){
+					delta [j] = static_cast <Real> (input._values [j]) - _position [j];
+					_position [j] = static_cast <Real> (input._values [j]);
+				}
+				for (auto &r : _rest){
+					r += delta;
+				}
+				return true;
+			}
+
+			// back to the rest shape in every buffer of the (three buffer) ring
+			void Reset ()
+			{
+				_phase = 0.;
+				for (unsigned int i = 0; i < 3; ++i){
+					std::copy (_rest.begin (), _rest.end (), _geometry.CurrentVertexBuffer ());
+					_geometry.Update ();
+				}
+			}
+	};
+
+	/**
+	 * Vertices of the asset inside a subset bound of another asset are
+	 * contacts; the penetration energy sums their squared depths. Unsplit,
+	 * both are computed by parallel loops of the task manager (a reduction
+	 * and an ordered gather); split, per subset and merged in subset order.
+	 * Every update is folded into a digest, which tells whether two runs
+	 * were bit-identical. At a reduced level of detail only every 2nd or
+	 * 4th vertex is tested.
+	 */
+	class BenchCollision : public Assets::Component {
+		protected:
+			std::string _name;
+			Assets::Geometry& _geometry;
+			const std::vector <std::shared_ptr <Assets::Geometry> >& _scene;
+			std::vector <std::vector <unsigned int> > _subsetContacts;
+			std::vector <double> _subsetEnergies;
+			std::vector <unsigned int> _contacts;
+			double _energy;
+			unsigned long long _digest;
+			QualityKnob _lod;
+
+		public:
+			BenchCollision (const char* name, Assets::Geometry& geometry, const std::vector <std::shared_ptr <Assets::Geometry> >& scene)
+			: _name (name), _geometry (geometry), _scene (scene), _subsetContacts (geometry.SubsetCount ()),
+				_subsetEnergies (geometry.SubsetCount (), 0.), _energy (0.), _digest (0), _lod ("LOD", 0, 2, 1)
+			{
+				Reset ();
+			}
+
+			virtual const std::string Name () const override {return _name;}
+			virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) override {return true;}
+			virtual void Cleanup () override {}
+
+			virtual void Update () override
+			{
+				std::vector <const AxisAlignedBox*> boxes;
+				OtherBounds (nullptr, boxes);
+				const Vector* vertices = _geometry.LatchedVertexBuffer ();
+				TaskManager* current = TaskManager::Current ();
+				TaskManager& manager = current != nullptr ? *current : Driver::Instance ().GetTaskManager ();
+				const unsigned int stride = Stride ();
+
+				_energy = manager.ParallelReduce (0, _geometry.SurfaceVertexCount (), 0, 0.,
+						[&] (unsigned int b, unsigned int e, double energy){
+					for (unsigned int v = b; v < e; ++v){
+						energy += v % stride == 0 ? Penetration (vertices [v], boxes) : 0.;
+					}
+					return energy;
+				}, [] (double x, double y) {return x + y;});
+
+				manager.ParallelCollect (0, _geometry.SurfaceVertexCount (), 0,
+						[&] (unsigned int b, unsigned int e, std::vector <unsigned int>& contacts){
+					for (unsigned int v = b; v < e; ++v){
+						if (v % stride == 0 && Penetration (vertices [v], boxes) > 0.){
+							contacts.push_back (v);
+						}
+					}
+				}, _contacts);
+				Fold ();
+			}
+
+			virtual unsigned int SubsetCount () const override {return _geometry.SubsetCount ();}
+
+			virtual void UpdateSubset (unsigned int subset) override
+			{
+				std::vector <const AxisAlignedBox*> boxes;
+				OtherBounds (&_geometry.SubsetBound (subset), boxes);
+				const Vector* vertices = _geometry.LatchedVertexBuffer ();
+				double energy = 0.;
+				std::vector <unsigned int>& contacts = _subsetContacts [subset];
+				contacts.clear ();
+				const std::vector <unsigned int>& owned = _geometry.SubsetVertices (subset);
+				for (size_t i = 0; i < owned.size (); i += Stride ()){
+					unsigned int v = owned [i];
+					double penetration = Penetration (vertices [v], boxes);
+					if (penetration > 0.){
+						energy += penetration;
+						contacts.push_back (v);
+					}
+				}
+				_subsetEnergies [subset] = energy;
+			}
+
+			virtual void MergeSubsets () override
+			{
+				_energy = 0.;
+				_contacts.clear ();
+				for (unsigned int s = 0; s < _subsetContacts.size (); ++s){
+					_energy += _subsetEnergies [s];
+					_contacts.insert (_contacts.end (), _subsetContacts [s].begin (), _subsetContacts [s].end ());
+				}
+				Fold ();
+			}
+
+			// per-subset results are rebuilt by every update and not saved
+			virtual bool Save (SnapshotWriter& snapshot) const override
+			{
+				snapshot.Write (_contacts);
+				snapshot.Write (_energy);
+				snapshot.Write (_digest);
+				return true;
+			}
+
+			virtual bool Restore (SnapshotReader& snapshot) override
+			{
+				return snapshot.Read (_contacts) && snapshot.Read (_energy) && snapshot.Read (_digest);
+			}
+
+			virtual void QualityKnobs (std::vector <QualityKnob*>& knobs) override {knobs.push_back (&_lod);}
+
+			unsigned int Contacts () const {return static_cast <unsigned int> (_contacts.size ());}
+			double Energy () const {return _energy;}
+			unsigned long long Fingerprint () const {return _digest;}
+			void Reset () {_digest = 14695981039346656037ull;}
+
+		protected:
+			// every how many vertices are tested
+			unsigned int Stride () const {return 1u << (_lod.Max () - _lod.Level ());}
+
+			void Fold ()
+			{
+				Digest (_digest, &_energy, sizeof (_energy));
+				Digest (_digest, _contacts.data (), _contacts.size ()*sizeof (unsigned int));
+			}
+
+			// subset bounds of the other assets (that overlap 'bound' if given)
+			void OtherBounds (const AxisAlignedBox* bound, std::vector <const AxisAlignedBox*>& boxes) const
+			{
+				for (auto &g : _scene){
+					if (g.get () == &_geometry){
+						continue;
+					}
+					unsigned int others = g->SubsetCount () > 0 ? g->SubsetCount () : 1;
+					for (unsigned int t = 0; t < others; ++t){
+						if (bound == nullptr || Overlap (*bound, g->SubsetBound (t))){
+							boxes.push_back (&g->SubsetBound (t));
+						}
+					}
+				}
+			}
+
+			// summed squared depth of a vertex inside the boxes (0: no contact)
+			static double Penetration (const Vector& p, const std::vector <const AxisAlignedBox*>& boxes)
+			{
+				double energy = 0.;
+				for (auto b : boxes){
+					Vector min ((*b) [0]), max ((*b) [7]);
+					double depth = -1.;
+					for (unsigned int j = 0; j < 3; ++j){
+						double d = std::min (p [j] - min [j], max [j] - p [j]);
+						depth = j == 0 || d < depth ? d : depth;
+					}
+					energy += depth > 0. ? depth*depth : 0.;
+				}
+				return energy;
+			}
+
+			static bool Overlap (const AxisAlignedBox& a, const AxisAlignedBox& b)
+			{
+				Vector amin (a [0]), amax (a [7]), bmin (b [0]), bmax (b [7]);
+				for (unsigned int j = 0; j < 3; ++j){
+					if (amax [j] < bmin [j] || bmax [j] < amin [j]){
+						return false;
+					}
+				}
+				return true;
+			}
+	};
+
+	// below full quality, only the subsets whose turn it is are refreshed
+	class BenchRender : public Assets::Component {
+		protected:
+			Assets::Geometry& _geometry;
+			std::vector <Vector> _staging;
+			QualityKnob _culling;
+			unsigned int _updates;
+
+		public:
+			explicit BenchRender (Assets::Geometry& geometry)
+			: _geometry (geometry), _staging (geometry.SurfaceVertexCount ()), _culling ("Culling", 0, 2), _updates (0) {}
+
+			virtual const std::string Name () const override {return "Render";}
+			virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) override {return true;}
+			virtual void Cleanup () override {}
+
+			virtual void Update () override
+			{
+				const Vector* vertices = _geometry.RenderVertexBuffer ();
+				unsigned int turns = 1u << (_culling.Max () - _culling.Level ());
+				unsigned int turn = _updates++ % turns;
+				if (turns == 1 || _geometry.SubsetCount () == 0){
+					std::copy (vertices, vertices + _staging.size (), _staging.begin ());
+					return;
+				}
+				for (unsigned int s = turn; s < _geometry.SubsetCount (); s += turns){
+					for (auto v : _geometry.SubsetVertices (s)){
+						_staging [v] = vertices [v];
+					}
+				}
+			}
+
+			virtual void QualityKnobs (std::vector <QualityKnob*>& knobs) override {knobs.push_back (&_culling);}
+
+			// the staging array is rewritten by every update: there is no state to save
+			virtual bool Save (SnapshotWriter& snapshot) const override {return true;}
+			virtual bool Restore (SnapshotReader& snapshot) override {return true;}
+	};
+
+	// state of a Motion component: stored by value, updated without a virtual call
+	class MotionState {
+		public:
+			Real _position [3];
+			Real _velocity [3];
+			Real _target [3];
+			Real _stiffness;
+			Real _damping;
+			Real _step; // seconds
+
+			void Update ()
+			{
+				for (unsigned int j = 0; j < 3; ++j){
+					_velocity [j] += _step*(_stiffness*(_target [j] - _position [j]) - _damping*_velocity [j]);
+					_position [j] += _step*_velocity [j];
+				}
+			}
+
+			bool Initialize (tinyxml2::XMLElement& config)
+			{
+				double stiffness = 40., damping = 4., step = 1./60.;
+				config.QueryDoubleAttribute ("Stiffness", &stiffness);
+				config.QueryDoubleAttribute ("Damping", &damping);
+				config.QueryDoubleAttribute ("Step", &step);
+				for (unsigned int j = 0; j < 3; ++j){
+					_position [j] = _velocity [j] = _target [j] = 0.;
+				}
+				const char* axes [3] = {"X", "Y", "Z"};
+				for (unsigned int j = 0; j < 3; ++j){
+					double x = 0.;
+					config.QueryDoubleAttribute (axes [j], &x);
+					_position [j] = static_cast <Real> (x);
+				}
+				_stiffness = static_cast <Real> (stiffness);
+				_damping = static_cast <Real> (damping);
+				_step = static_cast <Real> (step);
+				return step > 0.;
+			}
+
+			bool ApplyInput (const Input& input)
+			{
+				if (input._type != INPUT_TOOL_POSE || input._values.size () < 3){
+					return false;
+				}
+				for (unsigned int j = 0; j < 3; ++j){
+					_target [j] = static_cast <Real> (input._values [j]);
+				}
+				return true;
+			}
+	};
+
+	// checkpoints of a Motion component start with its storage
+	typedef enum {
+		MOTION_OBJECT = 0,
+		MOTION_ELEMENT
+	} MotionStorage;
+
+	// the object variant: one heap object per asset behind a virtual update
+	class BenchMotion : public Assets::Component {
+		protected:
+			MotionState _state;
+
+		public:
+			BenchMotion () {}
+			explicit BenchMotion (const MotionState& state): _state (state) {}
+
+			virtual const std::string Name () const override {return "Motion";}
+			virtual bool Initialize (tinyxml2::XMLElement& config, Asset* asset) override {return _state.Initialize (config);}
+			virtual void Cleanup () override {}
+			virtual void Update () override {_state.Update ();}
+
+			MotionState& State () {return _state;}
+			const MotionState& State () const {return _state;}
+
+			virtual bool Save (SnapshotWriter& snapshot) const override
+			{
+				snapshot.Write (static_cast <unsigned char> (MOTION_OBJECT));
+				snapshot.Write (&_state, 1);
+				return true;
+			}
+
+			virtual bool Restore (SnapshotReader& snapshot) override
+			{
+				unsigned char storage = MOTION_ELEMENT;
+				return snapshot.Read (storage) && storage == MOTION_OBJECT && snapshot.Read (&_state, 1);
+			}
+
+			virtual bool ApplyInput (const Input& input) override {return _state.ApplyInput (input);}
+	};
+
+	// the system variant: the Motion of every asset of a factory in one array
+	class MotionSystem : public Assets::ComponentArray <MotionState> {
+		public:
+			explicit MotionSystem (const std::string& type): Assets::ComponentArray <MotionState> (type) {}
+
+			virtual bool SaveElement (unsigned int index, SnapshotWriter& snapshot) const override
+			{
+				snapshot.Write (static_cast <unsigned char> (MOTION_ELEMENT));
+				return Assets::ComponentArray <MotionState>::SaveElement (index, snapshot);
+			}
+
+			virtual bool RestoreElement (unsigned int index, SnapshotReader& snapshot) override
+			{
+				unsigned char storage = MOTION_OBJECT;
+				return snapshot.Read (storage) && storage == MOTION_ELEMENT && Assets::ComponentArray <MotionState>::RestoreElement (index, snapshot);
+			}
+
+			virtual bool ApplyInput (unsigned int index, const Input& input) override {return _elements [index].ApplyInput (input);}
+	};
+
+	class BenchPlugin : public Plugin {
+		protected:
+			std::mutex _mutex;
+			// geometries of every scene (asset factory), complete once the scene is loaded
+			std::map <const AssetFactory*, std::vector <std::shared_ptr <Assets::Geometry> > > _scenes;
+
+		public:
+			BenchPlugin () {}
+			virtual ~BenchPlugin () {}
+
+			virtual const char* Name () const override {return "Bench";}
+
+			// called concurrently for different assets by asynchronous loading
+			virtual bool InitializeAssetComponent (const char* component, tinyxml2::XMLElement& config, Asset* asset) override
+			{
+				if (!strcmp (component, "Geometry")){
+					return InitializeGeometry (config, asset);
+				}
+				if (!strcmp (component, "Motion")){
+					return InitializeMotion (config, asset);
+				}
+				std::shared_ptr <Assets::Component> c = NewComponent (component, asset, true);
+				if (!c || !c->Initialize (config, asset)){
+					return false;
+				}
+				asset->AddComponent (component, c);
+				return true;
+			}
+
+			virtual bool RestoreAssetComponent (const char* component, SnapshotReader& snapshot, Asset* asset) override
+			{
+				if (!strcmp (component, "Motion")){
+					return RestoreMotion (snapshot, asset);
+				}
+				std::shared_ptr <Assets::Component> c;
+				if (!strcmp (component, "Geometry")){
+					c = std::make_shared <Assets::Geometry> ();
+				} else {
+					c = NewComponent (component, asset, false);
+				}
+				if (!c || !c->Restore (snapshot)){
+					return false;
+				}
+				asset->AddComponent (component, c);
+				if (!strcmp (component, "Geometry")){
+					std::lock_guard <std::mutex> lock (_mutex);
+					_scenes [asset->Factory ()].push_back (std::static_pointer_cast <Assets::Geometry> (c));
+				}
+				return true;
+			}
+
+			virtual void ReleaseAssets (const AssetFactory* factory) override
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_scenes.erase (factory);
+			}
+
+			virtual void Cleanup () override
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_scenes.clear ();
+			}
+
+		protected:
+			// a component over the asset's geometry (without precomputation when it is to be restored)
+			std::shared_ptr <Assets::Component> NewComponent (const char* component, Asset* asset, bool precompute)
+			{
+				unsigned int gid = SIM_COMPONENT_ID ("Geometry");
+				if (!asset->HasComponent (gid)){
+					LOG_ERROR ("The bench " << component << " component needs the asset's Geometry loaded first");
+					return std::shared_ptr <Assets::Component> ();
+				}
+				Assets::Geometry& geometry = *asset->GetComponent <Assets::Geometry> (gid);
+
+				if (!strcmp (component, "Physics")){
+					return std::make_shared <FramePhysics> (geometry, precompute);
+				}
+				if (!strcmp (component, "Collision") || !strcmp (component, "Intersection")){
+					// map nodes stay put, so the collider may hold on to its scene
+					std::lock_guard <std::mutex> lock (_mutex);
+					return std::make_shared <BenchCollision> (component, geometry, _scenes [asset->Factory ()]);
+				}
+				if (!strcmp (component, "Render")){
+					return std::make_shared <BenchRender> (geometry);
+				}
+				LOG_ERROR ("The bench plugin can not load " << component << " components");
+				return std::shared_ptr <Assets::Component> ();
+			}
+
+			bool InitializeMotion (tinyxml2::XMLElement& config, Asset* asset)
+			{
+				MotionState state;
+				if (!state.Initialize (config)){
+					LOG_ERROR ("Invalid bench motion of asset " << asset->Id ());
+					return false;
+				}
+				const char* storage = config.Attribute ("Storage");
+				if (storage != nullptr && !strcmp (storage, "System")){
+					asset->AddElement ("Motion", asset->Factory ()->System <MotionSystem> ("Motion").Add (asset, state));
+				} else {
+					asset->AddComponent ("Motion", std::make_shared <BenchMotion> (state));
+				}
+				return true;
+			}
+
+			// the storage the component was checkpointed from decides the one it is restored to
+			bool RestoreMotion (SnapshotReader& snapshot, Asset* asset)
+			{
+				unsigned char storage = MOTION_OBJECT;
+				MotionState state;
+				if (!snapshot.Read (storage) || !snapshot.Read (&state, 1)){
+					return false;
+				}
+				if (storage == MOTION_ELEMENT){
+					asset->AddElement ("Motion", asset->Factory ()->System <MotionSystem> ("Motion").Add (asset, state));
+				} else {
+					asset->AddComponent ("Motion", std::make_shared <BenchMotion> (state));
+				}
+				return true;
+			}
+
+			bool InitializeGeometry (tinyxml2::XMLElement& config, Asset* asset)
+			{
+				unsigned int tessellation = 0;
+				unsigned int depth = 0;
+				config.QueryUnsignedAttribute ("Tessellation", &tessellation);
+				config.QueryUnsignedAttribute ("Depth", &depth);
+				const char* prefix = config.Attribute ("Prefix");
+				const char* location = config.Attribute ("Location");
+				if (tessellation > 0 && prefix != nullptr && location != nullptr){
+					std::string dir (location);
+					if (!dir.empty () && dir [dir.size () - 1] == '/'){
+						dir.erase (dir.size () - 1);
+					}
+					std::string node = dir + "/" + std::to_string (depth) + "/" + prefix + ".node";
+					for (size_t p = dir.find ('/', 1); p != std::string::npos; p = dir.find ('/', p + 1)){
+						mkdir (dir.substr (0, p).c_str (), 0755); // parents of the location
+					}
+					if (!std::ifstream (node).good () && !WriteMesh (dir, prefix, depth, tessellation)){
+						LOG_ERROR ("Could not write the bench mesh " << node);
+						return false;
+					}
+				}
+
+				std::shared_ptr <Assets::Geometry> geometry = std::make_shared <Assets::Geometry> ();
+				if (!geometry->Initialize (config, asset)){
+					return false;
+				}
+				asset->AddComponent ("Geometry", geometry);
+				std::lock_guard <std::mutex> lock (_mutex);
+				_scenes [asset->Factory ()].push_back (geometry);
+				return true;
+			}
+	};
+}
@@ -37,7 +37,7 @@ namespace Sim {
 
 		bool CuglMsdPhysics::Initialize (XMLElement& config, Asset* asset)
 		{
-			CuglMsdRender* c = asset->GetComponent <CuglMsdRender> ("Render").get ();
+			CuglMsdRender* c = asset->GetComponent <CuglMsdRender> (SIM_COMPONENT_ID ("Render")).get ();
 
 			LOG_CUDA_RESULT (cuGraphicsGLRegisterBuffer (_vertices, c->_positionBuffer, CU_GRAPHICS_REGISTER_FLAGS_NONE));
 
@@ -84,7 +84,7 @@ namespace Sim {
 				LOG_ERROR ("No file specified for normal texture coordinates");
 				return false;
 			}
-			Geometry* g = asset->GetComponent <Geometry> ("Geometry").get ();
+			Geometry* g = asset->GetComponent <Geometry> (SIM_COMPONENT_ID ("Geometry")).get ();
 			Vector2* ntc = new Vector2 [g->SurfaceVertexCount()];
 			if (!MeshLoader::LoadVertices <2> (location, ntc)){
 				LOG_ERROR ("Could not load normal texture coordinates from " << location);
@@ -171,7 +171,7 @@ namespace Sim {
 			// initialize index buffer
 			glGenBuffers (1, &_indexBuffer); LOG_GL_ERROR ();
 			glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, _indexBuffer); LOG_GL_ERROR ();
-			unsigned int* iptr = g->FaceIndexBuffer ();
+			const unsigned int* iptr = g->FaceIndexBuffer ();
 			glNamedBufferDataEXT (_indexBuffer, 3*sizeof (unsigned int)*g->FaceIndexCount (),
 					&iptr, GL_STATIC_DRAW); LOG_GL_ERROR ();
 			glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
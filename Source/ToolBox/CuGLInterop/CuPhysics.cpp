@@ -5,8 +5,10 @@
  *      Author: kishalay
  */
 
+#include <chrono>
 #include <iostream>
 
+#include "Mesh.h"
 #include "GLDisplay.h"
 #include "CuPhysics.h"
 
@@ -16,8 +18,13 @@ using std::shared_ptr;
 
 namespace Sim {
 
-	bool CuPhysics::Initialize (shared_ptr <Sim::GLDisplay>& d)
+	CuPhysics::CuPhysics ()
+	: _runFlag (false), _rate (60.), _display (nullptr), _context (nullptr)
+	{ }
+
+	bool CuPhysics::Initialize (shared_ptr <Sim::GLDisplay>& d, shared_ptr <Sim::Mesh>& m)
 	{
+		_mesh = m;
 		_display = d->GetDisplay ();
 		_context = glXCreateContextAttribsARB (_display, d->GetConfig (), d->GetContext (), true, d->GetContextAttributes ());
 		if (!_context){
@@ -33,9 +40,29 @@ namespace Sim {
 	{
 		glXMakeContextCurrent (_display, 0, 0, _context);
 
+		typedef std::chrono::steady_clock Clock;
+		const Clock::duration period = std::chrono::duration_cast <Clock::duration> (std::chrono::duration <double> (1./_rate));
+		Clock::time_point next = Clock::now ();
+
+		std::unique_lock <std::mutex> lock (_mutex);
 		while (_runFlag){
+			lock.unlock ();
+			// the CUDA step writes _mesh->WriteBuffer () here
+			_mesh->Publish ();
+			lock.lock ();
+
+			next += period;
+			_stopped.wait_until (lock, next, [this] {return !_runFlag;});
+		}
+	}
 
+	void CuPhysics::Stop ()
+	{
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			_runFlag = false;
 		}
+		_stopped.notify_all ();
 	}
 
 	void CuPhysics::Cleanup ()
@@ -9,24 +9,35 @@
  */
 #pragma once
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include "GL/GLUtils.h"
 
 namespace Sim {
 
 	class GLDisplay;
+	class Mesh;
 
 	class CuPhysics {
 
 	protected:
+		// the thread sleeps between steps; Stop () wakes it
+		std::mutex _mutex;
+		std::condition_variable _stopped;
 		bool _runFlag;
+		double _rate; // steps per second
+
 		::Display* _display;
 		::GLXContext _context;
+		std::shared_ptr <Mesh> _mesh;
 
 	public:
-		bool Initialize (std::shared_ptr <GLDisplay>&);
+		CuPhysics ();
+		bool Initialize (std::shared_ptr <GLDisplay>&, std::shared_ptr <Mesh>&);
 		void Run ();
+		void Stop ();
 		void Cleanup ();
 	};
 }
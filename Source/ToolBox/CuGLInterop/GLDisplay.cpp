@@ -5,6 +5,7 @@
  *      Author: kishalay
  */
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 
@@ -32,6 +33,7 @@ namespace Sim {
 			return false;
 		}
 
+		_mesh = m;
 		_runFlag = true;
 		return true;
 	}
@@ -42,11 +44,24 @@ namespace Sim {
 	  // make created context current
 		glXMakeContextCurrent (_display, _window, _window, _context);
 
+		// sleep until physics publishes new vertices (or Stop () is noticed)
+		unsigned int seen = _mesh->Publications ();
 		while (_runFlag){
-
+			if (!_mesh->WaitForPublication (seen, std::chrono::milliseconds (100))){
+				continue;
+			}
+			seen = _mesh->Publications ();
+			const Vector* vertices = _mesh->ReadBuffer ();
+			// the frame is drawn from 'vertices' here
+			(void) vertices;
 		}
 	}
 
+	void GLDisplay::Stop ()
+	{
+		_runFlag = false;
+	}
+
 	void GLDisplay::Cleanup ()
 	{
 		DestroyWindow ();
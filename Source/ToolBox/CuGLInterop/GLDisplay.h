@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include "GL/GLUtils.h"
@@ -21,7 +22,8 @@ namespace Sim {
 	class GLDisplay {
 
 	protected:
-		bool _runFlag;
+		std::atomic <bool> _runFlag;
+		std::shared_ptr <Mesh> _mesh;
 
 		int _top;
 		int _left;
@@ -42,6 +44,7 @@ namespace Sim {
 		~GLDisplay ();
 		bool Initialize (std::shared_ptr <Mesh>&);
 		void Run ();
+		void Stop ();
 		void Cleanup ();
 
 		Display* GetDisplay () const;
@@ -9,6 +9,7 @@
  */
 
 #include <memory>
+#include <vector>
 
 #include "Preprocess.h"
 
@@ -32,11 +33,15 @@ namespace Sim {
 	bool Mesh::Initialize (const char* vf, const char* ff)
 	{
 		_numVertices = MeshLoader::GetElementCount (vf);
-		_current = shared_ptr <Vector> (new Vector [_numVertices], DeleteArray <Vector> ());
-		if (!MeshLoader::LoadVertices <SIM_VECTOR_SIZE> (vf, _current. get())){
+		std::vector <Vector>& loaded = _vertices.Slot (0);
+		loaded.resize (_numVertices);
+		if (!MeshLoader::LoadVertices <SIM_VECTOR_SIZE> (vf, loaded.data ())){
 			Cleanup ();
 			return false;
 		}
+		// every buffer starts from the loaded state
+		_vertices.Slot (1) = loaded;
+		_vertices.Slot (2) = loaded;
 		_numFaces = MeshLoader::GetElementCount (ff);
 		_faces = shared_ptr <unsigned int> (new unsigned int [3*_numFaces], DeleteArray <unsigned int> ());
 		if (!MeshLoader::LoadIndices <3> (ff, _faces.get ())){
@@ -48,7 +53,9 @@ namespace Sim {
 
 	void Mesh::Cleanup ()
 	{
-		_current.reset ();
+		for (unsigned int i = 0; i < 3; ++i){
+			_vertices.Slot (i).clear ();
+		}
 		_faces.reset ();
 	}
 }
@@ -5,23 +5,25 @@
  * See LICENSE.txt included in this package
  *
  * @section DESCRIPTION
- * Mesh geometry.
+ * Mesh geometry. The vertices are handed from the physics thread to the
+ * display thread through a triple buffer, so neither waits for the other.
  */
 #pragma once
 
+#include <chrono>
 #include <memory>
-#include <mutex>
+#include <vector>
+
 #include "Vector.h"
+#include "TripleBuffer.h"
 
 namespace Sim {
 
 	class Mesh {
 
 	protected:
-		std::mutex _mutex;
-
 		unsigned int _numVertices;
-		std::shared_ptr <Vector> _current;
+		TripleBuffer <std::vector <Vector> > _vertices;
 
 		unsigned int _numFaces;
 		std::shared_ptr <unsigned int> _faces;
@@ -31,5 +33,18 @@ namespace Sim {
 		~Mesh ();
 		bool Initialize (const char* vertexFile, const char* indexFile);
 		void Cleanup ();
+
+		unsigned int VertexCount () const {return _numVertices;}
+		unsigned int FaceCount () const {return _numFaces;}
+		const unsigned int* FaceBuffer () const {return _faces.get ();}
+
+		// physics thread: fill the write buffer, then publish it
+		Vector* WriteBuffer () {return _vertices.Back ().data ();}
+		void Publish () {_vertices.Publish ();}
+
+		// display thread: the latest published vertices
+		const Vector* ReadBuffer () {_vertices.Acquire (); return _vertices.Front ().data ();}
+		unsigned int Publications () const {return _vertices.Sequence ();}
+		bool WaitForPublication (unsigned int seen, std::chrono::nanoseconds timeout) {return _vertices.Wait (seen, timeout);}
 	};
 }
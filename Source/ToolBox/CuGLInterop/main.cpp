@@ -12,6 +12,7 @@
 #include <cstring>
 #include <cstdlib>
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <thread>
@@ -35,13 +36,13 @@ using Sim::CuPhysics;
 
 void Invoke (Callback<void (void)> callback)
 {
-
+	callback ();
 }
 
 int main (int argc, const char** argv)
 {
 	if (argc < 3 || !strcmp ("-h", argv [1]) || !strcmp ("--help", argv [1])){
-		cerr << "Usage: Bin/cuglTest <vertex file> <index file>" << endl;
+		cerr << "Usage: Bin/cuglTest <vertex file> <index file> [seconds (10)]" << endl;
 		exit (EXIT_SUCCESS);
 	}
 
@@ -58,7 +59,7 @@ int main (int argc, const char** argv)
 		exit (EXIT_FAILURE);
 	}
 	shared_ptr <CuPhysics> physics= make_shared <CuPhysics> ();
-	if (!physics->Initialize (display)){
+	if (!physics->Initialize (display, mesh)){
 		cerr << "Could not load CUDA physics....Aborting" << endl;
 		display.reset ();
 		mesh.reset ();
@@ -68,6 +69,12 @@ int main (int argc, const char** argv)
 	thread t1 (Invoke, BIND_MEM_CB (&GLDisplay::Run, display.get ()));
 	thread t2 (Invoke, BIND_MEM_CB (&CuPhysics::Run, physics.get ()));
 
+	std::this_thread::sleep_for (std::chrono::seconds (argc > 3 ? atoi (argv [3]) : 10));
+	physics->Stop ();
+	display->Stop ();
+	t2.join ();
+	t1.join ();
+
 	physics->Cleanup ();
 	display->Cleanup ();
 	mesh.reset ();
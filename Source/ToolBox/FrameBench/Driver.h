@@ -0,0 +1,62 @@
+/**
+ * @file Driver.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * The driver of the frame benchmark. The engine sources built into the
+ * benchmark include "Driver.h" to reach the running driver; this header
+ * takes the place of the platform driver (see Common/Driver.h) for them.
+ * It only owns the asset factory and the CPU stand-in plugin loading the
+ * scene (see BenchPlugin.h): no display, GPU or plugin libraries.
+ */
+#pragma once
+
+#include <cstring>
+#include <memory>
+
+#include "Preprocess.h"
+
+#include "Plugins/Plugin.h"
+#include "Assets/AssetFactory.h"
+#include "Tasks/TaskManager.h"
+
+namespace Sim {
+
+	class Driver {
+
+		protected:
+			static Driver* _instance;
+
+			std::shared_ptr <Plugin> _plugin;
+			std::unique_ptr <AssetFactory> _assetFactory;
+			TaskManager* _taskManager; // of the running measurement
+
+		public:
+			Driver (): _taskManager (nullptr) {_instance = this;}
+			~Driver () {Cleanup (); _instance = nullptr;}
+
+			// forbidden copy constructor and assignment operator
+			Driver (const Driver&) = delete;
+			Driver& operator = (const Driver&) = delete;
+
+			static Driver& Instance () {return *_instance;}
+
+			// load the scene (an AssetsConfig file) and wait for every asset
+			bool Initialize (const char* scene);
+			void Cleanup ();
+
+			// the stand-in plugin answers for every loading plugin name
+			std::shared_ptr <Plugin> GetPlugin (unsigned int id) const {return _plugin;}
+			std::shared_ptr <Plugin> GetPlugin (const char* name) const {return _plugin;}
+
+			std::shared_ptr <Asset> GetAsset (unsigned int id) const {return _assetFactory->GetAsset (id);}
+			std::shared_ptr <Asset> GetAsset (const char* name) const {return _assetFactory->GetAsset (name);}
+			AssetFactory& GetAssetFactory () const {return *_assetFactory;}
+
+			// every measurement runs its own task manager
+			TaskManager& GetTaskManager () const {return *_taskManager;}
+			void SetTaskManager (TaskManager* manager) {_taskManager = manager;}
+	};
+}
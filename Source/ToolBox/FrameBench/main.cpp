@@ -0,0 +1,324 @@
+/**
+ * @file main.cpp
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Thread-count scaling benchmark of the whole simulation frame. A scene
+ * (an AssetsConfig file whose assets are loaded by the CPU stand-in
+ * plugin, see BenchPlugin.h) is loaded headlessly and the task graph of
+ * a scheduler configuration is run through the engine's task manager for
+ * a number of frames at 1, 2, 4 ... up to the maximum thread count. A
+ * frame runs every stage once (with its sub-steps) and publishes the
+ * geometries written by physics, as the rate scheduler does, but without
+ * pacing. Every thread count runs in the fast and in the deterministic
+ * mode of the task manager (see TaskManager.h), from the same initial
+ * state. Reported per run: frames/s, speed-up and efficiency relative to
+ * one thread of the same mode, the mean time of every stage and a digest
+ * of the collision results and final vertex buffers; per thread count
+ * the overhead of the deterministic mode; and whether the digests of a
+ * mode are identical across thread counts. The results are also written
+ * as JSON so that scaling can be compared across releases.
+ * Usage: ./Bin/benchFrame [scene] [scheduler config] [frames] [max threads] [json file]
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "Driver.h"
+#include "BenchPlugin.h"
+#include "Assets/Asset.h"
+#include "Assets/Geometry.h"
+#include "Tasks/TaskManager.h"
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+#	include "Tasks/Threads/ThreadTaskManager.h"
+#else
+#	include "Tasks/TBB/TBBTaskManager.h"
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using tinyxml2::XMLDocument;
+using tinyxml2::XMLElement;
+using Sim::Assets::Geometry;
+
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+	typedef Sim::ThreadTaskManager BenchTaskManager;
+	const static char* SIM_BENCH_SCHEDULER = "Assets/Config/Bench/ThreadsConfig.xml";
+#else
+	typedef Sim::TBBTaskManager BenchTaskManager;
+	const static char* SIM_BENCH_SCHEDULER = "Assets/Config/Bench/TBBConfig.xml";
+#endif
+
+// warm-up frames before timing (first touch, grain tuning)
+const static unsigned int SIM_BENCH_WARMUP = 10;
+
+namespace Sim {
+
+	Driver* Driver::_instance = nullptr;
+
+	bool Driver::Initialize (const char* scene)
+	{
+		_plugin = std::make_shared <BenchPlugin> ();
+		_assetFactory.reset (new AssetFactory);
+		if (!_assetFactory->Initialize (scene)){
+			LOG_ERROR ("Could not load scene " << scene);
+			return false;
+		}
+		if (!_assetFactory->Wait ()){
+			LOG_ERROR ("Some assets of " << scene << " failed to load");
+			return false;
+		}
+		return true;
+	}
+
+	void Driver::Cleanup ()
+	{
+		_assetFactory.reset ();
+		if (_plugin){
+			_plugin->Cleanup ();
+			_plugin.reset ();
+		}
+	}
+}
+
+class ScalingRun {
+	public:
+		unsigned int _threads;
+		bool _deterministic;
+		unsigned long long _digest; // of the collision results and the final vertex buffers
+		double _frameTime; // seconds per frame
+		vector <unsigned int> _stages; // configured stage indices
+		vector <double> _stageTimes; // seconds per frame
+};
+
+// a copy of the scheduler configuration with the given worker count and mode
+static bool WriteConfig (const char* source, const string& target, unsigned int threads, bool deterministic)
+{
+	XMLDocument doc;
+	if (doc.LoadFile (source) != tinyxml2::XML_SUCCESS || doc.RootElement () == nullptr){
+		std::cerr << "Could not read " << source << endl;
+		return false;
+	}
+	XMLElement* workers = doc.RootElement ()->FirstChildElement ("Workers");
+	if (workers == nullptr){
+		workers = doc.NewElement ("Workers");
+		doc.RootElement ()->InsertFirstChild (workers);
+	}
+	workers->SetAttribute ("Count", threads);
+	XMLElement* mode = doc.RootElement ()->FirstChildElement ("Deterministic");
+	if (mode == nullptr){
+		mode = doc.NewElement ("Deterministic");
+		doc.RootElement ()->InsertAfterChild (workers, mode);
+	}
+	mode->SetAttribute ("Enabled", deterministic);
+	return doc.SaveFile (target.c_str ()) == tinyxml2::XML_SUCCESS;
+}
+
+static bool RunFrames (const char* config, unsigned int threads, bool deterministic, unsigned int frames, ScalingRun& run)
+{
+	string file = "/tmp/benchFrame.scheduler.xml";
+	if (!WriteConfig (config, file, threads, deterministic)){
+		return false;
+	}
+	BenchTaskManager manager;
+	if (!manager.Initialize (file.c_str ())){
+		std::cerr << "Could not initialize the task manager from " << config << endl;
+		return false;
+	}
+	Sim::Driver::Instance ().SetTaskManager (&manager);
+	const Sim::TaskGraph& graph = manager.Graph ();
+
+	// geometries each stage's physics writes; every run starts from the rest shapes
+	unsigned int gid = SIM_COMPONENT_ID ("Geometry");
+	vector <vector <shared_ptr <Geometry> > > published (graph.StageCount ());
+	vector <Sim::BenchCollision*> collisions;
+	for (unsigned int i = 0; i < graph.StageCount (); ++i){
+		for (auto &node : graph.Stage (i)._nodes){
+			for (auto &c : node._components){
+				Sim::Asset* owner = c->Owner ();
+				if (c->Name () == "Physics" && owner != nullptr && owner->HasComponent (gid)){
+					published [i].push_back (owner->GetComponent <Geometry> (gid));
+				}
+				if (Sim::FramePhysics* physics = dynamic_cast <Sim::FramePhysics*> (c.get ())){
+					physics->Reset ();
+				}
+				if (Sim::BenchCollision* collision = dynamic_cast <Sim::BenchCollision*> (c.get ())){
+					collision->Reset ();
+					collisions.push_back (collision);
+				}
+			}
+		}
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	run._threads = manager.ThreadCount ();
+	run._deterministic = manager.Deterministic ();
+	run._stageTimes.assign (graph.StageCount (), 0.);
+	for (auto &stage : graph.Stages ()){
+		run._stages.push_back (stage._index);
+	}
+	Clock::time_point start;
+	for (unsigned int f = 0; f < SIM_BENCH_WARMUP + frames; ++f){
+		if (f == SIM_BENCH_WARMUP){
+			std::fill (run._stageTimes.begin (), run._stageTimes.end (), 0.);
+			start = Clock::now ();
+		}
+		for (unsigned int i = 0; i < graph.StageCount (); ++i){
+			Clock::time_point begin = Clock::now ();
+			for (unsigned int s = 0; s < graph.Stage (i)._subSteps; ++s){
+				manager.UpdateStage (i);
+				for (auto &g : published [i]){
+					g->Update ();
+				}
+			}
+			run._stageTimes [i] += std::chrono::duration <double> (Clock::now () - begin).count ();
+		}
+	}
+	run._frameTime = std::chrono::duration <double> (Clock::now () - start).count () / frames;
+	for (auto &t : run._stageTimes){
+		t /= frames;
+	}
+
+	run._digest = 14695981039346656037ull;
+	for (auto c : collisions){
+		unsigned long long fingerprint = c->Fingerprint ();
+		Sim::Digest (run._digest, &fingerprint, sizeof (fingerprint));
+	}
+	for (auto &stage : published){
+		for (auto &g : stage){
+			Sim::Digest (run._digest, g->PreviousVertexBuffer (), g->SurfaceVertexCount ()*sizeof (Sim::Vector));
+		}
+	}
+	Sim::Driver::Instance ().SetTaskManager (nullptr);
+	manager.Cleanup ();
+	return true;
+}
+
+// all runs of a mode gave the same digest
+static bool Identical (const vector <ScalingRun>& runs, bool deterministic)
+{
+	const ScalingRun* first = nullptr;
+	for (auto &run : runs){
+		if (run._deterministic != deterministic){
+			continue;
+		}
+		if (first != nullptr && run._digest != first->_digest){
+			return false;
+		}
+		first = first == nullptr ? &run : first;
+	}
+	return true;
+}
+
+// the run of the other mode at the same thread count, and the one-thread run of the same mode
+static const ScalingRun& Counterpart (const vector <ScalingRun>& runs, unsigned int r) {return runs [r ^ 1];}
+static const ScalingRun& Baseline (const vector <ScalingRun>& runs, unsigned int r) {return runs [r & 1];}
+
+static void WriteJson (std::ostream& out, const char* scene, const char* config, unsigned int frames, const vector <ScalingRun>& runs)
+{
+	out << "{" << endl;
+	out << "\t\"scene\": \"" << scene << "\"," << endl;
+	out << "\t\"scheduler\": \"" << config << "\"," << endl;
+	out << "\t\"frames\": " << frames << "," << endl;
+	out << "\t\"identical\": {\"fast\": " << (Identical (runs, false) ? "true" : "false")
+			<< ", \"deterministic\": " << (Identical (runs, true) ? "true" : "false") << "}," << endl;
+	out << "\t\"runs\": [" << endl;
+	for (unsigned int r = 0; r < runs.size (); ++r){
+		const ScalingRun& run = runs [r];
+		const ScalingRun& baseline = Baseline (runs, r);
+		double speedup = baseline._frameTime / run._frameTime;
+		out << "\t\t{\"threads\": " << run._threads << ", \"mode\": \"" << (run._deterministic ? "deterministic" : "fast")
+				<< "\", \"fps\": " << 1./run._frameTime << ", \"speedup\": " << speedup
+				<< ", \"efficiency\": " << speedup * baseline._threads / run._threads;
+		if (run._deterministic){
+			out << ", \"overhead\": " << run._frameTime / Counterpart (runs, r)._frameTime - 1.;
+		}
+		out << ", \"digest\": \"" << std::hex << run._digest << std::dec << "\", \"stages\": {";
+		for (unsigned int i = 0; i < run._stageTimes.size (); ++i){
+			out << (i > 0 ? ", " : "") << "\"" << run._stages [i] << "\": " << 1000.*run._stageTimes [i];
+		}
+		out << "}}" << (r + 1 < runs.size () ? "," : "") << endl;
+	}
+	out << "\t]" << endl;
+	out << "}" << endl;
+}
+
+int main (int argc, char** argv)
+{
+	const char* scene = argc > 1 ? argv [1] : "Assets/Config/Bench/Scene.xml";
+	const char* config = argc > 2 ? argv [2] : SIM_BENCH_SCHEDULER;
+	unsigned int frames = argc > 3 ? static_cast <unsigned int> (atoi (argv [3])) : 200;
+	unsigned int maxThreads = argc > 4 ? static_cast <unsigned int> (atoi (argv [4])) : std::thread::hardware_concurrency ();
+	const char* json = argc > 5 ? argv [5] : "benchFrame.json";
+	if (frames == 0 || maxThreads == 0){
+		std::cerr << "Usage: ./Bin/benchFrame [scene] [scheduler config] [frames] [max threads] [json file]" << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	Sim::Driver driver;
+	if (!driver.Initialize (scene)){
+		exit (EXIT_FAILURE);
+	}
+
+	// 1, 2, 4 ... and the maximum
+	vector <unsigned int> counts;
+	for (unsigned int t = 1; t < maxThreads; t *= 2){
+		counts.push_back (t);
+	}
+	counts.push_back (maxThreads);
+
+	// fast and deterministic runs alternate
+	vector <ScalingRun> runs;
+	for (auto t : counts){
+		for (int mode = 0; mode < 2; ++mode){
+			ScalingRun run;
+			if (!RunFrames (config, t, mode == 1, frames, run)){
+				exit (EXIT_FAILURE);
+			}
+			runs.push_back (run);
+		}
+	}
+	cout << "threads\tmode\tframes/s\tspeed-up\tefficiency\toverhead\tdigest\tstage ms" << endl;
+	for (unsigned int r = 0; r < runs.size (); ++r){
+		const ScalingRun& run = runs [r];
+		const ScalingRun& baseline = Baseline (runs, r);
+		double speedup = baseline._frameTime / run._frameTime;
+		cout << run._threads << "\t" << (run._deterministic ? "determ." : "fast") << "\t" << 1./run._frameTime << "\t"
+				<< speedup << "\t" << speedup * baseline._threads / run._threads << "\t";
+		if (run._deterministic){
+			cout << 100.*(run._frameTime / Counterpart (runs, r)._frameTime - 1.) << "%";
+		}
+		cout << "\t" << std::hex << run._digest << std::dec << "\t";
+		for (unsigned int i = 0; i < run._stageTimes.size (); ++i){
+			cout << (i > 0 ? " " : "") << run._stages [i] << ":" << 1000.*run._stageTimes [i];
+		}
+		cout << endl;
+	}
+	cout << "Identical across thread counts: fast " << (Identical (runs, false) ? "yes" : "no")
+			<< ", deterministic " << (Identical (runs, true) ? "yes" : "no") << endl;
+
+	std::ofstream out (json);
+	if (!out.is_open ()){
+		std::cerr << "Could not write " << json << endl;
+		exit (EXIT_FAILURE);
+	}
+	WriteJson (out, scene, config, frames, runs);
+	cout << "Results written to " << json << endl;
+
+	driver.Cleanup ();
+	exit (EXIT_SUCCESS);
+}
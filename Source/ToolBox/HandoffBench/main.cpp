@@ -0,0 +1,245 @@
+/***
+ * Benchmark and check of the lock-free hand-off of vertex state from a
+ * simulation thread to presentation threads. The simulation thread stamps
+ * every vertex of its write buffer with the frame number and publishes it
+ * at a fixed rate; presentation threads sleep until a new state is
+ * published, latch it, verify that every vertex carries the same stamp
+ * (no tearing) and that stamps never go back, and keep the latched buffer
+ * for a while as drawing would. Two hand-offs are measured:
+ *   ring:   the Geometry vertex ring shared by all presentation threads
+ *           (Latch/ReleaseVertexBuffer (), WaitForPublication ());
+ *   triple: the TripleBuffer template, with one presentation thread.
+ * Latency is the time from publishing a state to a presentation thread
+ * holding it. The writer's publication time shows it never waits for the
+ * readers. The exit status is non-zero if any state was torn or stale.
+ * Usage: ./Bin/benchHandoff [rate Hz] [readers] [seconds] [hold us]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Vector.h"
+#include "TripleBuffer.h"
+#include "BenchMesh.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+using Sim::Real;
+using Sim::Vector;
+using Sim::TripleBuffer;
+using Sim::Assets::Geometry;
+
+typedef std::chrono::steady_clock Clock;
+
+// what a presentation thread saw
+class BenchReader {
+	public:
+		vector <double> _latencies; // seconds
+		unsigned long long _torn;
+		unsigned long long _stale;
+
+		BenchReader (): _torn (0), _stale (0) {}
+};
+
+static double Percentile (vector <double>& samples, double p)
+{
+	if (samples.empty ()){
+		return 0.;
+	}
+	size_t n = static_cast <size_t> (p/100.*(samples.size () - 1));
+	std::nth_element (samples.begin (), samples.begin () + n, samples.end ());
+	return samples [n];
+}
+
+// the stamp of a whole buffer, or -1 if its vertices disagree
+static long long Stamp (const Vector* vertices, unsigned int count)
+{
+	Real stamp = vertices [0][0];
+	for (unsigned int i = 0; i < count; ++i){
+		for (unsigned int j = 0; j < 3; ++j){
+			if (vertices [i][j] != stamp){
+				return -1;
+			}
+		}
+	}
+	return static_cast <long long> (stamp);
+}
+
+// check one latched state and record its latency
+static void Present (BenchReader& reader, const Vector* vertices, unsigned int count, long long& last,
+		const vector <std::atomic <long long> >& published, std::chrono::microseconds hold)
+{
+	Clock::time_point now = Clock::now ();
+	long long stamp = Stamp (vertices, count);
+	if (stamp < 0){
+		++reader._torn;
+	} else if (stamp < last){
+		++reader._stale;
+	} else if (stamp > last){
+		last = stamp;
+		if (stamp > 0 && static_cast <size_t> (stamp) < published.size ()){
+			Clock::time_point publish (Clock::duration (published [stamp].load ()));
+			reader._latencies.push_back (std::chrono::duration <double> (now - publish).count ());
+		}
+	}
+	// drawing holds on to the state
+	std::this_thread::sleep_for (hold);
+	// the buffer must not change while it is held
+	if (Stamp (vertices, count) != stamp){
+		++reader._torn;
+	}
+}
+
+static bool Report (const string& name, vector <BenchReader>& readers, vector <double>& writes, unsigned long long frames)
+{
+	unsigned long long torn = 0, stale = 0, seen = 0;
+	vector <double> latencies;
+	for (auto &r : readers){
+		torn += r._torn;
+		stale += r._stale;
+		seen += r._latencies.size ();
+		latencies.insert (latencies.end (), r._latencies.begin (), r._latencies.end ());
+	}
+	cout << name << "\t" << frames << "\t" << seen/readers.size () << "\t" << Percentile (latencies, 50.)*1e6 << "\t"
+			<< Percentile (latencies, 99.)*1e6 << "\t" << Percentile (latencies, 100.)*1e6 << "\t" << Percentile (writes, 99.)*1e6
+			<< "\t" << Percentile (writes, 100.)*1e6 << "\t" << torn << "\t" << stale << endl;
+	return torn == 0 && stale == 0;
+}
+
+// the simulation thread: stamp, publish at 'rate' and time the publication
+template <class Write, class Publish> static vector <double> Simulate (double rate, unsigned long long frames,
+		vector <std::atomic <long long> >& published, Write write, Publish publish)
+{
+	vector <double> writes;
+	writes.reserve (frames);
+	const Clock::duration period = std::chrono::duration_cast <Clock::duration> (std::chrono::duration <double> (1./rate));
+	Clock::time_point next = Clock::now ();
+	for (unsigned long long f = 1; f <= frames; ++f){
+		write (static_cast <Real> (f));
+		Clock::time_point start = Clock::now ();
+		published [f].store (start.time_since_epoch ().count ());
+		publish ();
+		writes.push_back (std::chrono::duration <double> (Clock::now () - start).count ());
+		next += period;
+		std::this_thread::sleep_until (next);
+	}
+	return writes;
+}
+
+int main (int argc, char** argv)
+{
+	double rate = argc > 1 ? atof (argv [1]) : 1000.;
+	unsigned int numReaders = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : 2;
+	double seconds = argc > 3 ? atof (argv [3]) : 2.;
+	std::chrono::microseconds hold (argc > 4 ? atoi (argv [4]) : 500);
+	if (rate <= 0. || numReaders == 0 || seconds <= 0. || hold.count () < 0){
+		std::cerr << "Usage: ./Bin/benchHandoff [rate Hz] [readers] [seconds] [hold us]" << endl;
+		exit (EXIT_FAILURE);
+	}
+	unsigned long long frames = static_cast <unsigned long long> (rate*seconds);
+
+	string dir = "/tmp/benchHandoff";
+	if (!Sim::WriteMesh (dir, "Torus", 1, 128)){
+		exit (EXIT_FAILURE);
+	}
+	tinyxml2::XMLDocument doc;
+	tinyxml2::XMLElement* config = doc.NewElement ("Geometry");
+	config->SetAttribute ("Prefix", "Torus");
+	config->SetAttribute ("Location", dir.c_str ());
+	config->SetAttribute ("Depth", 1);
+	Geometry geometry;
+	if (!geometry.Initialize (*config, nullptr)){
+		std::cerr << "Could not load the benchmark mesh from " << dir << endl;
+		exit (EXIT_FAILURE);
+	}
+	unsigned int count = geometry.VertexCount ();
+
+	cout << count << " vertices at " << rate << " Hz for " << seconds << " s, states held for " << hold.count () << " us" << endl;
+	cout << "handoff\tstates\tseen/reader\tp50 us\tp99 us\tmax us\tpublish p99 us\tpublish max us\ttorn\tstale" << endl;
+	bool success = true;
+
+	// the vertex ring of the core, shared by all readers
+	{
+		vector <std::atomic <long long> > published (frames + 1);
+		vector <BenchReader> readers (numReaders);
+		std::atomic <bool> running (true);
+		vector <std::thread> threads;
+		for (unsigned int r = 0; r < numReaders; ++r){
+			threads.emplace_back ([&, r] {
+				long long last = 0;
+				unsigned int seen = geometry.Publications ();
+				while (running.load ()){
+					if (!geometry.WaitForPublication (seen, std::chrono::milliseconds (10))){
+						continue;
+					}
+					seen = geometry.Publications ();
+					geometry.LatchVertexBuffer ();
+					Present (readers [r], geometry.LatchedVertexBuffer (), count, last, published, hold);
+					geometry.ReleaseVertexBuffer ();
+				}
+			});
+		}
+		vector <double> writes = Simulate (rate, frames, published,
+				[&geometry, count] (Real stamp) {
+					Vector* vertices = geometry.CurrentVertexBuffer ();
+					for (unsigned int i = 0; i < count; ++i){
+						vertices [i] = Vector (stamp);
+					}
+				},
+				[&geometry] {geometry.Update ();});
+		running.store (false);
+		for (auto &t : threads){
+			t.join ();
+		}
+		success = Report ("ring", readers, writes, frames) && success;
+	}
+
+	// the triple buffer, one reader
+	{
+		TripleBuffer <vector <Vector> > buffer;
+		for (unsigned int i = 0; i < 3; ++i){
+			buffer.Slot (i).assign (count, Vector (static_cast <Real> (0)));
+		}
+		vector <std::atomic <long long> > published (frames + 1);
+		vector <BenchReader> readers (1);
+		std::atomic <bool> running (true);
+		std::thread thread ([&] {
+			long long last = 0;
+			unsigned int seen = buffer.Sequence ();
+			while (running.load ()){
+				if (!buffer.Wait (seen, std::chrono::milliseconds (10))){
+					continue;
+				}
+				seen = buffer.Sequence ();
+				buffer.Acquire ();
+				Present (readers [0], buffer.Front ().data (), count, last, published, hold);
+			}
+		});
+		vector <double> writes = Simulate (rate, frames, published,
+				[&buffer, count] (Real stamp) {
+					Vector* vertices = buffer.Back ().data ();
+					for (unsigned int i = 0; i < count; ++i){
+						vertices [i] = Vector (stamp);
+					}
+				},
+				[&buffer] {buffer.Publish ();});
+		running.store (false);
+		thread.join ();
+		success = Report ("triple", readers, writes, frames) && success;
+	}
+
+	if (!success){
+		std::cerr << "Torn or stale states were presented" << endl;
+		exit (EXIT_FAILURE);
+	}
+	exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,202 @@
+/***
+ * Benchmark for the effect of task and memory locality on a multi-asset
+ * scene. Every asset owns a ring of three vertex buffers (like the
+ * Geometry component) and one physics-like step per frame reads the
+ * previous buffer and writes the current one. Two schedules are timed:
+ *   migrating: buffers are allocated by the main thread and an asset's
+ *              step moves to a different worker every frame (the default
+ *              behaviour of an unpinned scheduler);
+ *   local:     every worker is pinned to one processor (NUMA nodes filled
+ *              one after the other), an asset always runs on the same
+ *              worker and its buffers are first touched by that worker.
+ * Usage: ./Bin/benchLocality [assets] [vertices per asset] [frames]
+ */
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Tasks/Affinity.h"
+
+using std::cout;
+using std::endl;
+using std::vector;
+using Sim::Affinity;
+
+// a simulated asset: three buffers of 4-float vertices
+class BenchAsset {
+	public:
+		unsigned int _count;
+		std::unique_ptr <float []> _buffers;
+
+		explicit BenchAsset (unsigned int count): _count (count) {}
+
+		// allocate and first-touch the buffers from the calling thread
+		void Allocate ()
+		{
+			_buffers.reset (new float [12*_count]);
+			for (unsigned int i = 0; i < 12*_count; ++i){
+				_buffers [i] = static_cast <float> (i % 97) * 0.01f;
+			}
+		}
+
+		// damped smoothing step: read buffer 'frame', write buffer 'frame + 1'
+		void Step (unsigned int frame)
+		{
+			const float* prev = &_buffers [4*_count*(frame % 3)];
+			float* curr = &_buffers [4*_count*((frame + 1) % 3)];
+			for (unsigned int i = 1; i + 1 < _count; ++i){
+				for (unsigned int j = 0; j < 4; ++j){
+					curr [4*i + j] = 0.98f*prev [4*i + j] + 0.01f*(prev [4*(i - 1) + j] + prev [4*(i + 1) + j]);
+				}
+			}
+		}
+};
+
+// workers that run one job per frame and meet at a barrier
+class BenchPool {
+	protected:
+		vector <std::thread> _threads;
+		vector <unsigned int> _cpus; // empty: not pinned
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		std::function <void (unsigned int)> _job;
+		unsigned long long _generation;
+		unsigned int _pending;
+		bool _running;
+
+	public:
+		BenchPool (): _generation (0), _pending (0), _running (true) {}
+
+		void Start (unsigned int count, const vector <unsigned int>& cpus)
+		{
+			_cpus = cpus;
+			for (unsigned int i = 0; i < count; ++i){
+				_threads.emplace_back ([this, i] {Loop (i);});
+			}
+		}
+
+		void Stop ()
+		{
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_running = false;
+			}
+			_start.notify_all ();
+			for (auto &t : _threads){
+				t.join ();
+			}
+			_threads.clear ();
+		}
+
+		// run job (worker index) on every worker and wait for all of them
+		void Run (const std::function <void (unsigned int)>& job)
+		{
+			std::unique_lock <std::mutex> lock (_mutex);
+			_job = job;
+			_pending = static_cast <unsigned int> (_threads.size ());
+			++_generation;
+			_start.notify_all ();
+			_done.wait (lock, [this] {return _pending == 0;});
+		}
+
+	protected:
+		void Loop (unsigned int index)
+		{
+			if (!_cpus.empty ()){
+				Affinity::SetThreadAffinity (vector <unsigned int> (1, _cpus [index % _cpus.size ()]));
+			}
+			unsigned long long seen = 0;
+			while (true){
+				std::function <void (unsigned int)> job;
+				{
+					std::unique_lock <std::mutex> lock (_mutex);
+					_start.wait (lock, [this, seen] {return _generation != seen || !_running;});
+					if (!_running){
+						return;
+					}
+					seen = _generation;
+					job = _job;
+				}
+				job (index);
+				std::lock_guard <std::mutex> lock (_mutex);
+				if (--_pending == 0){
+					_done.notify_one ();
+				}
+			}
+		}
+};
+
+static double RunScene (bool local, unsigned int numAssets, unsigned int numVertices,
+		unsigned int frames, const vector <unsigned int>& cpus)
+{
+	unsigned int numWorkers = static_cast <unsigned int> (cpus.size ());
+	vector <std::unique_ptr <BenchAsset> > assets;
+	for (unsigned int a = 0; a < numAssets; ++a){
+		assets.emplace_back (new BenchAsset (numVertices));
+	}
+
+	BenchPool pool;
+	pool.Start (numWorkers, local ? cpus : vector <unsigned int> ());
+
+	// placement: first touch by the owning worker, or by the main thread
+	if (local){
+		pool.Run ([&] (unsigned int w) {
+			for (unsigned int a = w; a < numAssets; a += numWorkers){
+				assets [a]->Allocate ();
+			}
+		});
+	} else {
+		for (auto &a : assets){
+			a->Allocate ();
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now ();
+	for (unsigned int f = 0; f < frames; ++f){
+		unsigned int shift = local ? 0 : f;
+		pool.Run ([&] (unsigned int w) {
+			for (unsigned int a = 0; a < numAssets; ++a){
+				if ((a + shift) % numWorkers == w){
+					assets [a]->Step (f);
+				}
+			}
+		});
+	}
+	double elapsed = std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count ();
+	pool.Stop ();
+	return elapsed / frames;
+}
+
+int main (int argc, char** argv)
+{
+	unsigned int numAssets = argc > 1 ? static_cast <unsigned int> (atoi (argv [1])) : 32;
+	unsigned int numVertices = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : 1 << 18;
+	unsigned int frames = argc > 3 ? static_cast <unsigned int> (atoi (argv [3])) : 200;
+	if (numAssets == 0 || numVertices < 3 || frames == 0){
+		std::cerr << "Usage: ./Bin/benchLocality [assets] [vertices per asset] [frames]" << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	Affinity affinity;
+	affinity.Initialize ();
+	vector <unsigned int> cpus = affinity.AllCpus ();
+
+	cout << "Scene: " << numAssets << " assets x " << numVertices << " vertices, " << frames << " frames, "
+			<< cpus.size () << " workers on " << affinity.NodeCount () << " NUMA node(s)" << endl;
+
+	double migrating = RunScene (false, numAssets, numVertices, frames, cpus);
+	double local = RunScene (true, numAssets, numVertices, frames, cpus);
+
+	cout << "migrating: " << migrating*1000. << " ms/frame" << endl;
+	cout << "local:     " << local*1000. << " ms/frame" << endl;
+	cout << "speed-up:  " << migrating/local << "x" << endl;
+
+	exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,271 @@
+/***
+ * Benchmark for the worst-case latency of a haptic-rate update under
+ * heavy background physics load. A feeder keeps the pool saturated with
+ * long background tasks (collision-like) while a haptic thread ticks at
+ * 1 kHz; every tick spawns a few short tasks and waits for them. The
+ * latency of a tick is the time from its due time to the end of its last
+ * task; a tick that overruns its period drops the ticks it overlapped,
+ * as the rate scheduler does. The pool follows the scheduling policies of ThreadTaskManager:
+ *   shared:   one FIFO queue for all work, a waiting thread helps with
+ *             any job (the scheduler without priority classes);
+ *   priority: one queue per class, workers take the most urgent job at
+ *             every task boundary and a waiter only helps with work at
+ *             least as urgent as its own;
+ *   reserved: as priority, with workers reserved for the haptic class.
+ * Usage: ./Bin/benchPriority [workers] [reserved] [seconds] [background task ms]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+typedef std::chrono::steady_clock Clock;
+
+// priority classes of the benchmark, most urgent first
+typedef enum {
+	BENCH_HAPTIC,
+	BENCH_BACKGROUND,
+	BENCH_CLASSES
+} BenchClass;
+
+// short tasks spawned by every haptic tick
+const static unsigned int SIM_HAPTIC_TASKS = 4;
+const static unsigned int SIM_HAPTIC_TASK_US = 50;
+const static unsigned int SIM_HAPTIC_PERIOD_US = 1000;
+
+// busy work for the given time
+static void Spin (std::chrono::microseconds length)
+{
+	Clock::time_point end = Clock::now () + length;
+	volatile unsigned int sink = 0;
+	while (Clock::now () < end){
+		for (unsigned int i = 0; i < 256; ++i){
+			sink = sink + i;
+		}
+	}
+}
+
+class BenchJob {
+	public:
+		std::function <void ()> _task;
+		std::atomic <unsigned int>* _pending;
+};
+
+class BenchPool {
+	protected:
+		vector <std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::deque <BenchJob> _queues [BENCH_CLASSES];
+		bool _prioritized;
+		bool _running;
+
+	public:
+		// workers [0, reserved) only run haptic work
+		BenchPool (unsigned int workers, unsigned int reserved, bool prioritized)
+		: _prioritized (prioritized), _running (true)
+		{
+			for (unsigned int i = 0; i < workers; ++i){
+				BenchClass lowest = i < reserved ? BENCH_HAPTIC : BENCH_BACKGROUND;
+				_threads.emplace_back ([this, lowest] {Loop (lowest);});
+			}
+		}
+
+		~BenchPool ()
+		{
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_running = false;
+				for (auto &q : _queues){
+					q.clear ();
+				}
+			}
+			_wake.notify_all ();
+			for (auto &t : _threads){
+				t.join ();
+			}
+		}
+
+		void Run (BenchClass c, std::atomic <unsigned int>& pending, const std::function <void ()>& task)
+		{
+			pending.fetch_add (1);
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				BenchJob job;
+				job._task = task;
+				job._pending = &pending;
+				_queues [_prioritized ? c : 0].push_back (job);
+			}
+			_wake.notify_all ();
+		}
+
+		// block until pending drops to 0, helping with jobs of classes up to 'lowest'
+		void Wait (std::atomic <unsigned int>& pending, BenchClass lowest)
+		{
+			while (pending.load () > 0){
+				BenchJob job;
+				if (Pop (lowest, job)){
+					Execute (job);
+				} else {
+					std::this_thread::yield ();
+				}
+			}
+		}
+
+		unsigned int Backlog ()
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			return static_cast <unsigned int> (_queues [0].size () + _queues [1].size ());
+		}
+
+	protected:
+		bool Pop (BenchClass lowest, BenchJob& job)
+		{
+			std::lock_guard <std::mutex> lock (_mutex);
+			return PopLocked (lowest, job);
+		}
+
+		bool PopLocked (BenchClass lowest, BenchJob& job)
+		{
+			for (unsigned int c = 0; c < BENCH_CLASSES; ++c){
+				// without classes every job sits in the first queue
+				if (!_queues [c].empty () && (!_prioritized || c <= static_cast <unsigned int> (lowest))){
+					job = _queues [c].front ();
+					_queues [c].pop_front ();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void Execute (BenchJob& job)
+		{
+			job._task ();
+			job._pending->fetch_sub (1);
+		}
+
+		void Loop (BenchClass lowest)
+		{
+			while (true){
+				BenchJob job;
+				{
+					std::unique_lock <std::mutex> lock (_mutex);
+					_wake.wait (lock, [&] {return !_running || PopLocked (lowest, job);});
+					if (!_running){
+						return;
+					}
+				}
+				Execute (job);
+			}
+		}
+};
+
+class BenchResult {
+	public:
+		vector <double> _latencies; // microseconds, per tick
+		unsigned int _dropped; // ticks skipped after an overrun
+		double _background; // background tasks per second
+
+		BenchResult (): _dropped (0), _background (0.) {}
+};
+
+static BenchResult RunPolicy (bool prioritized, unsigned int workers, unsigned int reserved, double seconds, unsigned int backgroundMs)
+{
+	BenchPool pool (workers, reserved, prioritized);
+	std::atomic <bool> running (true);
+
+	// keep two background tasks queued per worker
+	std::atomic <unsigned int> background (0);
+	std::atomic <unsigned int> finished (0);
+	std::thread feeder ([&] {
+		while (running.load ()){
+			if (pool.Backlog () < 2*workers){
+				pool.Run (BENCH_BACKGROUND, background, [&finished, backgroundMs] {
+					Spin (std::chrono::milliseconds (backgroundMs));
+					finished.fetch_add (1);
+				});
+			} else {
+				std::this_thread::sleep_for (std::chrono::microseconds (100));
+			}
+		}
+	});
+
+	// the haptic rate thread runs outside the pool, like a rate group of the scheduler
+	BenchResult result;
+	Clock::time_point start = Clock::now ();
+	Clock::time_point due = start;
+	Clock::time_point stop = start + std::chrono::microseconds (static_cast <long long> (seconds*1e6));
+	while (due < stop){
+		std::this_thread::sleep_until (due);
+		std::atomic <unsigned int> pending (0);
+		for (unsigned int i = 0; i < SIM_HAPTIC_TASKS; ++i){
+			pool.Run (BENCH_HAPTIC, pending, [] {Spin (std::chrono::microseconds (SIM_HAPTIC_TASK_US));});
+		}
+		pool.Wait (pending, BENCH_HAPTIC);
+		Clock::time_point end = Clock::now ();
+		result._latencies.push_back (std::chrono::duration <double, std::micro> (end - due).count ());
+		due += std::chrono::microseconds (SIM_HAPTIC_PERIOD_US);
+		while (due < end){
+			due += std::chrono::microseconds (SIM_HAPTIC_PERIOD_US);
+			++result._dropped;
+		}
+	}
+	result._background = finished.load () / std::chrono::duration <double> (Clock::now () - start).count ();
+
+	running.store (false);
+	feeder.join ();
+	return result;
+}
+
+static void Report (const char* name, BenchResult& result)
+{
+	vector <double>& l = result._latencies;
+	std::sort (l.begin (), l.end ());
+	double mean = 0.;
+	unsigned int missed = 0;
+	for (double d : l){
+		mean += d;
+		missed += d > SIM_HAPTIC_PERIOD_US ? 1 : 0;
+	}
+	mean /= l.size ();
+	cout << name << "mean " << mean << " us, p99 " << l [l.size ()*99/100] << " us, max " << l.back ()
+			<< " us, missed " << missed << "/" << l.size () << " ticks (" << result._dropped << " dropped), background "
+			<< result._background << " tasks/s" << endl;
+}
+
+int main (int argc, char** argv)
+{
+	unsigned int workers = argc > 1 ? static_cast <unsigned int> (atoi (argv [1])) : std::thread::hardware_concurrency ();
+	unsigned int reserved = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : (workers > 1 ? 1 : 0);
+	double seconds = argc > 3 ? atof (argv [3]) : 5.;
+	unsigned int backgroundMs = argc > 4 ? static_cast <unsigned int> (atoi (argv [4])) : 10;
+	if (workers == 0 || reserved >= workers || seconds <= 0. || backgroundMs == 0){
+		std::cerr << "Usage: ./Bin/benchPriority [workers] [reserved < workers] [seconds] [background task ms]" << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	cout << "Haptic tick: " << SIM_HAPTIC_TASKS << " x " << SIM_HAPTIC_TASK_US << " us every " << SIM_HAPTIC_PERIOD_US
+			<< " us; background tasks of " << backgroundMs << " ms on " << workers << " worker(s)" << endl;
+
+	BenchResult shared = RunPolicy (false, workers, 0, seconds, backgroundMs);
+	BenchResult priority = RunPolicy (true, workers, 0, seconds, backgroundMs);
+	BenchResult isolated = RunPolicy (true, workers, reserved, seconds, backgroundMs);
+
+	Report ("shared:   ", shared);
+	Report ("priority: ", priority);
+	cout << "reserved (" << reserved << "):" << endl;
+	Report ("          ", isolated);
+
+	exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,226 @@
+/**
+ * @file BenchMesh.h
+ * @author Kishalay Kundu <kishalay.kundu@gmail.com>
+ * @section LICENSE
+ * See LICENSE.txt included in this package
+ *
+ * @section DESCRIPTION
+ * Synthetic scene content shared by the benchmarks: a finely tessellated
+ * torus written in the asset mesh format (cut into 8^depth spatial
+ * subsets), and a CPU physics component over a Geometry that can be
+ * split over those subsets.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "Vector.h"
+#include "Snapshot.h"
+#include "Assets/Geometry.h"
+#include "Assets/Physics.h"
+
+namespace Sim {
+
+	// interleave the low 10 bits of x, y and z
+	inline unsigned int Morton (unsigned int x, unsigned int y, unsigned int z)
+	{
+		unsigned int code = 0;
+		for (unsigned int b = 0; b < 10; ++b){
+			code |= ((x >> b) & 1) << (3*b) | ((y >> b) & 1) << (3*b + 1) | ((z >> b) & 1) << (3*b + 2);
+		}
+		return code;
+	}
+
+	/**
+	 * Write a torus of n x n/2 quads (two faces each) as <dir>/<depth>/<name>.node
+	 * and <name>.<i>.tri. Vertices are numbered and faces grouped along a Morton
+	 * curve, so that each subset is a compact region with contiguous vertices.
+	 */
+	inline bool WriteMesh (const std::string& dir, const std::string& name, unsigned int depth, unsigned int n)
+	{
+		unsigned int rings = n, segments = n/2;
+		unsigned int numVertices = rings*segments;
+		std::vector <float> positions (3*numVertices);
+		for (unsigned int i = 0; i < rings; ++i){
+			for (unsigned int j = 0; j < segments; ++j){
+				float u = 6.2831853f*i/rings, v = 6.2831853f*j/segments;
+				float* p = &positions [3*(i*segments + j)];
+				p [0] = (2.f + std::cos (v))*std::cos (u);
+				p [1] = (2.f + std::cos (v))*std::sin (u);
+				p [2] = std::sin (v);
+			}
+		}
+
+		// renumber the vertices along the Morton curve of their position
+		auto code = [] (const float* p) {
+			return Morton (static_cast <unsigned int> ((p [0] + 3.f)/6.f*1023.f),
+					static_cast <unsigned int> ((p [1] + 3.f)/6.f*1023.f), static_cast <unsigned int> ((p [2] + 1.f)/2.f*1023.f));
+		};
+		std::vector <unsigned int> order (numVertices), rank (numVertices);
+		for (unsigned int i = 0; i < numVertices; ++i){
+			order [i] = i;
+		}
+		std::sort (order.begin (), order.end (), [&] (unsigned int a, unsigned int b) {
+			return code (&positions [3*a]) < code (&positions [3*b]);
+		});
+		for (unsigned int i = 0; i < numVertices; ++i){
+			rank [order [i]] = i;
+		}
+
+		std::vector <unsigned int> faces;
+		for (unsigned int i = 0; i < rings; ++i){
+			for (unsigned int j = 0; j < segments; ++j){
+				unsigned int a = i*segments + j, b = ((i + 1) % rings)*segments + j;
+				unsigned int c = ((i + 1) % rings)*segments + (j + 1) % segments, d = i*segments + (j + 1) % segments;
+				unsigned int quad [6] = {a, b, c, a, c, d};
+				for (auto q : quad){
+					faces.push_back (rank [q]);
+				}
+			}
+		}
+		unsigned int numFaces = static_cast <unsigned int> (faces.size ()/3);
+		unsigned int numSubsets = 1u << (3*depth);
+		if (numFaces < numSubsets){
+			std::cerr << "Tessellation too coarse for " << numSubsets << " subsets" << std::endl;
+			return false;
+		}
+
+		// group the faces by the Morton code of their centroid
+		std::vector <unsigned int> forder (numFaces);
+		std::vector <unsigned int> fcode (numFaces);
+		for (unsigned int f = 0; f < numFaces; ++f){
+			float c [3] = {0.f, 0.f, 0.f};
+			for (unsigned int k = 0; k < 3; ++k){
+				for (unsigned int j = 0; j < 3; ++j){
+					c [j] += positions [3*order [faces [3*f + k]] + j]/3.f;
+				}
+			}
+			forder [f] = f;
+			fcode [f] = code (c);
+		}
+		std::sort (forder.begin (), forder.end (), [&] (unsigned int a, unsigned int b) {return fcode [a] < fcode [b];});
+
+		std::string path = dir + "/" + std::to_string (depth);
+		mkdir (dir.c_str (), 0755);
+		mkdir (path.c_str (), 0755);
+		std::string prefix = path + "/" + name;
+
+		FILE* fp = fopen ((prefix + ".node").c_str (), "w");
+		if (fp == nullptr){
+			std::cerr << "Could not write " << prefix << ".node" << std::endl;
+			return false;
+		}
+		fprintf (fp, "%u\n", numVertices);
+		for (unsigned int i = 0; i < numVertices; ++i){
+			const float* p = &positions [3*order [i]];
+			fprintf (fp, "%f %f %f\n", p [0], p [1], p [2]);
+		}
+		fclose (fp);
+
+		for (unsigned int s = 0; s < numSubsets; ++s){
+			unsigned int first = static_cast <unsigned int> (static_cast <unsigned long long> (numFaces)*s/numSubsets);
+			unsigned int last = static_cast <unsigned int> (static_cast <unsigned long long> (numFaces)*(s + 1)/numSubsets);
+			std::string file = prefix + "." + std::to_string (s) + ".tri";
+			fp = fopen (file.c_str (), "w");
+			if (fp == nullptr){
+				std::cerr << "Could not write " << file << std::endl;
+				return false;
+			}
+			fprintf (fp, "%u\n", last - first);
+			for (unsigned int f = first; f < last; ++f){
+				const unsigned int* t = &faces [3*forder [f]];
+				fprintf (fp, "%u %u %u\n", t [0], t [1], t [2]);
+			}
+			fclose (fp);
+		}
+		return true;
+	}
+
+	// a physics component that can be split: owned vertices written, halo read from the previous buffer
+	class BenchPhysics : public Assets::Physics {
+		protected:
+			Assets::Geometry& _geometry;
+			std::vector <unsigned int> _offsets; // neighbour lists (CSR)
+			std::vector <unsigned int> _neighbours;
+			std::vector <Vector> _rest;
+			Real _phase;
+
+		public:
+			// without precomputation the state is expected from Restore ()
+			explicit BenchPhysics (Assets::Geometry& geometry, bool precompute = true): _geometry (geometry), _phase (0.)
+			{
+				if (!precompute){
+					return;
+				}
+				unsigned int count = geometry.SurfaceVertexCount ();
+				const unsigned int* faces = geometry.FaceIndexBuffer ();
+				std::vector <std::vector <unsigned int> > adjacency (count);
+				for (unsigned int f = 0; f < geometry.FaceIndexCount (); ++f){
+					for (unsigned int k = 0; k < 3; ++k){
+						adjacency [faces [3*f + k]].push_back (faces [3*f + (k + 1) % 3]);
+						adjacency [faces [3*f + (k + 1) % 3]].push_back (faces [3*f + k]);
+					}
+				}
+				_offsets.push_back (0);
+				for (auto &a : adjacency){
+					std::sort (a.begin (), a.end ());
+					a.erase (std::unique (a.begin (), a.end ()), a.end ());
+					_neighbours.insert (_neighbours.end (), a.begin (), a.end ());
+					_offsets.push_back (static_cast <unsigned int> (_neighbours.size ()));
+				}
+				_rest.assign (geometry.PreviousVertexBuffer (), geometry.PreviousVertexBuffer () + count);
+			}
+
+			virtual unsigned int SubsetCount () const override {return _geometry.SubsetCount ();}
+
+			virtual void UpdateSubset (unsigned int subset) override
+			{
+				const Vector* prev = _geometry.PreviousVertexBuffer ();
+				Vector* curr = _geometry.CurrentVertexBuffer ();
+				for (auto v : _geometry.SubsetVertices (subset)){
+					Vector average (Vector::ZERO);
+					for (unsigned int k = _offsets [v]; k < _offsets [v + 1]; ++k){
+						average += prev [_neighbours [k]];
+					}
+					average /= static_cast <Real> (_offsets [v + 1] - _offsets [v]);
+					average -= prev [v];
+					average *= 0.1;
+
+					Vector target (_rest [v]);
+					target *= 1. + 0.05*std::sin (_phase + _rest [v][0]);
+					for (unsigned int j = 0; j < 3; ++j){
+						curr [v][j] = target [j] + average [j];
+					}
+				}
+			}
+
+			// the halo was only read: nothing to reconcile
+			virtual void MergeSubsets () override {}
+
+			void SetPhase (Real phase) {_phase = phase;}
+
+			// the neighbour lists and rest shape are saved with the phase
+			virtual bool Save (SnapshotWriter& snapshot) const override
+			{
+				snapshot.Write (_offsets);
+				snapshot.Write (_neighbours);
+				snapshot.Write (_rest);
+				snapshot.Write (_phase);
+				return true;
+			}
+
+			virtual bool Restore (SnapshotReader& snapshot) override
+			{
+				return snapshot.Read (_offsets) && snapshot.Read (_neighbours) && snapshot.Read (_rest) && snapshot.Read (_phase);
+			}
+	};
+
+	// threads that share the subsets of a parallel loop with the calling thread
+}
@@ -0,0 +1,225 @@
+/***
+ * Scaling benchmark for intra-asset parallelism. A single large mesh (a
+ * finely tessellated torus) is written in the asset format with its faces
+ * cut into 8^depth spatial subsets, and loaded through the Geometry
+ * component. Every frame runs the split task chain the task manager runs
+ * for an asset entry with 'Split="true"':
+ *   physics:  per subset, a spring-like smoothing step that writes the
+ *             owned vertices of the current buffer and reads neighbours
+ *             (including the halo) from the previous one;
+ *   geometry: per subset, bounds and vertex normals of the current buffer,
+ *             then the halo normals are merged into their owners;
+ * and publishes the buffer. The frame is timed for 1 to N threads, and
+ * the merged normals are checked against a serial computation.
+ * Usage: ./Bin/benchSubsets [depth] [tessellation] [frames] [threads]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tinyxml2.h"
+#include "Vector.h"
+#include "Assets/Geometry.h"
+#include "BenchMesh.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using Sim::Real;
+using Sim::Vector;
+using Sim::Assets::Geometry;
+using Sim::BenchPhysics;
+using Sim::WriteMesh;
+
+class BenchPool {
+	protected:
+		vector <std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		std::function <void (unsigned int)> _job;
+		std::atomic <unsigned int> _next;
+		unsigned int _count;
+		unsigned long long _generation;
+		unsigned int _pending;
+		bool _running;
+
+	public:
+		explicit BenchPool (unsigned int threads)
+		: _next (0), _count (0), _generation (0), _pending (0), _running (true)
+		{
+			for (unsigned int i = 1; i < threads; ++i){
+				_threads.emplace_back ([this] {Loop ();});
+			}
+		}
+
+		~BenchPool ()
+		{
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_running = false;
+			}
+			_start.notify_all ();
+			for (auto &t : _threads){
+				t.join ();
+			}
+		}
+
+		// run job (index) for every index of [0, count), one index at a time
+		void ParallelFor (unsigned int count, const std::function <void (unsigned int)>& job)
+		{
+			{
+				std::lock_guard <std::mutex> lock (_mutex);
+				_job = job;
+				_count = count;
+				_next.store (0);
+				_pending = static_cast <unsigned int> (_threads.size ());
+				++_generation;
+			}
+			_start.notify_all ();
+			Work ();
+			std::unique_lock <std::mutex> lock (_mutex);
+			_done.wait (lock, [this] {return _pending == 0;});
+		}
+
+	protected:
+		void Work ()
+		{
+			for (unsigned int i = _next.fetch_add (1); i < _count; i = _next.fetch_add (1)){
+				_job (i);
+			}
+		}
+
+		void Loop ()
+		{
+			unsigned long long seen = 0;
+			while (true){
+				{
+					std::unique_lock <std::mutex> lock (_mutex);
+					_start.wait (lock, [this, seen] {return _generation != seen || !_running;});
+					if (!_running){
+						return;
+					}
+					seen = _generation;
+				}
+				Work ();
+				std::lock_guard <std::mutex> lock (_mutex);
+				if (--_pending == 0){
+					_done.notify_one ();
+				}
+			}
+		}
+};
+
+// one frame of the split chain of TaskManager::RunChain (), then publish
+static void RunFrame (BenchPool& pool, BenchPhysics& physics, Geometry& geometry, unsigned int frame)
+{
+	physics.SetPhase (0.05*frame);
+	pool.ParallelFor (physics.SubsetCount (), [&physics] (unsigned int s) {physics.UpdateSubset (s);});
+	physics.MergeSubsets ();
+	pool.ParallelFor (geometry.SubsetCount (), [&geometry] (unsigned int s) {geometry.UpdateSubset (s);});
+	geometry.MergeSubsets ();
+	geometry.Update ();
+}
+
+// largest deviation of the merged normals from a serial computation over the published buffer
+static Real CheckNormals (Geometry& geometry)
+{
+	unsigned int count = geometry.SurfaceVertexCount ();
+	const Vector* vertices = geometry.PreviousVertexBuffer ();
+	const unsigned int* f = geometry.FaceIndexBuffer ();
+	vector <Vector> reference (count, Vector::ZERO);
+	for (unsigned int i = 0; i < geometry.FaceIndexCount (); ++i, f += 3){
+		Vector e1 (vertices [f [1]]);
+		e1 -= vertices [f [0]];
+		Vector e2 (vertices [f [2]]);
+		e2 -= vertices [f [0]];
+		Vector n;
+		e1.Cross (e2, n);
+		for (unsigned int j = 0; j < 3; ++j){
+			reference [f [j]] += n;
+		}
+	}
+	Real error = 0.;
+	const Vector* normals = geometry.NormalBuffer ();
+	for (unsigned int v = 0; v < count; ++v){
+		for (unsigned int j = 0; j < 3; ++j){
+			error = std::max (error, static_cast <Real> (std::fabs (normals [v][j] - reference [v][j])));
+		}
+	}
+	return error;
+}
+
+int main (int argc, char** argv)
+{
+	unsigned int depth = argc > 1 ? static_cast <unsigned int> (atoi (argv [1])) : 2;
+	unsigned int n = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : 1024;
+	unsigned int frames = argc > 3 ? static_cast <unsigned int> (atoi (argv [3])) : 100;
+	unsigned int maxThreads = argc > 4 ? static_cast <unsigned int> (atoi (argv [4])) : std::thread::hardware_concurrency ();
+	if (depth == 0 || depth > 3 || n < 8 || frames == 0){
+		std::cerr << "Usage: ./Bin/benchSubsets [depth (1-3)] [tessellation] [frames] [threads]" << endl;
+		exit (EXIT_FAILURE);
+	}
+	if (maxThreads == 0){
+		maxThreads = 1;
+	}
+
+	string dir = "/tmp/benchSubsets";
+	if (!WriteMesh (dir, "Torus", depth, n)){
+		exit (EXIT_FAILURE);
+	}
+	tinyxml2::XMLDocument doc;
+	tinyxml2::XMLElement* config = doc.NewElement ("Geometry");
+	config->SetAttribute ("Prefix", "Torus");
+	config->SetAttribute ("Location", dir.c_str ());
+	config->SetAttribute ("Depth", depth);
+
+	Geometry geometry;
+	if (!geometry.Initialize (*config, nullptr)){
+		std::cerr << "Could not load the benchmark mesh from " << dir << endl;
+		exit (EXIT_FAILURE);
+	}
+	BenchPhysics physics (geometry);
+
+	unsigned int halo = 0;
+	for (unsigned int s = 0; s < geometry.SubsetCount (); ++s){
+		halo += static_cast <unsigned int> (geometry.SubsetHalo (s).size ());
+	}
+	cout << "Mesh: " << geometry.SurfaceVertexCount () << " vertices, " << geometry.FaceIndexCount () << " faces in "
+			<< geometry.SubsetCount () << " subsets (" << halo << " halo vertices), " << frames << " frames" << endl;
+	cout << "threads\tms/frame\tspeed-up\tefficiency" << endl;
+
+	double serial = 0.;
+	for (unsigned int t = 1; t <= maxThreads; t = t < maxThreads && 2*t > maxThreads ? maxThreads : 2*t){
+		BenchPool pool (t);
+		RunFrame (pool, physics, geometry, 0);
+
+		auto start = std::chrono::steady_clock::now ();
+		for (unsigned int f = 1; f <= frames; ++f){
+			RunFrame (pool, physics, geometry, f);
+		}
+		double elapsed = std::chrono::duration <double> (std::chrono::steady_clock::now () - start).count () / frames;
+		if (t == 1){
+			serial = elapsed;
+		}
+		cout << t << "\t" << elapsed*1000. << "\t" << serial/elapsed << "\t" << serial/elapsed/t << endl;
+		if (t == maxThreads){
+			break;
+		}
+	}
+
+	cout << "halo check: max normal deviation " << CheckNormals (geometry) << endl;
+	exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,326 @@
+/***
+ * Benchmark of data-oriented component storage (see ComponentSystem.h).
+ * Two scenes of the same N assets are generated, whose only component is
+ * the stand-in plugin's Motion (see BenchPlugin.h): in one it is an object
+ * per asset, in the other an element of the factory's Motion system. Every
+ * asset gets its own target through a tool pose. From the same initial
+ * state, each way of updating the component of every asset runs for a
+ * number of frames:
+ *   objects: one pass over the asset's components, a virtual update each
+ *            (the components are wherever the loading threads put them);
+ *   lookup:  the asset looked up by its configuration id and then its
+ *            component, every frame;
+ *   handle:  the same through the asset's handle (see AssetFactory.h);
+ *   system:  one pass over the system's array;
+ *   tasks:   the system run by a <System> entry of a task graph, split into
+ *            blocks over the workers of the task manager.
+ * Reported: time per asset update, speed-up over the objects and a digest
+ * of the final positions, which must be identical for every way. The
+ * results are also written as JSON.
+ * Usage: ./Bin/benchSystem [assets] [frames] [json file]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "tinyxml2.h"
+#include "Preprocess.h"
+
+#include "Driver.h"
+#include "BenchPlugin.h"
+#include "Assets/Asset.h"
+#include "Assets/AssetFactory.h"
+#include "Assets/ComponentSystem.h"
+#include "Events/InputLog.h"
+#include "Tasks/TaskManager.h"
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+#	include "Tasks/Threads/ThreadTaskManager.h"
+#else
+#	include "Tasks/TBB/TBBTaskManager.h"
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using Sim::Asset;
+using Sim::AssetFactory;
+using Sim::BenchMotion;
+using Sim::MotionState;
+using Sim::MotionSystem;
+
+#ifdef SIM_THREAD_SCHEDULER_ENABLED
+	typedef Sim::ThreadTaskManager BenchTaskManager;
+	const static char* SIM_BENCH_ROOT = "ThreadsConfig";
+#else
+	typedef Sim::TBBTaskManager BenchTaskManager;
+	const static char* SIM_BENCH_ROOT = "TBBConfig";
+#endif
+
+// generated scenes and configurations
+const static char* SIM_BENCH_DIR = "/tmp/benchSystem";
+// first asset id of the scenes
+const static unsigned int SIM_BENCH_FIRST_ID = 20001;
+// warm-up frames before timing
+const static unsigned int SIM_BENCH_WARMUP = 10;
+
+namespace Sim {
+
+	Driver* Driver::_instance = nullptr;
+
+	// the driver's scene is the one with the Motion system, which the task graph runs
+	bool Driver::Initialize (const char* scene)
+	{
+		_plugin = std::make_shared <BenchPlugin> ();
+		_assetFactory.reset (new AssetFactory);
+		if (!_assetFactory->Initialize (scene) || !_assetFactory->Wait ()){
+			LOG_ERROR ("Could not load scene " << scene);
+			return false;
+		}
+		return true;
+	}
+
+	void Driver::Cleanup ()
+	{
+		_assetFactory.reset ();
+		if (_plugin){
+			_plugin->Cleanup ();
+			_plugin.reset ();
+		}
+	}
+}
+
+class StorageRun {
+	public:
+		string _name;
+		double _time; // seconds per asset update
+		unsigned long long _digest; // of the final positions
+};
+
+// an asset configuration with the Motion component only, stored as given
+static bool WriteAssetConfig (const string& file, const char* storage)
+{
+	std::ofstream out (file);
+	out << "<AssetConfig>" << endl << endl;
+	out << "\t<Motion Storage=\"" << storage << "\" Stiffness=\"40\" Damping=\"4\" Step=\"0.002\"/>" << endl << endl;
+	out << "</AssetConfig>" << endl;
+	return out.good ();
+}
+
+static bool WriteScene (const string& file, const string& config, unsigned int assets)
+{
+	std::ofstream out (file);
+	out << "<AssetsConfig>" << endl << endl;
+	out << "\t<ComponentIdMap>" << endl;
+	out << "\t  <Map Name=\"Geometry\" Key=\"31452\"/>" << endl;
+	out << "\t  <Map Name=\"Motion\" Key=\"47120\"/>" << endl;
+	out << "\t</ComponentIdMap>" << endl << endl;
+	out << "\t<Assets Async=\"true\" Loaders=\"0\">" << endl;
+	for (unsigned int i = 0; i < assets; ++i){
+		out << "\t\t<Asset Name=\"Point" << i << "\" ID=\"" << SIM_BENCH_FIRST_ID + i << "\" Type=\"Point_Bench\" Config=\"" << config << "\">" << endl;
+		out << "\t\t\t<Component Type=\"Motion\" LoadingPlugin=\"Bench\"/>" << endl;
+		out << "\t\t</Asset>" << endl;
+	}
+	out << "\t</Assets>" << endl << endl;
+	out << "</AssetsConfig>" << endl;
+	return out.good ();
+}
+
+// a scheduler configuration whose only task runs the Motion system
+static bool WriteSchedulerConfig (const string& file)
+{
+	std::ofstream out (file);
+	out << "<" << SIM_BENCH_ROOT << ">" << endl << endl;
+	out << "\t<Workers Count=\"0\" SpinCount=\"64\"/>" << endl;
+	out << "\t<Rates Default=\"60\" MaxCatchUp=\"4\" Pipelined=\"false\" Interpolate=\"false\"/>" << endl;
+	out << "\t<Affinity Enabled=\"false\"/>" << endl;
+	out << "\t<Priorities/>" << endl;
+	out << "\t<Profiler Enabled=\"false\"/>" << endl;
+	out << "\t<Grain Adaptive=\"false\"/>" << endl;
+	out << "\t<Deterministic Enabled=\"false\"/>" << endl;
+	out << "\t<Quality Enabled=\"false\"/>" << endl << endl;
+	out << "\t<Task Index=\"1\" Type=\"Parallel\">" << endl;
+	out << "\t\t<System Component=\"Motion\"/>" << endl;
+	out << "\t</Task>" << endl << endl;
+	out << "</" << SIM_BENCH_ROOT << ">" << endl;
+	return out.good ();
+}
+
+// a different target for every asset
+static void AimAssets (AssetFactory& factory, unsigned int assets)
+{
+	for (unsigned int i = 0; i < assets; ++i){
+		vector <double> pose = {static_cast <double> (i % 17), static_cast <double> (i % 11) - 5., 0.25*(i % 7), 0., 0., 0., 1.};
+		factory.GetAsset (SIM_BENCH_FIRST_ID + i)->ApplyInput (Sim::Input (Sim::INPUT_TOOL_POSE, SIM_BENCH_FIRST_ID + i, pose));
+	}
+}
+
+// runs 'update' (all assets once) for the warm-up and timed frames, from the initial states
+static void Run (StorageRun& run, unsigned int assets, unsigned int frames, vector <MotionState*> states, const vector <MotionState>& initial,
+		const std::function <void ()>& update)
+{
+	for (unsigned int i = 0; i < assets; ++i){
+		*states [i] = initial [i];
+	}
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start;
+	for (unsigned int f = 0; f < SIM_BENCH_WARMUP + frames; ++f){
+		if (f == SIM_BENCH_WARMUP){
+			start = Clock::now ();
+		}
+		update ();
+	}
+	run._time = std::chrono::duration <double> (Clock::now () - start).count () / frames / assets;
+	run._digest = 14695981039346656037ull;
+	for (auto s : states){
+		Sim::Digest (run._digest, s->_position, sizeof (s->_position));
+	}
+}
+
+static bool Identical (const vector <StorageRun>& runs)
+{
+	for (auto &run : runs){
+		if (run._digest != runs [0]._digest){
+			return false;
+		}
+	}
+	return true;
+}
+
+static void WriteJson (std::ostream& out, unsigned int assets, unsigned int frames, unsigned int threads, const vector <StorageRun>& runs)
+{
+	out << "{" << endl;
+	out << "\t\"assets\": " << assets << "," << endl;
+	out << "\t\"frames\": " << frames << "," << endl;
+	out << "\t\"threads\": " << threads << "," << endl;
+	out << "\t\"identical\": " << (Identical (runs) ? "true" : "false") << "," << endl;
+	out << "\t\"runs\": [" << endl;
+	for (unsigned int r = 0; r < runs.size (); ++r){
+		out << "\t\t{\"storage\": \"" << runs [r]._name << "\", \"ns_per_update\": " << 1e9*runs [r]._time
+				<< ", \"speedup\": " << runs [0]._time / runs [r]._time
+				<< ", \"digest\": \"" << std::hex << runs [r]._digest << std::dec << "\"}" << (r + 1 < runs.size () ? "," : "") << endl;
+	}
+	out << "\t]" << endl;
+	out << "}" << endl;
+}
+
+int main (int argc, char** argv)
+{
+	unsigned int assets = argc > 1 ? static_cast <unsigned int> (atoi (argv [1])) : 2000;
+	unsigned int frames = argc > 2 ? static_cast <unsigned int> (atoi (argv [2])) : 2000;
+	const char* json = argc > 3 ? argv [3] : "benchSystem.json";
+	if (assets == 0 || frames == 0){
+		std::cerr << "Usage: ./Bin/benchSystem [assets] [frames] [json file]" << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	string dir (SIM_BENCH_DIR);
+	mkdir (dir.c_str (), 0755);
+	string objectScene = dir + "/ObjectScene.xml", systemScene = dir + "/SystemScene.xml", scheduler = dir + "/Scheduler.xml";
+	if (!WriteAssetConfig (dir + "/Object.xml", "Asset") || !WriteAssetConfig (dir + "/System.xml", "System") ||
+			!WriteScene (objectScene, dir + "/Object.xml", assets) || !WriteScene (systemScene, dir + "/System.xml", assets) ||
+			!WriteSchedulerConfig (scheduler)){
+		std::cerr << "Could not write the scenes to " << dir << endl;
+		exit (EXIT_FAILURE);
+	}
+
+	Sim::Driver driver;
+	if (!driver.Initialize (systemScene.c_str ())){
+		exit (EXIT_FAILURE);
+	}
+	AssetFactory objects;
+	if (!objects.Initialize (objectScene.c_str ()) || !objects.Wait ()){
+		std::cerr << "Could not load scene " << objectScene << endl;
+		exit (EXIT_FAILURE);
+	}
+	AssetFactory& systems = driver.GetAssetFactory ();
+	AimAssets (objects, assets);
+	AimAssets (systems, assets);
+
+	unsigned int mid = SIM_COMPONENT_ID ("Motion");
+	vector <shared_ptr <Sim::Assets::Component> > components;
+	vector <MotionState*> objectStates, elementStates;
+	vector <Sim::AssetHandle> handles;
+	for (unsigned int i = 0; i < assets; ++i){
+		shared_ptr <Asset> a = objects.GetAsset (SIM_BENCH_FIRST_ID + i);
+		shared_ptr <BenchMotion> motion = a->GetComponent <BenchMotion> (mid);
+		components.push_back (motion);
+		handles.push_back (a->Handle ());
+		objectStates.push_back (&motion->State ());
+		elementStates.push_back (systems.GetAsset (SIM_BENCH_FIRST_ID + i)->GetElement <MotionState> (mid));
+		if (elementStates.back () == nullptr){
+			std::cerr << "Asset " << SIM_BENCH_FIRST_ID + i << " has no Motion element" << endl;
+			exit (EXIT_FAILURE);
+		}
+	}
+	shared_ptr <Sim::Assets::ComponentSystem> system = systems.GetSystem (mid);
+	if (!system || system->Count () != assets){
+		std::cerr << "The Motion system does not hold every asset" << endl;
+		exit (EXIT_FAILURE);
+	}
+	vector <MotionState> initial;
+	for (auto s : objectStates){
+		initial.push_back (*s);
+	}
+
+	vector <StorageRun> runs (5);
+	runs [0]._name = "objects";
+	Run (runs [0], assets, frames, objectStates, initial, [&] () {
+		for (auto &c : components){
+			c->Update ();
+		}
+	});
+	runs [1]._name = "lookup";
+	Run (runs [1], assets, frames, objectStates, initial, [&] () {
+		for (unsigned int i = 0; i < assets; ++i){
+			objects.GetAsset (SIM_BENCH_FIRST_ID + i)->GetComponent <Sim::Assets::Component> (mid)->Update ();
+		}
+	});
+	runs [2]._name = "handle";
+	Run (runs [2], assets, frames, objectStates, initial, [&] () {
+		for (auto &h : handles){
+			objects.GetAsset (h)->GetComponent <Sim::Assets::Component> (mid)->Update ();
+		}
+	});
+	runs [3]._name = "system";
+	Run (runs [3], assets, frames, elementStates, initial, [&] () {system->Update ();});
+
+	BenchTaskManager manager;
+	if (!manager.Initialize (scheduler.c_str ()) || manager.Graph ().StageCount () == 0){
+		std::cerr << "Could not initialize the task manager from " << scheduler << endl;
+		exit (EXIT_FAILURE);
+	}
+	driver.SetTaskManager (&manager);
+	runs [4]._name = "tasks";
+	Run (runs [4], assets, frames, elementStates, initial, [&] () {manager.UpdateStage (0);});
+	unsigned int threads = manager.ThreadCount ();
+	driver.SetTaskManager (nullptr);
+	manager.Cleanup ();
+
+	cout << assets << " assets, " << frames << " frames, " << system->SubsetCount () << " blocks over " << threads << " threads" << endl;
+	cout << "storage\tns/update\tspeed-up\tdigest" << endl;
+	for (auto &run : runs){
+		cout << run._name << "\t" << 1e9*run._time << "\t" << runs [0]._time / run._time << "\t" << std::hex << run._digest << std::dec << endl;
+	}
+	cout << "Identical across storages: " << (Identical (runs) ? "yes" : "no") << endl;
+
+	std::ofstream out (json);
+	if (!out.is_open ()){
+		std::cerr << "Could not write " << json << endl;
+		exit (EXIT_FAILURE);
+	}
+	WriteJson (out, assets, frames, threads, runs);
+	cout << "Results written to " << json << endl;
+
+	objects.Cleanup ();
+	driver.Cleanup ();
+	exit (EXIT_SUCCESS);
+}